@@ -0,0 +1,179 @@
+#pragma once
+#include <unistd.h>
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "StreamClient.h"
+#include "StreamingTpkt.h"
+
+//
+// TestUtil - helpers, that are shared by tests (each test is a separate executable, that returns non-zero on failure)
+//
+
+#define KEY_FRAME_INTERVAL      10
+
+inline std::atomic<int> gErrorNumber{0};
+
+#define CHECK(expr) { \
+        if ( !(expr) ) { \
+            _LOG( "CHECK FAILED: " << __FILE__ << ":" << __LINE__ << ": " #expr ); \
+            gErrorNumber++; \
+        } \
+    }
+
+// makePayload - payload of frame 'i'
+inline std::vector<uint8_t> makePayload( uint32_t i, size_t size )
+{
+    std::vector<uint8_t> payload( size );
+    for( size_t k = 0; k < payload.size(); k++ )
+    {
+        payload[k] = uint8_t( i*7 + k );
+    }
+    return payload;
+}
+
+// makeFrame - STREAMING_DATA { frameFlags, i, payload } (every KEY_FRAME_INTERVAL-th frame is a key frame)
+inline catapult::streaming::StreamingTpkt makeFrame( uint32_t i, size_t payloadSize )
+{
+    using namespace catapult::streaming;
+
+    std::vector<uint8_t> payload = makePayload( i, payloadSize );
+
+    StreamingTpkt pkt( uint32_t( 12+payload.size() ), cmd::STREAMING_DATA );
+    pkt.writeUint32( uint32_t( (i%KEY_FRAME_INTERVAL == 0) ? frame::KEY_FRAME : 0 ) );
+    pkt.writeUint32( i );
+    pkt.writeBytes( payload.data(), uint32_t(payload.size()) );
+    pkt.updatePacketLenght();
+    return pkt;
+}
+
+inline catapult::streaming::StreamingTpkt makeFrame( uint32_t i )
+{
+    return makeFrame( i, 1000+i );
+}
+
+// isFrameValid - the received frame 'i' is the same as it was sent by 'makeFrame()'
+inline bool isFrameValid( const catapult::streaming::StreamingTpktRcv& response, uint32_t i )
+{
+    // (packetLenght, version, command, frameFlags, i, payloadLenght)
+    catapult::net::TpktBufferPtr received = response.sharedBuffer();
+    if ( received->lenght() < 24 )
+        return false;
+
+    catapult::streaming::StreamingTpkt expected = makeFrame( i, received->lenght()-24 );
+    return received->lenght() == expected.lenght() && memcmp( received->data(), expected.ptr(), expected.lenght() ) == 0;
+}
+
+// readResponse - returns responseId
+template<class Client>
+uint32_t readResponse( Client& tcpClient, catapult::streaming::StreamingTpktRcv& response )
+{
+    if ( !tcpClient.read( (catapult::net::TpktRcv&)response ) )
+        throw std::runtime_error( tcpClient.errorMessage() );
+
+    uint32_t version, responseId;
+    response.read( version, responseId );
+    return responseId;
+}
+
+// connect - sends the first request; it throws, if the request is not accepted
+inline std::unique_ptr<catapult::streaming::IStreamClient> connect( uint32_t port, catapult::streaming::StreamingTpkt request )
+{
+    using namespace catapult::streaming;
+
+    auto tcpClient = createStreamingClient();
+    if ( !tcpClient->connect( "127.0.0.1", port ) )
+        throw std::runtime_error( tcpClient->errorMessage() );
+    if ( !tcpClient->write( request ) )
+        throw std::runtime_error( tcpClient->errorMessage() );
+
+    StreamingTpktRcv response;
+    if ( readResponse( *tcpClient, response ) != cmd::OK_STREAMING_RESPONSE )
+        throw std::runtime_error( "request is not accepted" );
+    return tcpClient;
+}
+
+// waitFor - returns false after the timeout
+template<class Predicate>
+bool waitFor( Predicate predicate, int timeoutMs = 20000 )
+{
+    for( int ms = 0; !predicate(); ms += 10 )
+    {
+        if ( ms >= timeoutMs )
+            return false;
+        usleep( 10000 );
+    }
+    return true;
+}
+
+//
+// Viewer - a live viewer, that reads frames by its own thread, until the connection is closed (or 'frameLimit' frames are read)
+//
+struct Viewer
+{
+    std::atomic<uint32_t>   m_frameNumber{0};
+    std::atomic<uint32_t>   m_firstFrame{uint32_t(-1)};
+    std::atomic<uint32_t>   m_lastFrame{uint32_t(-1)};
+    std::atomic<bool>       m_hasGap{false};
+    std::atomic<bool>       m_hasBadData{false};
+    std::atomic<bool>       m_isClosed{false};
+    std::thread             m_thread;
+
+    Viewer( uint32_t port, const std::string& streamId, uint32_t frameLimit = uint32_t(-1) )
+    {
+        using namespace catapult::streaming;
+
+        std::shared_ptr<IStreamClient> tcpClient = connect( port, StreamingTpkt( 0, cmd::START_LIFE_STREAM_VIEWING, streamId ) );
+
+        m_thread = std::thread( [this,tcpClient,frameLimit]
+        {
+            StreamingTpktRcv response;
+            try
+            {
+                while( m_frameNumber < frameLimit && readResponse( *tcpClient, response ) == cmd::STREAMING_DATA )
+                {
+                    uint32_t frameFlags, i;
+                    response.read( frameFlags, i );
+                    if ( m_lastFrame == uint32_t(-1) )
+                    {
+                        m_firstFrame = i;
+                    }
+                    else if ( i != m_lastFrame+1 )
+                    {
+                        _LOG( "viewer: frame " << i << " after " << m_lastFrame );
+                        m_hasGap = true;
+                    }
+
+                    if ( !isFrameValid( response, i ) )
+                    {
+                        m_hasBadData = true;
+                    }
+
+                    m_lastFrame = i;
+                    m_frameNumber++;
+                }
+            }
+            catch( std::runtime_error& ) {}
+
+            // (the connection is closed by the viewer, if it has read 'frameLimit' frames)
+            tcpClient->close();
+            m_isClosed = true;
+        });
+    }
+
+    ~Viewer()
+    {
+        join();
+    }
+
+    void join()
+    {
+        if ( m_thread.joinable() )
+            m_thread.join();
+    }
+};
@@ -0,0 +1,170 @@
+#include <unistd.h>
+
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include "StreamClient.h"
+#include "StreamManager.h"
+#include "PacketSchema.h"
+#include "HandlerMemory.h"
+#include "TestUtil.h"
+
+//
+// allocationTest - forwarding of frames by the server does not allocate memory in steady state (see HandlerMemory.h)
+//
+
+using namespace catapult::net;
+using namespace catapult::streaming;
+
+#define PORT                    7661
+#define STREAM_ID               "ALLOCATION"
+#define VIEWER_NUMBER           4
+#define WARM_UP_FRAME_NUMBER    100
+#define FRAME_NUMBER            200
+
+// allocations of the server threads (threads of the test are not counted)
+std::atomic<uint64_t>   gServerAllocationNumber{0};
+thread_local bool       gIsTestThread = false;
+
+void* operator new( size_t size )
+{
+    if ( !gIsTestThread )
+        gServerAllocationNumber++;
+
+    void* pointer = std::malloc( size == 0 ? 1 : size );
+    if ( pointer == nullptr )
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void operator delete( void* pointer ) noexcept
+{
+    std::free( pointer );
+}
+
+void operator delete( void* pointer, size_t ) noexcept
+{
+    std::free( pointer );
+}
+
+// testHandlerMemory - the memory is reused by the next operation; the heap is used, if it is busy or too small
+void testHandlerMemory()
+{
+    gIsTestThread = false;
+    uint64_t allocationNumber = gServerAllocationNumber;
+
+    HandlerMemory memory;
+    void* first = memory.allocate( 100 );
+    memory.deallocate( first );
+    void* second = memory.allocate( 200 );
+    CHECK( second == first );
+    CHECK( gServerAllocationNumber == allocationNumber );
+
+    // busy
+    void* third = memory.allocate( 100 );
+    CHECK( third != first );
+    CHECK( gServerAllocationNumber == allocationNumber+1 );
+    memory.deallocate( third );
+    memory.deallocate( second );
+
+    // too big
+    void* big = memory.allocate( 100*1000 );
+    CHECK( big != first );
+    CHECK( gServerAllocationNumber == allocationNumber+2 );
+    memory.deallocate( big );
+
+    CHECK( memory.allocate( 100 ) == first );
+    memory.deallocate( first );
+
+    gIsTestThread = true;
+}
+
+// testForwarding - frames are received from the streamer and written to viewers without allocations
+void testForwarding()
+{
+    std::string streamId( STREAM_ID );
+
+    auto streamer = connect( PORT, StartStreamingRequest::encode( StreamId( streamId ), 0 ) );
+
+    std::vector<std::unique_ptr<IStreamClient>> viewers;
+    for( int i = 0; i < VIEWER_NUMBER; i++ )
+    {
+        viewers.push_back( connect( PORT, StreamingTpkt( 0, cmd::START_LIFE_STREAM_VIEWING, streamId ) ) );
+    }
+
+    StreamingTpktRcv response;
+
+    // each frame is received by all viewers, before the next one is sent
+    std::vector<uint8_t> payload( 10*1000, 0xee );
+    uint64_t allocationNumber = 0;
+    for( uint32_t i = 0; i < WARM_UP_FRAME_NUMBER+FRAME_NUMBER; i++ )
+    {
+        if ( i == WARM_UP_FRAME_NUMBER )
+        {
+            allocationNumber = gServerAllocationNumber;
+        }
+
+        StreamingGatherTpkt pkt( cmd::STREAMING_DATA );
+        pkt.writeUint32( (i%10 == 0) ? frame::KEY_FRAME : 0 );
+        pkt.writeUint32( i );
+        pkt.writeBytes( payload.data(), uint32_t(payload.size()) );
+        CHECK( streamer->write( pkt ) );
+        CHECK( readResponse( *streamer, response ) == cmd::OK_STREAMING_RESPONSE );
+
+        for( auto& viewer : viewers )
+        {
+            CHECK( readResponse( *viewer, response ) == cmd::STREAMING_DATA );
+            uint32_t frameFlags, frameNumber;
+            response.read( frameFlags, frameNumber );
+            CHECK( frameNumber == i );
+        }
+    }
+    allocationNumber = gServerAllocationNumber - allocationNumber;
+
+    _LOG( "allocations per " << FRAME_NUMBER << " frames: " << allocationNumber );
+    CHECK( allocationNumber == 0 );
+
+    std::string endStreamId( STREAM_ID );
+    StreamingTpkt endStreaming( 0, cmd::END_STREAMING, endStreamId );
+    CHECK( streamer->write( endStreaming ) );
+}
+
+int main( int, const char* [] )
+{
+    gIsTestThread = true;
+
+    // (the resume ring grows only until its limit is reached; here it is reached by the warm-up frames)
+    DistributorConfig config;
+    config.m_resumeRingMaxBytes = 20*10*1000;
+
+    std::string errorText;
+    gStreamManager().startStreamManager( PORT, 2, errorText, config );
+    if ( !errorText.empty() )
+    {
+        _LOG( "cannot start server: " << errorText );
+        return 1;
+    }
+
+    try
+    {
+        testHandlerMemory();
+        testForwarding();
+    }
+    catch( std::runtime_error& error )
+    {
+        _LOG( "allocationTest: " << error.what() );
+        gErrorNumber++;
+    }
+
+    gStreamManager().stopStreamManager();
+
+    if ( gErrorNumber != 0 )
+    {
+        _LOG( "allocationTest FAILED: " << gErrorNumber << " errors" );
+        return 1;
+    }
+    _LOG( "allocationTest passed" );
+    return 0;
+}
@@ -0,0 +1,182 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include "AsyncTcpClient.h"
+#include "StreamClient.h"
+#include "StreamManager.h"
+#include "PacketSchema.h"
+#include "TestUtil.h"
+
+//
+// asyncClientTest - many IAsyncStreamClient viewers served by one thread
+//
+
+using namespace catapult::net;
+using namespace catapult::streaming;
+
+#define PORT                    7657
+#define STREAM_ID               "ASYNC_CLIENT"
+#define VIEWER_NUMBER           200
+#define FRAME_NUMBER            100
+
+// (handlers of a viewer are called by the thread of context)
+struct AsyncViewer
+{
+    std::unique_ptr<IAsyncStreamClient> m_client;
+
+    std::atomic<bool>       m_isConnected{false};
+    std::atomic<bool>       m_isStarted{false};
+    std::atomic<int>        m_closeNumber{0};
+    std::atomic<uint32_t>   m_frameNumber{0};
+    uint32_t                m_lastFrame   = uint32_t(-1);
+    bool                    m_hasGap      = false;
+};
+
+void startViewer( AsyncViewer& viewer )
+{
+    viewer.m_client->asyncConnect( "localhost", PORT, [&viewer]( bool isConnected )
+    {
+        if ( !isConnected )
+        {
+            _LOG( "viewer: " << viewer.m_client->errorMessage() );
+            return;
+        }
+
+        std::string streamId( STREAM_ID );
+        StreamingTpkt request( 0, cmd::START_LIFE_STREAM_VIEWING, streamId );
+        viewer.m_client->asyncWrite( request );
+
+        viewer.m_client->startReadLoop( [&viewer]( StreamingTpktRcv& response )
+        {
+            uint32_t version, responseId;
+            response.read( version, responseId );
+            if ( responseId != cmd::STREAMING_DATA )
+            {
+                viewer.m_isStarted = true;
+                return;
+            }
+
+            uint32_t frameFlags, i;
+            response.read( frameFlags, i );
+            if ( viewer.m_lastFrame != uint32_t(-1) && i != viewer.m_lastFrame+1 )
+            {
+                viewer.m_hasGap = true;
+            }
+            viewer.m_lastFrame = i;
+            viewer.m_frameNumber++;
+        },
+        [&viewer]
+        {
+            viewer.m_closeNumber++;
+        });
+
+        viewer.m_isConnected = true;
+    });
+}
+
+// runStreamer - 'waitForViewers' is called before END_STREAMING
+void runStreamer( std::function<void()> waitForViewers )
+{
+    auto tcpClient = connect( PORT, StartStreamingRequest::encode( StreamId( std::string( STREAM_ID ) ), 0 ) );
+
+    StreamingTpktRcv response;
+    for( uint32_t i = 0; i < FRAME_NUMBER; i++ )
+    {
+        StreamingTpkt pkt = makeFrame( i );
+        if ( !tcpClient->write( pkt ) )
+            throw std::runtime_error( tcpClient->errorMessage() );
+        if ( readResponse( *tcpClient, response ) != cmd::OK_STREAMING_RESPONSE )
+            throw std::runtime_error( "frame is not accepted" );
+    }
+
+    // (frames, that are queued to viewers, are not sent after the end of stream)
+    waitForViewers();
+
+    std::string streamId( STREAM_ID );
+    StreamingTpkt endStreaming( 0, cmd::END_STREAMING, streamId );
+    if ( !tcpClient->write( endStreaming ) )
+        throw std::runtime_error( tcpClient->errorMessage() );
+}
+
+void testAsyncViewers( std::shared_ptr<IAsyncTcpClientContext> context )
+{
+    std::vector<AsyncViewer> viewers( VIEWER_NUMBER );
+    for( auto& viewer : viewers )
+    {
+        viewer.m_client = createAsyncStreamingClient( context );
+        startViewer( viewer );
+    }
+
+    CHECK( waitFor( [&] { return std::all_of( viewers.begin(), viewers.end(), []( auto& viewer ) { return viewer.m_isStarted.load(); } ); } ) );
+
+    runStreamer( [&]
+    {
+        CHECK( waitFor( [&] { return std::all_of( viewers.begin(), viewers.end(), []( auto& viewer ) { return viewer.m_frameNumber == FRAME_NUMBER; } ); } ) );
+    });
+
+    // the viewers are disconnected by the end of stream
+    CHECK( waitFor( [&] { return std::all_of( viewers.begin(), viewers.end(), []( auto& viewer ) { return viewer.m_closeNumber > 0; } ); } ) );
+
+    for( auto& viewer : viewers )
+    {
+        CHECK( viewer.m_isConnected );
+        CHECK( viewer.m_closeNumber == 1 );
+        CHECK( viewer.m_frameNumber == FRAME_NUMBER );
+        CHECK( viewer.m_lastFrame == FRAME_NUMBER-1 );
+        CHECK( !viewer.m_hasGap );
+    }
+
+    // (handlers are not called after 'stop()', so the viewers could be released)
+    context->stop();
+}
+
+void testConnectionError( std::shared_ptr<IAsyncTcpClientContext> context )
+{
+    std::atomic<int> connectResult{-1};
+
+    // (nobody listens on the port)
+    auto client = createAsyncStreamingClient( context );
+    client->asyncConnect( "localhost", PORT+1000, [&]( bool isConnected ) { connectResult = isConnected ? 1 : 0; } );
+
+    CHECK( waitFor( [&] { return connectResult != -1; } ) );
+    CHECK( connectResult == 0 );
+    CHECK( client->hasError() );
+
+    context->stop();
+}
+
+int main( int, const char* [] )
+{
+    std::string errorText;
+    gStreamManager().startStreamManager( PORT, 2, errorText );
+    if ( !errorText.empty() )
+    {
+        _LOG( "cannot start server: " << errorText );
+        return 1;
+    }
+
+    try
+    {
+        testAsyncViewers( createAsyncTcpClientContext( 1 ) );
+        testConnectionError( createAsyncTcpClientContext( 1 ) );
+    }
+    catch( std::runtime_error& error )
+    {
+        _LOG( "asyncClientTest: " << error.what() );
+        gErrorNumber++;
+    }
+
+    gStreamManager().stopStreamManager();
+
+    if ( gErrorNumber != 0 )
+    {
+        _LOG( "asyncClientTest FAILED: " << gErrorNumber << " errors" );
+        return 1;
+    }
+    _LOG( "asyncClientTest passed" );
+    return 0;
+}
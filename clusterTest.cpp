@@ -0,0 +1,335 @@
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <map>
+#include "StreamClient.h"
+#include "StreamManager.h"
+#include "PacketSchema.h"
+#include "ClusterRing.h"
+#include "TcpClient.h"
+#include "TestUtil.h"
+
+//
+// clusterTest - consistent hashing of streams (see ClusterRing.h) and redirects to their owners:
+// node A is run by the test process, node B - by a child process
+//
+
+using namespace catapult::net;
+using namespace catapult::streaming;
+
+#define NODE_A_PORT             7665
+#define NODE_B_PORT             7666
+#define REDIRECT_LOOP_PORT      7667
+#define STREAM_NUMBER           10000
+#define FRAME_NUMBER            10
+
+// (it is MAX_REDIRECT_NUMBER of StreamClient)
+#define MAX_REDIRECT_NUMBER     4
+
+const ClusterNode gNodeA{ "127.0.0.1", NODE_A_PORT };
+const ClusterNode gNodeB{ "127.0.0.1", NODE_B_PORT };
+
+// testClusterRing - owners do not depend on the order of nodes; streams are spread over nodes;
+// a new node takes about 1/N of streams (and other streams are not moved)
+void testClusterRing()
+{
+    std::vector<ClusterNode> nodes{ { "10.0.0.1", 7654 }, { "10.0.0.2", 7654 }, { "10.0.0.3", 7654 } };
+    std::vector<ClusterNode> reversedNodes( nodes.rbegin(), nodes.rend() );
+    std::vector<ClusterNode> newNodes = nodes;
+    newNodes.push_back( { "10.0.0.4", 7654 } );
+
+    ClusterRing ring( nodes ), reversedRing( reversedNodes ), newRing( newNodes );
+
+    std::map<std::string,int> streamNumbers;
+    int movedNumber = 0;
+    for( int i = 0; i < STREAM_NUMBER; i++ )
+    {
+        StreamId streamId( "stream-" + std::to_string(i) );
+        const ClusterNode& owner = ring.owner( streamId );
+        streamNumbers[ owner.name() ]++;
+
+        CHECK( reversedRing.owner( streamId ) == owner );
+
+        const ClusterNode& newOwner = newRing.owner( streamId );
+        if ( !( newOwner == owner ) )
+        {
+            movedNumber++;
+            CHECK( newOwner == newNodes.back() );
+        }
+    }
+
+    CHECK( streamNumbers.size() == nodes.size() );
+    for( auto& [name, number] : streamNumbers )
+    {
+        CHECK( number > STREAM_NUMBER/5 && number < STREAM_NUMBER/2 );
+    }
+    CHECK( movedNumber > STREAM_NUMBER/6 && movedNumber < STREAM_NUMBER/3 );
+}
+
+// streamOwnedBy - returns id of a stream, that is owned by the node
+std::string streamOwnedBy( const ClusterNode& node )
+{
+    ClusterRing ring( { gNodeA, gNodeB } );
+    for( int i = 0; ; i++ )
+    {
+        std::string streamId = "CLUSTER_" + std::to_string(i);
+        if ( ring.owner( StreamId( streamId ) ) == node )
+            return streamId;
+    }
+}
+
+// testRedirectResponse - a first request of a stream, that is owned by another node, gets REDIRECT_RESPONSE
+// and the connection is closed
+void testRedirectResponse()
+{
+    std::string streamIdA = streamOwnedBy( gNodeA );
+    std::string streamIdB = streamOwnedBy( gNodeB );
+
+    for( auto command : { cmd::START_STREAMING, cmd::START_LIFE_STREAM_VIEWING } )
+    {
+        auto tcpClient = createTcpClient();
+        CHECK( tcpClient->connect( gNodeA.m_address, std::to_string( NODE_A_PORT ) ) );
+
+        StreamingTpkt request( 0, command, streamIdB );
+        CHECK( tcpClient->write( request ) );
+
+        StreamingTpktRcv response;
+        CHECK( readResponse( *tcpClient, response ) == cmd::REDIRECT_RESPONSE );
+        std::string ownerAddress;
+        uint32_t    ownerPort = 0;
+        RedirectResponse::decode( response, ownerAddress, ownerPort );
+        CHECK( ownerAddress == gNodeB.m_address && ownerPort == NODE_B_PORT );
+
+        CHECK( !tcpClient->read( (TpktRcv&)response ) );
+    }
+
+    // the owner accepts the request (the stream is not started yet)
+    auto tcpClient = createTcpClient();
+    CHECK( tcpClient->connect( gNodeA.m_address, std::to_string( NODE_A_PORT ) ) );
+
+    StreamingTpkt request( 0, cmd::START_LIFE_STREAM_VIEWING, streamIdA );
+    CHECK( tcpClient->write( request ) );
+    StreamingTpktRcv response;
+    CHECK( readResponse( *tcpClient, response ) == cmd::IS_NOT_STARTED_RESPONSE );
+}
+
+// testFollowRedirect - a streamer and a viewer, that are connected to another node, meet on the owner of stream
+void testFollowRedirect()
+{
+    std::string streamId = streamOwnedBy( gNodeB );
+
+    // (both of them are connected to node A)
+    auto streamer = connect( NODE_A_PORT, StartStreamingRequest::encode( StreamId( streamId ), 0 ) );
+    auto viewer   = connect( NODE_A_PORT, StreamingTpkt( 0, cmd::START_LIFE_STREAM_VIEWING, streamId ) );
+
+    StreamingTpktRcv response;
+    StreamingTpktRcv viewerResponse;
+    for( uint32_t i = 0; i < FRAME_NUMBER; i++ )
+    {
+        StreamingTpkt pkt = makeFrame( i );
+        CHECK( streamer->write( pkt ) );
+        CHECK( readResponse( *streamer, response ) == cmd::OK_STREAMING_RESPONSE );
+
+        CHECK( readResponse( *viewer, viewerResponse ) == cmd::STREAMING_DATA );
+        uint32_t frameFlags, frameNumber;
+        viewerResponse.read( frameFlags, frameNumber );
+        CHECK( frameNumber == i );
+        CHECK( isFrameValid( viewerResponse, i ) );
+    }
+
+    StreamingTpkt endStreaming( 0, cmd::END_STREAMING, streamId );
+    CHECK( streamer->write( endStreaming ) );
+}
+
+// readAll - returns false, if the connection is closed
+bool readAll( int fd, uint8_t* data, size_t size )
+{
+    while( size > 0 )
+    {
+        ssize_t len = ::read( fd, data, size );
+        if ( len <= 0 )
+            return false;
+        data += len;
+        size -= size_t(len);
+    }
+    return true;
+}
+
+// testRedirectLoop - redirects are followed not more than MAX_REDIRECT_NUMBER times
+// (the last REDIRECT_RESPONSE is returned by 'read()'); the request is sent again as it was written
+void testRedirectLoop()
+{
+    int listenFd = ::socket( AF_INET, SOCK_STREAM, 0 );
+    int reuse = 1;
+    ::setsockopt( listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse) );
+
+    sockaddr_in address{};
+    address.sin_family      = AF_INET;
+    address.sin_port        = htons( REDIRECT_LOOP_PORT );
+    address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    if ( ::bind( listenFd, (sockaddr*) &address, sizeof(address) ) != 0 || ::listen( listenFd, 16 ) != 0 )
+    {
+        ::close( listenFd );
+        throw std::runtime_error( "cannot listen on redirect loop port" );
+    }
+
+    // the server redirects each request to itself (it accepts not more than 2*MAX_REDIRECT_NUMBER connections)
+    std::vector<std::vector<uint8_t>> requests;
+    std::thread serverThread( [&]
+    {
+        StreamingTpkt redirect = RedirectResponse::encode( "127.0.0.1", REDIRECT_LOOP_PORT );
+
+        for( int i = 0; i < 2*MAX_REDIRECT_NUMBER; i++ )
+        {
+            int fd = ::accept( listenFd, nullptr, nullptr );
+            if ( fd < 0 )
+                break;
+
+            uint8_t lenght[4];
+            if ( readAll( fd, lenght, 4 ) )
+            {
+                std::vector<uint8_t> request( loadUint32LE( lenght ) );
+                memcpy( request.data(), lenght, 4 );
+                if ( request.size() >= 4 && readAll( fd, request.data()+4, request.size()-4 ) )
+                {
+                    requests.push_back( request );
+                    [[maybe_unused]] auto len = ::write( fd, redirect.ptr(), redirect.lenght() );
+                }
+            }
+            ::close( fd );
+        }
+
+        // (next connections are refused)
+        ::shutdown( listenFd, SHUT_RDWR );
+    });
+
+    auto tcpClient = createStreamingClient();
+    CHECK( tcpClient->connect( "127.0.0.1", REDIRECT_LOOP_PORT ) );
+    StreamingTpkt request = StartStreamingRequest::encode( StreamId( std::string( "REDIRECT_LOOP" ) ), 0 );
+    CHECK( tcpClient->write( request ) );
+
+    StreamingTpktRcv response;
+    CHECK( tcpClient->read( (TpktRcv&)response ) );
+    uint32_t version = 0, responseId = 0;
+    if ( response.restDataLen() >= 8 )
+        response.read( version, responseId );
+    CHECK( responseId == cmd::REDIRECT_RESPONSE );
+    tcpClient->close();
+
+    // (the accept is interrupted)
+    ::shutdown( listenFd, SHUT_RDWR );
+    serverThread.join();
+    ::close( listenFd );
+
+    CHECK( requests.size() == MAX_REDIRECT_NUMBER+1 );
+    for( auto& received : requests )
+    {
+        CHECK( received == request.constBuffer() );
+    }
+}
+
+// runNodeB - runs node B, until the pipe is closed by the test process
+int runNodeB( int pipeFd )
+{
+    DistributorConfig config;
+    config.m_clusterNodes = { gNodeA, gNodeB };
+    config.m_selfNode     = gNodeB;
+
+    std::string errorText;
+    gStreamManager().startStreamManager( NODE_B_PORT, 2, errorText, config );
+    if ( !errorText.empty() )
+    {
+        _LOG( "cannot start node B: " << errorText );
+        return 1;
+    }
+
+    char byte;
+    while( ::read( pipeFd, &byte, 1 ) > 0 ) {}
+
+    gStreamManager().stopStreamManager();
+    return 0;
+}
+
+int main( int, const char* [] )
+{
+    // (node B is forked before any thread is started)
+    int pipeFds[2];
+    if ( ::pipe( pipeFds ) != 0 )
+    {
+        _LOG( "cannot create pipe" );
+        return 1;
+    }
+
+    pid_t nodeBPid = ::fork();
+    if ( nodeBPid < 0 )
+    {
+        _LOG( "cannot fork" );
+        return 1;
+    }
+    if ( nodeBPid == 0 )
+    {
+        ::close( pipeFds[1] );
+        ::_exit( runNodeB( pipeFds[0] ) );
+    }
+    ::close( pipeFds[0] );
+
+    DistributorConfig config;
+    config.m_clusterNodes = { gNodeA, gNodeB };
+    config.m_selfNode     = gNodeA;
+
+    std::string errorText;
+    gStreamManager().startStreamManager( NODE_A_PORT, 2, errorText, config );
+    if ( !errorText.empty() )
+    {
+        _LOG( "cannot start server: " << errorText );
+        ::close( pipeFds[1] );
+        ::waitpid( nodeBPid, nullptr, 0 );
+        return 1;
+    }
+
+    try
+    {
+        testClusterRing();
+        testRedirectLoop();
+
+        // (node B is started by the child process)
+        bool isNodeBStarted = false;
+        for( int i = 0; i < 2000 && !isNodeBStarted; i++ )
+        {
+            auto tcpClient = createTcpClient();
+            isNodeBStarted = tcpClient->connect( gNodeB.m_address, std::to_string( NODE_B_PORT ) );
+            if ( !isNodeBStarted )
+                usleep( 10000 );
+        }
+        CHECK( isNodeBStarted );
+
+        testRedirectResponse();
+        testFollowRedirect();
+    }
+    catch( std::runtime_error& error )
+    {
+        _LOG( "clusterTest: " << error.what() );
+        gErrorNumber++;
+    }
+
+    gStreamManager().stopStreamManager();
+
+    ::close( pipeFds[1] );
+    int status = 0;
+    ::waitpid( nodeBPid, &status, 0 );
+    CHECK( WIFEXITED( status ) && WEXITSTATUS( status ) == 0 );
+
+    if ( gErrorNumber != 0 )
+    {
+        _LOG( "clusterTest FAILED: " << gErrorNumber << " errors" );
+        return 1;
+    }
+    _LOG( "clusterTest passed" );
+    return 0;
+}
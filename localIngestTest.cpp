@@ -0,0 +1,243 @@
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include "StreamClient.h"
+#include "StreamManager.h"
+#include "PacketSchema.h"
+#include "LocalIngest.h"
+#include "TestUtil.h"
+
+//
+// localIngestTest - the shared-memory ring and streaming of a local streamer (see LocalIngest.h)
+//
+
+using namespace catapult::net;
+using namespace catapult::streaming;
+
+#define PORT                    7668
+#define STREAM_ID               "LOCAL_INGEST"
+#define RING_CAPACITY           16*1024
+#define FRAME_NUMBER            300
+
+// testIngestRing - bytes, that are written across the end of ring, are continued at its beginning
+// and are read back by the attached ring (as they are read by the server)
+void testIngestRing()
+{
+    std::string errorText;
+    LocalIngestRing producer;
+    CHECK( producer.create( 5000, errorText ) );
+    CHECK( producer.capacity() == 8192 );
+
+    LocalIngestRing consumer;
+    CHECK( consumer.attach( ::dup( producer.memFd() ), errorText ) );
+    CHECK( consumer.capacity() == producer.capacity() );
+
+    // the last 10 bytes of ring and the first 90 bytes
+    uint64_t capacity = producer.capacity();
+    std::vector<uint8_t> bytes = makePayload( 1, 100 );
+    producer.write( capacity-10, bytes.data(), bytes.size() );
+
+    std::vector<uint8_t> tail( 10 ), head( 90 );
+    consumer.read( capacity-10, tail.data(), tail.size() );
+    consumer.read( 2*capacity, head.data(), head.size() );
+    CHECK( memcmp( tail.data(), bytes.data(), 10 ) == 0 );
+    CHECK( memcmp( head.data(), bytes.data()+10, 90 ) == 0 );
+
+    // positions are not wrapped: chunks of different sizes go round the ring many times
+    uint64_t position = 0;
+    for( uint32_t i = 0; position < 10*capacity; i++ )
+    {
+        std::vector<uint8_t> chunk = makePayload( i, 1 + (i*997) % capacity );
+        producer.write( position, chunk.data(), chunk.size() );
+
+        std::vector<uint8_t> received( chunk.size() );
+        consumer.read( position, received.data(), received.size() );
+        CHECK( received == chunk );
+
+        position += chunk.size();
+    }
+
+    // the whole ring at an unaligned position
+    std::vector<uint8_t> whole = makePayload( 2, capacity );
+    producer.write( position+1, whole.data(), whole.size() );
+    std::vector<uint8_t> received( whole.size() );
+    consumer.read( position+1, received.data(), received.size() );
+    CHECK( received == whole );
+
+    // a memfd, that could be resized by the streamer, is not attached
+    int memFd = memfd_create( "catapult-test", MFD_CLOEXEC );
+    CHECK( memFd >= 0 && ftruncate( memFd, sizeof(LocalIngestRingHeader) + 4096 ) == 0 );
+    LocalIngestRing unsealed;
+    CHECK( !unsealed.attach( memFd, errorText ) );
+
+    // a sealed memfd without a ring
+    memFd = memfd_create( "catapult-test", MFD_CLOEXEC | MFD_ALLOW_SEALING );
+    CHECK( memFd >= 0 && ftruncate( memFd, sizeof(LocalIngestRingHeader) + 4096 ) == 0 );
+    CHECK( fcntl( memFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL ) == 0 );
+    LocalIngestRing invalid;
+    CHECK( !invalid.attach( memFd, errorText ) );
+}
+
+// testLocalStreaming - frames of a local streamer are received by a TCP viewer as they were written
+// (the ring is smaller than the frames, so the streamer waits for the server)
+void testLocalStreaming()
+{
+    std::string streamId( STREAM_ID );
+
+    // the viewer is connected before the streamer
+    auto viewer = createStreamingClient();
+    if ( !viewer->connect( "localhost", PORT ) )
+        throw std::runtime_error( viewer->errorMessage() );
+    StreamingTpkt viewingRequest( 0, cmd::START_LIFE_STREAM_VIEWING, streamId );
+    CHECK( viewer->write( viewingRequest ) );
+    StreamingTpktRcv viewerResponse;
+    CHECK( readResponse( *viewer, viewerResponse ) == cmd::IS_NOT_STARTED_RESPONSE );
+
+    std::atomic<uint32_t> frameNumber{0};
+    bool hasBadFrame = false;
+    std::thread viewerThread( [&]
+    {
+        StreamingTpktRcv response;
+        try
+        {
+            while( readResponse( *viewer, response ) == cmd::STREAMING_DATA )
+            {
+                uint32_t frameFlags, i, size;
+                response.read( frameFlags, i, size );
+
+                std::vector<uint8_t> expected = makePayload( i, 1000 + (i*37) % 2000 );
+                if ( i != frameNumber || frameFlags != uint32_t( (i%10 == 0) ? frame::KEY_FRAME : 0 ) || size != expected.size()
+                        || response.restDataLen() != size || memcmp( response.restDataPtr(), expected.data(), size ) != 0 )
+                {
+                    hasBadFrame = true;
+                }
+                frameNumber++;
+            }
+        }
+        catch( std::runtime_error& ) {}
+    });
+
+    auto streamer = createLocalStreamingClient( RING_CAPACITY );
+    if ( !streamer->connect( "localhost", PORT ) )
+        throw std::runtime_error( streamer->errorMessage() );
+
+    StreamingTpkt request = StartStreamingRequest::encode( StreamId( streamId ), 0 );
+    CHECK( streamer->write( request ) );
+    StreamingTpktRcv response;
+    CHECK( readResponse( *streamer, response ) == cmd::OK_STREAMING_RESPONSE );
+
+    // the stream could not be started twice
+    auto secondStreamer = createLocalStreamingClient( RING_CAPACITY );
+    CHECK( secondStreamer->connect( "localhost", PORT ) );
+    CHECK( secondStreamer->write( request ) );
+    CHECK( readResponse( *secondStreamer, response ) == cmd::ERROR_STREAMING_RESPONSE );
+
+    // frames are written as StreamingTpkt and as StreamingGatherTpkt
+    for( uint32_t i = 0; i < FRAME_NUMBER; i++ )
+    {
+        std::vector<uint8_t> payload = makePayload( i, 1000 + (i*37) % 2000 );
+        uint32_t frameFlags = (i%10 == 0) ? frame::KEY_FRAME : 0;
+
+        if ( i%2 == 0 )
+        {
+            StreamingTpkt pkt( 8+4+payload.size(), cmd::STREAMING_DATA );
+            pkt.writeUint32( frameFlags, i );
+            pkt.writeBytes( payload.data(), uint32_t(payload.size()) );
+            CHECK( streamer->write( pkt ) );
+        }
+        else
+        {
+            StreamingGatherTpkt pkt( cmd::STREAMING_DATA );
+            pkt.writeUint32( frameFlags );
+            pkt.writeUint32( i );
+            pkt.writeBytes( payload.data(), uint32_t(payload.size()) );
+            CHECK( streamer->write( pkt ) );
+        }
+    }
+
+    // a frame is not written, if it is larger than the ring
+    std::vector<uint8_t> bigPayload( RING_CAPACITY );
+    StreamingTpkt bigPkt( 8+4+bigPayload.size(), cmd::STREAMING_DATA );
+    bigPkt.writeUint32( 0, FRAME_NUMBER );
+    bigPkt.writeBytes( bigPayload.data(), uint32_t(bigPayload.size()) );
+    CHECK( !streamer->write( bigPkt ) );
+
+    // (frames, that are queued to viewers, are not sent after the end of stream)
+    for( int ms = 0; frameNumber < FRAME_NUMBER && ms < 20000; ms += 10 )
+    {
+        usleep( 10000 );
+    }
+
+    StreamingTpkt endStreaming( 0, cmd::END_STREAMING, streamId );
+    CHECK( streamer->write( endStreaming ) );
+
+    viewerThread.join();
+    CHECK( frameNumber == FRAME_NUMBER );
+    CHECK( !hasBadFrame );
+}
+
+// connectSilentStreamer - a local connection, that does not send the handshake
+int connectSilentStreamer()
+{
+    int fd = ::socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+    sockaddr_un address;
+    socklen_t addressLenght = localIngestAddress( PORT, address );
+    if ( fd < 0 || ::connect( fd, (sockaddr*)&address, addressLenght ) != 0 )
+    {
+        if ( fd >= 0 )
+            ::close( fd );
+        throw std::runtime_error( "cannot connect to local ingest" );
+    }
+    return fd;
+}
+
+int main( int, const char* [] )
+{
+    DistributorConfig config;
+    config.m_isLocalIngestEnabled = true;
+
+    std::string errorText;
+    gStreamManager().startStreamManager( PORT, 2, errorText, config );
+    if ( !errorText.empty() )
+    {
+        _LOG( "cannot start server: " << errorText );
+        return 1;
+    }
+
+    // a session, that waits for the handshake, is closed by the stop of server
+    int silentFd = -1;
+
+    try
+    {
+        testIngestRing();
+        testLocalStreaming();
+
+        silentFd = connectSilentStreamer();
+        usleep( 100000 );
+    }
+    catch( std::runtime_error& error )
+    {
+        _LOG( "localIngestTest: " << error.what() );
+        gErrorNumber++;
+    }
+
+    gStreamManager().stopStreamManager();
+
+    if ( silentFd >= 0 )
+    {
+        char byte;
+        CHECK( ::recv( silentFd, &byte, 1, MSG_DONTWAIT ) == 0 );
+        ::close( silentFd );
+    }
+
+    if ( gErrorNumber != 0 )
+    {
+        _LOG( "localIngestTest FAILED: " << gErrorNumber << " errors" );
+        return 1;
+    }
+    _LOG( "localIngestTest passed" );
+    return 0;
+}
@@ -0,0 +1,345 @@
+#include <unistd.h>
+
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <map>
+#include "StreamClient.h"
+#include "StreamManager.h"
+#include "Multiplexing.h"
+#include "TestUtil.h"
+
+//
+// multiplexingTest - several streams over one connection (see Multiplexing.h)
+//
+//   multiplexingTest        - multiplexed and plain streamers and viewers of the same streams
+//   multiplexingTest slow   - a slow channel is closed, other channels of the connection are continued
+//
+
+using namespace catapult::net;
+using namespace catapult::streaming;
+
+#define PORT                    7658
+#define SLOW_CHANNEL_TEST_PORT  7659
+#define FRAME_NUMBER            100
+#define PAYLOAD_SIZE            1000
+
+uint32_t gPort = PORT;
+
+// readResponse - returns responseId (and channelId, if it is in the response)
+uint32_t readResponse( IStreamClient& tcpClient, StreamingTpktRcv& response, uint32_t& channelId )
+{
+    if ( !tcpClient.read( (TpktRcv&)response ) )
+        throw std::runtime_error( tcpClient.errorMessage() );
+
+    uint32_t version, responseId;
+    response.read( version, responseId );
+    if ( responseId == cmd::ERROR_STREAMING_RESPONSE )
+    {
+        std::string errorText;
+        response.read( errorText );
+        throw std::runtime_error( errorText );
+    }
+    if ( response.restDataLen() >= 4 )
+    {
+        response.read( channelId );
+    }
+    return responseId;
+}
+
+std::unique_ptr<IStreamClient> connect( const StreamingTpkt& firstRequest )
+{
+    auto tcpClient = createStreamingClient();
+    if ( !tcpClient->connect( "localhost", gPort ) )
+        throw std::runtime_error( tcpClient->errorMessage() );
+
+    StreamingTpkt request = firstRequest;
+    if ( !tcpClient->write( request ) )
+        throw std::runtime_error( tcpClient->errorMessage() );
+    return tcpClient;
+}
+
+// openChannel - returns channelId
+uint32_t openChannel( IStreamClient& tcpClient, cmd::Id requestId, std::string streamId )
+{
+    StreamingTpkt request( 0, requestId, streamId );
+    if ( !tcpClient.write( request ) )
+        throw std::runtime_error( tcpClient.errorMessage() );
+
+    StreamingTpktRcv response;
+    uint32_t channelId = 0;
+    readResponse( tcpClient, response, channelId );
+    return channelId;
+}
+
+// payload of frame 'i' of stream 'k'
+uint8_t payloadByte( uint32_t i, uint32_t k )
+{
+    return uint8_t( i*7 + k );
+}
+
+bool isPayloadValid( StreamingTpktRcv& response, uint32_t i, uint32_t k )
+{
+    std::vector<uint8_t> payload( PAYLOAD_SIZE );
+    uint32_t payloadSize = 0;
+    response.read( payloadSize );
+    if ( payloadSize != PAYLOAD_SIZE || response.restDataLen() < PAYLOAD_SIZE )
+        return false;
+    response.readBytes( payload.data(), payloadSize );
+
+    return std::all_of( payload.begin(), payload.end(), [&]( uint8_t byte ) { return byte == payloadByte( i, k ); } );
+}
+
+//
+// testMultiplexing - streams M0..M2 are sent by one multiplexed streamer, L - by plain streamer;
+// all of them are viewed by one multiplexed viewer, M1 is viewed by plain viewer too
+//
+void testMultiplexing()
+{
+    const std::vector<std::string> streamIds = { "M0", "M1", "M2", "L" };
+
+    auto muxViewer = connect( StreamingTpkt( 0, cmd::START_MULTIPLEXING ) );
+    StreamingTpktRcv response;
+    uint32_t channelId = 0;
+    CHECK( readResponse( *muxViewer, response, channelId ) == cmd::OK_STREAMING_RESPONSE );
+
+    std::map<uint32_t,uint32_t> viewerChannelStream;
+    for( uint32_t k = 0; k < streamIds.size(); k++ )
+    {
+        viewerChannelStream[ openChannel( *muxViewer, cmd::START_LIFE_STREAM_VIEWING, streamIds[k] ) ] = k;
+    }
+    CHECK( viewerChannelStream.size() == streamIds.size() );
+
+    auto plainViewer = connect( StreamingTpkt( 0, cmd::START_LIFE_STREAM_VIEWING, streamIds[1] ) );
+    readResponse( *plainViewer, response, channelId );
+
+    auto muxStreamer = connect( StreamingTpkt( 0, cmd::START_MULTIPLEXING ) );
+    CHECK( readResponse( *muxStreamer, response, channelId ) == cmd::OK_STREAMING_RESPONSE );
+
+    std::vector<uint32_t> streamerChannels;
+    for( uint32_t k = 0; k < 3; k++ )
+    {
+        streamerChannels.push_back( openChannel( *muxStreamer, cmd::START_STREAMING, streamIds[k] ) );
+
+        // (channel id is the number of stream, it is the same for all connections)
+        CHECK( viewerChannelStream.count( streamerChannels.back() ) && viewerChannelStream[ streamerChannels.back() ] == k );
+    }
+
+    auto plainStreamer = connect( StreamingTpkt( 0, cmd::START_STREAMING, streamIds[3] ) );
+    CHECK( readResponse( *plainStreamer, response, channelId ) == cmd::OK_STREAMING_RESPONSE );
+
+    std::thread muxReader( [&]
+    {
+        StreamingTpktRcv response;
+        std::map<uint32_t,uint32_t> frameNumbers;
+        uint32_t endNumber = 0;
+        while( endNumber < streamIds.size() && muxViewer->read( (TpktRcv&)response ) )
+        {
+            uint32_t version, responseId, channelId;
+            response.read( version, responseId, channelId );
+            CHECK( viewerChannelStream.count( channelId ) );
+            uint32_t k = viewerChannelStream[channelId];
+
+            if ( responseId == cmd::END_STREAMING )
+            {
+                CHECK( frameNumbers[channelId] == FRAME_NUMBER );
+                endNumber++;
+                continue;
+            }
+            CHECK( responseId == cmd::MUX_STREAMING_DATA );
+
+            uint32_t frameFlags, i;
+            response.read( frameFlags, i );
+            CHECK( i == frameNumbers[channelId] );
+            CHECK( isPayloadValid( response, i, k ) );
+            frameNumbers[channelId]++;
+        }
+        CHECK( endNumber == streamIds.size() );
+    });
+
+    std::thread plainReader( [&]
+    {
+        StreamingTpktRcv response;
+        uint32_t frameNumber = 0;
+        while( frameNumber < FRAME_NUMBER && plainViewer->read( (TpktRcv&)response ) )
+        {
+            uint32_t version, responseId, frameFlags, i;
+            response.read( version, responseId, frameFlags, i );
+            CHECK( responseId == cmd::STREAMING_DATA );
+            CHECK( i == frameNumber );
+            CHECK( isPayloadValid( response, i, 1 ) );
+            frameNumber++;
+        }
+        CHECK( frameNumber == FRAME_NUMBER );
+    });
+
+    std::vector<uint8_t> payload( PAYLOAD_SIZE );
+    for( uint32_t i = 0; i < FRAME_NUMBER; i++ )
+    {
+        for( uint32_t k = 0; k < 4; k++ )
+        {
+            std::fill( payload.begin(), payload.end(), payloadByte( i, k ) );
+
+            bool isMultiplexed = ( k < 3 );
+            StreamingTpkt pkt( 4+12+PAYLOAD_SIZE, isMultiplexed ? cmd::MUX_STREAMING_DATA : cmd::STREAMING_DATA );
+            if ( isMultiplexed )
+            {
+                pkt.writeUint32( streamerChannels[k] );
+            }
+            pkt.writeUint32( (i%10 == 0) ? frame::KEY_FRAME : 0 );
+            pkt.writeUint32( i );
+            pkt.writeBytes( payload.data(), PAYLOAD_SIZE );
+
+            IStreamClient& streamer = isMultiplexed ? *muxStreamer : *plainStreamer;
+            CHECK( streamer.write( pkt ) );
+            if ( !isMultiplexed )
+            {
+                readResponse( streamer, response, channelId );
+            }
+        }
+    }
+
+    // (frames, that are queued to viewers, are not sent after the end of stream)
+    usleep( 500000 );
+    for( uint32_t k = 0; k < 3; k++ )
+    {
+        StreamingTpkt endStreaming( 4, cmd::END_STREAMING );
+        endStreaming.writeUint32( streamerChannels[k] );
+        CHECK( muxStreamer->write( endStreaming ) );
+    }
+    StreamingTpkt endStreaming( 0, cmd::END_STREAMING, streamIds[3] );
+    CHECK( plainStreamer->write( endStreaming ) );
+
+    muxReader.join();
+    plainReader.join();
+}
+
+//
+// testSlowChannel - a multiplexed viewer does not read its connection;
+// the overflowed channel is closed by END_STREAMING and the stream could be viewed again by the connection
+//
+void testSlowChannel()
+{
+    auto streamer = connect( StreamingTpkt( 0, cmd::START_STREAMING, std::string( "SLOW" ) ) );
+    StreamingTpktRcv response;
+    uint32_t channelId = 0;
+    CHECK( readResponse( *streamer, response, channelId ) == cmd::OK_STREAMING_RESPONSE );
+
+    auto muxViewer = connect( StreamingTpkt( 0, cmd::START_MULTIPLEXING ) );
+    CHECK( readResponse( *muxViewer, response, channelId ) == cmd::OK_STREAMING_RESPONSE );
+
+    uint32_t slowChannelId = openChannel( *muxViewer, cmd::START_LIFE_STREAM_VIEWING, "SLOW" );
+    uint32_t idleChannelId = openChannel( *muxViewer, cmd::START_LIFE_STREAM_VIEWING, "IDLE" );
+
+    std::atomic<bool> isStopped{false};
+    std::thread streamerThread( [&]
+    {
+        std::vector<uint8_t> payload( 100*1000 );
+        for( uint32_t i = 0; !isStopped; i++ )
+        {
+            StreamingTpkt pkt( 12+payload.size(), cmd::STREAMING_DATA );
+            pkt.writeUint32( (i%10 == 0) ? frame::KEY_FRAME : 0 );
+            pkt.writeUint32( i );
+            pkt.writeBytes( payload.data(), payload.size() );
+
+            StreamingTpktRcv response;
+            uint32_t channelId;
+            if ( !streamer->write( pkt ) || readResponse( *streamer, response, channelId ) != cmd::OK_STREAMING_RESPONSE )
+                break;
+            usleep( 2000 );
+        }
+    });
+
+    // the viewer does not read
+    sleep( 2 );
+
+    bool isEnded = false;
+    for( int n = 0; n < 1000 && !isEnded; n++ )
+    {
+        CHECK( muxViewer->read( (TpktRcv&)response ) );
+        if ( gErrorNumber != 0 )
+            break;
+
+        uint32_t version, responseId, channelId;
+        response.read( version, responseId, channelId );
+        if ( responseId == cmd::END_STREAMING )
+        {
+            CHECK( channelId == slowChannelId );
+            isEnded = true;
+        }
+    }
+    CHECK( isEnded );
+
+    isStopped = true;
+    streamerThread.join();
+
+    // (the connection is closed, if it was not the channel)
+    if ( !isEnded )
+        return;
+
+    // the other channel of the connection is alive
+    auto idleStreamer = connect( StreamingTpkt( 0, cmd::START_STREAMING, std::string( "IDLE" ) ) );
+    CHECK( readResponse( *idleStreamer, response, channelId ) == cmd::OK_STREAMING_RESPONSE );
+
+    std::vector<uint8_t> payload( PAYLOAD_SIZE );
+    StreamingTpkt pkt( 12+payload.size(), cmd::STREAMING_DATA );
+    pkt.writeUint32( frame::KEY_FRAME );
+    pkt.writeUint32( 0 );
+    pkt.writeBytes( payload.data(), payload.size() );
+    CHECK( idleStreamer->write( pkt ) );
+
+    CHECK( muxViewer->read( (TpktRcv&)response ) );
+    uint32_t version, responseId;
+    response.read( version, responseId, channelId );
+    CHECK( responseId == cmd::MUX_STREAMING_DATA && channelId == idleChannelId );
+
+    // the closed stream could be viewed again by the connection
+    StreamingTpkt request( 0, cmd::START_LIFE_STREAM_VIEWING, std::string( "SLOW" ) );
+    CHECK( muxViewer->write( request ) );
+    CHECK( readResponse( *muxViewer, response, channelId ) != 0 );
+}
+
+int main( int argc, const char* argv[] )
+{
+    bool isSlowChannelTest = ( argc > 1 && std::string( argv[1] ) == "slow" );
+
+    DistributorConfig config;
+    if ( isSlowChannelTest )
+    {
+        config.m_slowViewerPolicy = SlowViewerPolicy::DISCONNECT;
+        config.m_viewerBacklogFrames = 8;
+    }
+
+    std::string errorText;
+    gPort = isSlowChannelTest ? SLOW_CHANNEL_TEST_PORT : PORT;
+    gStreamManager().startStreamManager( gPort, 2, errorText, config );
+    if ( !errorText.empty() )
+    {
+        _LOG( "cannot start server: " << errorText );
+        return 1;
+    }
+
+    try
+    {
+        if ( isSlowChannelTest )
+            testSlowChannel();
+        else
+            testMultiplexing();
+    }
+    catch( std::runtime_error& error )
+    {
+        _LOG( "multiplexingTest: " << error.what() );
+        gErrorNumber++;
+    }
+
+    gStreamManager().stopStreamManager();
+
+    if ( gErrorNumber != 0 )
+    {
+        _LOG( "multiplexingTest FAILED: " << gErrorNumber << " errors" );
+        return 1;
+    }
+    _LOG( "multiplexingTest passed" );
+    return 0;
+}
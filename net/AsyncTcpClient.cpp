@@ -0,0 +1,181 @@
+#include "AsyncTcpClient.h"
+#include "AsyncTcpSession.h"
+
+namespace catapult {
+namespace net      {
+
+//
+// AsyncTcpClientContext
+//
+class AsyncTcpClientContext : public IAsyncTcpClientContext
+{
+    asio::io_context                                            m_context;
+    asio::executor_work_guard<asio::io_context::executor_type>  m_workGuard;
+    std::vector<std::thread>                                    m_threads;
+
+public:
+    AsyncTcpClientContext( uint threadNumber ) : m_workGuard( asio::make_work_guard( m_context ) )
+    {
+        if ( threadNumber == 0 )
+            threadNumber = 1;
+
+        for( uint i=0; i<threadNumber; i++ )
+        {
+            m_threads.emplace_back( [this] { m_context.run(); } );
+        }
+    }
+
+    ~AsyncTcpClientContext()
+    {
+        stop();
+    }
+
+    void stop() override
+    {
+        m_workGuard.reset();
+        m_context.stop();
+
+        for( auto& thread: m_threads )
+        {
+            if ( thread.joinable() && thread.get_id() != std::this_thread::get_id() )
+                thread.join();
+        }
+    }
+
+    asio::io_context& context() { return m_context; }
+};
+
+//
+// AsyncTcpClient - AsyncTcpSession with outgoing connection
+//
+class AsyncTcpClient : public IAsyncTcpClient, public std::enable_shared_from_this<AsyncTcpClient>
+{
+    std::shared_ptr<AsyncTcpClientContext>  m_context;
+    std::shared_ptr<AsyncTcpSession>        m_session;
+    tcp::resolver                           m_resolver;
+
+    boost::system::error_code               m_connectError;
+
+public:
+    AsyncTcpClient( std::shared_ptr<AsyncTcpClientContext> context )
+        : m_context( context ),
+          m_session( std::make_shared<AsyncTcpSession>( context->context() ) ),
+          m_resolver( context->context() )
+    {}
+
+    ~AsyncTcpClient()
+    {
+        LOG( "~AsyncTcpClient()" << std::endl );
+    }
+
+    void asyncConnect( const std::string& addr, const std::string& port, ConnectHandler handler ) override
+    {
+        m_resolver.async_resolve( addr, port, [this, shared=shared_from_this(), handler]
+                                  ( const boost::system::error_code& ec, tcp::resolver::results_type endpoints )
+        {
+            if ( ec )
+            {
+                m_connectError = ec;
+                handler( false );
+                return;
+            }
+
+            asio::async_connect( m_session->socket(), endpoints, [this, shared, handler]
+                                 ( const boost::system::error_code& ec, const tcp::endpoint& )
+            {
+                m_connectError = ec;
+                handler( !ec );
+            });
+        });
+    }
+
+    void startReadLoop( PacketHandler packetHandler, CloseHandler closeHandler ) override
+    {
+        session().asyncReadBatch( [this, shared=shared_from_this(), packetHandler, closeHandler]
+        {
+            if ( session().hasReadError() )
+            {
+                closeHandler();
+                return;
+            }
+
+            for( const auto& packet : session().receivedPackets() )
+            {
+                packetHandler( packet );
+            }
+
+            // the next read is done with this handler
+            session().asyncReadBatch();
+        });
+    }
+
+    void asyncWrite( Tpkt& packet ) override
+    {
+        session().asyncWrite( packet, {} );
+    }
+
+    bool asyncWrite( const TpktBufferPtr& packet ) override
+    {
+        return session().asyncWrite( packet, {} );
+    }
+
+    void asyncWrite( GatherTpktPtr packet, std::function<void()> func ) override
+    {
+        session().asyncWrite( packet, func );
+    }
+
+    void setSendQueueLimits( uint32_t maxPacketNumber, uint32_t maxBytes ) override
+    {
+        session().setSendQueueLimits( maxPacketNumber, maxBytes );
+    }
+
+    size_t sendQueueLength() const override
+    {
+        return session().sendQueueLength();
+    }
+
+    void setBufferPool( TpktBufferPoolPtr bufferPool ) override
+    {
+        session().request().setBufferPool( bufferPool );
+    }
+
+    bool hasError() const override
+    {
+        return m_connectError || ( session().hasReadError() && !session().isEof() ) || session().hasWriteError();
+    }
+
+    std::string errorMessage() const override
+    {
+        if ( m_connectError )
+            return m_connectError.message();
+        if ( session().hasWriteError() )
+            return session().writeErrorMessage();
+        return session().readErrorMessage();
+    }
+
+    // close - socket is closed by a thread of the context (the read loop will be finished)
+    void close() override
+    {
+        asio::post( m_context->context(), [this, shared=shared_from_this()]
+        {
+            m_resolver.cancel();
+            session().closeSession();
+        });
+    }
+
+private:
+    IAsyncTcpSession&       session()       { return *m_session; }
+    const IAsyncTcpSession& session() const { return *m_session; }
+};
+
+std::shared_ptr<IAsyncTcpClientContext> createAsyncTcpClientContext( uint threadNumber )
+{
+    return std::make_shared<AsyncTcpClientContext>( threadNumber );
+}
+
+std::shared_ptr<IAsyncTcpClient> createAsyncTcpClient( std::shared_ptr<IAsyncTcpClientContext> context )
+{
+    return std::make_shared<AsyncTcpClient>( std::static_pointer_cast<AsyncTcpClientContext>( context ) );
+}
+
+}} // namespace catapult { namespace net
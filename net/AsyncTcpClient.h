@@ -0,0 +1,75 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "Tpkt.h"
+#include "GatherTpkt.h"
+
+namespace catapult {
+namespace net      {
+
+    //
+    // IAsyncTcpClientContext - io_context and threads, that are shared by async clients
+    //
+    // Many clients could be served by one thread (instead of a thread per blocking ITcpClient).
+    //
+    class IAsyncTcpClientContext
+    {
+    public:
+        virtual ~IAsyncTcpClientContext() = default;
+
+        // stop - stops threads (handlers of clients are not called after it)
+        virtual void stop() = 0;
+    };
+
+    std::shared_ptr<IAsyncTcpClientContext> createAsyncTcpClientContext( uint threadNumber = 1 );
+
+    //
+    // IAsyncTcpClient - callback driven client
+    //
+    // Callbacks are called by a thread of the context; calls of the same client are not concurrent.
+    //
+    class IAsyncTcpClient
+    {
+    public:
+        typedef std::function<void( bool isConnected )>          ConnectHandler;
+        typedef std::function<void( const TpktBufferPtr& )>      PacketHandler;
+        typedef std::function<void()>                            CloseHandler;
+
+        virtual ~IAsyncTcpClient() = default;
+
+        virtual void asyncConnect( const std::string& addr, const std::string& port, ConnectHandler handler ) = 0;
+
+        //
+        // startReadLoop - reads packets until error (or 'close()')
+        //
+        // 'packetHandler' is called for each received packet;
+        // 'closeHandler' is called once after the loop is finished
+        //
+        virtual void startReadLoop( PacketHandler packetHandler, CloseHandler closeHandler ) = 0;
+
+        // asyncWrite - queues a copy of 'packet' (the caller could reuse it); it never blocks
+        virtual void asyncWrite( Tpkt& packet ) = 0;
+
+        // asyncWrite - queues immutable packet; returns false, if the queue limits are exceeded
+        virtual bool asyncWrite( const TpktBufferPtr& packet ) = 0;
+
+        // asyncWrite - queues packet without copying of its payload; 'func' is called after the write (or its failure)
+        virtual void asyncWrite( GatherTpktPtr packet, std::function<void()> func ) = 0;
+
+        virtual void   setSendQueueLimits( uint32_t maxPacketNumber, uint32_t maxBytes ) = 0;
+        virtual size_t sendQueueLength() const = 0;
+
+        // setBufferPool - received packets will be placed in buffers of 'bufferPool' (must be called before 'startReadLoop()')
+        virtual void   setBufferPool( TpktBufferPoolPtr bufferPool ) = 0;
+
+        virtual bool        hasError() const = 0;
+        virtual std::string errorMessage() const = 0;
+
+        virtual void close() = 0;
+    };
+
+    std::shared_ptr<IAsyncTcpClient> createAsyncTcpClient( std::shared_ptr<IAsyncTcpClientContext> context );
+
+}} // namespace catapult { namespace net
@@ -1,12 +1,53 @@
 #pragma once
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "Streaming.h"
 #include "Tpkt.h"
+#include "GatherTpkt.h"
+#include "HandlerMemory.h"
 
 namespace catapult {
 namespace net      {
 
+    //
+    // FileDescriptor - file, that is closed by its last owner (see 'IAsyncTcpSession::asyncSendFile()')
+    //
+    class FileDescriptor
+    {
+        int m_fd;
+
+    public:
+        explicit FileDescriptor( int fd ) : m_fd( fd ) {}
+        ~FileDescriptor() { if ( m_fd >= 0 ) ::close( m_fd ); }
+
+        FileDescriptor( const FileDescriptor& ) = delete;
+        FileDescriptor& operator=( const FileDescriptor& ) = delete;
+
+        int fd() const { return m_fd; }
+    };
+
+    typedef std::shared_ptr<FileDescriptor> FileDescriptorPtr;
+
+    //
+    // StrandTask - task, which is posted by 'IAsyncTcpSession::postOnStrand( task )' without memory allocation
+    //
+    // The operation of the post is placed in the task,
+    // so the task must not be posted again until its 'run()' is called.
+    //
+    class StrandTask
+    {
+        HandlerMemory m_handlerMemory;
+
+    public:
+        virtual ~StrandTask() = default;
+
+        virtual void run() = 0;
+
+        HandlerMemory& handlerMemory() { return m_handlerMemory; }
+    };
+    typedef std::shared_ptr<StrandTask> StrandTaskPtr;
+
     //
     // IAsyncTcpSession - interface for AsyncTcpSession
     //
@@ -23,12 +64,72 @@ namespace net      {
         virtual void asyncRead( std::function<void()> func, uint32_t maxPacketLength = 10*1024*1024 ) = 0;
 
         //
-        // asyncWrite - writes response
+        // asyncReadBatch - reads all packets, that are available after one socket read
+        //
+        // Packets will be available by calling 'receivedPackets()'.
+        // Small packets are received into the session buffer and then taken out of it;
+        // the rest of a bigger packet (a frame) is read directly into its own buffer, when its length is received.
+        // After 'asyncReadBatch()' is called, the session must not be read by 'asyncRead()'
+        //
+        virtual void asyncReadBatch( std::function<void()> func, uint32_t maxPacketLength = 10*1024*1024 ) = 0;
+
+        // asyncReadBatch - reads the next batch with 'func' and 'maxPacketLength' of the previous call
+        // (so a read loop does not build a new handler for each read)
+        virtual void asyncReadBatch() = 0;
+
+        virtual std::vector<TpktBufferPtr>& receivedPackets() = 0;
+
+        //
+        // asyncWrite - queues response for writing
         //
-        // 'func' will be called after the write is completed
+        // Packets are written in the order of queueing;
+        // 'response' is copied, so it could be reused by caller.
+        // 'func' will be called after the write is completed or failed
         //
         virtual void asyncWrite( Tpkt&, std::function<void()> func ) = 0;
 
+        //
+        // asyncWrite - queues already received (immutable) packet for writing
+        //
+        // 'packet' is held until the write is completed, so the same packet
+        // could be written to many sessions without copying.
+        // Returns false (and does not queue the packet) if the queue limits are exceeded.
+        // 'func' (if set) will be called after the write is completed
+        //
+        virtual bool asyncWrite( TpktBufferPtr packet, std::function<void()> func ) = 0;
+
+        //
+        // asyncWrite - queues packet, which payload is written without copying (see GatherTpkt.h)
+        //
+        // 'func' (if set) will be called after the write is completed or failed,
+        // so borrowed spans of 'packet' could be released by it
+        //
+        virtual void asyncWrite( GatherTpktPtr packet, std::function<void()> func ) = 0;
+
+        // asyncWrite - queues built packet (its lenght is updated), that could be shared by many sessions;
+        // it is limited and dropped as 'asyncWrite( TpktBufferPtr, ... )'
+        virtual bool asyncWrite( GatherTpktPtr packet ) = 0;
+
+        // asyncWrite - queues several immutable packets at once (they are gathered into one write);
+        // returns false (and does not queue any packet) if the queue limits are exceeded
+        virtual bool asyncWrite( const std::vector<TpktBufferPtr>& packets ) = 0;
+
+        //
+        // asyncSendFile - queues range of file, that contains whole packets
+        //
+        // The range is sent by 'sendfile' (from page cache to socket without copying to user space).
+        // Returns false (and does not queue the range) if the queue limits are exceeded.
+        //
+        virtual bool asyncSendFile( FileDescriptorPtr file, uint64_t offset, uint32_t size, std::function<void()> func ) = 0;
+
+        // setSendQueueLimits - limits queue for 'asyncWrite( TpktBufferPtr, ... )' (and for other droppable writes)
+        virtual void   setSendQueueLimits( uint32_t maxPacketNumber, uint32_t maxBytes ) = 0;
+        virtual size_t sendQueueLength() const = 0;
+        virtual size_t sendQueueBytes()  const = 0;
+
+        // dropQueuedPackets - removes packets queued by 'asyncWrite( TpktBufferPtr, ... )', which are not being written yet
+        virtual void   dropQueuedPackets() = 0;
+
         virtual TpktRcv&    request() = 0;
         virtual bool        isEof()              const = 0;
         virtual bool        hasReadError()       const = 0;
@@ -40,6 +141,12 @@ namespace net      {
 
         virtual void postOnStrand( std::function<void()> func ) = 0;
 
+        // postOnStrand - posts 'task->run()' (the task is held until it is called)
+        virtual void postOnStrand( StrandTaskPtr task ) = 0;
+
+        // asyncWait - calls 'func' after 'milliseconds' (by a thread of the session io_context)
+        virtual void asyncWait( uint32_t milliseconds, std::function<void()> func ) = 0;
+
         virtual void closeSession() = 0;
 
         virtual ~IAsyncTcpSession() = default;
@@ -61,4 +168,12 @@ namespace net      {
 
     std::unique_ptr<IAsyncTcpServer> createAsyncTcpServer( NewSessionHandler newSessionHandler );
 
+    // createShardedAsyncTcpServer - server with one io_context per thread;
+    // a session is served by the thread, that accepted it (or got it round-robin, if 'useReusePort' is false)
+    std::unique_ptr<IAsyncTcpServer> createShardedAsyncTcpServer( NewSessionHandler newSessionHandler, bool useReusePort );
+
+    // createUringTcpServer - thread-per-core server over io_uring (see UringTcpServer.cpp);
+    // returns nullptr (and 'errorText'), if io_uring is not supported by the kernel
+    std::unique_ptr<IAsyncTcpServer> createUringTcpServer( NewSessionHandler newSessionHandler, std::string& errorText );
+
 }} // namespace catapult { namespace streaming
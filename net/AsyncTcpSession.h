@@ -0,0 +1,896 @@
+#pragma once
+#include <algorithm>
+#include <optional>
+#include <thread>
+#include <utility>
+
+#include <sys/sendfile.h>
+
+#include <boost/asio.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/circular_buffer.hpp>
+#include <boost/container/small_vector.hpp>
+
+#include "AsyncTcpServer.h"
+#include "Tpkt.h"
+
+namespace asio = boost::asio;
+using     tcp  = boost::asio::ip::tcp;
+
+namespace catapult {
+namespace net      {
+
+class IoShard;
+
+//
+// AsyncTcpSession
+//
+class AsyncTcpSession : public IAsyncTcpSession
+{
+    tcp::socket                 m_socket;
+    asio::io_context::strand    m_strand;
+
+    // is set in sharded mode: socket operations must be started only by the shard thread
+    IoShard*                    m_shard;
+
+private:
+    TpktLen                     m_packetLen;
+    TpktRcv                     m_request;
+
+    boost::system::error_code   m_lastReadError;
+    std::optional<std::string>  m_readProtocolError;
+
+    boost::system::error_code   m_lastWriteError;
+
+    bool                        m_received1stRequest = false;
+
+    // outgoing queue (only one 'async_write' is in flight)
+    struct OutPacket
+    {
+        TpktBufferPtr           m_packet;
+        std::function<void()>   m_handler;
+        bool                    m_isDroppable = false;  // could be removed by 'dropQueuedPackets()'
+
+        // file range (see 'asyncSendFile()'); it is written instead of 'm_packet'
+        FileDescriptorPtr       m_file;
+        uint64_t                m_fileOffset = 0;
+        uint32_t                m_fileSize = 0;
+
+        // packet with not copied payload; it is written instead of 'm_packet'
+        GatherTpktPtr           m_gatherPacket;
+
+        OutPacket( TpktBufferPtr packet, std::function<void()> handler, bool isDroppable )
+            : m_packet( std::move(packet) ), m_handler( std::move(handler) ), m_isDroppable( isDroppable ) {}
+
+        OutPacket( FileDescriptorPtr file, uint64_t offset, uint32_t size, std::function<void()> handler )
+            : m_handler( std::move(handler) ), m_isDroppable( true ), m_file( std::move(file) ), m_fileOffset( offset ), m_fileSize( size ) {}
+
+        OutPacket( GatherTpktPtr packet, std::function<void()> handler, bool isDroppable )
+            : m_handler( std::move(handler) ), m_isDroppable( isDroppable ), m_gatherPacket( std::move(packet) ) {}
+
+        size_t size() const { return m_file ? m_fileSize : m_gatherPacket ? m_gatherPacket->lenght() : m_packet->lenght(); }
+    };
+
+    // all packets that are queued at the moment of write start, are written by one 'async_write'
+    static constexpr size_t     MAX_GATHERED_PACKETS = 64;
+
+    // ConstBufferRange - buffer sequence, that is not copied by 'async_write' (it refers to m_writeBuffers)
+    struct ConstBufferRange
+    {
+        typedef asio::const_buffer          value_type;
+        typedef const asio::const_buffer*   const_iterator;
+
+        const_iterator m_begin;
+        const_iterator m_end;
+
+        const_iterator begin() const { return m_begin; }
+        const_iterator end()   const { return m_end; }
+    };
+
+    // the queue grows, but it is not shrunk (so queueing does not allocate memory in steady state)
+    boost::circular_buffer<OutPacket>   m_sendQueue{ 16 };
+    size_t                              m_sendQueueBytes = 0;
+    size_t                              m_inFlightPacketNumber = 0;
+    bool                                m_isWriteStartPosted = false;
+    std::vector<asio::const_buffer>     m_writeBuffers;
+    std::mutex                          m_sendQueueMutex;
+
+    // file range, that is being written (it is copied from the queue, so it is used without lock)
+    FileDescriptorPtr                   m_sendingFile;
+    uint64_t                            m_sendingFileOffset = 0;
+    uint32_t                            m_sendingFileSize = 0;
+    uint32_t                            m_fileSentBytes = 0;
+
+    // batched receiving (see 'asyncReadBatch()'); not parsed data is [m_receivedBegin,m_receivedEnd)
+    static constexpr size_t     RECEIVE_BUFFER_SIZE = 64*1024;
+
+    // packets up to this size (control packets, small frames) are coalesced in m_receiveBuffer;
+    // the rest of a bigger packet is read directly into its own buffer, when its length is received
+    static constexpr size_t     MAX_COALESCED_PACKET_SIZE = 4*1024;
+
+    std::vector<uint8_t>        m_receiveBuffer;
+    size_t                      m_receivedBegin = 0;
+    size_t                      m_receivedEnd   = 0;
+    std::vector<TpktBufferPtr>  m_receivedPackets;
+
+    // the read after a big packet is short, so the body of the next big packet is not received into m_receiveBuffer
+    bool                        m_isShortRead = false;
+
+    // handler of 'asyncReadBatch()'; it is held by shared_ptr, because it could be replaced by itself
+    std::shared_ptr<std::function<void()>>  m_readBatchHandler;
+    uint32_t                                m_readBatchMaxPacketLength = 0;
+
+    // memory of asio operations (only one read and one write are in flight)
+    HandlerMemory               m_readHandlerMemory;
+    HandlerMemory               m_writeHandlerMemory;
+
+    uint32_t                    m_maxSendQueueLength = 1024;
+    uint32_t                    m_maxSendQueueBytes  = 64*1024*1024;
+
+public:
+    AsyncTcpSession( asio::io_context& io_context, IoShard* shard = nullptr )
+        : m_socket( io_context ), m_strand( io_context ), m_shard( shard )
+    {
+        LOG( "TcpSession(" << this << ")" << std::endl );
+    }
+
+    virtual ~AsyncTcpSession()
+    {
+        LOG( "~TcpSession(" << this << ")" << std::endl );
+    }
+
+    tcp::socket&  socket() { return m_socket; }
+
+    TpktRcv&    request()               override { return m_request; }
+    bool        hasReadError() const    override { return (m_lastReadError || m_readProtocolError.has_value()) ? true : false; }
+    bool        hasWriteError() const   override { return (m_lastWriteError) ? true : false; }
+    bool        isEof()    const        override { return m_lastReadError == make_error_code(boost::asio::error::eof); }
+
+protected:
+
+    void asyncWrite( Tpkt& response, std::function<void()> func ) override
+    {
+        response.updatePacketLenght();
+
+        //LOG( "async_write: response.lenght():" << response.lenght() << std::endl );
+
+        // responses are small, so they are copied (and caller could reuse or delete 'response')
+        TpktBufferPtr packet = acquireTpktBuffer( m_request.bufferPool(), (uint32_t)response.lenght() );
+        memcpy( packet->data(), response.ptr(), response.lenght() );
+        packet->setLenght( (uint32_t)response.lenght() );
+
+        const std::lock_guard<std::mutex> autolock( m_sendQueueMutex );
+        enqueue( packet, std::move(func), false );
+    }
+
+    bool asyncWrite( TpktBufferPtr packet, std::function<void()> func ) override
+    {
+        const std::lock_guard<std::mutex> autolock( m_sendQueueMutex );
+
+        if ( m_sendQueue.size() >= m_maxSendQueueLength || m_sendQueueBytes + packet->lenght() > m_maxSendQueueBytes )
+        {
+            return false;
+        }
+
+        enqueue( packet, std::move(func), true );
+        return true;
+    }
+
+    void asyncWrite( GatherTpktPtr packet, std::function<void()> func ) override
+    {
+        packet->updatePacketLenght();
+
+        const std::lock_guard<std::mutex> autolock( m_sendQueueMutex );
+
+        pushToSendQueue( OutPacket( packet, std::move(func), false ) );
+        m_sendQueueBytes += packet->lenght();
+
+        startWriteIfIdle();
+    }
+
+    bool asyncWrite( GatherTpktPtr packet ) override
+    {
+        const std::lock_guard<std::mutex> autolock( m_sendQueueMutex );
+
+        if ( m_sendQueue.size() >= m_maxSendQueueLength || m_sendQueueBytes + packet->lenght() > m_maxSendQueueBytes )
+        {
+            return false;
+        }
+
+        pushToSendQueue( OutPacket( packet, {}, true ) );
+        m_sendQueueBytes += packet->lenght();
+
+        startWriteIfIdle();
+        return true;
+    }
+
+    bool asyncWrite( const std::vector<TpktBufferPtr>& packets ) override
+    {
+        const std::lock_guard<std::mutex> autolock( m_sendQueueMutex );
+
+        size_t bytes = 0;
+        for( const auto& packet : packets )
+            bytes += packet->lenght();
+
+        if ( m_sendQueue.size() + packets.size() > m_maxSendQueueLength || m_sendQueueBytes + bytes > m_maxSendQueueBytes )
+        {
+            return false;
+        }
+
+        for( const auto& packet : packets )
+        {
+            pushToSendQueue( OutPacket( packet, {}, true ) );
+        }
+        m_sendQueueBytes += bytes;
+
+        startWriteIfIdle();
+        return true;
+    }
+
+    bool asyncSendFile( FileDescriptorPtr file, uint64_t offset, uint32_t size, std::function<void()> func ) override
+    {
+        const std::lock_guard<std::mutex> autolock( m_sendQueueMutex );
+
+        if ( m_sendQueue.size() >= m_maxSendQueueLength || m_sendQueueBytes + size > m_maxSendQueueBytes )
+        {
+            return false;
+        }
+
+        pushToSendQueue( OutPacket( file, offset, size, std::move(func) ) );
+        m_sendQueueBytes += size;
+
+        startWriteIfIdle();
+        return true;
+    }
+
+    void setSendQueueLimits( uint32_t maxPacketNumber, uint32_t maxBytes ) override
+    {
+        const std::lock_guard<std::mutex> autolock( m_sendQueueMutex );
+        m_maxSendQueueLength = maxPacketNumber;
+        m_maxSendQueueBytes  = maxBytes;
+    }
+
+    size_t sendQueueLength() const override { return m_sendQueue.size(); }
+    size_t sendQueueBytes()  const override { return m_sendQueueBytes; }
+
+    void dropQueuedPackets() override
+    {
+        const std::lock_guard<std::mutex> autolock( m_sendQueueMutex );
+
+        // packets that are being written are kept
+        auto it = std::remove_if( m_sendQueue.begin()+m_inFlightPacketNumber, m_sendQueue.end(), [this]( const OutPacket& outPacket )
+        {
+            if ( !outPacket.m_isDroppable )
+                return false;
+            m_sendQueueBytes -= outPacket.size();
+            return true;
+        });
+        m_sendQueue.erase( it, m_sendQueue.end() );
+    }
+
+private:
+    // must be called under m_sendQueueMutex
+    void enqueue( const TpktBufferPtr& packet, std::function<void()> func, bool isDroppable )
+    {
+        pushToSendQueue( OutPacket( packet, std::move(func), isDroppable ) );
+        m_sendQueueBytes += packet->lenght();
+
+        startWriteIfIdle();
+    }
+
+    // must be called under m_sendQueueMutex
+    void pushToSendQueue( OutPacket&& outPacket )
+    {
+        if ( m_sendQueue.full() )
+        {
+            m_sendQueue.set_capacity( m_sendQueue.capacity()*2 );
+        }
+        m_sendQueue.push_back( std::move(outPacket) );
+    }
+
+    // must be called under m_sendQueueMutex
+    void startWriteIfIdle()
+    {
+        if ( m_inFlightPacketNumber == 0 && !m_isWriteStartPosted )
+        {
+            if ( isOnOwnThread() )
+            {
+                startWrite();
+            }
+            else
+            {
+                // the write will be started by the shard thread
+                m_isWriteStartPosted = true;
+                postWriteStartToShard();
+            }
+        }
+    }
+
+    bool isOnOwnThread() const;
+    void postWriteStartToShard();
+
+public:
+    // startQueuedWrite - is called by the shard thread (see 'IoShard::drainChannel()')
+    void startQueuedWrite()
+    {
+        const std::lock_guard<std::mutex> autolock( m_sendQueueMutex );
+
+        m_isWriteStartPosted = false;
+        if ( m_inFlightPacketNumber == 0 && !m_sendQueue.empty() )
+        {
+            startWrite();
+        }
+    }
+
+private:
+
+    // startWrite - writes all queued packets (up to MAX_GATHERED_PACKETS) by one 'async_write'
+    // (file ranges are written separately by 'sendfile');
+    // must be called under m_sendQueueMutex
+    void startWrite()
+    {
+        if ( m_sendQueue.front().m_file )
+        {
+            m_inFlightPacketNumber = 1;
+            m_sendingFile       = m_sendQueue.front().m_file;
+            m_sendingFileOffset = m_sendQueue.front().m_fileOffset;
+            m_sendingFileSize   = m_sendQueue.front().m_fileSize;
+            m_fileSentBytes     = 0;
+            waitWritableForSendFile();
+            return;
+        }
+
+        m_writeBuffers.clear();
+        m_inFlightPacketNumber = 0;
+        while( m_inFlightPacketNumber < std::min( m_sendQueue.size(), MAX_GATHERED_PACKETS ) && !m_sendQueue[m_inFlightPacketNumber].m_file )
+        {
+            auto& outPacket = m_sendQueue[m_inFlightPacketNumber];
+            if ( outPacket.m_gatherPacket )
+            {
+                outPacket.m_gatherPacket->forEachBuffer( [this]( const uint8_t* data, size_t size )
+                {
+                    m_writeBuffers.push_back( asio::buffer( data, size ) );
+                });
+            }
+            else
+            {
+                m_writeBuffers.push_back( asio::buffer( outPacket.m_packet->data(), outPacket.m_packet->lenght() ) );
+            }
+            m_inFlightPacketNumber++;
+        }
+
+        ConstBufferRange buffers{ m_writeBuffers.data(), m_writeBuffers.data()+m_writeBuffers.size() };
+        asio::async_write( m_socket, buffers, makeAllocHandler( m_writeHandlerMemory,
+                [this,weak=weakFromThis()]( boost::system::error_code ec, std::size_t /*bytesTransfered*/ )
+        {
+            if ( auto shared = weak.lock(); shared )
+            {
+                onWriteCompleted( ec );
+            }
+        }));
+    }
+
+    std::weak_ptr<IAsyncTcpSession> weakFromThis()
+    {
+        return ((IAsyncTcpSession*)this)->weak_from_this();
+    }
+
+    void waitWritableForSendFile()
+    {
+        m_socket.async_wait( tcp::socket::wait_write, makeAllocHandler( m_writeHandlerMemory,
+                             [this,weak=weakFromThis()]( boost::system::error_code ec )
+        {
+            if ( auto shared = weak.lock(); shared )
+            {
+                if ( ec )
+                {
+                    onWriteCompleted( ec );
+                    return;
+                }
+                continueSendFile();
+            }
+        }));
+    }
+
+    // continueSendFile - sends file range, while socket is writable
+    void continueSendFile()
+    {
+        boost::system::error_code ec;
+        m_socket.native_non_blocking( true, ec );
+
+        while( !ec && m_fileSentBytes < m_sendingFileSize )
+        {
+            off_t offset = off_t( m_sendingFileOffset + m_fileSentBytes );
+            ssize_t sent = ::sendfile( m_socket.native_handle(), m_sendingFile->fd(), &offset, m_sendingFileSize - m_fileSentBytes );
+            if ( sent > 0 )
+            {
+                m_fileSentBytes += uint32_t(sent);
+            }
+            else if ( sent == 0 )
+            {
+                // file is shorter than the range
+                ec = asio::error::make_error_code( asio::error::eof );
+            }
+            else if ( errno == EAGAIN || errno == EWOULDBLOCK )
+            {
+                waitWritableForSendFile();
+                return;
+            }
+            else if ( errno != EINTR )
+            {
+                ec = boost::system::error_code( errno, boost::system::system_category() );
+            }
+        }
+
+        onWriteCompleted( ec );
+    }
+
+    void onWriteCompleted( boost::system::error_code ec )
+    {
+        boost::container::small_vector<std::function<void()>,8> handlers;
+        {
+            const std::lock_guard<std::mutex> autolock( m_sendQueueMutex );
+
+            m_lastWriteError = ec;
+
+            for( size_t i=0; i<m_inFlightPacketNumber; i++ )
+            {
+                if ( m_sendQueue.front().m_handler )
+                {
+                    handlers.push_back( std::move( m_sendQueue.front().m_handler ) );
+                }
+                m_sendQueueBytes -= m_sendQueue.front().size();
+                m_sendQueue.pop_front();
+            }
+            m_inFlightPacketNumber = 0;
+            m_sendingFile.reset();
+
+            if ( ec )
+            {
+                logSocketError();
+
+                // the rest of packets will never be sent
+                // (their handlers are called, so borrowed payload could be released and awaiting coroutines are resumed)
+                for( auto& outPacket : m_sendQueue )
+                {
+                    if ( outPacket.m_handler )
+                    {
+                        handlers.push_back( std::move( outPacket.m_handler ) );
+                    }
+                }
+                m_sendQueue.clear();
+                m_sendQueueBytes = 0;
+                boost::system::error_code ignored;
+                m_socket.close( ignored );
+            }
+            else if ( !m_sendQueue.empty() )
+            {
+                startWrite();
+            }
+        }
+
+        // handlers are called out of lock, because they could write again
+        for( auto& handler : handlers )
+        {
+            handler();
+        }
+    }
+
+protected:
+
+    void asyncRead( std::function<void()> func, uint32_t maxPacketLength ) override
+    {
+        //LOG( "asyncRead(" << this << ")" << std::endl );
+
+        // Get package lenght
+        auto weak = std::weak_ptr<IAsyncTcpSession>( ((IAsyncTcpSession*)this)->shared_from_this() );
+        asio::async_read( m_socket, asio::buffer( m_packetLen.bytes, 4 ),
+                          asio::transfer_exactly( 4 ),
+                          [this, weak, func, maxPacketLength]( boost::system::error_code ec, std::size_t bytesTransfered )
+        {
+            m_received1stRequest = true;
+
+            if ( auto shared = weak.lock(); shared )
+            {
+                m_lastReadError = ec;
+                if ( ec )
+                {
+                    logSocketError();
+                    func();
+                    return;
+                }
+
+                if ( bytesTransfered != 4 )
+                {
+                    handleProtocolError("invalid packet size");
+                    func();
+                    return;
+                }
+
+                uint32_t packetLen = m_packetLen.uint32();
+                LOG( "asyncRead: packetLen: " << packetLen << std::endl );
+
+                if ( !checkPacketLength( packetLen, maxPacketLength ) )
+                {
+                    func();
+                    return;
+                }
+
+                // Read package data
+                m_request.prepareToRead( packetLen );
+                auto weak = std::weak_ptr<IAsyncTcpSession>( ((IAsyncTcpSession*)this)->shared_from_this() );
+                asio::async_read( m_socket, asio::buffer( m_request.ptr()+4, packetLen-4 ),
+                                  asio::transfer_exactly( packetLen ),
+                                  [this, weak, func]( boost::system::error_code ec, std::size_t bytesTransfered )
+                {
+                    if ( auto shared = weak.lock(); shared )
+                    {
+                        //m_request.print("server:");
+                        m_lastReadError = ec;
+                        if ( ec )
+                        {
+                            logSocketError();
+                        }
+
+                        func();
+                    }
+                });
+            }
+        });
+    }
+    
+    void asyncReadBatch( std::function<void()> func, uint32_t maxPacketLength ) override
+    {
+        m_readBatchHandler = std::make_shared<std::function<void()>>( std::move(func) );
+        m_readBatchMaxPacketLength = maxPacketLength;
+
+        asyncReadBatch();
+    }
+
+    void asyncReadBatch() override
+    {
+        m_receivedPackets.clear();
+
+        if ( m_receiveBuffer.empty() )
+        {
+            m_receiveBuffer.resize( RECEIVE_BUFFER_SIZE );
+        }
+
+        // the rest of received data is the beginning of an incomplete packet (its length is already checked)
+        size_t restLen = m_receivedEnd - m_receivedBegin;
+        if ( restLen >= 4 )
+        {
+            uint32_t packetLen = packetLenght( &m_receiveBuffer[m_receivedBegin] );
+            if ( packetLen > MAX_COALESCED_PACKET_SIZE )
+            {
+                readBigPacket( packetLen );
+                return;
+            }
+        }
+
+        if ( m_receivedBegin > 0 )
+        {
+            memmove( &m_receiveBuffer[0], &m_receiveBuffer[m_receivedBegin], restLen );
+            m_receivedBegin = 0;
+            m_receivedEnd   = restLen;
+        }
+
+        size_t readSize = RECEIVE_BUFFER_SIZE-m_receivedEnd;
+        if ( m_isShortRead )
+        {
+            readSize = std::min( readSize, size_t(MAX_COALESCED_PACKET_SIZE) );
+        }
+
+        m_socket.async_read_some( asio::buffer( &m_receiveBuffer[m_receivedEnd], readSize ),
+                                  makeAllocHandler( m_readHandlerMemory,
+                                  [this,weak=weakFromThis()]( boost::system::error_code ec, std::size_t bytesTransfered )
+        {
+            m_received1stRequest = true;
+            m_isShortRead = false;
+
+            if ( auto shared = weak.lock(); shared )
+            {
+                m_lastReadError = ec;
+                if ( ec )
+                {
+                    logSocketError();
+                    callReadBatchHandler();
+                    return;
+                }
+
+                m_receivedEnd += bytesTransfered;
+                if ( !extractPackets( m_readBatchMaxPacketLength ) )
+                {
+                    callReadBatchHandler();
+                    return;
+                }
+
+                if ( m_receivedPackets.empty() )
+                {
+                    // not a single packet is received completely
+                    asyncReadBatch();
+                    return;
+                }
+
+                callReadBatchHandler();
+            }
+        }));
+    }
+
+    std::vector<TpktBufferPtr>& receivedPackets() override { return m_receivedPackets; }
+
+private:
+    static uint32_t packetLenght( const uint8_t* bytes )
+    {
+        return loadUint32LE( bytes );
+    }
+
+    bool checkPacketLength( uint32_t packetLen, uint32_t maxPacketLength )
+    {
+        if ( packetLen > maxPacketLength )
+        {
+            handleProtocolError( std::string("packet length exceeds ") + std::to_string(maxPacketLength) );
+            return false;
+        }
+
+        if ( packetLen < 8 )
+        {
+            handleProtocolError( "invalid packet size (<8)" );
+            return false;
+        }
+        return true;
+    }
+
+    // extractPackets - copies all complete packets from m_receiveBuffer into m_receivedPackets
+    // (an incomplete big packet is left for 'readBigPacket')
+    bool extractPackets( uint32_t maxPacketLength )
+    {
+        while( m_receivedEnd - m_receivedBegin >= 4 )
+        {
+            const uint8_t* bytes = &m_receiveBuffer[m_receivedBegin];
+            uint32_t packetLen = packetLenght( bytes );
+
+            if ( !checkPacketLength( packetLen, maxPacketLength ) )
+                return false;
+
+            if ( m_receivedEnd - m_receivedBegin < packetLen )
+                break;
+
+            TpktBufferPtr packet = acquireTpktBuffer( m_request.bufferPool(), packetLen );
+            memcpy( packet->data(), bytes, packetLen );
+            packet->setLenght( packetLen );
+            m_receivedPackets.push_back( std::move(packet) );
+
+            m_receivedBegin += packetLen;
+        }
+
+        if ( m_receivedBegin == m_receivedEnd )
+        {
+            m_receivedBegin = m_receivedEnd = 0;
+        }
+        return true;
+    }
+
+    void callReadBatchHandler()
+    {
+        // the handler could start the next read with another handler;
+        // after a read error the handler is released (it could hold the owner of the session)
+        auto handler = hasReadError() ? std::move( m_readBatchHandler ) : m_readBatchHandler;
+        (*handler)();
+    }
+
+    // readBigPacket - reads the rest of a packet, that is bigger than MAX_COALESCED_PACKET_SIZE, directly into its own buffer
+    void readBigPacket( uint32_t packetLen )
+    {
+        m_isShortRead = true;
+
+        TpktBufferPtr packet = acquireTpktBuffer( m_request.bufferPool(), packetLen );
+        packet->setLenght( packetLen );
+
+        size_t restLen = m_receivedEnd - m_receivedBegin;
+        memcpy( packet->data(), &m_receiveBuffer[m_receivedBegin], restLen );
+        m_receivedBegin = m_receivedEnd = 0;
+
+        asio::async_read( m_socket, asio::buffer( packet->data()+restLen, packetLen-restLen ),
+                          makeAllocHandler( m_readHandlerMemory,
+                          [this,weak=weakFromThis(),packet]( boost::system::error_code ec, std::size_t /*bytesTransfered*/ )
+        {
+            if ( auto shared = weak.lock(); shared )
+            {
+                m_lastReadError = ec;
+                if ( ec )
+                {
+                    logSocketError();
+                }
+                else
+                {
+                    m_receivedPackets.push_back( packet );
+                }
+                callReadBatchHandler();
+            }
+        }));
+    }
+
+protected:
+    void logSocketError()
+    {
+        if ( isEof() )
+        {
+            LOG( "AsyncTcpSession: client disconnected (" << m_lastErrorCode.message() << ")" << std::endl );
+        }
+        else
+        {
+            LOG( "AsyncTcpSession: socket error: " << m_lastReadError.message() << " " << m_lastReadError.message() << std::endl );
+        }
+    }
+
+    void closeSession() override
+    {
+        if ( !isOnOwnThread() )
+        {
+            asio::post( m_socket.get_executor(), [shared=shared_from_this()] { shared->closeSession(); } );
+            return;
+        }
+
+        boost::system::error_code ec;
+        m_socket.close(ec);
+    }
+
+
+    void handleProtocolError( std::string errorText )
+    {
+        m_readProtocolError.emplace( errorText );
+    }
+
+    std::string readErrorMessage() const    override
+    {
+        if ( m_readProtocolError.has_value() )
+            return m_readProtocolError.value();
+
+        return m_lastReadError.message();
+    }
+    std::string writeErrorMessage() const    override
+    {
+
+        return m_lastWriteError.message();
+    }
+
+    bool received1stRequest() const override
+    {
+        return m_received1stRequest;
+    }
+
+
+    void postOnStrand( std::function<void()> func ) override
+    {
+        asio::post( m_strand, std::move(func) );
+    }
+
+    void postOnStrand( StrandTaskPtr task ) override
+    {
+        HandlerMemory& memory = task->handlerMemory();
+        asio::post( m_strand, makeAllocHandler( memory, [task=std::move(task)] { task->run(); } ) );
+    }
+
+    void asyncWait( uint32_t milliseconds, std::function<void()> func ) override
+    {
+        auto timer = std::make_shared<asio::steady_timer>( m_socket.get_executor(), std::chrono::milliseconds( milliseconds ) );
+        timer->async_wait( [timer,func]( const boost::system::error_code& ec )
+        {
+            if ( !ec )
+                func();
+        });
+    }
+};
+
+
+//
+// IoShard - io_context, that is run by its own thread (sharded mode of AsyncTcpServer)
+//
+// Sessions of a shard are used only by the shard thread. Other shards start writes
+// on its sessions through the shard channel: queued sessions are handled
+// by one posted handler, so a fan-out to many sessions costs one wake-up of the shard.
+//
+class IoShard
+{
+    asio::io_context                                            m_context;
+    asio::executor_work_guard<asio::io_context::executor_type>  m_workGuard;
+
+    std::unique_ptr<tcp::acceptor>                              m_acceptor;
+    std::thread                                                 m_thread;
+
+    // shard channel (only one drain is posted at a time, so its memory is reused)
+    std::vector<std::shared_ptr<AsyncTcpSession>>               m_channel;
+    std::vector<std::shared_ptr<AsyncTcpSession>>               m_drainedChannel;
+    bool                                                        m_isDrainPosted = false;
+    HandlerMemory                                               m_drainHandlerMemory;
+    std::mutex                                                  m_channelMutex;
+
+    static inline thread_local IoShard*                         s_currentShard = nullptr;
+
+public:
+    IoShard() : m_workGuard( asio::make_work_guard( m_context ) ) {}
+
+    asio::io_context&                context()        { return m_context; }
+    std::unique_ptr<tcp::acceptor>&  acceptor()       { return m_acceptor; }
+
+    bool isCurrentThread() const { return s_currentShard == this; }
+
+    // start - runs io_context by the shard thread (bound to 'cpuIndex' if it is >= 0)
+    void start( int cpuIndex )
+    {
+        m_thread = std::thread( [this,cpuIndex]
+        {
+#ifdef __linux__
+            if ( cpuIndex >= 0 )
+            {
+                cpu_set_t cpuSet;
+                CPU_ZERO( &cpuSet );
+                CPU_SET( cpuIndex, &cpuSet );
+                pthread_setaffinity_np( pthread_self(), sizeof(cpuSet), &cpuSet );
+            }
+#endif
+            s_currentShard = this;
+            m_context.run();
+            s_currentShard = nullptr;
+        });
+    }
+
+    void stop()
+    {
+        if ( m_acceptor )
+        {
+            boost::system::error_code ec;
+            m_acceptor->close( ec );
+        }
+        m_workGuard.reset();
+        m_context.stop();
+    }
+
+    void join()
+    {
+        if ( m_thread.joinable() )
+            m_thread.join();
+    }
+
+    // postWriteStart - could be called by any thread
+    void postWriteStart( std::shared_ptr<AsyncTcpSession> session )
+    {
+        const std::lock_guard<std::mutex> autolock( m_channelMutex );
+
+        m_channel.push_back( std::move(session) );
+        if ( !m_isDrainPosted )
+        {
+            m_isDrainPosted = true;
+            asio::post( m_context, makeAllocHandler( m_drainHandlerMemory, [this] { drainChannel(); } ) );
+        }
+    }
+
+private:
+    void drainChannel()
+    {
+        {
+            const std::lock_guard<std::mutex> autolock( m_channelMutex );
+            m_channel.swap( m_drainedChannel );
+            m_isDrainPosted = false;
+        }
+
+        for( auto& session : m_drainedChannel )
+        {
+            session->startQueuedWrite();
+        }
+        m_drainedChannel.clear();
+    }
+};
+
+inline bool AsyncTcpSession::isOnOwnThread() const
+{
+    return m_shard == nullptr || m_shard->isCurrentThread();
+}
+
+inline void AsyncTcpSession::postWriteStartToShard()
+{
+    m_shard->postWriteStart( std::static_pointer_cast<AsyncTcpSession>( shared_from_this() ) );
+}
+
+}} // namespace catapult { namespace net
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+namespace catapult {
+namespace net {
+
+    //
+    // Little-endian fields of transport packets
+    //
+    // A field is loaded/stored by one unaligned 'memcpy' (compiled into one mov);
+    // bytes are swapped only on big-endian hosts.
+    //
+
+    inline uint32_t toLittleEndian( uint32_t val )
+    {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        return __builtin_bswap32( val );
+#else
+        return val;
+#endif
+    }
+
+    inline uint32_t loadUint32LE( const uint8_t* bytes )
+    {
+        uint32_t val;
+        std::memcpy( &val, bytes, sizeof(val) );
+        return toLittleEndian( val );
+    }
+
+    inline void storeUint32LE( uint8_t* bytes, uint32_t val )
+    {
+        val = toLittleEndian( val );
+        std::memcpy( bytes, &val, sizeof(val) );
+    }
+
+}} // namespace catapult { namespace net
@@ -0,0 +1,129 @@
+#pragma once
+#include <array>
+#include <memory>
+#include <stdexcept>
+
+#include <boost/container/small_vector.hpp>
+
+#include "Streaming.h"
+#include "ByteOrder.h"
+#include "TpktBuffer.h"
+
+namespace catapult {
+namespace net {
+
+    //
+    // GatherTpkt - transport packet, that is written as a buffer sequence: { packetLenght, fields and payload spans ... }
+    //
+    // Small fields are stored inline; payload is never copied:
+    // a borrowed span must be valid until the write is completed,
+    // a shared span holds its owner (so it could be used by async writes).
+    // A built packet is immutable, so it could be written to many sessions.
+    //
+    class GatherTpkt
+    {
+        static constexpr uint32_t INLINE_CAPACITY = 64;
+
+        struct Span
+        {
+            const uint8_t*              m_data;     // inline bytes, if it is nullptr
+            uint32_t                    m_offset;   // offset of inline bytes
+            uint32_t                    m_size;
+            std::shared_ptr<const void> m_owner;
+            TpktBufferPtr               m_buffer;   // owner of bytes of a received packet
+        };
+
+        std::array<uint8_t,INLINE_CAPACITY>         m_inline;
+        uint32_t                                    m_inlineSize = 0;
+        boost::container::small_vector<Span,4>      m_spans;
+        size_t                                      m_lenght = 0;
+
+    public:
+        GatherTpkt( uint32_t version, uint32_t command )
+        {
+            writeUint32( 0 );       // packet lenght (see 'updatePacketLenght()')
+            writeUint32( version );
+            writeUint32( command );
+        }
+
+        // writeUint32 - writes field inline
+        void writeUint32( uint32_t val )
+        {
+            if ( m_inlineSize + 4 > INLINE_CAPACITY )
+                throw std::runtime_error( "GatherTpkt: too many inline fields" );
+
+            storeUint32LE( &m_inline[m_inlineSize], val );
+
+            if ( !m_spans.empty() && m_spans.back().m_data == nullptr )
+            {
+                m_spans.back().m_size += 4;
+            }
+            else
+            {
+                m_spans.push_back( Span{ nullptr, m_inlineSize, 4, {}, {} } );
+            }
+            m_inlineSize += 4;
+            m_lenght += 4;
+        }
+
+        // writeBytes - writes lenght and borrowed bytes (as 'Tpkt::writeBytes()', but without copying)
+        void writeBytes( const uint8_t* bytes, uint32_t len )
+        {
+            writeUint32( len );
+            append( bytes, len );
+        }
+
+        // writeBytes - writes lenght and bytes, that are held by 'owner'
+        void writeBytes( std::shared_ptr<const void> owner, const uint8_t* bytes, uint32_t len )
+        {
+            writeUint32( len );
+            append( std::move(owner), bytes, len );
+        }
+
+        // append - appends borrowed bytes
+        void append( const uint8_t* bytes, uint32_t len )
+        {
+            append( std::shared_ptr<const void>(), bytes, len );
+        }
+
+        // append - appends bytes, that are held by 'owner'
+        void append( std::shared_ptr<const void> owner, const uint8_t* bytes, uint32_t len )
+        {
+            if ( len > 0 )
+            {
+                m_spans.push_back( Span{ bytes, 0, len, std::move(owner), {} } );
+                m_lenght += len;
+            }
+        }
+
+        // append - appends bytes of received packet 'buffer' (they are held by the packet)
+        void append( const TpktBufferPtr& buffer, const uint8_t* bytes, uint32_t len )
+        {
+            if ( len > 0 )
+            {
+                m_spans.push_back( Span{ bytes, 0, len, {}, buffer } );
+                m_lenght += len;
+            }
+        }
+
+        void updatePacketLenght()
+        {
+            storeUint32LE( &m_inline[0], uint32_t( m_lenght ) );
+        }
+
+        size_t lenght() const { return m_lenght; }
+
+        // forEachBuffer - calls 'func( const uint8_t* data, size_t size )' for each span in order
+        template<class Func>
+        void forEachBuffer( Func&& func ) const
+        {
+            for( const auto& span : m_spans )
+            {
+                func( span.m_data ? span.m_data : &m_inline[span.m_offset], size_t(span.m_size) );
+            }
+        }
+    };
+
+    typedef std::shared_ptr<GatherTpkt> GatherTpktPtr;
+
+}} // namespace catapult { namespace net
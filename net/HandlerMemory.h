@@ -0,0 +1,108 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace catapult {
+namespace net {
+
+    //
+    // HandlerMemory - memory of asio operation, that is reused by the next operation of the same kind
+    //
+    // A session has only one read (and one write) in flight, so its operations
+    // are allocated from the session instead of the heap.
+    // If the memory is busy or too small, the heap is used.
+    //
+    class HandlerMemory
+    {
+        static constexpr size_t SIZE = 1024;
+
+        typename std::aligned_storage<SIZE>::type   m_storage;
+        bool                                        m_isInUse = false;
+
+    public:
+        HandlerMemory() {}
+
+        HandlerMemory( const HandlerMemory& ) = delete;
+        HandlerMemory& operator=( const HandlerMemory& ) = delete;
+
+        void* allocate( size_t size )
+        {
+            if ( !m_isInUse && size <= SIZE )
+            {
+                m_isInUse = true;
+                return &m_storage;
+            }
+            return ::operator new( size );
+        }
+
+        void deallocate( void* pointer )
+        {
+            if ( pointer == &m_storage )
+            {
+                m_isInUse = false;
+                return;
+            }
+            ::operator delete( pointer );
+        }
+    };
+
+    //
+    // HandlerAllocator - allocator of handler, that is associated with asio operation
+    //
+    template<class T>
+    class HandlerAllocator
+    {
+        template<class> friend class HandlerAllocator;
+
+        HandlerMemory& m_memory;
+
+    public:
+        typedef T value_type;
+
+        explicit HandlerAllocator( HandlerMemory& memory ) : m_memory( memory ) {}
+
+        template<class U>
+        HandlerAllocator( const HandlerAllocator<U>& other ) : m_memory( other.m_memory ) {}
+
+        T* allocate( size_t n )          { return static_cast<T*>( m_memory.allocate( sizeof(T)*n ) ); }
+        void deallocate( T* p, size_t )  { m_memory.deallocate( p ); }
+
+        template<class U>
+        bool operator==( const HandlerAllocator<U>& other ) const { return &m_memory == &other.m_memory; }
+
+        template<class U>
+        bool operator!=( const HandlerAllocator<U>& other ) const { return &m_memory != &other.m_memory; }
+    };
+
+    //
+    // AllocHandler - handler, which operation is allocated in HandlerMemory (see 'makeAllocHandler()')
+    //
+    template<class Handler>
+    class AllocHandler
+    {
+        HandlerMemory&  m_memory;
+        Handler         m_handler;
+
+    public:
+        typedef HandlerAllocator<Handler> allocator_type;
+
+        AllocHandler( HandlerMemory& memory, Handler handler ) : m_memory( memory ), m_handler( std::move(handler) ) {}
+
+        allocator_type get_allocator() const noexcept { return allocator_type( m_memory ); }
+
+        template<class... Args>
+        void operator()( Args&&... args )
+        {
+            m_handler( std::forward<Args>(args)... );
+        }
+    };
+
+    template<class Handler>
+    inline AllocHandler<typename std::decay<Handler>::type> makeAllocHandler( HandlerMemory& memory, Handler&& handler )
+    {
+        return AllocHandler<typename std::decay<Handler>::type>( memory, std::forward<Handler>(handler) );
+    }
+
+}} // namespace catapult { namespace net
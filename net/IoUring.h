@@ -0,0 +1,408 @@
+#pragma once
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace catapult {
+namespace net      {
+
+    //
+    // IoUring - submission and completion queues of io_uring
+    //
+    // It is a thin wrapper of raw syscalls (liburing is not required).
+    // A ring is used only by its own thread (see UringTcpServer.cpp).
+    //
+    class IoUring
+    {
+        int             m_fd = -1;
+
+        // index of registered ring fd (io_uring_enter does not look up the file), or -1
+        int             m_registeredIndex = -1;
+
+        void*           m_sqRing = MAP_FAILED;
+        size_t          m_sqRingSize = 0;
+        void*           m_cqRing = MAP_FAILED;
+        size_t          m_cqRingSize = 0;
+        io_uring_sqe*   m_sqes = (io_uring_sqe*) MAP_FAILED;
+        size_t          m_sqesSize = 0;
+
+        uint32_t*       m_sqHead;
+        uint32_t*       m_sqTail;
+        uint32_t*       m_sqArray;
+        uint32_t        m_sqMask = 0;
+        uint32_t        m_sqEntries = 0;
+
+        // entries, that are filled but not submitted yet
+        uint32_t        m_sqLocalTail = 0;
+        uint32_t        m_toSubmit = 0;
+
+        uint32_t*       m_cqHead;
+        uint32_t*       m_cqTail;
+        io_uring_cqe*   m_cqes;
+        uint32_t        m_cqMask = 0;
+
+    public:
+        IoUring() {}
+
+        IoUring( const IoUring& ) = delete;
+        IoUring& operator=( const IoUring& ) = delete;
+
+        ~IoUring()
+        {
+            if ( m_sqes != MAP_FAILED )
+                munmap( m_sqes, m_sqesSize );
+            if ( m_cqRing != MAP_FAILED && m_cqRing != m_sqRing )
+                munmap( m_cqRing, m_cqRingSize );
+            if ( m_sqRing != MAP_FAILED )
+                munmap( m_sqRing, m_sqRingSize );
+            if ( m_fd >= 0 )
+                ::close( m_fd );
+        }
+
+        int fd() const { return m_fd; }
+
+        //
+        // init - creates the ring; returns false (and 'errorText'), if io_uring is not available
+        //
+        // The ring is created for a single issuer with deferred task running (if the kernel supports it),
+        // so completions are processed only when the ring thread waits for them.
+        //
+        bool init( uint32_t entries, std::string& errorText )
+        {
+            const uint32_t flagVariants[] = { IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN, IORING_SETUP_COOP_TASKRUN, 0 };
+
+            io_uring_params params;
+            for( uint32_t flags : flagVariants )
+            {
+                memset( &params, 0, sizeof(params) );
+                params.flags = flags | IORING_SETUP_CQSIZE;
+                params.cq_entries = entries*4;
+
+                m_fd = (int) syscall( __NR_io_uring_setup, entries, &params );
+                if ( m_fd >= 0 || errno != EINVAL )
+                    break;
+            }
+
+            if ( m_fd < 0 )
+            {
+                errorText = std::string( "io_uring_setup: " ) + strerror( errno );
+                return false;
+            }
+
+            if ( !(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP) )
+            {
+                errorText = "io_uring: kernel is too old";
+                return false;
+            }
+
+            m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+            m_cqRingSize = params.cq_off.cqes  + params.cq_entries * sizeof(io_uring_cqe);
+            m_sqRingSize = m_cqRingSize = std::max( m_sqRingSize, m_cqRingSize );
+
+            m_sqRing = mmap( 0, m_sqRingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, m_fd, IORING_OFF_SQ_RING );
+            if ( m_sqRing == MAP_FAILED )
+            {
+                errorText = std::string( "io_uring mmap: " ) + strerror( errno );
+                return false;
+            }
+            m_cqRing = m_sqRing;
+
+            m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            m_sqes = (io_uring_sqe*) mmap( 0, m_sqesSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, m_fd, IORING_OFF_SQES );
+            if ( m_sqes == MAP_FAILED )
+            {
+                errorText = std::string( "io_uring mmap: " ) + strerror( errno );
+                return false;
+            }
+
+            uint8_t* sq = (uint8_t*) m_sqRing;
+            m_sqHead    = (uint32_t*)( sq + params.sq_off.head );
+            m_sqTail    = (uint32_t*)( sq + params.sq_off.tail );
+            m_sqArray   = (uint32_t*)( sq + params.sq_off.array );
+            m_sqMask    = *(uint32_t*)( sq + params.sq_off.ring_mask );
+            m_sqEntries = params.sq_entries;
+            m_sqLocalTail = *m_sqTail;
+
+            uint8_t* cq = (uint8_t*) m_cqRing;
+            m_cqHead    = (uint32_t*)( cq + params.cq_off.head );
+            m_cqTail    = (uint32_t*)( cq + params.cq_off.tail );
+            m_cqes      = (io_uring_cqe*)( cq + params.cq_off.cqes );
+            m_cqMask    = *(uint32_t*)( cq + params.cq_off.ring_mask );
+
+            registerRingFd();
+            return true;
+        }
+
+        // getSqe - returns zeroed entry; queued entries are submitted, if the queue is full
+        io_uring_sqe* getSqe()
+        {
+            if ( m_sqLocalTail - __atomic_load_n( m_sqHead, __ATOMIC_ACQUIRE ) >= m_sqEntries )
+            {
+                submitAndWait( 0 );
+            }
+
+            uint32_t index = m_sqLocalTail & m_sqMask;
+            io_uring_sqe* sqe = &m_sqes[index];
+            memset( sqe, 0, sizeof(*sqe) );
+
+            m_sqArray[index] = index;
+            m_sqLocalTail++;
+            m_toSubmit++;
+            __atomic_store_n( m_sqTail, m_sqLocalTail, __ATOMIC_RELEASE );
+            return sqe;
+        }
+
+        //
+        // submitAndWait - submits all queued entries by one syscall and waits for 'waitNumber' completions;
+        // returns negative errno on failure (EINTR and EBUSY are not failures)
+        //
+        // Completions are always reaped (with deferred task running they are posted only by IORING_ENTER_GETEVENTS).
+        //
+        int submitAndWait( uint32_t waitNumber )
+        {
+            uint32_t flags = IORING_ENTER_GETEVENTS;
+            int fd = m_fd;
+            if ( m_registeredIndex >= 0 )
+            {
+                flags |= IORING_ENTER_REGISTERED_RING;
+                fd = m_registeredIndex;
+            }
+
+            int rc = (int) syscall( __NR_io_uring_enter, fd, m_toSubmit, waitNumber, flags, nullptr, 0 );
+            if ( rc < 0 )
+            {
+                return ( errno == EINTR || errno == EBUSY || errno == EAGAIN ) ? 0 : -errno;
+            }
+
+            m_toSubmit -= std::min( m_toSubmit, uint32_t(rc) );
+            return rc;
+        }
+
+        // forEachCqe - calls 'func( cqe )' for each available completion
+        template<class Func>
+        uint32_t forEachCqe( Func&& func )
+        {
+            uint32_t head = *m_cqHead;
+            uint32_t tail = __atomic_load_n( m_cqTail, __ATOMIC_ACQUIRE );
+
+            for( uint32_t i = head; i != tail; i++ )
+            {
+                func( m_cqes[ i & m_cqMask ] );
+            }
+
+            __atomic_store_n( m_cqHead, tail, __ATOMIC_RELEASE );
+            return tail - head;
+        }
+
+        // registerResource - 'IORING_REGISTER_...' call; returns negative errno on failure
+        int registerResource( uint32_t opcode, void* arg, uint32_t argNumber )
+        {
+            int rc = (int) syscall( __NR_io_uring_register, m_fd, opcode, arg, argNumber );
+            return rc < 0 ? -errno : rc;
+        }
+
+    private:
+        void registerRingFd()
+        {
+            io_uring_rsrc_update update;
+            memset( &update, 0, sizeof(update) );
+            update.offset = uint32_t(-1);
+            update.data   = uint64_t( m_fd );
+
+            if ( registerResource( IORING_REGISTER_RING_FDS, &update, 1 ) == 1 && update.offset != uint32_t(-1) )
+            {
+                m_registeredIndex = int( update.offset );
+            }
+        }
+    };
+
+    //
+    // UringBufferRing - buffers, that are registered in io_uring and are provided to receive operations
+    //
+    // The kernel picks a buffer for each received chunk (IOSQE_BUFFER_SELECT), so receives, that are
+    // waiting for data, do not hold memory. A buffer is returned to the ring after its data is consumed.
+    //
+    // A buffer ring (IORING_REGISTER_PBUF_RING) is checked by a test read at init; if the kernel does not
+    // pick buffers from it, buffers are provided by IORING_OP_PROVIDE_BUFFERS (consecutive recycled buffers by one entry).
+    //
+    class UringBufferRing
+    {
+        IoUring&                m_ring;
+        uint16_t                m_groupId;
+        uint32_t                m_bufferNumber;
+        uint32_t                m_bufferSize;
+
+        io_uring_buf_ring*      m_bufRing = (io_uring_buf_ring*) MAP_FAILED;
+        size_t                  m_bufRingSize = 0;
+        uint8_t*                m_buffers = (uint8_t*) MAP_FAILED;
+
+        uint16_t                m_tail = 0;
+
+        // buffers, that are recycled but not provided yet (if the buffer ring is not used)
+        bool                    m_isRingUsed = true;
+        std::vector<uint16_t>   m_recycled;
+
+    public:
+        // 'bufferNumber' must be a power of 2
+        UringBufferRing( IoUring& ring, uint16_t groupId, uint32_t bufferNumber, uint32_t bufferSize )
+            : m_ring( ring ), m_groupId( groupId ), m_bufferNumber( bufferNumber ), m_bufferSize( bufferSize )
+        {}
+
+        UringBufferRing( const UringBufferRing& ) = delete;
+        UringBufferRing& operator=( const UringBufferRing& ) = delete;
+
+        ~UringBufferRing()
+        {
+            if ( m_buffers != MAP_FAILED )
+                munmap( m_buffers, size_t(m_bufferNumber)*m_bufferSize );
+            if ( m_bufRing != MAP_FAILED )
+                munmap( m_bufRing, m_bufRingSize );
+        }
+
+        uint16_t groupId()    const { return m_groupId; }
+        uint32_t bufferSize() const { return m_bufferSize; }
+        bool     isRingUsed() const { return m_isRingUsed; }
+
+        // init - must be called before other operations of the ring are submitted (it waits for a test completion)
+        bool init( std::string& errorText )
+        {
+            m_bufRingSize = m_bufferNumber * sizeof(io_uring_buf);
+            m_bufRing = (io_uring_buf_ring*) mmap( 0, m_bufRingSize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0 );
+            m_buffers = (uint8_t*) mmap( 0, size_t(m_bufferNumber)*m_bufferSize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0 );
+            if ( m_bufRing == MAP_FAILED || m_buffers == MAP_FAILED )
+            {
+                errorText = std::string( "buffer ring mmap: " ) + strerror( errno );
+                return false;
+            }
+
+            io_uring_buf_reg reg;
+            memset( &reg, 0, sizeof(reg) );
+            reg.ring_addr    = uint64_t( m_bufRing );
+            reg.ring_entries = m_bufferNumber;
+            reg.bgid         = m_groupId;
+
+            if ( m_ring.registerResource( IORING_REGISTER_PBUF_RING, &reg, 1 ) == 0 )
+            {
+                for( uint32_t i=0; i<m_bufferNumber; i++ )
+                {
+                    recycle( uint16_t(i) );
+                }
+                publish();
+
+                if ( testRead() )
+                    return true;
+
+                m_ring.registerResource( IORING_UNREGISTER_PBUF_RING, &reg, 1 );
+            }
+
+            m_isRingUsed = false;
+            m_recycled.clear();
+            for( uint32_t i=0; i<m_bufferNumber; i++ )
+            {
+                recycle( uint16_t(i) );
+            }
+            publish();
+
+            if ( !testRead() )
+            {
+                errorText = "io_uring: provided buffers are not supported";
+                return false;
+            }
+            return true;
+        }
+
+        const uint8_t* buffer( uint16_t bufferId ) const { return m_buffers + size_t(bufferId)*m_bufferSize; }
+
+        // recycle - returns buffer to the ring (it is visible to the kernel after 'publish()')
+        void recycle( uint16_t bufferId )
+        {
+            if ( !m_isRingUsed )
+            {
+                m_recycled.push_back( bufferId );
+                return;
+            }
+
+            io_uring_buf& buf = m_bufRing->bufs[ m_tail & (m_bufferNumber-1) ];
+            buf.addr = uint64_t( m_buffers + size_t(bufferId)*m_bufferSize );
+            buf.len  = m_bufferSize;
+            buf.bid  = bufferId;
+            m_tail++;
+        }
+
+        void publish()
+        {
+            if ( m_isRingUsed )
+            {
+                __atomic_store_n( &m_bufRing->tail, m_tail, __ATOMIC_RELEASE );
+                return;
+            }
+
+            // consecutive buffers are provided by one entry (its completion is skipped, if it succeeds)
+            for( size_t i=0; i<m_recycled.size(); )
+            {
+                size_t j = i+1;
+                while( j < m_recycled.size() && m_recycled[j] == m_recycled[j-1]+1 )
+                {
+                    j++;
+                }
+
+                io_uring_sqe* sqe = m_ring.getSqe();
+                sqe->opcode    = IORING_OP_PROVIDE_BUFFERS;
+                sqe->fd        = int( j-i );
+                sqe->addr      = uint64_t( buffer( m_recycled[i] ) );
+                sqe->len       = m_bufferSize;
+                sqe->off       = m_recycled[i];
+                sqe->buf_group = m_groupId;
+                sqe->flags     = IOSQE_CQE_SKIP_SUCCESS;
+                i = j;
+            }
+            m_recycled.clear();
+        }
+
+    private:
+        // testRead - reads one byte from a pipe into a selected buffer (the buffer is recycled)
+        bool testRead()
+        {
+            int pipeFds[2];
+            if ( pipe( pipeFds ) != 0 )
+                return false;
+
+            uint8_t byte = 0;
+            bool isSelected = false;
+            if ( ::write( pipeFds[1], &byte, 1 ) == 1 )
+            {
+                io_uring_sqe* sqe = m_ring.getSqe();
+                sqe->opcode    = IORING_OP_READ;
+                sqe->fd        = pipeFds[0];
+                sqe->off       = uint64_t(-1);
+                sqe->flags     = IOSQE_BUFFER_SELECT;
+                sqe->buf_group = m_groupId;
+
+                if ( m_ring.submitAndWait( 1 ) >= 0 )
+                {
+                    m_ring.forEachCqe( [&]( const io_uring_cqe& cqe )
+                    {
+                        if ( cqe.res == 1 && (cqe.flags & IORING_CQE_F_BUFFER) )
+                        {
+                            isSelected = true;
+                            recycle( uint16_t( cqe.flags >> IORING_CQE_BUFFER_SHIFT ) );
+                            publish();
+                        }
+                    });
+                }
+            }
+
+            ::close( pipeFds[0] );
+            ::close( pipeFds[1] );
+            return isSelected;
+        }
+    };
+
+}} // namespace catapult { namespace net
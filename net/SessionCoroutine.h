@@ -0,0 +1,146 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+#include "AsyncTcpServer.h"
+
+//
+// Coroutine API of IAsyncTcpSession (it is used by the C++20 build, see CATAPULT_COROUTINES in CMakeLists.txt)
+//
+// A session is served by one coroutine with straight-line code:
+//
+//      AwaitableSession session( tcpSession );
+//      if ( !co_await session.write( response ) ) ...
+//      while( co_await session.read() )
+//          for( auto& packet : session->receivedPackets() ) ...
+//
+// The frame of the coroutine is allocated once and it is reused by all reads and writes of the session
+// (instead of a closure for each step of callback chain).
+//
+
+namespace catapult {
+namespace net      {
+
+    //
+    // SessionCoroutine - coroutine, that is started at once and is not awaited (its frame is deleted at its end)
+    //
+    // Exceptions must be handled by the coroutine itself (an unhandled exception is logged and ends the coroutine).
+    //
+    struct SessionCoroutine
+    {
+        struct promise_type
+        {
+            SessionCoroutine    get_return_object() noexcept    { return {}; }
+            std::suspend_never  initial_suspend()   noexcept    { return {}; }
+            std::suspend_never  final_suspend()     noexcept    { return {}; }
+            void                return_void()       noexcept    {}
+
+            void unhandled_exception()
+            {
+                try
+                {
+                    throw;
+                }
+                catch ( std::exception& error )
+                {
+                    LOG_ERR( "session coroutine error: " << error.what() << std::endl );
+                }
+            }
+        };
+    };
+
+    //
+    // AwaitableSession - IAsyncTcpSession, which operations are awaited by a coroutine
+    //
+    // 'co_await read()'       - reads the next batch of packets (see 'IAsyncTcpSession::asyncReadBatch()');
+    //                           returns false after a read error
+    // 'co_await write( pkt )' - queues 'pkt' (it is copied) and waits until it is written;
+    //                           returns false after a write error
+    //
+    // Only one coroutine awaits the session (it is resumed by a thread of the session io_context).
+    // Session handlers hold only a pointer to this object (so std::function does not allocate it),
+    // and the read handler is set once for the whole read loop.
+    // The session is held until the coroutine ends (so a pending read is always completed).
+    //
+    class AwaitableSession
+    {
+        std::shared_ptr<IAsyncTcpSession>   m_session;
+        uint32_t                            m_maxPacketLength;
+
+        std::coroutine_handle<>             m_awaitingCoroutine;
+        bool                                m_isReadHandlerSet = false;
+
+    public:
+        explicit AwaitableSession( std::shared_ptr<IAsyncTcpSession> session, uint32_t maxPacketLength = 10*1024*1024 )
+            : m_session( std::move(session) ), m_maxPacketLength( maxPacketLength )
+        {}
+
+        AwaitableSession( const AwaitableSession& ) = delete;
+        AwaitableSession& operator=( const AwaitableSession& ) = delete;
+
+        IAsyncTcpSession* operator->() { return m_session.get(); }
+        IAsyncTcpSession& operator*()  { return *m_session; }
+
+        struct ReadAwaiter
+        {
+            AwaitableSession& m_owner;
+
+            bool await_ready() const noexcept { return false; }
+
+            void await_suspend( std::coroutine_handle<> coroutine )
+            {
+                m_owner.m_awaitingCoroutine = coroutine;
+                m_owner.startRead();
+            }
+
+            bool await_resume() const
+            {
+                if ( !m_owner.m_session->hasReadError() )
+                    return true;
+
+                // the session releases the read handler after a read error
+                m_owner.m_isReadHandlerSet = false;
+                return false;
+            }
+        };
+
+        struct WriteAwaiter
+        {
+            AwaitableSession&   m_owner;
+            Tpkt&               m_packet;
+
+            bool await_ready() const noexcept { return false; }
+
+            void await_suspend( std::coroutine_handle<> coroutine )
+            {
+                m_owner.m_awaitingCoroutine = coroutine;
+                m_owner.m_session->asyncWrite( m_packet, [owner=&m_owner] { owner->resume(); } );
+            }
+
+            bool await_resume() const { return !m_owner.m_session->hasWriteError(); }
+        };
+
+        ReadAwaiter  read()                 { return ReadAwaiter{ *this }; }
+        WriteAwaiter write( Tpkt& packet )  { return WriteAwaiter{ *this, packet }; }
+
+    private:
+        void startRead()
+        {
+            if ( m_isReadHandlerSet )
+            {
+                m_session->asyncReadBatch();
+                return;
+            }
+
+            m_isReadHandlerSet = true;
+            m_session->asyncReadBatch( [this] { resume(); }, m_maxPacketLength );
+        }
+
+        void resume()
+        {
+            std::exchange( m_awaitingCoroutine, nullptr ).resume();
+        }
+    };
+
+}} // namespace catapult { namespace net
@@ -0,0 +1,174 @@
+#include "AsyncTcpServer.h"
+#include "AsyncTcpSession.h"
+#include "StreamManager.h"
+
+namespace catapult {
+namespace net      {
+
+//
+// ShardedAsyncTcpServer - thread-per-core AsyncTcpServer
+//
+// Each thread runs its own io_context (IoShard) and a session is served by one shard for its whole life.
+// With SO_REUSEPORT each shard has its own acceptor (the kernel balances connections);
+// otherwise the acceptor of the 1st shard hands over accepted sockets to shards round-robin.
+//
+class ShardedAsyncTcpServer : public IAsyncTcpServer
+{
+    std::vector<std::unique_ptr<IoShard>>   m_shards;
+
+    NewSessionHandler                       m_newSessionHandler;
+    bool                                    m_useReusePort;
+
+    size_t                                  m_nextShardIndex = 0;
+    std::atomic<bool>                       m_isStopping{false};
+
+public:
+
+    ShardedAsyncTcpServer( NewSessionHandler newSessionHandler, bool useReusePort )
+        : m_newSessionHandler( newSessionHandler ),
+          m_useReusePort( useReusePort )
+    {}
+
+    // start
+    void start( uint32_t port, uint threadNumber ) override
+    {
+        if ( threadNumber == 0 )
+            threadNumber = 1;
+
+        for( uint i=0; i<threadNumber; i++ )
+        {
+            m_shards.emplace_back( new IoShard() );
+        }
+
+        if ( m_useReusePort && !openReusePortAcceptors( port ) )
+        {
+            LOG_WARN( "SO_REUSEPORT is not available; sessions are handed over to shards round-robin" << std::endl );
+            m_useReusePort = false;
+        }
+
+        if ( m_useReusePort )
+        {
+            for( auto& shard : m_shards )
+            {
+                startAccept( *shard );
+            }
+        }
+        else
+        {
+            auto& acceptor = m_shards[0]->acceptor();
+            acceptor = std::unique_ptr<tcp::acceptor>( new tcp::acceptor( m_shards[0]->context(), tcp::endpoint( tcp::v4(), port )) );
+            startRoundRobinAccept();
+        }
+
+        uint cpuNumber = std::thread::hardware_concurrency();
+        for( uint i=0; i<m_shards.size(); i++ )
+        {
+            m_shards[i]->start( cpuNumber > 0 ? int(i % cpuNumber) : -1 );
+        }
+    }
+
+    // stop
+    void stop() override
+    {
+        m_isStopping = true;
+
+        for( auto& shard : m_shards )
+        {
+            shard->stop();
+        }
+        for( auto& shard : m_shards )
+        {
+            shard->join();
+        }
+    }
+
+private:
+
+    bool openReusePortAcceptors( uint32_t port )
+    {
+#ifdef SO_REUSEPORT
+        try
+        {
+            for( auto& shard : m_shards )
+            {
+                auto acceptor = std::unique_ptr<tcp::acceptor>( new tcp::acceptor( shard->context() ) );
+                tcp::endpoint endpoint( tcp::v4(), port );
+
+                acceptor->open( endpoint.protocol() );
+                acceptor->set_option( tcp::acceptor::reuse_address(true) );
+                acceptor->set_option( asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true) );
+                acceptor->bind( endpoint );
+                acceptor->listen();
+
+                shard->acceptor() = std::move( acceptor );
+            }
+            return true;
+        }
+        catch( std::exception& ex )
+        {
+            LOG_WARN( "cannot open SO_REUSEPORT acceptor: " << ex.what() << std::endl );
+            for( auto& shard : m_shards )
+            {
+                shard->acceptor().reset();
+            }
+        }
+#endif
+        return false;
+    }
+
+    // startAccept - accepts sessions of 'shard' by its own acceptor
+    void startAccept( IoShard& shard )
+    {
+        auto newSession = std::make_shared<AsyncTcpSession>( shard.context(), &shard );
+
+        shard.acceptor()->async_accept( newSession->socket(), [newSession,&shard,this] ( const boost::system::error_code& ec )
+        {
+            if ( m_isStopping )
+                return;
+
+            if (!ec)
+            {
+                m_newSessionHandler( newSession );
+            }
+            else
+            {
+                LOG_ERR( "async_accept error: " << ec.message() << std::endl );
+            }
+            startAccept( shard );
+        });
+    }
+
+    // startRoundRobinAccept - accepts socket into the context of the next shard
+    void startRoundRobinAccept()
+    {
+        IoShard& shard = *m_shards[ m_nextShardIndex ];
+        m_nextShardIndex = (m_nextShardIndex+1) % m_shards.size();
+
+        auto newSession = std::make_shared<AsyncTcpSession>( shard.context(), &shard );
+
+        m_shards[0]->acceptor()->async_accept( newSession->socket(), [newSession,&shard,this] ( const boost::system::error_code& ec )
+        {
+            if ( m_isStopping )
+                return;
+
+            if (!ec)
+            {
+                // session is started by its own shard
+                asio::post( shard.context(), [newSession,this] { m_newSessionHandler( newSession ); } );
+            }
+            else
+            {
+                LOG_ERR( "async_accept error: " << ec.message() << std::endl );
+            }
+            startRoundRobinAccept();
+        });
+    }
+};
+
+
+std::unique_ptr<IAsyncTcpServer> createShardedAsyncTcpServer( NewSessionHandler newSessionHandler, bool useReusePort )
+{
+    return std::unique_ptr<IAsyncTcpServer>( new ShardedAsyncTcpServer( newSessionHandler, useReusePort ) );
+}
+
+}}
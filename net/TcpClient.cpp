@@ -2,6 +2,7 @@
 #include <cstring>
 #include <iostream>
 #include <string>
+#include <utility>
 #include <boost/asio.hpp>
 #include <boost/lambda/bind.hpp>
 #include <boost/lambda/lambda.hpp>
@@ -102,6 +103,28 @@ public:
         return !ec;
     }
 
+    bool write( GatherTpkt& packet ) override
+    {
+        packet.updatePacketLenght();
+
+        std::vector<asio::const_buffer> buffers;
+        packet.forEachBuffer( [&buffers]( const uint8_t* data, size_t size )
+        {
+            buffers.push_back( asio::buffer( data, size ) );
+        });
+
+        // start write
+        m_deadline.expires_from_now(m_timeout);
+        boost::system::error_code ec = boost::asio::error::would_block;
+        boost::asio::async_write( m_socket, buffers, boost::lambda::var(ec) = boost::lambda::_1 );
+
+        // perform operation
+        do m_context.run_one(); while (ec == boost::asio::error::would_block);
+
+        m_lastErrorCode = ec;
+        return !ec;
+    }
+
     bool read( TpktRcv& packet ) override
     {
         //
@@ -2,6 +2,7 @@
 #include <string>
 
 #include "Tpkt.h"
+#include "GatherTpkt.h"
 
 namespace catapult {
 namespace net {
@@ -23,12 +24,15 @@ namespace net {
         virtual void close() = 0;
 
         virtual bool write( Tpkt& ) = 0;
+
+        // write - writes packet as a buffer sequence (its payload is not copied)
+        virtual bool write( GatherTpkt& ) = 0;
         virtual bool read( TpktRcv& ) = 0;
 
 //        virtual bool writeChunk( streamId, timeMilisecods, audioVideoOffset, audioDuration, videoDuration, isKeyVideoFrame, data ) = 0;
 //        virtual bool readChuck( TpktRcv& ) = 0;
 
-//        virtual void startReadLoop( std::function<void(Tpkt&)> ) = 0;
+        // see IAsyncTcpClient (AsyncTcpClient.h) for callback driven reading
     };
 
     std::unique_ptr<ITcpClient> createTcpClient();
@@ -1,4 +1,5 @@
 #pragma once
+#include <initializer_list>
 #include <vector>
 
 //#ifdef DEBUG
@@ -6,6 +7,8 @@
 //#endif
 
 #include "Streaming.h"
+#include "TpktBuffer.h"
+#include "ByteOrder.h"
 
 namespace catapult {
 namespace net {
@@ -19,15 +22,12 @@ namespace net {
 
         TpktLen( uint32_t len )
         {
-            bytes[0] = len         & 0xFF;
-            bytes[1] = (len >>  8) & 0xFF;
-            bytes[2] = (len >> 16) & 0xFF;
-            bytes[3] = (len >> 14) & 0xFF;
+            storeUint32LE( bytes, len );
         }
         
         uint32_t uint32() const
         {
-            return (bytes[0]) | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24);
+            return loadUint32LE( bytes );
         }
     };
 
@@ -45,29 +45,29 @@ namespace net {
         Tpkt( uint32_t restDataLen, uint32_t version, uint32_t command )
         {
             m_buffer.reserve( restDataLen+12 );
-            writeUint32( restDataLen+12 );
-            writeUint32( version );
-            writeUint32( command );
+            writeUint32( restDataLen+12, version, command );
         }
     public:
 
         // updatePacketLenght
         void updatePacketLenght()
         {
-            uint32_t len = m_buffer.size();
-            m_buffer[0] = len         & 0xFF;
-            m_buffer[1] = (len >>  8) & 0xFF;
-            m_buffer[2] = (len >> 16) & 0xFF;
-            m_buffer[3] = (len >> 24) & 0xFF;
+            storeUint32LE( &m_buffer[0], uint32_t( m_buffer.size() ) );
         }
 
-        // writeUint32
-        void writeUint32( uint32_t val )
+        // writeUint32 - writes one or several fields (the buffer is grown once)
+        template<class... Rest>
+        void writeUint32( uint32_t val, Rest... rest )
         {
-            m_buffer.push_back( (val      ) & 0xFF );
-            m_buffer.push_back( (val >>  8) & 0xFF );
-            m_buffer.push_back( (val >> 16) & 0xFF );
-            m_buffer.push_back( (val >> 24) & 0xFF );
+            size_t size = m_buffer.size();
+            m_buffer.resize( size + 4*(1+sizeof...(rest)) );
+
+            uint8_t* bytes = &m_buffer[size];
+            for( uint32_t field : { val, uint32_t(rest)... } )
+            {
+                storeUint32LE( bytes, field );
+                bytes += 4;
+            }
         }
 
         // writeBytes
@@ -107,45 +107,76 @@ namespace net {
     //
     // TpktRcv - for receiving data
     //
-    class TpktRcv : protected net::Tpkt
+    // Received packet is stored in a refcounted buffer,
+    // so it could be passed further (see 'sharedBuffer()') without copying
+    //
+    class TpktRcv
     {
     protected:
-        uint8_t* m_readPosition;
-        uint8_t* m_endPosition;
+        TpktBufferPtr       m_buffer;
+        uint8_t*            m_readPosition = nullptr;
+        uint8_t*            m_endPosition  = nullptr;
+
+        // if it is set, new buffers are taken from it
+        TpktBufferPoolPtr   m_bufferPool;
 
     public:
         TpktRcv() {}
 
-        TpktRcv( uint32_t packetLenght ) : net::Tpkt( 0, -1, -1)
+        TpktRcv( uint32_t packetLenght )
         {
             prepareToRead( packetLenght );
         }
+
+        // TpktRcv - for reading of already received packet
+        TpktRcv( TpktBufferPtr packet ) : m_buffer( packet )
+        {
+            m_readPosition = m_buffer->data()+4;
+            m_endPosition  = m_buffer->data()+m_buffer->lenght();
+        }
         
-        uint8_t*       ptr()               { return &m_buffer[0]; }
+        uint8_t*       ptr()               { return m_buffer->data(); }
         const uint32_t restDataLen() const { return uint32_t(m_endPosition - m_readPosition); }
         const uint8_t* restDataPtr() const { return m_readPosition; }
 
+        // skip - moves read position (the caller must check 'restDataLen()')
+        void           skip( uint32_t lenght ) { m_readPosition += lenght; }
+
+        // sharedBuffer - returns the whole received packet; it must not be modified after that
+        TpktBufferPtr  sharedBuffer() const { return m_buffer; }
+
+        void                      setBufferPool( TpktBufferPoolPtr bufferPool ) { m_bufferPool = bufferPool; }
+        const TpktBufferPoolPtr&  bufferPool() const { return m_bufferPool; }
+
         void prepareToRead( uint32_t packetLenght )
         {
-            m_buffer.reserve( packetLenght );
-            m_buffer[0] = packetLenght         & 0xFF;
-            m_buffer[1] = (packetLenght >>  8) & 0xFF;
-            m_buffer[2] = (packetLenght >> 16) & 0xFF;
-            m_buffer[3] = (packetLenght >> 14) & 0xFF;
-
-            m_readPosition = &m_buffer[4];
-            m_endPosition  = &m_buffer[packetLenght];
+            // previous packet could be still used by somebody else (see 'sharedBuffer()')
+            if ( !m_buffer || m_buffer->isShared() || m_buffer->capacity() < packetLenght )
+            {
+                m_buffer = acquireTpktBuffer( m_bufferPool, packetLenght );
+            }
+            m_buffer->setLenght( packetLenght );
+
+            uint8_t* data = m_buffer->data();
+            storeUint32LE( data, packetLenght );
+
+            m_readPosition = data+4;
+            m_endPosition  = data+packetLenght;
         }
 
-        bool read( uint32_t& val )
+        // read - reads one or several fields (with one bounds check);
+        // returns false (and reads nothing) if the rest of packet is too short
+        template<class... Rest>
+        bool read( uint32_t& val, Rest&... rest )
         {
-            if ( m_endPosition - m_readPosition < 4 )
+            if ( m_endPosition - m_readPosition < ptrdiff_t( 4*(1+sizeof...(rest)) ) )
                 return false;
 
-            val = *m_readPosition++;
-            val |= *m_readPosition++ << 8;
-            val |= *m_readPosition++ << 16;
-            val |= *m_readPosition++ << 24;
+            for( uint32_t* field : { &val, &rest... } )
+            {
+                *field = loadUint32LE( m_readPosition );
+                m_readPosition += 4;
+            }
 
             return true;
         }
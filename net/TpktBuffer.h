@@ -0,0 +1,270 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <new>
+#include <stdlib.h>
+
+#include <boost/smart_ptr/intrusive_ptr.hpp>
+
+namespace catapult {
+namespace net {
+
+    class TpktBufferPool;
+
+    //
+    // TpktBuffer - refcounted storage of one whole transport packet: { packetLenght, data ... }
+    //
+    // Packet bytes are placed right after the header in the same memory block,
+    // so one packet costs one allocation.
+    // When a packet is received, the buffer is immutable and could be shared
+    // by any number of writers (for example, by all viewers of a stream)
+    //
+    class alignas(16) TpktBuffer
+    {
+        std::atomic<uint32_t>   m_refCounter;
+        uint32_t                m_capacity;
+        uint32_t                m_lenght = 0;
+
+        // the packet starts after removed front bytes (see 'removeFront()')
+        uint32_t                m_offset = 0;
+
+        // if it is set, the buffer is returned to the pool instead of freeing
+        TpktBufferPool*         m_pool = nullptr;
+
+        TpktBuffer( uint32_t capacity ) : m_refCounter(0), m_capacity(capacity) {}
+
+        friend class TpktBufferPool;
+        friend void intrusive_ptr_add_ref( TpktBuffer* );
+        friend void intrusive_ptr_release( TpktBuffer* );
+
+    public:
+        TpktBuffer( const TpktBuffer& ) = delete;
+        TpktBuffer& operator=( const TpktBuffer& ) = delete;
+
+        static TpktBuffer* create( uint32_t capacity )
+        {
+            void* memory = ::malloc( sizeof(TpktBuffer) + capacity );
+            if ( memory == nullptr )
+                throw std::bad_alloc();
+            return new (memory) TpktBuffer( capacity );
+        }
+
+        uint8_t*        data()             { return reinterpret_cast<uint8_t*>( this+1 ) + m_offset; }
+        const uint8_t*  data()       const { return reinterpret_cast<const uint8_t*>( this+1 ) + m_offset; }
+
+        uint32_t        capacity()   const { return m_capacity - m_offset; }
+        uint32_t        lenght()     const { return m_lenght; }
+        void            setLenght( uint32_t lenght ) { m_lenght = lenght; }
+
+        // removeFront - removes 'size' bytes from the front of the packet (so a header could be shortened in place)
+        void            removeFront( uint32_t size ) { m_offset += size; m_lenght -= size; }
+
+        // isShared - returns true if buffer is referenced not only by its current owner
+        bool            isShared()   const { return m_refCounter.load( std::memory_order_acquire ) > 1; }
+    };
+
+    typedef boost::intrusive_ptr<TpktBuffer> TpktBufferPtr;
+
+    //
+    // TpktBufferPoolStats
+    //
+    struct TpktBufferPoolStats
+    {
+        uint64_t    m_allocatedNumber   = 0;    // buffers allocated from heap
+        uint64_t    m_reusedNumber      = 0;    // buffers taken from free lists
+        uint64_t    m_freedNumber       = 0;    // returned buffers, that were freed because of 'maxFreeBytes'
+        uint32_t    m_outstandingNumber = 0;    // buffers, that are in use now
+        uint32_t    m_freeNumber        = 0;    // buffers in free lists
+        uint64_t    m_freeBytes         = 0;    // capacity of buffers in free lists
+    };
+
+    //
+    // TpktBufferPool - size-classed free lists of TpktBuffer
+    //
+    // Buffer capacities are rounded up to a power of two (from 1KB to 16MB);
+    // bigger packets are not pooled. Free buffers take no more than 'maxFreeBytes'.
+    // Buffers return to the pool by themselves (when the last reference is released),
+    // and the pool is deleted after its last owner and its last outstanding buffer.
+    //
+    class TpktBufferPool
+    {
+        enum { MIN_CLASS_SHIFT = 10, MAX_CLASS_SHIFT = 24, CLASS_NUMBER = MAX_CLASS_SHIFT-MIN_CLASS_SHIFT+1 };
+
+        // owners (TpktBufferPoolPtr) + outstanding buffers
+        std::atomic<uint32_t>       m_refCounter;
+
+        std::mutex                  m_mutex;
+        std::vector<TpktBuffer*>    m_freeLists[CLASS_NUMBER];
+        uint32_t                    m_bufferNumbers[CLASS_NUMBER] = {};     // buffers of size class, that are not freed
+        uint64_t                    m_maxFreeBytes;
+        TpktBufferPoolStats         m_stats;
+
+        TpktBufferPool( uint64_t maxFreeBytes ) : m_refCounter(0), m_maxFreeBytes( maxFreeBytes ) {}
+
+        ~TpktBufferPool()
+        {
+            for( auto& freeList : m_freeLists )
+            {
+                for( auto* buffer : freeList )
+                {
+                    buffer->~TpktBuffer();
+                    ::free( buffer );
+                }
+            }
+        }
+
+        friend void intrusive_ptr_add_ref( TpktBufferPool* );
+        friend void intrusive_ptr_release( TpktBufferPool* );
+        friend void intrusive_ptr_release( TpktBuffer* );
+
+        static int sizeClass( uint32_t capacity )
+        {
+            int shift = MIN_CLASS_SHIFT;
+            while( (uint32_t(1) << shift) < capacity )
+            {
+                if ( ++shift > MAX_CLASS_SHIFT )
+                    return -1;
+            }
+            return shift - MIN_CLASS_SHIFT;
+        }
+
+        // recycle - is called when the last reference to 'buffer' is released
+        void recycle( TpktBuffer* buffer )
+        {
+            int sizeClass = TpktBufferPool::sizeClass( buffer->m_capacity );
+            bool isFreed = false;
+            {
+                const std::lock_guard<std::mutex> autolock( m_mutex );
+                m_stats.m_outstandingNumber--;
+
+                if ( m_stats.m_freeBytes + buffer->m_capacity <= m_maxFreeBytes )
+                {
+                    m_freeLists[sizeClass].push_back( buffer );
+                    m_stats.m_freeNumber++;
+                    m_stats.m_freeBytes += buffer->m_capacity;
+                }
+                else
+                {
+                    m_bufferNumbers[sizeClass]--;
+                    m_stats.m_freedNumber++;
+                    isFreed = true;
+                }
+            }
+
+            if ( isFreed )
+            {
+                buffer->~TpktBuffer();
+                ::free( buffer );
+            }
+
+            // it could delete the pool
+            intrusive_ptr_release( this );
+        }
+
+    public:
+        TpktBufferPool( const TpktBufferPool& ) = delete;
+        TpktBufferPool& operator=( const TpktBufferPool& ) = delete;
+
+        static boost::intrusive_ptr<TpktBufferPool> create( uint64_t maxFreeBytes )
+        {
+            return boost::intrusive_ptr<TpktBufferPool>( new TpktBufferPool( maxFreeBytes ) );
+        }
+
+        // acquire - returns buffer with capacity >= 'capacity'
+        TpktBufferPtr acquire( uint32_t capacity )
+        {
+            int sizeClass = TpktBufferPool::sizeClass( capacity );
+            if ( sizeClass < 0 )
+            {
+                return TpktBuffer::create( capacity );
+            }
+
+            TpktBuffer* buffer = nullptr;
+            {
+                const std::lock_guard<std::mutex> autolock( m_mutex );
+                m_stats.m_outstandingNumber++;
+
+                auto& freeList = m_freeLists[sizeClass];
+                if ( !freeList.empty() )
+                {
+                    buffer = freeList.back();
+                    freeList.pop_back();
+                    m_stats.m_reusedNumber++;
+                    m_stats.m_freeNumber--;
+                    m_stats.m_freeBytes -= buffer->m_capacity;
+                }
+                else
+                {
+                    m_stats.m_allocatedNumber++;
+
+                    // (the free list could take all buffers of the class, so 'recycle()' does not allocate)
+                    uint32_t bufferNumber = ++m_bufferNumbers[sizeClass];
+                    if ( freeList.capacity() < bufferNumber )
+                    {
+                        freeList.reserve( 2*bufferNumber );
+                    }
+                }
+            }
+
+            if ( buffer == nullptr )
+            {
+                buffer = TpktBuffer::create( uint32_t(1) << (sizeClass + MIN_CLASS_SHIFT) );
+                buffer->m_pool = this;
+            }
+            buffer->m_lenght = 0;
+            buffer->m_offset = 0;
+
+            // outstanding buffer holds the pool
+            intrusive_ptr_add_ref( this );
+            return TpktBufferPtr( buffer );
+        }
+
+        TpktBufferPoolStats stats()
+        {
+            const std::lock_guard<std::mutex> autolock( m_mutex );
+            return m_stats;
+        }
+    };
+
+    typedef boost::intrusive_ptr<TpktBufferPool> TpktBufferPoolPtr;
+
+    inline void intrusive_ptr_add_ref( TpktBufferPool* pool )
+    {
+        pool->m_refCounter.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    inline void intrusive_ptr_release( TpktBufferPool* pool )
+    {
+        if ( pool->m_refCounter.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+        {
+            delete pool;
+        }
+    }
+
+    // acquireTpktBuffer - takes buffer from 'pool' (if it is set)
+    inline TpktBufferPtr acquireTpktBuffer( const TpktBufferPoolPtr& pool, uint32_t capacity )
+    {
+        return pool ? pool->acquire( capacity ) : TpktBufferPtr( TpktBuffer::create( capacity ) );
+    }
+
+    inline void intrusive_ptr_add_ref( TpktBuffer* buffer )
+    {
+        buffer->m_refCounter.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    inline void intrusive_ptr_release( TpktBuffer* buffer )
+    {
+        if ( buffer->m_refCounter.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+        {
+            if ( buffer->m_pool != nullptr )
+            {
+                buffer->m_pool->recycle( buffer );
+                return;
+            }
+            buffer->~TpktBuffer();
+            ::free( buffer );
+        }
+    }
+
+}} // namespace catapult { namespace net
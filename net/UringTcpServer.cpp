@@ -0,0 +1,673 @@
+#include <future>
+#include <list>
+
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+
+#include "AsyncTcpServer.h"
+#include "UringTcpSession.h"
+
+namespace catapult {
+namespace net      {
+
+//
+// UringShard - io_uring, that is run by its own thread (see UringTcpServer)
+//
+// The shard accepts connections by its own SO_REUSEPORT socket (multishot accept)
+// and serves them for their whole life. All operations of the shard sessions
+// are submitted by the shard thread: one 'io_uring_enter' submits everything, that was queued
+// by completion handlers, and waits for the next completions.
+// Other threads post tasks to the shard; they wake it up by eventfd (only once per batch of tasks).
+//
+class UringShard
+{
+    NewSessionHandler&      m_newSessionHandler;
+
+    IoUring                 m_ring;
+    UringBufferRing         m_bufferRing;
+
+    int                     m_listenFd = -1;
+    UringOp                 m_acceptOp{ UringOp::ACCEPT };
+
+    int                     m_eventFd = -1;
+    UringOp                 m_wakeupOp{ UringOp::WAKEUP };
+    uint64_t                m_eventValue = 0;
+
+    // UringTimerOp - timer of 'IAsyncTcpSession::asyncWait()'
+    struct UringTimerOp : UringOp
+    {
+        __kernel_timespec                   m_timeout;
+        std::function<void()>               m_func;
+        std::list<UringTimerOp>::iterator   m_it;
+    };
+    std::list<UringTimerOp> m_timers;
+
+    // zero-copy send is disabled after the first send, that is not supported by the kernel
+    bool                    m_isZeroCopyEnabled = true;
+
+public:
+    //
+    // Task - is posted by 'post()'
+    //
+    struct Task
+    {
+        enum Kind : uint8_t { FUNC, STRAND_TASK, START_WRITE, START_READ, COMPLETE_READ, RELEASE };
+
+        Kind                                m_kind;
+        std::shared_ptr<UringTcpSession>    m_session;
+        UringTcpSession*                    m_releasedSession = nullptr;
+        StrandTaskPtr                       m_strandTask;
+        std::function<void()>               m_func;
+    };
+
+private:
+    std::vector<Task>       m_tasks;
+    std::vector<Task>       m_runningTasks;
+    bool                    m_isWakeupPending = false;
+    bool                    m_isStopped = false;
+    std::mutex              m_taskMutex;
+
+    std::atomic<bool>       m_isStopping{false};
+    std::thread             m_thread;
+
+    static inline thread_local UringShard* s_currentShard = nullptr;
+
+public:
+    UringShard( NewSessionHandler& newSessionHandler )
+        : m_newSessionHandler( newSessionHandler ),
+          m_bufferRing( m_ring, 0, 256, 16*1024 )
+    {}
+
+    ~UringShard()
+    {
+        if ( m_listenFd >= 0 )
+            ::close( m_listenFd );
+        if ( m_eventFd >= 0 )
+            ::close( m_eventFd );
+    }
+
+    bool isCurrentThread() const { return s_currentShard == this; }
+
+    IoUring&         ring()       { return m_ring; }
+    UringBufferRing& bufferRing() { return m_bufferRing; }
+
+    bool isZeroCopyEnabled() const { return m_isZeroCopyEnabled; }
+    void disableZeroCopy()         { m_isZeroCopyEnabled = false; }
+
+    // listen - opens the shard listening socket (it is called before 'start()')
+    void listen( uint32_t port )
+    {
+        m_listenFd = ::socket( AF_INET, SOCK_STREAM|SOCK_CLOEXEC, 0 );
+        if ( m_listenFd < 0 )
+        {
+            throw std::runtime_error( std::string("socket: ") + strerror(errno) );
+        }
+
+        int on = 1;
+        setsockopt( m_listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on) );
+        setsockopt( m_listenFd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on) );
+
+        sockaddr_in addr{};
+        addr.sin_family      = AF_INET;
+        addr.sin_port        = htons( uint16_t(port) );
+        addr.sin_addr.s_addr = htonl( INADDR_ANY );
+
+        if ( ::bind( m_listenFd, (sockaddr*)&addr, sizeof(addr) ) != 0 || ::listen( m_listenFd, SOMAXCONN ) != 0 )
+        {
+            throw std::runtime_error( std::string("bind/listen: ") + strerror(errno) );
+        }
+    }
+
+    //
+    // start - runs the shard thread (bound to 'cpuIndex' if it is >= 0)
+    //
+    // The ring is created by the shard thread (a single issuer ring is used only by the thread, that created it);
+    // returns false, if io_uring could not be initialized
+    //
+    bool start( int cpuIndex, std::string& errorText )
+    {
+        std::promise<std::string> initResult;
+        auto initFuture = initResult.get_future();
+
+        m_thread = std::thread( [this,cpuIndex,&initResult]
+        {
+            if ( cpuIndex >= 0 )
+            {
+                cpu_set_t cpuSet;
+                CPU_ZERO( &cpuSet );
+                CPU_SET( cpuIndex, &cpuSet );
+                pthread_setaffinity_np( pthread_self(), sizeof(cpuSet), &cpuSet );
+            }
+            s_currentShard = this;
+
+            std::string errorText;
+            bool isInitialized = init( errorText );
+            initResult.set_value( errorText );
+
+            if ( isInitialized )
+            {
+                run();
+            }
+            s_currentShard = nullptr;
+        });
+
+        errorText = initFuture.get();
+        return errorText.empty();
+    }
+
+    void stop()
+    {
+        m_isStopping = true;
+        wakeUp();
+    }
+
+    // join - waits for the shard thread; sessions, which are released after it, are deleted at once
+    void join()
+    {
+        if ( m_thread.joinable() )
+            m_thread.join();
+
+        // the ring is released by the kernel later, and its accept holds the socket;
+        // the socket stops listening now (otherwise it would get a part of connections of the next SO_REUSEPORT server)
+        if ( m_listenFd >= 0 )
+            ::shutdown( m_listenFd, SHUT_RDWR );
+
+        std::vector<Task> tasks;
+        {
+            const std::lock_guard<std::mutex> autolock( m_taskMutex );
+            m_isStopped = true;
+            tasks.swap( m_tasks );
+        }
+        for( auto& task : tasks )
+        {
+            if ( task.m_kind == Task::RELEASE )
+            {
+                delete task.m_releasedSession;
+            }
+        }
+    }
+
+    //
+    // post - queues task for the shard thread (it could be called by any thread);
+    // returns false, if the shard is stopped
+    //
+    bool post( Task&& task )
+    {
+        bool wakeUpShard = false;
+        {
+            const std::lock_guard<std::mutex> autolock( m_taskMutex );
+
+            if ( m_isStopped )
+                return false;
+
+            m_tasks.push_back( std::move(task) );
+
+            // the shard thread runs its own tasks before the next wait
+            if ( !m_isWakeupPending && !isCurrentThread() )
+            {
+                m_isWakeupPending = true;
+                wakeUpShard = true;
+            }
+        }
+
+        if ( wakeUpShard )
+        {
+            wakeUp();
+        }
+        return true;
+    }
+
+    void post( std::function<void()> func )
+    {
+        post( Task{ Task::FUNC, {}, nullptr, {}, std::move(func) } );
+    }
+
+    void post( StrandTaskPtr task )
+    {
+        post( Task{ Task::STRAND_TASK, {}, nullptr, std::move(task), {} } );
+    }
+
+    void post( Task::Kind kind, std::shared_ptr<UringTcpSession> session )
+    {
+        post( Task{ kind, std::move(session), nullptr, {}, {} } );
+    }
+
+    // postRelease - is called after the last reference to the session
+    void postRelease( UringTcpSession* session )
+    {
+        if ( !post( Task{ Task::RELEASE, {}, session, {}, {} } ) )
+        {
+            delete session;
+        }
+    }
+
+    // startTimer - calls 'func' after 'milliseconds' by the shard thread
+    void startTimer( uint32_t milliseconds, std::function<void()> func )
+    {
+        if ( !isCurrentThread() )
+        {
+            post( [this,milliseconds,func=std::move(func)]() mutable { startTimer( milliseconds, std::move(func) ); } );
+            return;
+        }
+
+        UringTimerOp& timer = m_timers.emplace_back();
+        timer.m_kind            = UringOp::TIMER;
+        timer.m_timeout.tv_sec  = milliseconds / 1000;
+        timer.m_timeout.tv_nsec = long(milliseconds % 1000) * 1000000;
+        timer.m_func            = std::move(func);
+        timer.m_it              = std::prev( m_timers.end() );
+
+        io_uring_sqe* sqe = m_ring.getSqe();
+        sqe->opcode    = IORING_OP_TIMEOUT;
+        sqe->addr      = uint64_t( &timer.m_timeout );
+        sqe->len       = 1;
+        sqe->user_data = uint64_t( static_cast<UringOp*>( &timer ) );
+    }
+
+private:
+    bool init( std::string& errorText )
+    {
+        if ( !m_ring.init( 4096, errorText ) || !m_bufferRing.init( errorText ) )
+            return false;
+
+        m_eventFd = eventfd( 0, EFD_CLOEXEC );
+        if ( m_eventFd < 0 )
+        {
+            errorText = std::string( "eventfd: " ) + strerror( errno );
+            return false;
+        }
+
+        armWakeup();
+        armAccept();
+        return true;
+    }
+
+    void run()
+    {
+        while( !m_isStopping )
+        {
+            runTasks();
+
+            // buffers, that were consumed by completion handlers, are returned to the kernel
+            m_bufferRing.publish();
+
+            bool hasTasks;
+            {
+                const std::lock_guard<std::mutex> autolock( m_taskMutex );
+                hasTasks = !m_tasks.empty();
+            }
+
+            if ( int rc = m_ring.submitAndWait( hasTasks ? 0 : 1 ); rc < 0 )
+            {
+                LOG_ERR( "io_uring_enter: " << strerror(-rc) << std::endl );
+                break;
+            }
+
+            m_ring.forEachCqe( [this]( const io_uring_cqe& cqe )
+            {
+                // (entries without operation provide buffers; their completions are posted only on failure)
+                if ( cqe.user_data == 0 )
+                {
+                    LOG_ERR( "io_uring provide buffers error: " << strerror(-cqe.res) << std::endl );
+                    return;
+                }
+                dispatch( *(UringOp*)cqe.user_data, cqe.res, cqe.flags );
+            });
+        }
+    }
+
+    void runTasks()
+    {
+        {
+            const std::lock_guard<std::mutex> autolock( m_taskMutex );
+            m_tasks.swap( m_runningTasks );
+            m_isWakeupPending = false;
+        }
+
+        for( auto& task : m_runningTasks )
+        {
+            switch( task.m_kind )
+            {
+                case Task::FUNC:            task.m_func(); break;
+                case Task::STRAND_TASK:     task.m_strandTask->run(); break;
+                case Task::START_WRITE:     task.m_session->startQueuedWrite(); break;
+                case Task::START_READ:      task.m_session->startRead( task.m_session->m_requestedRead ); break;
+                case Task::COMPLETE_READ:   task.m_session->completeRead(); break;
+                case Task::RELEASE:         task.m_releasedSession->release(); break;
+            }
+        }
+
+        // tasks release their references to sessions (so the sessions could post RELEASE tasks)
+        m_runningTasks.clear();
+    }
+
+    void dispatch( UringOp& op, int result, uint32_t flags )
+    {
+        switch( op.m_kind )
+        {
+            case UringOp::ACCEPT:
+                onAccept( result, flags );
+                break;
+
+            case UringOp::WAKEUP:
+                if ( !m_isStopping )
+                    armWakeup();
+                break;
+
+            case UringOp::TIMER:
+            {
+                auto& timer = static_cast<UringTimerOp&>( op );
+                auto func = std::move( timer.m_func );
+                m_timers.erase( timer.m_it );
+                if ( result == -ETIME )
+                {
+                    func();
+                }
+                break;
+            }
+
+            default:
+                op.m_session->onCompletion( op, result, flags );
+                break;
+        }
+    }
+
+    void onAccept( int result, uint32_t flags )
+    {
+        if ( m_isStopping )
+            return;
+
+        if ( result >= 0 )
+        {
+            m_newSessionHandler( UringTcpSession::create( *this, result ) );
+        }
+        else
+        {
+            LOG_ERR( "io_uring accept error: " << strerror(-result) << std::endl );
+        }
+
+        if ( !(flags & IORING_CQE_F_MORE) )
+        {
+            armAccept();
+        }
+    }
+
+    void armAccept()
+    {
+        io_uring_sqe* sqe = m_ring.getSqe();
+        sqe->opcode       = IORING_OP_ACCEPT;
+        sqe->fd           = m_listenFd;
+        sqe->ioprio       = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_CLOEXEC;
+        sqe->user_data    = uint64_t( &m_acceptOp );
+    }
+
+    void armWakeup()
+    {
+        io_uring_sqe* sqe = m_ring.getSqe();
+        sqe->opcode    = IORING_OP_READ;
+        sqe->fd        = m_eventFd;
+        sqe->addr      = uint64_t( &m_eventValue );
+        sqe->len       = sizeof(m_eventValue);
+        sqe->off       = uint64_t(-1);
+        sqe->user_data = uint64_t( &m_wakeupOp );
+    }
+
+    void wakeUp()
+    {
+        if ( m_eventFd >= 0 )
+        {
+            eventfd_write( m_eventFd, 1 );
+        }
+    }
+};
+
+//
+// UringTcpSession methods, that use its shard
+//
+
+std::shared_ptr<UringTcpSession> UringTcpSession::create( UringShard& shard, int fd )
+{
+    return std::shared_ptr<UringTcpSession>( new UringTcpSession( shard, fd ), []( UringTcpSession* session )
+    {
+        session->m_shard.postRelease( session );
+    });
+}
+
+bool UringTcpSession::isOnOwnThread() const
+{
+    return m_shard.isCurrentThread();
+}
+
+io_uring_sqe* UringTcpSession::getSqe( UringOp& op )
+{
+    m_inFlightOps++;
+
+    io_uring_sqe* sqe = m_shard.ring().getSqe();
+    sqe->user_data = uint64_t( &op );
+    return sqe;
+}
+
+void UringTcpSession::onCompletion( UringOp& op, int result, uint32_t flags )
+{
+    // multishot operations (and zero-copy sends) are in flight until a completion without IORING_CQE_F_MORE
+    if ( !(flags & IORING_CQE_F_MORE) )
+    {
+        m_inFlightOps--;
+    }
+
+    // completions of the released session only return buffers and release in-flight packets
+    auto shared = weakFromThis().lock();
+    bool isAlive = shared && !m_isReleased;
+
+    switch( op.m_kind )
+    {
+        case UringOp::RECEIVE:  onReceive( result, flags, isAlive ); break;
+        case UringOp::SEND:     onSend( result, flags, isAlive ); break;
+        case UringOp::SPLICE:   onSplice( result, isAlive ); break;
+        default:                break;
+    }
+
+    if ( !isAlive )
+    {
+        deleteIfDone();
+    }
+}
+
+void UringTcpSession::armReceive()
+{
+    io_uring_sqe* sqe = getSqe( m_receiveOp );
+    sqe->opcode    = IORING_OP_RECV;
+    sqe->fd        = m_fd;
+    sqe->ioprio    = IORING_RECV_MULTISHOT;
+    sqe->flags     = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = m_shard.bufferRing().groupId();
+
+    m_isReceiveArmed  = true;
+    m_isReceivePaused = false;
+}
+
+void UringTcpSession::cancelReceive()
+{
+    io_uring_sqe* sqe = getSqe( m_cancelOp );
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr   = uint64_t( &m_receiveOp );
+
+    m_isReceivePaused = true;
+}
+
+void UringTcpSession::onReceive( int result, uint32_t flags, bool isAlive )
+{
+    if ( !(flags & IORING_CQE_F_MORE) )
+    {
+        m_isReceiveArmed = false;
+    }
+
+    if ( flags & IORING_CQE_F_BUFFER )
+    {
+        uint16_t bufferId = uint16_t( flags >> IORING_CQE_BUFFER_SHIFT );
+        if ( isAlive && result > 0 )
+        {
+            consume( m_shard.bufferRing().buffer( bufferId ), size_t(result) );
+        }
+        m_shard.bufferRing().recycle( bufferId );
+    }
+
+    if ( !isAlive )
+        return;
+
+    m_received1stRequest = true;
+
+    if ( result == 0 )
+    {
+        m_receiveError = m_isClosed ? make_error_code( boost::asio::error::operation_aborted ) : make_error_code( boost::asio::error::eof );
+    }
+    else if ( result < 0 && result != -ENOBUFS && result != -ECANCELED )
+    {
+        // (receive is rearmed after ENOBUFS, when consumed buffers are returned to the ring)
+        m_receiveError = boost::system::error_code( -result, boost::system::system_category() );
+    }
+
+    completeRead();
+
+    pauseReceiveIfFull();
+    resumeReceive();
+}
+
+void UringTcpSession::postCompleteRead()
+{
+    m_shard.post( UringShard::Task::COMPLETE_READ, sharedFromThis() );
+}
+
+void UringTcpSession::requestRead( ReadKind kind )
+{
+    if ( isOnOwnThread() )
+    {
+        startRead( kind );
+        return;
+    }
+
+    m_requestedRead = kind;
+    m_shard.post( UringShard::Task::START_READ, sharedFromThis() );
+}
+
+void UringTcpSession::postWriteStart()
+{
+    m_shard.post( UringShard::Task::START_WRITE, sharedFromThis() );
+}
+
+bool UringTcpSession::isZeroCopyEnabled() const
+{
+    return m_shard.isZeroCopyEnabled();
+}
+
+void UringTcpSession::disableZeroCopy()
+{
+    m_shard.disableZeroCopy();
+}
+
+void UringTcpSession::closeSession()
+{
+    if ( !isOnOwnThread() )
+    {
+        m_shard.post( [shared=sharedFromThis()] { shared->closeSession(); } );
+        return;
+    }
+
+    close();
+}
+
+void UringTcpSession::postOnStrand( std::function<void()> func )
+{
+    m_shard.post( std::move(func) );
+}
+
+void UringTcpSession::postOnStrand( StrandTaskPtr task )
+{
+    m_shard.post( std::move(task) );
+}
+
+void UringTcpSession::asyncWait( uint32_t milliseconds, std::function<void()> func )
+{
+    m_shard.startTimer( milliseconds, std::move(func) );
+}
+
+
+//
+// UringTcpServer - thread-per-core server over io_uring
+//
+// Each thread runs its own UringShard with its own SO_REUSEPORT listening socket (the kernel balances connections).
+// Received data is placed by the kernel into buffers of the shard buffer ring (they are registered once),
+// so idle sessions do not hold receive buffers.
+//
+class UringTcpServer : public IAsyncTcpServer
+{
+    std::vector<std::unique_ptr<UringShard>>    m_shards;
+
+    NewSessionHandler                           m_newSessionHandler;
+
+public:
+
+    UringTcpServer( NewSessionHandler newSessionHandler ) : m_newSessionHandler( newSessionHandler )
+    {}
+
+    ~UringTcpServer()
+    {
+        stop();
+    }
+
+    // start
+    void start( uint32_t port, uint threadNumber ) override
+    {
+        if ( threadNumber == 0 )
+            threadNumber = 1;
+
+        for( uint i=0; i<threadNumber; i++ )
+        {
+            m_shards.emplace_back( new UringShard( m_newSessionHandler ) );
+            m_shards.back()->listen( port );
+        }
+
+        uint cpuNumber = std::thread::hardware_concurrency();
+        for( uint i=0; i<m_shards.size(); i++ )
+        {
+            std::string errorText;
+            if ( !m_shards[i]->start( cpuNumber > 0 ? int(i % cpuNumber) : -1, errorText ) )
+            {
+                throw std::runtime_error( "io_uring shard: " + errorText );
+            }
+        }
+    }
+
+    // stop
+    void stop() override
+    {
+        for( auto& shard : m_shards )
+        {
+            shard->stop();
+        }
+        for( auto& shard : m_shards )
+        {
+            shard->join();
+        }
+    }
+};
+
+
+std::unique_ptr<IAsyncTcpServer> createUringTcpServer( NewSessionHandler newSessionHandler, std::string& errorText )
+{
+    // the kernel must support rings and provided buffer rings
+    {
+        IoUring ring;
+        if ( !ring.init( 8, errorText ) )
+            return nullptr;
+
+        UringBufferRing bufferRing( ring, 0, 1, 4096 );
+        if ( !bufferRing.init( errorText ) )
+            return nullptr;
+    }
+
+    return std::unique_ptr<IAsyncTcpServer>( new UringTcpServer( newSessionHandler ) );
+}
+
+}}
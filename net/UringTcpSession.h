@@ -0,0 +1,1075 @@
+#pragma once
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <optional>
+#include <thread>
+
+#include <boost/asio/error.hpp>
+#include <boost/circular_buffer.hpp>
+#include <boost/container/small_vector.hpp>
+
+#include "AsyncTcpServer.h"
+#include "IoUring.h"
+
+namespace catapult {
+namespace net      {
+
+class UringShard;
+class UringTcpSession;
+
+//
+// UringOp - target of io_uring completion (its address is 'user_data' of submitted entry)
+//
+struct UringOp
+{
+    enum Kind : uint8_t { ACCEPT, WAKEUP, TIMER, RECEIVE, CANCEL, SEND, SPLICE };
+
+    Kind                m_kind;
+    UringTcpSession*    m_session = nullptr;
+};
+
+//
+// UringTcpSession - IAsyncTcpSession over io_uring (see UringTcpServer.cpp)
+//
+// A session belongs to one shard (io_uring and its thread); operations of other threads are posted to the shard.
+//
+// Receiving: multishot receive is armed while unread data is less than RECEIVE_BUFFER_SIZE;
+// the kernel fills buffers of the shard buffer ring, and data is copied into the receive buffer of session
+// (or directly into a packet, that does not fit it). Reads are completed from the received data.
+//
+// Sending: queued packets are gathered into one 'sendmsg' (as in AsyncTcpSession);
+// large batches are sent by zero-copy send, so packets are held until the kernel releases their pages.
+// File ranges are spliced (file -> pipe -> socket).
+//
+// The session is owned by shared_ptr, which deleter posts 'release()' to the shard:
+// the socket is shut down, and the session is deleted after its last in-flight operation.
+//
+class UringTcpSession : public IAsyncTcpSession
+{
+    friend class UringShard;
+
+    UringShard&                 m_shard;
+    int                         m_fd;
+
+    // operations, which completions are not received yet
+    uint32_t                    m_inFlightOps = 0;
+    bool                        m_isReleased = false;
+    bool                        m_isClosed = false;
+
+    TpktRcv                     m_request;
+
+    boost::system::error_code   m_lastReadError;
+    std::optional<std::string>  m_readProtocolError;
+    boost::system::error_code   m_lastWriteError;
+
+    bool                        m_received1stRequest = false;
+
+    //
+    // receiving
+    //
+    static constexpr size_t     RECEIVE_BUFFER_SIZE = 64*1024;
+
+    UringOp                     m_receiveOp{ UringOp::RECEIVE, this };
+    UringOp                     m_cancelOp{ UringOp::CANCEL, this };
+    bool                        m_isReceiveArmed = false;
+    bool                        m_isReceivePaused = false;
+
+    // error or end of stream; it is reported after the received data
+    boost::system::error_code   m_receiveError;
+
+    // not parsed data is [m_receivedBegin,m_receivedEnd)
+    std::vector<uint8_t>        m_receiveBuffer;
+    size_t                      m_receivedBegin = 0;
+    size_t                      m_receivedEnd   = 0;
+
+    // packet, that does not fit m_receiveBuffer, is received directly into its own buffer
+    TpktBufferPtr               m_bigPacket;
+    size_t                      m_bigPacketReceived = 0;
+
+    enum class ReadKind : uint8_t { NONE, SINGLE, BATCH };
+
+    // read requested by another thread (it is started by the shard)
+    ReadKind                    m_requestedRead = ReadKind::NONE;
+    ReadKind                    m_pendingRead   = ReadKind::NONE;
+
+    std::function<void()>       m_readHandler;
+    uint32_t                    m_readMaxPacketLength = 0;
+
+    // handler of 'asyncReadBatch()'; it is held by shared_ptr, because it could be replaced by itself
+    std::shared_ptr<std::function<void()>>  m_readBatchHandler;
+    uint32_t                                m_readBatchMaxPacketLength = 0;
+    std::vector<TpktBufferPtr>              m_receivedPackets;
+
+    //
+    // sending
+    //
+    struct OutPacket
+    {
+        TpktBufferPtr           m_packet;
+        std::function<void()>   m_handler;
+        bool                    m_isDroppable = false;  // could be removed by 'dropQueuedPackets()'
+
+        // file range (see 'asyncSendFile()'); it is written instead of 'm_packet'
+        FileDescriptorPtr       m_file;
+        uint64_t                m_fileOffset = 0;
+        uint32_t                m_fileSize = 0;
+
+        // packet with not copied payload; it is written instead of 'm_packet'
+        GatherTpktPtr           m_gatherPacket;
+
+        OutPacket( TpktBufferPtr packet, std::function<void()> handler, bool isDroppable )
+            : m_packet( std::move(packet) ), m_handler( std::move(handler) ), m_isDroppable( isDroppable ) {}
+
+        OutPacket( FileDescriptorPtr file, uint64_t offset, uint32_t size, std::function<void()> handler )
+            : m_handler( std::move(handler) ), m_isDroppable( true ), m_file( std::move(file) ), m_fileOffset( offset ), m_fileSize( size ) {}
+
+        OutPacket( GatherTpktPtr packet, std::function<void()> handler, bool isDroppable )
+            : m_handler( std::move(handler) ), m_isDroppable( isDroppable ), m_gatherPacket( std::move(packet) ) {}
+
+        size_t size() const { return m_file ? m_fileSize : m_gatherPacket ? m_gatherPacket->lenght() : m_packet->lenght(); }
+    };
+
+    static constexpr size_t     MAX_GATHERED_PACKETS = 64;
+
+    // zero-copy send is used for batches of this size (smaller ones are cheaper to copy)
+    static constexpr size_t     ZERO_COPY_MIN_BYTES = 32*1024;
+
+    boost::circular_buffer<OutPacket>   m_sendQueue{ 16 };
+    size_t                              m_sendQueueBytes = 0;
+    size_t                              m_inFlightPacketNumber = 0;
+    bool                                m_isWriteStartPosted = false;
+    std::mutex                          m_sendQueueMutex;
+
+    uint32_t                            m_maxSendQueueLength = 1024;
+    uint32_t                            m_maxSendQueueBytes  = 64*1024*1024;
+
+    UringOp                             m_sendOp{ UringOp::SEND, this };
+    std::vector<iovec>                  m_iovecs;
+    size_t                              m_iovIndex = 0;
+    msghdr                              m_msg{};
+    bool                                m_isZeroCopySend = false;
+
+    //
+    // zero-copy sending: the kernel notifies, when pages of a send request are released
+    // (notifications of a socket come in the order of requests, so they are counted)
+    //
+    struct ZeroCopyBatch
+    {
+        size_t      m_packetNumber;
+        uint64_t    m_lastRequest;  // the batch is released after notification of this request
+    };
+    boost::circular_buffer<OutPacket>       m_zeroCopyPackets{ 16 };
+    boost::circular_buffer<ZeroCopyBatch>   m_zeroCopyBatches{ 16 };
+    uint64_t                                m_zeroCopyRequests = 0;
+    uint64_t                                m_zeroCopyNotifications = 0;
+
+    //
+    // file range, that is being written (file -> pipe -> socket)
+    //
+    UringOp                             m_spliceOp{ UringOp::SPLICE, this };
+    FileDescriptorPtr                   m_sendingFile;
+    uint64_t                            m_sendingFileOffset = 0;
+    uint32_t                            m_sendingFileSize = 0;
+    uint32_t                            m_fileSentBytes = 0;
+    int                                 m_pipe[2] = { -1, -1 };
+    uint32_t                            m_pipeSize = 0;
+    uint32_t                            m_pipeBytes = 0;
+    bool                                m_isSplicingToSocket = false;
+
+    // error of write, that is not submitted (it is reported by completion of NOP)
+    boost::system::error_code           m_pendingWriteError;
+
+public:
+    UringTcpSession( UringShard& shard, int fd ) : m_shard( shard ), m_fd( fd )
+    {
+        LOG( "UringTcpSession(" << this << ")" << std::endl );
+    }
+
+    virtual ~UringTcpSession()
+    {
+        LOG( "~UringTcpSession(" << this << ")" << std::endl );
+        if ( m_pipe[0] >= 0 )
+        {
+            ::close( m_pipe[0] );
+            ::close( m_pipe[1] );
+        }
+        ::close( m_fd );
+    }
+
+    // create - the session is deleted by its shard (after the last reference and the last in-flight operation)
+    static std::shared_ptr<UringTcpSession> create( UringShard& shard, int fd );
+
+    TpktRcv&    request()               override { return m_request; }
+    bool        hasReadError() const    override { return (m_lastReadError || m_readProtocolError.has_value()) ? true : false; }
+    bool        hasWriteError() const   override { return (m_lastWriteError) ? true : false; }
+    bool        isEof()    const        override { return m_lastReadError == make_error_code(boost::asio::error::eof); }
+
+    std::string readErrorMessage() const override
+    {
+        if ( m_readProtocolError.has_value() )
+            return m_readProtocolError.value();
+
+        return m_lastReadError.message();
+    }
+
+    std::string writeErrorMessage() const override { return m_lastWriteError.message(); }
+    bool        received1stRequest() const override { return m_received1stRequest; }
+
+    //
+    // reading (it is done by the shard thread)
+    //
+
+    void asyncRead( std::function<void()> func, uint32_t maxPacketLength ) override
+    {
+        m_readHandler = std::move(func);
+        m_readMaxPacketLength = maxPacketLength;
+        requestRead( ReadKind::SINGLE );
+    }
+
+    void asyncReadBatch( std::function<void()> func, uint32_t maxPacketLength ) override
+    {
+        m_readBatchHandler = std::make_shared<std::function<void()>>( std::move(func) );
+        m_readBatchMaxPacketLength = maxPacketLength;
+        requestRead( ReadKind::BATCH );
+    }
+
+    void asyncReadBatch() override
+    {
+        requestRead( ReadKind::BATCH );
+    }
+
+    std::vector<TpktBufferPtr>& receivedPackets() override { return m_receivedPackets; }
+
+    //
+    // writing
+    //
+
+    void asyncWrite( Tpkt& response, std::function<void()> func ) override
+    {
+        response.updatePacketLenght();
+
+        // responses are small, so they are copied (and caller could reuse or delete 'response')
+        TpktBufferPtr packet = acquireTpktBuffer( m_request.bufferPool(), (uint32_t)response.lenght() );
+        memcpy( packet->data(), response.ptr(), response.lenght() );
+        packet->setLenght( (uint32_t)response.lenght() );
+
+        const std::lock_guard<std::mutex> autolock( m_sendQueueMutex );
+        enqueue( packet, std::move(func), false );
+    }
+
+    bool asyncWrite( TpktBufferPtr packet, std::function<void()> func ) override
+    {
+        const std::lock_guard<std::mutex> autolock( m_sendQueueMutex );
+
+        if ( m_sendQueue.size() >= m_maxSendQueueLength || m_sendQueueBytes + packet->lenght() > m_maxSendQueueBytes )
+        {
+            return false;
+        }
+
+        enqueue( packet, std::move(func), true );
+        return true;
+    }
+
+    void asyncWrite( GatherTpktPtr packet, std::function<void()> func ) override
+    {
+        packet->updatePacketLenght();
+
+        const std::lock_guard<std::mutex> autolock( m_sendQueueMutex );
+
+        pushToSendQueue( OutPacket( packet, std::move(func), false ) );
+        m_sendQueueBytes += packet->lenght();
+
+        startWriteIfIdle();
+    }
+
+    bool asyncWrite( GatherTpktPtr packet ) override
+    {
+        const std::lock_guard<std::mutex> autolock( m_sendQueueMutex );
+
+        if ( m_sendQueue.size() >= m_maxSendQueueLength || m_sendQueueBytes + packet->lenght() > m_maxSendQueueBytes )
+        {
+            return false;
+        }
+
+        pushToSendQueue( OutPacket( packet, {}, true ) );
+        m_sendQueueBytes += packet->lenght();
+
+        startWriteIfIdle();
+        return true;
+    }
+
+    bool asyncWrite( const std::vector<TpktBufferPtr>& packets ) override
+    {
+        const std::lock_guard<std::mutex> autolock( m_sendQueueMutex );
+
+        size_t bytes = 0;
+        for( const auto& packet : packets )
+            bytes += packet->lenght();
+
+        if ( m_sendQueue.size() + packets.size() > m_maxSendQueueLength || m_sendQueueBytes + bytes > m_maxSendQueueBytes )
+        {
+            return false;
+        }
+
+        for( const auto& packet : packets )
+        {
+            pushToSendQueue( OutPacket( packet, {}, true ) );
+        }
+        m_sendQueueBytes += bytes;
+
+        startWriteIfIdle();
+        return true;
+    }
+
+    bool asyncSendFile( FileDescriptorPtr file, uint64_t offset, uint32_t size, std::function<void()> func ) override
+    {
+        const std::lock_guard<std::mutex> autolock( m_sendQueueMutex );
+
+        if ( m_sendQueue.size() >= m_maxSendQueueLength || m_sendQueueBytes + size > m_maxSendQueueBytes )
+        {
+            return false;
+        }
+
+        pushToSendQueue( OutPacket( file, offset, size, std::move(func) ) );
+        m_sendQueueBytes += size;
+
+        startWriteIfIdle();
+        return true;
+    }
+
+    void setSendQueueLimits( uint32_t maxPacketNumber, uint32_t maxBytes ) override
+    {
+        const std::lock_guard<std::mutex> autolock( m_sendQueueMutex );
+        m_maxSendQueueLength = maxPacketNumber;
+        m_maxSendQueueBytes  = maxBytes;
+    }
+
+    size_t sendQueueLength() const override { return m_sendQueue.size(); }
+    size_t sendQueueBytes()  const override { return m_sendQueueBytes; }
+
+    void dropQueuedPackets() override
+    {
+        const std::lock_guard<std::mutex> autolock( m_sendQueueMutex );
+
+        // packets that are being written are kept
+        auto it = std::remove_if( m_sendQueue.begin()+m_inFlightPacketNumber, m_sendQueue.end(), [this]( const OutPacket& outPacket )
+        {
+            if ( !outPacket.m_isDroppable )
+                return false;
+            m_sendQueueBytes -= outPacket.size();
+            return true;
+        });
+        m_sendQueue.erase( it, m_sendQueue.end() );
+    }
+
+    void closeSession() override;
+    void postOnStrand( std::function<void()> func ) override;
+    void postOnStrand( StrandTaskPtr task ) override;
+    void asyncWait( uint32_t milliseconds, std::function<void()> func ) override;
+
+private:
+    std::weak_ptr<IAsyncTcpSession> weakFromThis()
+    {
+        return ((IAsyncTcpSession*)this)->weak_from_this();
+    }
+
+    std::shared_ptr<UringTcpSession> sharedFromThis()
+    {
+        return std::static_pointer_cast<UringTcpSession>( ((IAsyncTcpSession*)this)->shared_from_this() );
+    }
+
+    bool isOnOwnThread() const;
+    io_uring_sqe* getSqe( UringOp& op );
+
+    //
+    // the following methods are called by the shard thread
+    //
+
+    void onCompletion( UringOp& op, int result, uint32_t flags );
+
+    // release - is called after the last reference to the session
+    void release()
+    {
+        m_isReleased = true;
+        close();
+        deleteIfDone();
+    }
+
+    void deleteIfDone()
+    {
+        if ( m_isReleased && m_inFlightOps == 0 )
+        {
+            delete this;
+        }
+    }
+
+    void close()
+    {
+        if ( m_isClosed )
+            return;
+
+        // in-flight operations are completed (with errors), and the socket is closed after them
+        m_isClosed = true;
+        ::shutdown( m_fd, SHUT_RDWR );
+    }
+
+    void logSocketError( const boost::system::error_code& ec )
+    {
+        if ( ec == boost::asio::error::eof )
+        {
+            LOG( "UringTcpSession: client disconnected" << std::endl );
+        }
+        else
+        {
+            LOG( "UringTcpSession: socket error: " << ec.message() << std::endl );
+        }
+    }
+
+    //
+    // receiving
+    //
+
+    void armReceive();
+    void cancelReceive();
+
+    void requestRead( ReadKind kind );
+
+    // startRead - the read is completed by received data (or it waits for data)
+    void startRead( ReadKind kind )
+    {
+        m_pendingRead = kind;
+        m_lastReadError.clear();
+        if ( kind == ReadKind::BATCH )
+        {
+            m_receivedPackets.clear();
+        }
+
+        // the handler is not called by the caller of read
+        if ( canCompleteRead() )
+        {
+            postCompleteRead();
+        }
+        resumeReceive();
+    }
+
+    void postCompleteRead();
+
+    size_t unreadBytes() const { return m_receivedEnd - m_receivedBegin; }
+
+    bool canCompleteRead() const
+    {
+        if ( m_bigPacket )
+            return m_bigPacketReceived == m_bigPacket->lenght();
+
+        return unreadBytes() >= 4 || m_receiveError;
+    }
+
+    void onReceive( int result, uint32_t flags, bool isAlive );
+
+    // consume - copies received data into the big packet and the receive buffer
+    void consume( const uint8_t* data, size_t len )
+    {
+        if ( m_bigPacket )
+        {
+            size_t size = std::min( len, m_bigPacket->lenght() - m_bigPacketReceived );
+            memcpy( m_bigPacket->data() + m_bigPacketReceived, data, size );
+            m_bigPacketReceived += size;
+            data += size;
+            len  -= size;
+        }
+
+        if ( len == 0 )
+            return;
+
+        if ( m_receiveBuffer.size() - m_receivedEnd < len && m_receivedBegin > 0 )
+        {
+            memmove( &m_receiveBuffer[0], &m_receiveBuffer[m_receivedBegin], unreadBytes() );
+            m_receivedEnd  -= m_receivedBegin;
+            m_receivedBegin = 0;
+        }
+
+        // the buffer grows only until the receive is paused
+        if ( m_receiveBuffer.size() - m_receivedEnd < len )
+        {
+            m_receiveBuffer.resize( m_receivedEnd + len );
+        }
+
+        memcpy( &m_receiveBuffer[m_receivedEnd], data, len );
+        m_receivedEnd += len;
+    }
+
+    // completeRead - completes pending read, if it has enough data
+    void completeRead()
+    {
+        if ( m_pendingRead == ReadKind::NONE )
+            return;
+
+        bool isCompleted = ( m_pendingRead == ReadKind::SINGLE ) ? completeSingleRead() : completeBatchRead();
+        if ( !isCompleted )
+        {
+            resumeReceive();
+            return;
+        }
+
+        ReadKind kind = m_pendingRead;
+        m_pendingRead = ReadKind::NONE;
+
+        if ( hasReadError() )
+        {
+            logSocketError( m_lastReadError );
+        }
+
+        if ( kind == ReadKind::SINGLE )
+        {
+            auto handler = std::move( m_readHandler );
+            handler();
+            return;
+        }
+
+        // the handler could start the next read with another handler;
+        // after a read error the handler is released (it could hold the owner of the session)
+        auto handler = hasReadError() ? std::move( m_readBatchHandler ) : m_readBatchHandler;
+        (*handler)();
+    }
+
+    bool completeSingleRead()
+    {
+        if ( m_bigPacket )
+        {
+            if ( m_bigPacketReceived < m_bigPacket->lenght() )
+                return completeByReceiveError();
+
+            // the packet was received into m_request
+            m_bigPacket.reset();
+            return true;
+        }
+
+        if ( unreadBytes() < 4 )
+            return completeByReceiveError();
+
+        const uint8_t* bytes = &m_receiveBuffer[m_receivedBegin];
+        uint32_t packetLen = loadUint32LE( bytes );
+        if ( !checkPacketLength( packetLen, m_readMaxPacketLength ) )
+            return true;
+
+        m_request.prepareToRead( packetLen );
+
+        if ( unreadBytes() >= packetLen )
+        {
+            memcpy( m_request.ptr(), bytes, packetLen );
+            m_receivedBegin += packetLen;
+            resetReceiveBufferIfEmpty();
+            return true;
+        }
+
+        startBigPacket( m_request.sharedBuffer() );
+        return false;
+    }
+
+    bool completeBatchRead()
+    {
+        if ( m_bigPacket )
+        {
+            if ( m_bigPacketReceived < m_bigPacket->lenght() )
+                return completeByReceiveError();
+
+            m_receivedPackets.push_back( std::move(m_bigPacket) );
+            return true;
+        }
+
+        // all complete packets are read
+        while( unreadBytes() >= 4 )
+        {
+            const uint8_t* bytes = &m_receiveBuffer[m_receivedBegin];
+            uint32_t packetLen = loadUint32LE( bytes );
+
+            if ( !checkPacketLength( packetLen, m_readBatchMaxPacketLength ) )
+                return true;
+
+            if ( unreadBytes() < packetLen )
+                break;
+
+            TpktBufferPtr packet = acquireTpktBuffer( m_request.bufferPool(), packetLen );
+            memcpy( packet->data(), bytes, packetLen );
+            packet->setLenght( packetLen );
+            m_receivedPackets.push_back( std::move(packet) );
+
+            m_receivedBegin += packetLen;
+        }
+        resetReceiveBufferIfEmpty();
+
+        if ( !m_receivedPackets.empty() )
+            return true;
+
+        if ( unreadBytes() >= 4 )
+        {
+            uint32_t packetLen = loadUint32LE( &m_receiveBuffer[m_receivedBegin] );
+            if ( packetLen > RECEIVE_BUFFER_SIZE )
+            {
+                TpktBufferPtr packet = acquireTpktBuffer( m_request.bufferPool(), packetLen );
+                packet->setLenght( packetLen );
+                startBigPacket( std::move(packet) );
+                return false;
+            }
+        }
+
+        return completeByReceiveError();
+    }
+
+    // completeByReceiveError - the read is completed, if nothing more will be received
+    bool completeByReceiveError()
+    {
+        if ( !m_receiveError )
+            return false;
+
+        m_lastReadError = m_receiveError;
+        return true;
+    }
+
+    // startBigPacket - moves the beginning of packet from the receive buffer
+    void startBigPacket( TpktBufferPtr packet )
+    {
+        size_t restLen = std::min( unreadBytes(), size_t( packet->lenght() ) );
+        memcpy( packet->data(), &m_receiveBuffer[m_receivedBegin], restLen );
+        m_receivedBegin += restLen;
+        resetReceiveBufferIfEmpty();
+
+        m_bigPacket = std::move(packet);
+        m_bigPacketReceived = restLen;
+    }
+
+    void resetReceiveBufferIfEmpty()
+    {
+        if ( m_receivedBegin == m_receivedEnd )
+        {
+            m_receivedBegin = m_receivedEnd = 0;
+        }
+    }
+
+    bool checkPacketLength( uint32_t packetLen, uint32_t maxPacketLength )
+    {
+        if ( packetLen > maxPacketLength )
+        {
+            m_readProtocolError.emplace( std::string("packet length exceeds ") + std::to_string(maxPacketLength) );
+            return false;
+        }
+
+        if ( packetLen < 8 )
+        {
+            m_readProtocolError.emplace( "invalid packet size (<8)" );
+            return false;
+        }
+        return true;
+    }
+
+    // resumeReceive - arms receive, if there is room for data
+    void resumeReceive()
+    {
+        if ( m_isReceiveArmed || m_receiveError || m_isClosed || m_isReleased )
+            return;
+
+        if ( m_bigPacket || unreadBytes() < RECEIVE_BUFFER_SIZE )
+        {
+            armReceive();
+        }
+    }
+
+    // pauseReceiveIfFull - stops receiving, while unread data is not consumed by reads
+    void pauseReceiveIfFull()
+    {
+        if ( m_isReceiveArmed && !m_isReceivePaused && !m_bigPacket && unreadBytes() >= RECEIVE_BUFFER_SIZE )
+        {
+            cancelReceive();
+        }
+    }
+
+    //
+    // writing
+    //
+
+    // must be called under m_sendQueueMutex
+    void enqueue( const TpktBufferPtr& packet, std::function<void()> func, bool isDroppable )
+    {
+        pushToSendQueue( OutPacket( packet, std::move(func), isDroppable ) );
+        m_sendQueueBytes += packet->lenght();
+
+        startWriteIfIdle();
+    }
+
+    // must be called under m_sendQueueMutex
+    void pushToSendQueue( OutPacket&& outPacket )
+    {
+        if ( m_sendQueue.full() )
+        {
+            m_sendQueue.set_capacity( m_sendQueue.capacity()*2 );
+        }
+        m_sendQueue.push_back( std::move(outPacket) );
+    }
+
+    // must be called under m_sendQueueMutex
+    void startWriteIfIdle()
+    {
+        if ( m_inFlightPacketNumber == 0 && !m_isWriteStartPosted )
+        {
+            if ( isOnOwnThread() )
+            {
+                startWrite();
+            }
+            else
+            {
+                // the write will be started by the shard thread
+                m_isWriteStartPosted = true;
+                postWriteStart();
+            }
+        }
+    }
+
+    void postWriteStart();
+
+    // startQueuedWrite - is called by the shard thread (after 'postWriteStart()')
+    void startQueuedWrite()
+    {
+        const std::lock_guard<std::mutex> autolock( m_sendQueueMutex );
+
+        m_isWriteStartPosted = false;
+        if ( m_inFlightPacketNumber == 0 && !m_sendQueue.empty() )
+        {
+            startWrite();
+        }
+    }
+
+    // startWrite - writes queued packets (up to MAX_GATHERED_PACKETS) by one send request
+    // (file ranges are written separately);
+    // must be called under m_sendQueueMutex
+    void startWrite()
+    {
+        if ( m_sendQueue.front().m_file )
+        {
+            startSendFile();
+            return;
+        }
+
+        m_iovecs.clear();
+        m_iovIndex = 0;
+        m_inFlightPacketNumber = 0;
+        size_t bytes = 0;
+        while( m_inFlightPacketNumber < std::min( m_sendQueue.size(), MAX_GATHERED_PACKETS ) && !m_sendQueue[m_inFlightPacketNumber].m_file )
+        {
+            auto& outPacket = m_sendQueue[m_inFlightPacketNumber];
+            if ( outPacket.m_gatherPacket )
+            {
+                outPacket.m_gatherPacket->forEachBuffer( [this]( const uint8_t* data, size_t size )
+                {
+                    m_iovecs.push_back( iovec{ (void*)data, size } );
+                });
+            }
+            else
+            {
+                m_iovecs.push_back( iovec{ outPacket.m_packet->data(), outPacket.m_packet->lenght() } );
+            }
+            bytes += outPacket.size();
+            m_inFlightPacketNumber++;
+        }
+
+        m_isZeroCopySend = bytes >= ZERO_COPY_MIN_BYTES && isZeroCopyEnabled();
+        submitSend();
+    }
+
+    bool isZeroCopyEnabled() const;
+    void disableZeroCopy();
+
+    // submitSend - sends the rest of m_iovecs
+    void submitSend()
+    {
+        io_uring_sqe* sqe = getSqe( m_sendOp );
+        sqe->fd = m_fd;
+        sqe->msg_flags = MSG_NOSIGNAL;
+
+        size_t iovNumber = m_iovecs.size() - m_iovIndex;
+        if ( iovNumber == 1 )
+        {
+            sqe->opcode = m_isZeroCopySend ? IORING_OP_SEND_ZC : IORING_OP_SEND;
+            sqe->addr   = uint64_t( m_iovecs[m_iovIndex].iov_base );
+            sqe->len    = uint32_t( m_iovecs[m_iovIndex].iov_len );
+            return;
+        }
+
+        m_msg = msghdr{};
+        m_msg.msg_iov    = &m_iovecs[m_iovIndex];
+        m_msg.msg_iovlen = iovNumber;
+
+        sqe->opcode = m_isZeroCopySend ? IORING_OP_SENDMSG_ZC : IORING_OP_SENDMSG;
+        sqe->addr   = uint64_t( &m_msg );
+        sqe->len    = 1;
+    }
+
+    void onSend( int result, uint32_t flags, bool isAlive )
+    {
+        if ( flags & IORING_CQE_F_NOTIF )
+        {
+            m_zeroCopyNotifications++;
+            if ( isAlive )
+            {
+                releaseZeroCopyPackets();
+            }
+            return;
+        }
+
+        // pages of the request will be released later (the notification completes the request)
+        if ( flags & IORING_CQE_F_MORE )
+        {
+            m_zeroCopyRequests++;
+        }
+
+        if ( !isAlive )
+            return;
+
+        if ( m_isZeroCopySend && ( result == -EINVAL || result == -EOPNOTSUPP ) )
+        {
+            LOG_WARN( "zero-copy send is not supported: " << strerror( -result ) << std::endl );
+            disableZeroCopy();
+            m_isZeroCopySend = false;
+
+            const std::lock_guard<std::mutex> autolock( m_sendQueueMutex );
+            submitSend();
+            return;
+        }
+
+        if ( result < 0 )
+        {
+            onWriteCompleted( boost::system::error_code( -result, boost::system::system_category() ) );
+            return;
+        }
+
+        // the rest of partially sent data
+        size_t sent = size_t(result);
+        while( sent > 0 && m_iovIndex < m_iovecs.size() )
+        {
+            iovec& iov = m_iovecs[m_iovIndex];
+            if ( sent < iov.iov_len )
+            {
+                iov.iov_base = (uint8_t*)iov.iov_base + sent;
+                iov.iov_len -= sent;
+                break;
+            }
+            sent -= iov.iov_len;
+            m_iovIndex++;
+        }
+
+        if ( m_iovIndex < m_iovecs.size() )
+        {
+            const std::lock_guard<std::mutex> autolock( m_sendQueueMutex );
+            submitSend();
+            return;
+        }
+
+        onWriteCompleted( {} );
+    }
+
+    // must be called under m_sendQueueMutex
+    void startSendFile()
+    {
+        m_inFlightPacketNumber = 1;
+        m_isZeroCopySend    = false;
+        m_sendingFile       = m_sendQueue.front().m_file;
+        m_sendingFileOffset = m_sendQueue.front().m_fileOffset;
+        m_sendingFileSize   = m_sendQueue.front().m_fileSize;
+        m_fileSentBytes     = 0;
+        m_pipeBytes         = 0;
+
+        if ( m_pipe[0] < 0 )
+        {
+            if ( pipe2( m_pipe, O_CLOEXEC ) != 0 )
+            {
+                m_pipe[0] = m_pipe[1] = -1;
+
+                // the error is reported by the completion
+                m_pendingWriteError = boost::system::error_code( errno, boost::system::system_category() );
+                getSqe( m_spliceOp )->opcode = IORING_OP_NOP;
+                return;
+            }
+
+            fcntl( m_pipe[1], F_SETPIPE_SZ, 1024*1024 );
+            int pipeSize = fcntl( m_pipe[1], F_GETPIPE_SZ );
+            m_pipeSize = pipeSize > 0 ? uint32_t(pipeSize) : 64*1024;
+        }
+
+        submitSplice();
+    }
+
+    void submitSplice()
+    {
+        io_uring_sqe* sqe = getSqe( m_spliceOp );
+        sqe->opcode = IORING_OP_SPLICE;
+
+        if ( m_isSplicingToSocket )
+        {
+            sqe->splice_fd_in  = m_pipe[0];
+            sqe->splice_off_in = uint64_t(-1);
+            sqe->fd            = m_fd;
+            sqe->off           = uint64_t(-1);
+            sqe->len           = m_pipeBytes;
+        }
+        else
+        {
+            sqe->splice_fd_in  = m_sendingFile->fd();
+            sqe->splice_off_in = m_sendingFileOffset + m_fileSentBytes;
+            sqe->fd            = m_pipe[1];
+            sqe->off           = uint64_t(-1);
+            sqe->len           = std::min( m_sendingFileSize - m_fileSentBytes, m_pipeSize );
+        }
+    }
+
+    void onSplice( int result, bool isAlive )
+    {
+        if ( !isAlive )
+            return;
+
+        if ( m_pendingWriteError )
+        {
+            auto ec = m_pendingWriteError;
+            m_pendingWriteError.clear();
+            onWriteCompleted( ec );
+            return;
+        }
+
+        if ( result < 0 )
+        {
+            onWriteCompleted( boost::system::error_code( -result, boost::system::system_category() ) );
+            return;
+        }
+
+        if ( result == 0 )
+        {
+            // file is shorter than the range
+            onWriteCompleted( make_error_code( boost::asio::error::eof ) );
+            return;
+        }
+
+        if ( !m_isSplicingToSocket )
+        {
+            m_pipeBytes = uint32_t(result);
+            m_isSplicingToSocket = true;
+        }
+        else
+        {
+            m_pipeBytes     -= uint32_t(result);
+            m_fileSentBytes += uint32_t(result);
+            if ( m_pipeBytes == 0 )
+            {
+                m_isSplicingToSocket = false;
+                if ( m_fileSentBytes == m_sendingFileSize )
+                {
+                    onWriteCompleted( {} );
+                    return;
+                }
+            }
+        }
+
+        submitSplice();
+    }
+
+    void onWriteCompleted( boost::system::error_code ec )
+    {
+        boost::container::small_vector<std::function<void()>,8> handlers;
+        {
+            const std::lock_guard<std::mutex> autolock( m_sendQueueMutex );
+
+            m_lastWriteError = ec;
+
+            size_t heldPacketNumber = 0;
+            for( size_t i=0; i<m_inFlightPacketNumber; i++ )
+            {
+                OutPacket& outPacket = m_sendQueue.front();
+                m_sendQueueBytes -= outPacket.size();
+
+                if ( m_isZeroCopySend )
+                {
+                    // the packet is held until the kernel releases its pages
+                    if ( m_zeroCopyPackets.full() )
+                    {
+                        m_zeroCopyPackets.set_capacity( m_zeroCopyPackets.capacity()*2 );
+                    }
+                    m_zeroCopyPackets.push_back( std::move(outPacket) );
+                    heldPacketNumber++;
+                }
+                else if ( outPacket.m_handler )
+                {
+                    handlers.push_back( std::move( outPacket.m_handler ) );
+                }
+                m_sendQueue.pop_front();
+            }
+            m_inFlightPacketNumber = 0;
+            m_sendingFile.reset();
+            m_isSplicingToSocket = false;
+
+            if ( heldPacketNumber > 0 )
+            {
+                if ( m_zeroCopyBatches.full() )
+                {
+                    m_zeroCopyBatches.set_capacity( m_zeroCopyBatches.capacity()*2 );
+                }
+                m_zeroCopyBatches.push_back( ZeroCopyBatch{ heldPacketNumber, m_zeroCopyRequests } );
+            }
+
+            if ( ec )
+            {
+                logSocketError( ec );
+
+                // the rest of packets will never be sent
+                // (their handlers are called, so borrowed payload could be released and awaiting coroutines are resumed)
+                for( auto& outPacket : m_sendQueue )
+                {
+                    if ( outPacket.m_handler )
+                    {
+                        handlers.push_back( std::move( outPacket.m_handler ) );
+                    }
+                }
+                m_sendQueue.clear();
+                m_sendQueueBytes = 0;
+                close();
+            }
+            else if ( !m_sendQueue.empty() )
+            {
+                startWrite();
+            }
+        }
+
+        // handlers are called out of lock, because they could write again
+        for( auto& handler : handlers )
+        {
+            handler();
+        }
+
+        releaseZeroCopyPackets();
+    }
+
+    // releaseZeroCopyPackets - releases packets (and calls their handlers), which pages are released by the kernel
+    void releaseZeroCopyPackets()
+    {
+        while( !m_zeroCopyBatches.empty() && m_zeroCopyBatches.front().m_lastRequest <= m_zeroCopyNotifications )
+        {
+            boost::container::small_vector<std::function<void()>,8> handlers;
+            for( size_t i=0; i<m_zeroCopyBatches.front().m_packetNumber; i++ )
+            {
+                if ( m_zeroCopyPackets.front().m_handler )
+                {
+                    handlers.push_back( std::move( m_zeroCopyPackets.front().m_handler ) );
+                }
+                m_zeroCopyPackets.pop_front();
+            }
+            m_zeroCopyBatches.pop_front();
+
+            for( auto& handler : handlers )
+            {
+                handler();
+            }
+        }
+    }
+};
+
+}} // namespace catapult { namespace net
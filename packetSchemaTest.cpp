@@ -0,0 +1,219 @@
+#include <iostream>
+#include "PacketSchema.h"
+#include "FileViewer.h"
+#include "TestUtil.h"
+
+//
+// packetSchemaTest - encoding, decoding and dispatching of commands by their schemas (see PacketSchema.h)
+//
+
+using namespace catapult::net;
+using namespace catapult::streaming;
+
+// sizes of fixed fields are known at compile time
+static_assert( StartStreamingRequest::minPacketSize   == 12+4 );
+static_assert( RestoreStreamingRequest::minPacketSize == 12+4+4 );
+static_assert( RedirectResponse::minPacketSize        == 12+4+4 );
+static_assert( StartMultiplexingRequest::minPacketSize == 12 && StartMultiplexingRequest::isFixedSize );
+static_assert( !StartLiveViewingRequest::isFixedSize );
+
+// toReceived - packet, as it is received; { version, command } are read
+StreamingTpktRcv toReceived( const StreamingTpkt& pkt, uint32_t& command )
+{
+    TpktBufferPtr buffer = acquireTpktBuffer( nullptr, uint32_t(pkt.lenght()) );
+    buffer->setLenght( uint32_t(pkt.lenght()) );
+    memcpy( buffer->data(), pkt.ptr(), pkt.lenght() );
+
+    StreamingTpktRcv received( buffer );
+    uint32_t version;
+    received.read( version, command );
+    return received;
+}
+
+template<class Func>
+bool isThrown( Func&& func )
+{
+    try
+    {
+        func();
+    }
+    catch( std::runtime_error& )
+    {
+        return true;
+    }
+    return false;
+}
+
+// testEncodeDecode - a packet is encoded with its exact size and decoded into the same fields
+void testEncodeDecode()
+{
+    StreamingTpkt pkt = RestoreStreamingRequest::encode( StreamId( std::string( "STREAM" ) ), 49, 1 );
+    CHECK( pkt.lenght() == 12 + 4+6 + 4 + 4 );
+    CHECK( loadUint32LE( pkt.ptr() ) == pkt.lenght() );
+
+    uint32_t command;
+    StreamingTpktRcv received = toReceived( pkt, command );
+    CHECK( command == cmd::RESTORE_STREAMING );
+
+    StreamId streamId;
+    uint32_t lastAckedSeq = 0, flowControl = 0;
+    RestoreStreamingRequest::decode( received, streamId, lastAckedSeq, flowControl );
+    CHECK( streamId == StreamId( std::string( "STREAM" ) ) );
+    CHECK( lastAckedSeq == 49 );
+    CHECK( flowControl == 1 );
+    CHECK( received.restDataLen() == 0 );
+
+    // the string field is the same as it is written by StreamingTpkt
+    StreamingTpkt redirect = RedirectResponse::encode( "10.0.0.1", 7654 );
+    StreamingTpkt expected( 4, cmd::REDIRECT_RESPONSE, std::string( "10.0.0.1" ) );
+    expected.writeUint32( 7654 );
+    CHECK( redirect.constBuffer() == expected.constBuffer() );
+
+    std::string address;
+    uint32_t port = 0;
+    received = toReceived( redirect, command );
+    RedirectResponse::decode( received, address, port );
+    CHECK( address == "10.0.0.1" && port == 7654 );
+}
+
+// testOptionalFields - an absent optional field does not change the value (so old clients are served by defaults)
+void testOptionalFields()
+{
+    uint32_t command;
+
+    // { streamId } (as it is sent by old clients)
+    StreamingTpktRcv received = toReceived( StreamingTpkt( 0, cmd::START_STREAMING, std::string( "OLD" ) ), command );
+    StreamId streamId;
+    uint32_t flowControl = 777;
+    StartStreamingRequest::decode( received, streamId, flowControl );
+    CHECK( streamId == StreamId( std::string( "OLD" ) ) );
+    CHECK( flowControl == 777 );
+
+    // { streamId, startMode, startValue }
+    received = toReceived( StartLiveViewingRequest::encode( StreamId( std::string( "LIVE" ) ), ViewingStart{ BEHIND_LIVE, 5 } ), command );
+    ViewingStart start;
+    StartLiveViewingRequest::decode( received, streamId, start );
+    CHECK( start.m_mode == BEHIND_LIVE && start.m_value == 5 );
+
+    // { streamId, startMode } - a part of optional field is ignored
+    StreamingTpkt partial( 4, cmd::START_LIFE_STREAM_VIEWING, std::string( "LIVE" ) );
+    partial.writeUint32( AT_TIME );
+    received = toReceived( partial, command );
+    start = ViewingStart{ DEFAULT_START, 0 };
+    StartLiveViewingRequest::decode( received, streamId, start );
+    CHECK( start.m_mode == DEFAULT_START );
+}
+
+// testInvalidPackets - a packet is rejected, if it is shorter than its required fields
+void testInvalidPackets()
+{
+    uint32_t command;
+    StreamId streamId;
+    uint32_t lastAckedSeq = 0, flowControl = 0;
+
+    // lastAckedSeq is absent
+    StreamingTpktRcv received = toReceived( StreamingTpkt( 0, cmd::RESTORE_STREAMING, std::string( "STREAM" ) ), command );
+    CHECK( isThrown( [&] { RestoreStreamingRequest::decode( received, streamId, lastAckedSeq, flowControl ); } ) );
+
+    // the lenght of streamId is greater than the rest of packet
+    StreamingTpkt badLenght( 8, cmd::RESTORE_STREAMING );
+    badLenght.writeUint32( 1000, 1 );
+    received = toReceived( badLenght, command );
+    CHECK( isThrown( [&] { RestoreStreamingRequest::decode( received, streamId, lastAckedSeq, flowControl ); } ) );
+
+    // the lenght of streamId, that would overflow 32-bit size
+    StreamingTpkt hugeLenght( 8, cmd::START_STREAMING );
+    hugeLenght.writeUint32( 0xFFFFFFFE, 1 );
+    received = toReceived( hugeLenght, command );
+    CHECK( isThrown( [&] { StartStreamingRequest::decode( received, streamId, flowControl ); } ) );
+}
+
+//
+// Handler - records the dispatched command
+//
+struct Handler
+{
+    cmd::Id     m_command = cmd::Id(0);
+    std::string m_streamId;
+    uint32_t    m_value = 0;
+
+    void handle( StartStreamingRequest, int& callNumber, StreamId& streamId, uint32_t& flowControl )
+    {
+        callNumber++;
+        m_command  = cmd::START_STREAMING;
+        m_streamId = streamId.m_id;
+        m_value    = flowControl;
+    }
+
+    void handle( RestoreStreamingRequest, int& callNumber, StreamId& streamId, uint32_t& lastAckedSeq, uint32_t& )
+    {
+        callNumber++;
+        m_command  = cmd::RESTORE_STREAMING;
+        m_streamId = streamId.m_id;
+        m_value    = lastAckedSeq;
+    }
+
+    void handle( StartMultiplexingRequest, int& callNumber )
+    {
+        callNumber++;
+        m_command  = cmd::START_MULTIPLEXING;
+    }
+};
+
+typedef CommandTable< StartStreamingRequest, RestoreStreamingRequest, StartMultiplexingRequest > TestCommandTable;
+
+// testDispatch - a request is decoded by the schema of its command and passed to the handler
+void testDispatch()
+{
+    Handler handler;
+    int callNumber = 0;
+    uint32_t command;
+
+    StreamingTpktRcv received = toReceived( RestoreStreamingRequest::encode( StreamId( std::string( "RESTORED" ) ), 7, 0 ), command );
+    CHECK( TestCommandTable::dispatch( command, received, handler, callNumber ) );
+    CHECK( callNumber == 1 && handler.m_command == cmd::RESTORE_STREAMING );
+    CHECK( handler.m_streamId == "RESTORED" && handler.m_value == 7 );
+
+    received = toReceived( StartStreamingRequest::encode( StreamId( std::string( "STARTED" ) ), 1 ), command );
+    CHECK( TestCommandTable::dispatch( command, received, handler, callNumber ) );
+    CHECK( callNumber == 2 && handler.m_command == cmd::START_STREAMING );
+    CHECK( handler.m_streamId == "STARTED" && handler.m_value == 1 );
+
+    received = toReceived( StartMultiplexingRequest::encode(), command );
+    CHECK( TestCommandTable::dispatch( command, received, handler, callNumber ) );
+    CHECK( callNumber == 3 && handler.m_command == cmd::START_MULTIPLEXING );
+
+    // the command is not in the table
+    received = toReceived( StartLiveViewingRequest::encode( StreamId( std::string( "LIVE" ) ), ViewingStart{} ), command );
+    CHECK( !TestCommandTable::dispatch( command, received, handler, callNumber ) );
+    CHECK( callNumber == 3 );
+
+    // the handler is not called for an invalid packet
+    received = toReceived( StreamingTpkt( 0, cmd::RESTORE_STREAMING, std::string( "STREAM" ) ), command );
+    CHECK( isThrown( [&] { TestCommandTable::dispatch( command, received, handler, callNumber ); } ) );
+    CHECK( callNumber == 3 );
+}
+
+int main( int, const char* [] )
+{
+    try
+    {
+        testEncodeDecode();
+        testOptionalFields();
+        testInvalidPackets();
+        testDispatch();
+    }
+    catch( std::exception& error )
+    {
+        _LOG( "packetSchemaTest: " << error.what() );
+        gErrorNumber++;
+    }
+
+    if ( gErrorNumber != 0 )
+    {
+        _LOG( "packetSchemaTest FAILED: " << gErrorNumber << " errors" );
+        return 1;
+    }
+    _LOG( "packetSchemaTest passed" );
+    return 0;
+}
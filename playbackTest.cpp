@@ -0,0 +1,238 @@
+#include <unistd.h>
+
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include "AsyncTcpServer.h"
+#include "StreamClient.h"
+#include "StreamManager.h"
+#include "FileViewer.h"
+#include "PacketSchema.h"
+#include "TestUtil.h"
+
+//
+// playbackTest - viewing of recorded streams (see FileViewer.h)
+//
+
+using namespace catapult::net;
+using namespace catapult::streaming;
+
+#define PORT                    7656
+#define IDLE_TIMEOUT_MS         3000
+
+uint64_t nowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+// runStreamer - sends 'frameNumber' frames (from 'firstFrame') with 'intervalMs' between them
+void runStreamer( const std::string& streamId, uint32_t frameNumber, uint32_t intervalMs, uint32_t firstFrame = 0 )
+{
+    auto tcpClient = connect( PORT, StartStreamingRequest::encode( StreamId( streamId ), 0 ) );
+
+    StreamingTpktRcv response;
+    for( uint32_t i = firstFrame; i < firstFrame+frameNumber; i++ )
+    {
+        StreamingTpkt pkt = makeFrame( i );
+        if ( !tcpClient->write( pkt ) )
+            throw std::runtime_error( tcpClient->errorMessage() );
+        if ( readResponse( *tcpClient, response ) != cmd::OK_STREAMING_RESPONSE )
+            throw std::runtime_error( "frame is not accepted" );
+        usleep( intervalMs*1000 );
+    }
+
+    StreamingTpkt endStreaming( 0, cmd::END_STREAMING, streamId );
+    if ( !tcpClient->write( endStreaming ) )
+        throw std::runtime_error( tcpClient->errorMessage() );
+}
+
+//
+// ViewingResult - frames received by a viewer, until the connection is closed
+//
+struct ViewingResult
+{
+    uint32_t    m_responseId    = 0;
+    uint32_t    m_frameNumber   = 0;
+    uint32_t    m_firstFrame    = uint32_t(-1);
+    uint32_t    m_firstFlags    = 0;
+    uint32_t    m_lastFrame     = uint32_t(-1);
+    bool        m_hasGap        = false;
+    bool        m_hasBadData    = false;
+    uint64_t    m_closeTimeMs   = 0;
+};
+
+ViewingResult runViewer( cmd::Id requestId, const std::string& streamId, ViewingStart start )
+{
+    ViewingResult result;
+
+    auto tcpClient = createStreamingClient();
+    if ( !tcpClient->connect( "localhost", PORT ) )
+        throw std::runtime_error( tcpClient->errorMessage() );
+
+    StreamingTpkt request( 8, requestId, streamId );
+    request.writeUint32( start.m_mode );
+    request.writeUint32( start.m_value );
+    if ( !tcpClient->write( request ) )
+        throw std::runtime_error( tcpClient->errorMessage() );
+
+    StreamingTpktRcv response;
+    result.m_responseId = readResponse( *tcpClient, response );
+    if ( result.m_responseId != cmd::OK_STREAMING_RESPONSE )
+        return result;
+
+    try
+    {
+        while( readResponse( *tcpClient, response ) == cmd::STREAMING_DATA )
+        {
+            uint32_t frameFlags, i;
+            response.read( frameFlags, i );
+
+            if ( result.m_frameNumber == 0 )
+            {
+                result.m_firstFrame = i;
+                result.m_firstFlags = frameFlags;
+            }
+            else if ( i != result.m_lastFrame+1 )
+            {
+                _LOG( "viewer: frame " << i << " after " << result.m_lastFrame );
+                result.m_hasGap = true;
+            }
+
+            // the packet is sent as it was received from the streamer
+            if ( !isFrameValid( response, i ) )
+            {
+                result.m_hasBadData = true;
+            }
+
+            result.m_lastFrame = i;
+            result.m_frameNumber++;
+        }
+    }
+    catch( std::runtime_error& ) {}
+
+    result.m_closeTimeMs = nowMs();
+    return result;
+}
+
+// testFileViewing - all recorded frames are played from the beginning of recording
+void testFileViewing()
+{
+    std::string streamId( "FILE_VIEWING" );
+    runStreamer( streamId, 100, 0 );
+
+    // (the recording is closed by the I/O thread)
+    usleep( 500000 );
+
+    ViewingResult result = runViewer( cmd::START_FILE_STREAM_VIEWING, streamId, ViewingStart{ DEFAULT_START, 0 } );
+    CHECK( result.m_responseId == cmd::OK_STREAMING_RESPONSE );
+    CHECK( result.m_frameNumber == 100 );
+    CHECK( result.m_firstFrame == 0 );
+    CHECK( result.m_lastFrame == 99 );
+    CHECK( !result.m_hasGap );
+    CHECK( !result.m_hasBadData );
+
+    // a stream, that was not recorded
+    result = runViewer( cmd::START_FILE_STREAM_VIEWING, "NOT_RECORDED", ViewingStart{ DEFAULT_START, 0 } );
+    CHECK( result.m_responseId != cmd::OK_STREAMING_RESPONSE );
+}
+
+// testNextRecording - a stream, that is recorded again, is played across the end of its first recording
+// (without the pause between recordings)
+void testNextRecording()
+{
+    std::string streamId( "NEXT_RECORDING" );
+    runStreamer( streamId, 50, 0 );
+    usleep( (IDLE_TIMEOUT_MS + 1000)*1000 );
+    runStreamer( streamId, 50, 0, 50 );
+
+    // (the recording is closed by the I/O thread)
+    usleep( 500000 );
+
+    uint64_t startTimeMs = nowMs();
+    ViewingResult result = runViewer( cmd::START_FILE_STREAM_VIEWING, streamId, ViewingStart{ DEFAULT_START, 0 } );
+    CHECK( result.m_responseId == cmd::OK_STREAMING_RESPONSE );
+    CHECK( result.m_frameNumber == 100 );
+    CHECK( result.m_firstFrame == 0 );
+    CHECK( result.m_lastFrame == 99 );
+    CHECK( !result.m_hasGap );
+    CHECK( !result.m_hasBadData );
+
+    // the viewer is closed after the idle timeout
+    CHECK( result.m_closeTimeMs < startTimeMs + IDLE_TIMEOUT_MS + 500 );
+}
+
+// testTimeShiftViewing - a viewer, that starts behind live, catches up with the stream and is switched to live fan-out
+void testTimeShiftViewing()
+{
+    std::string streamId( "TIME_SHIFT_VIEWING" );
+    std::thread streamer( [streamId] { runStreamer( streamId, 250, 20 ); } );
+    sleep( 3 );
+
+    ViewingResult result;
+    std::thread viewer( [&] { result = runViewer( cmd::START_LIFE_STREAM_VIEWING, streamId, ViewingStart{ BEHIND_LIVE, 2 } ); } );
+
+    streamer.join();
+    uint64_t endTimeMs = nowMs();
+    viewer.join();
+
+    CHECK( result.m_responseId == cmd::OK_STREAMING_RESPONSE );
+    CHECK( result.m_firstFrame < 100 );
+    CHECK( result.m_firstFlags & frame::KEY_FRAME );
+    CHECK( result.m_lastFrame == 249 );
+    CHECK( !result.m_hasGap );
+    CHECK( !result.m_hasBadData );
+
+    // a live viewer is closed with the end of stream (a file viewer would wait for the idle timeout)
+    CHECK( result.m_closeTimeMs < endTimeMs + IDLE_TIMEOUT_MS/2 );
+}
+
+int main( int, const char* [] )
+{
+    char directoryTemplate[] = "/tmp/playbackTestXXXXXX";
+    if ( ::mkdtemp( directoryTemplate ) == nullptr )
+    {
+        _LOG( "cannot create directory: " << strerror( errno ) );
+        return 1;
+    }
+
+    DistributorConfig config;
+    config.m_recorderConfig.m_recordDirectory = directoryTemplate;
+    config.m_recorderConfig.m_segmentMaxBytes = 40000;
+    config.m_recorderConfig.m_writeBlockBytes = 8192;
+    config.m_recorderConfig.m_flushIntervalMs = 100;
+    config.m_fileViewingIdleTimeoutMs = IDLE_TIMEOUT_MS;
+    config.m_timeShiftPlaybackPercent = 200;
+
+    std::string errorText;
+    gStreamManager().startStreamManager( PORT, 2, errorText, config );
+    if ( !errorText.empty() )
+    {
+        _LOG( "cannot start server: " << errorText );
+        return 1;
+    }
+
+    try
+    {
+        testFileViewing();
+        testNextRecording();
+        testTimeShiftViewing();
+    }
+    catch( std::runtime_error& error )
+    {
+        _LOG( "playbackTest: " << error.what() );
+        gErrorNumber++;
+    }
+
+    gStreamManager().stopStreamManager();
+    std::filesystem::remove_all( directoryTemplate );
+
+    if ( gErrorNumber != 0 )
+    {
+        _LOG( "playbackTest FAILED: " << gErrorNumber << " errors" );
+        return 1;
+    }
+    _LOG( "playbackTest passed" );
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <filesystem>
+#include <vector>
+#include "Recorder.h"
+#include "KeyFrameIndex.h"
+#include "StreamingTpkt.h"
+#include "TestUtil.h"
+
+//
+// recorderTest - segments, their indexes and the key frame index of a recording (see Recorder.h)
+//
+
+using namespace catapult::net;
+using namespace catapult::streaming;
+
+#define FRAME_NUMBER            100
+#define FRAME_INTERVAL_MS       40
+#define FIRST_TIMESTAMP_MS      1000000
+#define SEGMENT_MAX_BYTES       40000
+
+// makeFrameBuffer - the frame, as it is received from a streamer
+TpktBufferPtr makeFrameBuffer( uint32_t i )
+{
+    StreamingTpkt pkt = makeFrame( i );
+
+    TpktBufferPtr packet = acquireTpktBuffer( nullptr, (uint32_t)pkt.lenght() );
+    packet->setLenght( (uint32_t)pkt.lenght() );
+    memcpy( packet->data(), pkt.ptr(), pkt.lenght() );
+    return packet;
+}
+
+template<class T>
+std::vector<T> readEntries( const std::string& fileName )
+{
+    std::vector<T> entries( std::filesystem::file_size( fileName ) / sizeof(T) );
+
+    int fd = ::open( fileName.c_str(), O_RDONLY );
+    CHECK( fd >= 0 );
+    CHECK( ::read( fd, entries.data(), entries.size()*sizeof(T) ) == ssize_t( entries.size()*sizeof(T) ) );
+    ::close( fd );
+    return entries;
+}
+
+void testRecording( const std::string& recordDirectory, bool useDirectIo )
+{
+    RecorderConfig config;
+    config.m_recordDirectory = recordDirectory;
+    config.m_segmentMaxBytes = SEGMENT_MAX_BYTES;
+    config.m_writeBlockBytes = 8192;
+    config.m_flushIntervalMs = 50;
+    config.m_useDirectIo     = useDirectIo;
+
+    StreamId streamId( std::string( "RECORDED_STREAM" ) );
+
+    auto recorder = createRecorder( config );
+    {
+        auto recording = recorder->startRecording( streamId );
+        for( uint32_t i = 0; i < FRAME_NUMBER; i++ )
+        {
+            TpktBufferPtr packet = makeFrameBuffer( i );
+            recording->append( packet, FIRST_TIMESTAMP_MS + i*FRAME_INTERVAL_MS, i, loadUint32LE( packet->data()+12 ) );
+        }
+    }
+    recorder->stop();
+
+    // segments are numbered from 1 and each of them is not greater than SEGMENT_MAX_BYTES
+    std::string directory = recordingDirectory( recordDirectory, streamId );
+    uint32_t frameNumber = 0;
+    uint64_t segmentNumber = 1;
+    for( ; std::filesystem::exists( segmentFileName( directory, segmentNumber, ".seg" ) ); segmentNumber++ )
+    {
+        std::string segmentName = segmentFileName( directory, segmentNumber, ".seg" );
+        CHECK( std::filesystem::file_size( segmentName ) <= SEGMENT_MAX_BYTES );
+
+        int fd = ::open( segmentName.c_str(), O_RDONLY );
+        CHECK( fd >= 0 );
+
+        uint64_t offset = 0;
+        for( const RecordIndexEntry& entry : readEntries<RecordIndexEntry>( segmentFileName( directory, segmentNumber, ".idx" ) ) )
+        {
+            uint32_t i = frameNumber++;
+            CHECK( entry.m_seq == i );
+            CHECK( entry.m_offset == offset );
+            CHECK( entry.m_timestampMs == FIRST_TIMESTAMP_MS + i*FRAME_INTERVAL_MS );
+            CHECK( entry.m_flags == ( (i%KEY_FRAME_INTERVAL == 0) ? frame::KEY_FRAME : 0 ) );
+
+            // the packet is written as it was received
+            TpktBufferPtr expected = makeFrameBuffer( i );
+            std::vector<uint8_t> packet( entry.m_size );
+            CHECK( entry.m_size == expected->lenght() );
+            CHECK( ::pread( fd, packet.data(), packet.size(), off_t( entry.m_offset ) ) == ssize_t( packet.size() ) );
+            CHECK( memcmp( packet.data(), expected->data(), std::min<size_t>( packet.size(), expected->lenght() ) ) == 0 );
+            offset += entry.m_size;
+        }
+        CHECK( std::filesystem::file_size( segmentName ) == offset );
+        ::close( fd );
+    }
+    CHECK( frameNumber == FRAME_NUMBER );
+    CHECK( segmentNumber > 2 );
+
+    // key frame index
+    KeyFrameIndex keyFrameIndex;
+    CHECK( keyFrameIndex.open( directory ) );
+    CHECK( keyFrameIndex.size() == FRAME_NUMBER/KEY_FRAME_INTERVAL );
+
+    for( const KeyFrameIndexEntry& entry : keyFrameIndex )
+    {
+        CHECK( entry.m_seq % KEY_FRAME_INTERVAL == 0 );
+        CHECK( entry.m_timestampMs == FIRST_TIMESTAMP_MS + entry.m_seq*FRAME_INTERVAL_MS );
+
+        // (it refers to the entry of segment index)
+        auto entries = readEntries<RecordIndexEntry>( segmentFileName( directory, entry.m_segmentNumber, ".idx" ) );
+        CHECK( entry.m_entryNumber < entries.size() );
+        if ( entry.m_entryNumber < entries.size() )
+        {
+            CHECK( entries[entry.m_entryNumber].m_seq == entry.m_seq );
+            CHECK( entries[entry.m_entryNumber].m_offset == entry.m_offset );
+        }
+    }
+
+    // 'find' returns the last key frame not later than the time (or the first one)
+    auto seqOfKeyFrame = [&]( uint64_t timestampMs )
+    {
+        const KeyFrameIndexEntry* entry = keyFrameIndex.find( timestampMs );
+        return entry ? int64_t( entry->m_seq ) : -1;
+    };
+    CHECK( seqOfKeyFrame( 0 ) == 0 );
+    CHECK( seqOfKeyFrame( FIRST_TIMESTAMP_MS ) == 0 );
+    CHECK( seqOfKeyFrame( FIRST_TIMESTAMP_MS + 15*FRAME_INTERVAL_MS ) == 10 );
+    CHECK( seqOfKeyFrame( FIRST_TIMESTAMP_MS + 20*FRAME_INTERVAL_MS ) == 20 );
+    CHECK( seqOfKeyFrame( FIRST_TIMESTAMP_MS + 20*FRAME_INTERVAL_MS - 1 ) == 10 );
+    CHECK( seqOfKeyFrame( uint64_t(-1) ) == FRAME_NUMBER - KEY_FRAME_INTERVAL );
+}
+
+int main( int, const char* [] )
+{
+    char directoryTemplate[] = "/tmp/recorderTestXXXXXX";
+    if ( ::mkdtemp( directoryTemplate ) == nullptr )
+    {
+        _LOG( "cannot create directory: " << strerror( errno ) );
+        return 1;
+    }
+    std::string recordDirectory( directoryTemplate );
+
+    try
+    {
+        testRecording( recordDirectory + "/buffered", false );
+
+        // (if the file system does not support O_DIRECT, segments are written without it)
+        testRecording( recordDirectory + "/direct", true );
+    }
+    catch( std::exception& error )
+    {
+        _LOG( "recorderTest: " << error.what() );
+        gErrorNumber++;
+    }
+
+    std::filesystem::remove_all( recordDirectory );
+
+    if ( gErrorNumber != 0 )
+    {
+        _LOG( "recorderTest FAILED: " << gErrorNumber << " errors" );
+        return 1;
+    }
+    _LOG( "recorderTest passed" );
+    return 0;
+}
@@ -0,0 +1,195 @@
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include "StreamClient.h"
+#include "StreamManager.h"
+#include "PacketSchema.h"
+#include "TestUtil.h"
+
+//
+// relayTest - edge mode (see 'DistributorConfig::m_originAddress'):
+// the origin server is run by a child process, the edge server is run by the test process
+//
+
+using namespace catapult::net;
+using namespace catapult::streaming;
+
+#define ORIGIN_PORT             7663
+#define EDGE_PORT               7664
+#define STREAM_ID               "RELAY"
+#define VIEWER_NUMBER           3
+#define FRAME_NUMBER            50
+
+// originConnectionNumber - established connections of this process to the origin (streamers and upstream connections)
+// (the origin is connected by IPv4 address, so connections are listed in /proc/net/tcp)
+int originConnectionNumber()
+{
+    std::ifstream file( "/proc/net/tcp" );
+    std::string line;
+    std::getline( file, line );
+
+    int number = 0;
+    while( std::getline( file, line ) )
+    {
+        // sl local_address rem_address st ...
+        std::istringstream fields( line );
+        std::string sl, localAddress, remoteAddress, state;
+        fields >> sl >> localAddress >> remoteAddress >> state;
+
+        if ( state == "01" && std::stoul( remoteAddress.substr( remoteAddress.find(':')+1 ), nullptr, 16 ) == ORIGIN_PORT )
+        {
+            number++;
+        }
+    }
+    return number;
+}
+
+// testRelay - viewers of the edge share one upstream connection, that is closed after the last of them;
+// the next viewer opens a new one (and starts from the GOP cache of the origin)
+void testRelay()
+{
+    std::string streamId( STREAM_ID );
+
+    // viewers are connected before the streamer (the stream is relayed by the first of them)
+    std::vector<std::unique_ptr<Viewer>> viewers;
+    for( int i = 0; i < VIEWER_NUMBER; i++ )
+    {
+        viewers.push_back( std::make_unique<Viewer>( EDGE_PORT, streamId, FRAME_NUMBER ) );
+    }
+    CHECK( waitFor( [] { return originConnectionNumber() == 1; } ) );
+
+    auto streamer = connect( ORIGIN_PORT, StartStreamingRequest::encode( StreamId( streamId ), 0 ) );
+    CHECK( originConnectionNumber() == 2 );
+
+    StreamingTpktRcv response;
+    for( uint32_t i = 0; i < FRAME_NUMBER; i++ )
+    {
+        StreamingTpkt pkt = makeFrame( i );
+        CHECK( streamer->write( pkt ) );
+        CHECK( readResponse( *streamer, response ) == cmd::OK_STREAMING_RESPONSE );
+    }
+
+    for( auto& viewer : viewers )
+    {
+        viewer->join();
+        CHECK( viewer->m_frameNumber == FRAME_NUMBER );
+        CHECK( viewer->m_firstFrame == 0 );
+        CHECK( !viewer->m_hasGap );
+        CHECK( !viewer->m_hasBadData );
+    }
+
+    // only the streamer is connected to the origin after the last viewer
+    CHECK( waitFor( [] { return originConnectionNumber() == 1; } ) );
+
+    // frames from the last key frame are received by a new upstream connection
+    Viewer lateViewer( EDGE_PORT, streamId );
+    CHECK( waitFor( [&] { return lateViewer.m_frameNumber == 10; } ) );
+    CHECK( originConnectionNumber() == 2 );
+
+    // the end of stream is relayed to the viewer of edge
+    StreamingTpkt endStreaming( 0, cmd::END_STREAMING, streamId );
+    CHECK( streamer->write( endStreaming ) );
+
+    lateViewer.join();
+    CHECK( lateViewer.m_frameNumber == 10 );
+    CHECK( lateViewer.m_firstFrame == FRAME_NUMBER-10 && lateViewer.m_lastFrame == FRAME_NUMBER-1 );
+    CHECK( !lateViewer.m_hasGap );
+    CHECK( !lateViewer.m_hasBadData );
+
+    streamer->close();
+    CHECK( waitFor( [] { return originConnectionNumber() == 0; } ) );
+}
+
+// runOrigin - runs the origin server, until the pipe is closed by the test process
+int runOrigin( int pipeFd )
+{
+    std::string errorText;
+    gStreamManager().startStreamManager( ORIGIN_PORT, 2, errorText );
+    if ( !errorText.empty() )
+    {
+        _LOG( "cannot start origin: " << errorText );
+        return 1;
+    }
+
+    char byte;
+    while( ::read( pipeFd, &byte, 1 ) > 0 ) {}
+
+    gStreamManager().stopStreamManager();
+    return 0;
+}
+
+int main( int, const char* [] )
+{
+    // (the origin is forked before any thread is started)
+    int pipeFds[2];
+    if ( ::pipe( pipeFds ) != 0 )
+    {
+        _LOG( "cannot create pipe" );
+        return 1;
+    }
+
+    pid_t originPid = ::fork();
+    if ( originPid < 0 )
+    {
+        _LOG( "cannot fork" );
+        return 1;
+    }
+    if ( originPid == 0 )
+    {
+        ::close( pipeFds[1] );
+        ::_exit( runOrigin( pipeFds[0] ) );
+    }
+    ::close( pipeFds[0] );
+
+    DistributorConfig config;
+    config.m_originAddress = "127.0.0.1";
+    config.m_originPort    = ORIGIN_PORT;
+
+    std::string errorText;
+    gStreamManager().startStreamManager( EDGE_PORT, 2, errorText, config );
+    if ( !errorText.empty() )
+    {
+        _LOG( "cannot start server: " << errorText );
+        ::close( pipeFds[1] );
+        ::waitpid( originPid, nullptr, 0 );
+        return 1;
+    }
+
+    try
+    {
+        // (the origin is started by the child process)
+        CHECK( waitFor( []
+        {
+            auto tcpClient = createStreamingClient();
+            return tcpClient->connect( "127.0.0.1", ORIGIN_PORT );
+        }) );
+
+        testRelay();
+    }
+    catch( std::runtime_error& error )
+    {
+        _LOG( "relayTest: " << error.what() );
+        gErrorNumber++;
+    }
+
+    gStreamManager().stopStreamManager();
+
+    ::close( pipeFds[1] );
+    int status = 0;
+    ::waitpid( originPid, &status, 0 );
+    CHECK( WIFEXITED( status ) && WEXITSTATUS( status ) == 0 );
+
+    if ( gErrorNumber != 0 )
+    {
+        _LOG( "relayTest FAILED: " << gErrorNumber << " errors" );
+        return 1;
+    }
+    _LOG( "relayTest passed" );
+    return 0;
+}
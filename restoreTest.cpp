@@ -0,0 +1,151 @@
+#include <unistd.h>
+
+#include <iostream>
+#include "AsyncTcpServer.h"
+#include "StreamClient.h"
+#include "StreamManager.h"
+#include "FlowControl.h"
+#include "PacketSchema.h"
+#include "TestUtil.h"
+
+//
+// restoreTest - RESTORE_STREAMING within and after the grace period (see ResumeRing.h)
+//
+
+using namespace catapult::net;
+using namespace catapult::streaming;
+
+#define PORT                    7655
+#define GRACE_PERIOD_MS         1000
+
+std::unique_ptr<IStreamClient> startStreaming( const std::string& streamId )
+{
+    return connect( PORT, StartStreamingRequest::encode( StreamId( streamId ), ONE_RESPONSE_PER_FRAME ) );
+}
+
+// sendFrames - sends frames [begin,end) and waits for OK_STREAMING_RESPONSE of each
+void sendFrames( IStreamClient& tcpClient, uint32_t begin, uint32_t end )
+{
+    StreamingTpktRcv response;
+    for( uint32_t i = begin; i < end; i++ )
+    {
+        StreamingTpkt pkt = makeFrame( i );
+        if ( !tcpClient.write( pkt ) )
+            throw std::runtime_error( tcpClient.errorMessage() );
+        if ( readResponse( tcpClient, response ) != cmd::OK_STREAMING_RESPONSE )
+            throw std::runtime_error( "frame is not accepted" );
+    }
+}
+
+// restoreStreaming - returns responseId of RESTORE_STREAMING
+uint32_t restoreStreaming( std::unique_ptr<IStreamClient>& tcpClient, const std::string& streamId, uint32_t lastAckedSeq, uint32_t& resumeSeq )
+{
+    tcpClient = createStreamingClient();
+    if ( !tcpClient->connect( "localhost", PORT ) )
+        throw std::runtime_error( tcpClient->errorMessage() );
+
+    StreamingTpkt request = RestoreStreamingRequest::encode( StreamId( streamId ), lastAckedSeq, ONE_RESPONSE_PER_FRAME );
+    if ( !tcpClient->write( request ) )
+        throw std::runtime_error( tcpClient->errorMessage() );
+
+    StreamingTpktRcv response;
+    uint32_t responseId = readResponse( *tcpClient, response );
+    if ( responseId == cmd::OK_STREAMING_RESPONSE )
+    {
+        response.read( resumeSeq );
+    }
+    return responseId;
+}
+
+// testRestoreWithinGracePeriod - the stream and its viewers survive the loss of streamer connection
+void testRestoreWithinGracePeriod()
+{
+    std::string streamId( "RESTORE_WITHIN_GRACE_PERIOD" );
+
+    auto streamer = startStreaming( streamId );
+    Viewer viewer( PORT, streamId );
+    usleep( 100000 );
+
+    sendFrames( *streamer, 0, 50 );
+
+    // frame 50 is not acknowledged
+    StreamingTpkt pkt = makeFrame( 50 );
+    CHECK( streamer->write( pkt ) );
+    usleep( 100000 );
+    streamer->close();
+
+    usleep( GRACE_PERIOD_MS/4 * 1000 );
+    CHECK( !viewer.m_isClosed );
+
+    uint32_t resumeSeq = 0;
+    CHECK( restoreStreaming( streamer, streamId, 49, resumeSeq ) == cmd::OK_STREAMING_RESPONSE );
+    CHECK( resumeSeq == 51 );
+
+    sendFrames( *streamer, resumeSeq, 100 );
+    usleep( 200000 );
+
+    StreamingTpkt endStreaming( 0, cmd::END_STREAMING, streamId );
+    CHECK( streamer->write( endStreaming ) );
+
+    viewer.join();
+
+    CHECK( viewer.m_frameNumber == 100 );
+    CHECK( viewer.m_lastFrame == 99 );
+    CHECK( !viewer.m_hasGap );
+    CHECK( !viewer.m_hasBadData );
+}
+
+// testRestoreAfterGracePeriod - the stream is ended (its viewers are disconnected) and cannot be restored
+void testRestoreAfterGracePeriod()
+{
+    std::string streamId( "RESTORE_AFTER_GRACE_PERIOD" );
+
+    auto streamer = startStreaming( streamId );
+    Viewer viewer( PORT, streamId );
+    usleep( 100000 );
+
+    sendFrames( *streamer, 0, 10 );
+    streamer->close();
+
+    usleep( ( GRACE_PERIOD_MS + 500 ) * 1000 );
+    CHECK( viewer.m_isClosed );
+    CHECK( viewer.m_frameNumber == 10 );
+
+    uint32_t resumeSeq = 0;
+    CHECK( restoreStreaming( streamer, streamId, 9, resumeSeq ) == cmd::ERROR_STREAMING_RESPONSE );
+}
+
+int main( int, const char* [] )
+{
+    DistributorConfig config;
+    config.m_restoreGracePeriodMs = GRACE_PERIOD_MS;
+
+    std::string errorText;
+    gStreamManager().startStreamManager( PORT, 2, errorText, config );
+    if ( !errorText.empty() )
+    {
+        _LOG( "cannot start server: " << errorText );
+        return 1;
+    }
+
+    try
+    {
+        testRestoreWithinGracePeriod();
+        testRestoreAfterGracePeriod();
+    }
+    catch( std::runtime_error& error )
+    {
+        _LOG( "restoreTest: " << error.what() );
+        gErrorNumber++;
+    }
+
+    gStreamManager().stopStreamManager();
+
+    if ( gErrorNumber != 0 )
+    {
+        _LOG( "restoreTest FAILED: " << gErrorNumber << " errors" );
+        return 1;
+    }
+    _LOG( "restoreTest passed" );
+    return 0;
+}
@@ -8,6 +8,9 @@
 #include <unistd.h>
 
 #include <iostream>
+#include <algorithm>
+#include <string>
+#include <vector>
 #include "AsyncTcpServer.h"
 #include "StreamClient.h"
 #include "StreamManager.h"
@@ -15,11 +18,68 @@
 using namespace catapult::net;
 using namespace catapult::streaming;
 
-int main(int, const char * [])
+//
+// usage: server [port [-local] [originAddress originPort]]
+//        server port [-local] -cluster selfAddress:port [nodeAddress:port ...]
+//
+// (the server is an edge server of the origin server, if 'originAddress' is set;
+//  streams are placed on nodes of cluster, if '-cluster' is set - see ClusterRing.h;
+//  streamers on this host could write frames to shared memory, if '-local' is set - see LocalIngest.h)
+//
+static ClusterNode parseNode( const std::string& node )
 {
-    std::string errorText;
-    gStreamManager().startStreamManager( 15001, 1, errorText );
+    auto colon = node.rfind( ':' );
+    if ( colon == std::string::npos )
+        throw std::runtime_error( "invalid node (address:port is expected): " + node );
 
-    return 0;
+    return ClusterNode{ node.substr( 0, colon ), uint32_t( std::stoul( node.substr( colon+1 ) ) ) };
 }
 
+int main(int argc, const char * argv[])
+{
+    std::vector<std::string> args( argv, argv+argc );
+
+    DistributorConfig config;
+
+    if ( args.size() > 2 && args[2] == "-local" )
+    {
+        config.m_isLocalIngestEnabled = true;
+        args.erase( args.begin()+2 );
+    }
+
+    uint32_t port = args.size() > 1 ? uint32_t( std::stoul( args[1] ) ) : 15001;
+
+    if ( args.size() > 3 && args[2] == "-cluster" )
+    {
+        config.m_selfNode = parseNode( args[3] );
+        for( size_t i = 3; i < args.size(); i++ )
+        {
+            ClusterNode node = parseNode( args[i] );
+
+            // (the list of nodes could be the same for all nodes)
+            const auto& nodes = config.m_clusterNodes;
+            if ( std::find( nodes.begin(), nodes.end(), node ) == nodes.end() )
+            {
+                config.m_clusterNodes.push_back( node );
+            }
+        }
+    }
+    else if ( args.size() > 3 )
+    {
+        config.m_originAddress = args[2];
+        config.m_originPort    = uint32_t( std::stoul( args[3] ) );
+    }
+
+    std::string errorText;
+    gStreamManager().startStreamManager( port, 1, errorText, config );
+    if ( !errorText.empty() )
+    {
+        std::cerr << "cannot start server: " << errorText << std::endl;
+        return 1;
+    }
+
+    for(;;)
+    {
+        pause();
+    }
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "Streaming.h"
+
+namespace catapult {
+namespace streaming {
+
+    //
+    // Stream placement in a cluster
+    //
+    // REDIRECT_RESPONSE:      { version, REDIRECT_RESPONSE, ownerAddress, ownerPort }
+    //
+    // Each server of a cluster knows the same list of nodes and maps a StreamId to its owner node
+    // by consistent hashing. A first request of a stream (START_STREAMING, RESTORE_STREAMING,
+    // START_LIFE_STREAM_VIEWING, START_FILE_STREAM_VIEWING), that is received by another node,
+    // gets REDIRECT_RESPONSE and the connection is closed; the client connects to the owner
+    // and sends the request again (IStreamClient does it by itself).
+    //
+
+    // ClusterNode - address of a server, as it is known to clients
+    struct ClusterNode
+    {
+        std::string m_address;
+        uint32_t    m_port = 0;
+
+        std::string name() const { return m_address + ":" + std::to_string( m_port ); }
+
+        bool operator==( const ClusterNode& node ) const { return m_port == node.m_port && m_address == node.m_address; }
+    };
+
+    //
+    // ClusterRing - consistent hashing of StreamIds to nodes
+    //
+    // Each node has 'virtualNodeNumber' points on the ring; a stream is owned by the node of the first point
+    // after the hash of its id. So when a node is added, only about 1/N of streams are moved (to the new node).
+    // Hashes do not depend on the process (std::hash is not used), so all nodes compute the same owner.
+    //
+    class ClusterRing
+    {
+        std::vector<ClusterNode>                    m_nodes;
+
+        // (sorted by hash)
+        std::vector<std::pair<uint64_t,uint32_t>>   m_points;
+
+    public:
+        enum { DEFAULT_VIRTUAL_NODE_NUMBER = 160 };
+
+        ClusterRing( const std::vector<ClusterNode>& nodes, uint32_t virtualNodeNumber = DEFAULT_VIRTUAL_NODE_NUMBER )
+            : m_nodes( nodes )
+        {
+            m_points.reserve( m_nodes.size() * virtualNodeNumber );
+
+            for( uint32_t nodeIndex = 0; nodeIndex < m_nodes.size(); nodeIndex++ )
+            {
+                std::string name = m_nodes[nodeIndex].name() + "#";
+                for( uint32_t i = 0; i < virtualNodeNumber; i++ )
+                {
+                    m_points.emplace_back( hash( name + std::to_string(i) ), nodeIndex );
+                }
+            }
+
+            // (points with equal hashes are ordered by node, so the order of 'nodes' does not matter)
+            std::sort( m_points.begin(), m_points.end(), [this]( const auto& a, const auto& b )
+            {
+                return a.first < b.first || ( a.first == b.first && m_nodes[a.second].name() < m_nodes[b.second].name() );
+            });
+        }
+
+        bool isEmpty() const { return m_points.empty(); }
+
+        // owner - the ring must not be empty
+        const ClusterNode& owner( const StreamId& streamId ) const
+        {
+            uint64_t streamHash = hash( streamId.m_id );
+
+            auto it = std::lower_bound( m_points.begin(), m_points.end(), streamHash, []( const auto& point, uint64_t value )
+            {
+                return point.first < value;
+            });
+
+            if ( it == m_points.end() )
+            {
+                it = m_points.begin();
+            }
+            return m_nodes[it->second];
+        }
+
+        // hash - FNV-1a with final mixing (the points of a node are spread over the ring)
+        static uint64_t hash( const std::string& str )
+        {
+            uint64_t h = 14695981039346656037ull;
+            for( unsigned char c : str )
+            {
+                h = ( h ^ c ) * 1099511628211ull;
+            }
+
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ull;
+            h ^= h >> 33;
+            return h;
+        }
+    };
+
+}} // namespace catapult { namespace streaming
@@ -0,0 +1,413 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <vector>
+
+#include "FileViewer.h"
+#include "KeyFrameIndex.h"
+#include "AsyncTcpServer.h"
+#include "StreamingTpkt.h"
+
+namespace catapult {
+namespace streaming {
+
+using namespace catapult::net;
+
+uint64_t viewingStartTimeMs( uint32_t startMode, uint32_t startValue )
+{
+    switch( startMode )
+    {
+        case DEFAULT_START:
+            return 0;
+        case AT_TIME:
+            return uint64_t(startValue) * 1000;
+        case BEHIND_LIVE:
+        {
+            uint64_t now = std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::system_clock::now().time_since_epoch() ).count();
+            return now - std::min<uint64_t>( now-1, uint64_t(startValue) * 1000 );
+        }
+        default:
+            throw std::runtime_error( "invalid start mode" );
+    }
+}
+
+//
+// FileViewer
+//
+class FileViewer : public IFileViewer, public std::enable_shared_from_this<FileViewer>
+{
+    // delay of the next attempt, when there is nothing to send or the viewer backlog is full
+    static constexpr uint32_t RETRY_DELAY_MS = 50;
+
+    // several frames are sent by one 'sendfile', if they are contiguous in segment
+    static constexpr uint32_t MAX_SEND_RANGE = 1024*1024;
+
+    std::shared_ptr<IAsyncTcpSession>   m_tcpSession;
+    const DistributorConfig&            m_config;
+    std::string                         m_directory;
+
+    // is set for time-shift viewing of a live stream
+    SwitchToLiveHandler                 m_switchToLiveHandler;
+    uint32_t                            m_playbackPercent = 100;
+
+    // current segment
+    uint64_t                            m_segmentNumber = 0;
+    FileDescriptorPtr                   m_segment;
+    FileDescriptorPtr                   m_index;
+    uint64_t                            m_indexReadOffset = 0;
+    uint64_t                            m_readaheadEnd = 0;
+
+    // not sent entries of current segment are [m_nextEntry, m_entries.size())
+    std::vector<RecordIndexEntry>       m_entries;
+    size_t                              m_nextEntry = 0;
+
+    // playback starts from a key frame; then frames are sent at (m_playbackStartMs + timestamp - m_firstTimestampMs)
+    bool                                m_isPlaybackStarted = false;
+    uint64_t                            m_firstTimestampMs = 0;
+    uint64_t                            m_playbackStartMs = 0;
+
+    // the last sent frame
+    uint32_t                            m_lastSeq = 0;
+    uint64_t                            m_lastTimestampMs = 0;
+
+    uint64_t                            m_lastDataTimeMs = 0;
+
+    std::atomic<bool>                   m_isStopped{false};
+
+public:
+    FileViewer( std::shared_ptr<IAsyncTcpSession> tcpSession, const StreamId& streamId, const DistributorConfig& config,
+                SwitchToLiveHandler switchToLiveHandler )
+        : m_tcpSession( tcpSession ),
+          m_config( config ),
+          m_directory( recordingDirectory( config.m_recorderConfig.m_recordDirectory, streamId ) ),
+          m_switchToLiveHandler( switchToLiveHandler )
+    {
+        m_tcpSession->setSendQueueLimits( m_config.m_viewerBacklogFrames, m_config.m_viewerBacklogBytes );
+
+        if ( m_switchToLiveHandler )
+        {
+            m_playbackPercent = std::max<uint32_t>( 1, m_config.m_timeShiftPlaybackPercent );
+        }
+    }
+
+    void start( uint64_t startTimeMs ) override
+    {
+        try
+        {
+            if ( startTimeMs == 0 )
+            {
+                uint64_t segmentNumber = nextSegmentNumber( 0 );
+                if ( segmentNumber == 0 )
+                    throw std::runtime_error( "recording is not found" );
+
+                openSegment( segmentNumber );
+            }
+            else
+            {
+                seek( startTimeMs );
+            }
+        }
+        catch( std::runtime_error& error )
+        {
+            StreamingTpkt response( 0, cmd::ERROR_STREAMING_RESPONSE, error.what() );
+            m_tcpSession->asyncWrite( response, [tcpSession=m_tcpSession] { tcpSession->closeSession(); } );
+            return;
+        }
+
+        StreamingTpkt response( 0, cmd::OK_STREAMING_RESPONSE );
+        m_tcpSession->asyncWrite( response, [] {} );
+
+        m_lastDataTimeMs = nowMs();
+
+        // after switching to live fan-out requests are read by live viewer
+        // (so disconnection of time-shift viewer is detected by write error)
+        if ( !m_switchToLiveHandler )
+        {
+            readNextClientRequest();
+        }
+        sendNextFrames();
+    }
+
+private:
+    static uint64_t nowMs()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+
+    // readNextClientRequest - detects disconnection of the viewer
+    void readNextClientRequest()
+    {
+        m_tcpSession->asyncRead( [this, shared=shared_from_this()]
+        {
+            if ( m_tcpSession->hasReadError() )
+            {
+                stop();
+                return;
+            }
+            readNextClientRequest();
+        });
+    }
+
+    // seek - positions playback at the last key frame before 'startTimeMs' (without reading of segments)
+    void seek( uint64_t startTimeMs )
+    {
+        KeyFrameIndex keyFrameIndex;
+        if ( !keyFrameIndex.open( m_directory ) )
+            throw std::runtime_error( "recording is not found" );
+
+        const KeyFrameIndexEntry* keyFrame = keyFrameIndex.find( startTimeMs );
+        if ( keyFrame == nullptr )
+            throw std::runtime_error( "recording has no key frames" );
+
+        openSegment( keyFrame->m_segmentNumber );
+        m_indexReadOffset = uint64_t( keyFrame->m_entryNumber ) * sizeof(RecordIndexEntry);
+    }
+
+    void stop()
+    {
+        m_isStopped = true;
+        m_tcpSession->closeSession();
+    }
+
+    void sendNextFramesAfter( uint32_t delayMs )
+    {
+        m_tcpSession->asyncWait( delayMs, [this, shared=shared_from_this()] { sendNextFrames(); } );
+    }
+
+    void sendNextFrames()
+    {
+        if ( m_isStopped )
+            return;
+
+        if ( m_switchToLiveHandler && m_tcpSession->hasWriteError() )
+        {
+            stop();
+            return;
+        }
+
+        try
+        {
+            uint64_t now = nowMs();
+
+            for(;;)
+            {
+                if ( m_nextEntry == m_entries.size() && !loadNextEntries() )
+                {
+                    // time-shift viewer has caught up with the recording
+                    if ( m_switchToLiveHandler && m_isPlaybackStarted && m_switchToLiveHandler( m_lastSeq, m_lastTimestampMs ) )
+                    {
+                        LOG( "time-shift viewer is switched to live" << std::endl );
+                        m_isStopped = true;
+                        return;
+                    }
+
+                    // the recording is finished (or the stream is not recorded now)
+                    if ( now - m_lastDataTimeMs > m_config.m_fileViewingIdleTimeoutMs )
+                    {
+                        finish();
+                        return;
+                    }
+                    sendNextFramesAfter( RETRY_DELAY_MS );
+                    return;
+                }
+                m_lastDataTimeMs = now;
+
+                const RecordIndexEntry& entry = m_entries[m_nextEntry];
+                if ( !m_isPlaybackStarted )
+                {
+                    if ( !(entry.m_flags & frame::KEY_FRAME) )
+                    {
+                        m_nextEntry++;
+                        continue;
+                    }
+                    m_isPlaybackStarted = true;
+                    m_firstTimestampMs  = entry.m_timestampMs;
+                    m_playbackStartMs   = now;
+                }
+                else if ( entry.m_timestampMs < m_lastTimestampMs
+                          || entry.m_timestampMs - m_lastTimestampMs > m_config.m_fileViewingIdleTimeoutMs )
+                {
+                    // the next recording of the stream (segments are numbered across recordings):
+                    // the pause between recordings is not played
+                    m_playbackStartMs   = std::max( now, playbackTime( m_lastTimestampMs ) );
+                    m_firstTimestampMs  = entry.m_timestampMs;
+                }
+
+                uint64_t dueTime = playbackTime( entry.m_timestampMs );
+                if ( dueTime > now + m_config.m_fileViewingLeadMs )
+                {
+                    sendNextFramesAfter( uint32_t( dueTime - now - m_config.m_fileViewingLeadMs ) );
+                    return;
+                }
+
+                // contiguous frames, that are due, are sent together
+                size_t   endEntry = m_nextEntry+1;
+                uint64_t endOffset = entry.m_offset + entry.m_size;
+                while( endEntry < m_entries.size()
+                       && m_entries[endEntry].m_offset == endOffset
+                       && endOffset + m_entries[endEntry].m_size - entry.m_offset <= MAX_SEND_RANGE
+                       && playbackTime( m_entries[endEntry].m_timestampMs ) <= now + m_config.m_fileViewingLeadMs )
+                {
+                    endOffset += m_entries[endEntry].m_size;
+                    endEntry++;
+                }
+
+                readahead( endOffset );
+
+                if ( !m_tcpSession->asyncSendFile( m_segment, entry.m_offset, uint32_t( endOffset - entry.m_offset ), {} ) )
+                {
+                    // the viewer does not keep up; playback is delayed
+                    sendNextFramesAfter( RETRY_DELAY_MS );
+                    return;
+                }
+                m_lastSeq         = m_entries[endEntry-1].m_seq;
+                m_lastTimestampMs = m_entries[endEntry-1].m_timestampMs;
+                m_nextEntry = endEntry;
+            }
+        }
+        catch( std::runtime_error& error )
+        {
+            LOG_ERR( "file viewing error: " << error.what() << std::endl );
+            stop();
+        }
+    }
+
+    uint64_t playbackTime( uint64_t timestampMs ) const
+    {
+        return m_playbackStartMs + ( timestampMs - m_firstTimestampMs ) * 100 / m_playbackPercent;
+    }
+
+    // finish - closes session, when all frames are sent
+    void finish()
+    {
+        if ( m_tcpSession->sendQueueLength() > 0 )
+        {
+            m_tcpSession->asyncWait( RETRY_DELAY_MS, [this, shared=shared_from_this()] { if ( !m_isStopped ) finish(); } );
+            return;
+        }
+        stop();
+    }
+
+    // loadNextEntries - returns false, if there are no new entries
+    bool loadNextEntries()
+    {
+        // segments are numbered consecutively and a segment is completed (flushed and closed),
+        // before the next one is created; so the check is done before reading the index,
+        // and the last entries of the current segment are read by this 'readIndex()'
+        bool isSegmentCompleted = isNextSegmentCreated();
+
+        if ( readIndex() )
+            return true;
+
+        if ( !isSegmentCompleted )
+            return false;
+
+        openSegment( m_segmentNumber+1 );
+        return readIndex();
+    }
+
+    // isNextSegmentCreated - checks only the file name of the next segment (the directory is not scanned)
+    bool isNextSegmentCreated()
+    {
+        // (the index file is created after the segment file)
+        std::string indexName = segmentFileName( m_directory, m_segmentNumber+1, ".idx" );
+        return ::access( indexName.c_str(), F_OK ) == 0;
+    }
+
+    // readIndex - reads entries, that are added to index file
+    bool readIndex()
+    {
+        struct stat st;
+        if ( ::fstat( m_index->fd(), &st ) != 0 )
+            throw std::runtime_error( std::string("index fstat error: ") + strerror(errno) );
+
+        size_t number = ( uint64_t(st.st_size) - m_indexReadOffset ) / sizeof(RecordIndexEntry);
+        if ( number == 0 )
+            return false;
+
+        m_entries.erase( m_entries.begin(), m_entries.begin() + m_nextEntry );
+        m_nextEntry = 0;
+
+        size_t oldSize = m_entries.size();
+        m_entries.resize( oldSize + number );
+
+        size_t size = number * sizeof(RecordIndexEntry);
+        ssize_t readSize = ::pread( m_index->fd(), m_entries.data() + oldSize, size, off_t( m_indexReadOffset ) );
+        if ( readSize != ssize_t(size) )
+            throw std::runtime_error( "index read error" );
+
+        m_indexReadOffset += size;
+        return true;
+    }
+
+    void openSegment( uint64_t segmentNumber )
+    {
+        std::string segmentName = segmentFileName( m_directory, segmentNumber, ".seg" );
+        int fd = ::open( segmentName.c_str(), O_RDONLY );
+        if ( fd < 0 )
+            throw std::runtime_error( "cannot open " + segmentName + ": " + strerror(errno) );
+        auto segment = std::make_shared<FileDescriptor>( fd );
+
+        std::string indexName = segmentFileName( m_directory, segmentNumber, ".idx" );
+        fd = ::open( indexName.c_str(), O_RDONLY );
+        if ( fd < 0 )
+            throw std::runtime_error( "cannot open " + indexName + ": " + strerror(errno) );
+
+        // playback reads segment sequentially
+        ::posix_fadvise( segment->fd(), 0, 0, POSIX_FADV_SEQUENTIAL );
+
+        m_segmentNumber   = segmentNumber;
+        m_segment         = segment;
+        m_index           = std::make_shared<FileDescriptor>( fd );
+        m_indexReadOffset = 0;
+        m_readaheadEnd    = 0;
+        m_entries.clear();
+        m_nextEntry       = 0;
+    }
+
+    // readahead - asks kernel to read the segment ahead of playback
+    void readahead( uint64_t sendEnd )
+    {
+        if ( sendEnd + m_config.m_fileViewingReadaheadBytes/2 <= m_readaheadEnd )
+            return;
+
+        uint64_t end = sendEnd + m_config.m_fileViewingReadaheadBytes;
+        uint64_t begin = std::max( m_readaheadEnd, sendEnd );
+        ::posix_fadvise( m_segment->fd(), off_t( begin ), off_t( end - begin ), POSIX_FADV_WILLNEED );
+        m_readaheadEnd = end;
+    }
+
+    // nextSegmentNumber - returns the least segment number greater than 'segmentNumber' (or 0);
+    // it scans the directory, so it is used only to start playback
+    uint64_t nextSegmentNumber( uint64_t segmentNumber )
+    {
+        uint64_t next = 0;
+
+        std::error_code ec;
+        for( auto& entry : std::filesystem::directory_iterator( m_directory, ec ) )
+        {
+            if ( entry.path().extension() == ".seg" )
+            {
+                uint64_t number = std::strtoull( entry.path().stem().c_str(), nullptr, 10 );
+                if ( number > segmentNumber && ( next == 0 || number < next ) )
+                    next = number;
+            }
+        }
+        return next;
+    }
+};
+
+std::shared_ptr<IFileViewer> createFileViewer( std::shared_ptr<IAsyncTcpSession> tcpSession,
+                                               const StreamId& streamId,
+                                               const DistributorConfig& config,
+                                               SwitchToLiveHandler switchToLiveHandler )
+{
+    return std::make_shared<FileViewer>( tcpSession, streamId, config, switchToLiveHandler );
+}
+
+}} // namespace catapult { namespace streaming
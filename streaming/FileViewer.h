@@ -0,0 +1,56 @@
+#pragma once
+#include <functional>
+
+#include "StreamManager.h"
+
+namespace catapult {
+
+namespace net { class IAsyncTcpSession; }
+
+namespace streaming {
+
+    //
+    // Start position of viewing
+    //
+    // START_LIFE_STREAM_VIEWING:  { version, START_LIFE_STREAM_VIEWING, streamId [, startMode, startValue] }
+    // START_FILE_STREAM_VIEWING:  { version, START_FILE_STREAM_VIEWING, streamId [, startMode, startValue] }
+    //
+    // Viewing starts from the last key frame before the start time (it is found by KeyFrameIndex.h).
+    // Live viewing with a start time (time-shift) is served from recording, until the viewer
+    // catches up with the stream; then it is switched to live fan-out.
+    //
+    enum ViewingStartMode
+    {
+        DEFAULT_START   = 0,    // live edge (START_LIFE_STREAM_VIEWING) or the beginning of recording (START_FILE_STREAM_VIEWING)
+        AT_TIME         = 1,    // startValue - seconds since epoch
+        BEHIND_LIVE     = 2,    // startValue - seconds before the current time
+    };
+
+    // viewingStartTimeMs - returns milliseconds since epoch (or 0 for DEFAULT_START)
+    uint64_t viewingStartTimeMs( uint32_t startMode, uint32_t startValue );
+
+    // SwitchToLiveHandler - adds viewer to live fan-out after the frame (lastSeq, lastTimestampMs);
+    // returns false, if the stream has no such frame in its ResumeRing
+    typedef std::function<bool( uint32_t lastSeq, uint64_t lastTimestampMs )> SwitchToLiveHandler;
+
+    //
+    // IFileViewer - sends recording of a stream (see Recorder.h) to a viewer
+    //
+    // STREAMING_DATA packets are sent from segment files by 'sendfile'
+    // and are paced by their timestamps.
+    //
+    class IFileViewer
+    {
+    public:
+        virtual ~IFileViewer() = default;
+
+        // start - 'startTimeMs' is milliseconds since epoch (0 - the beginning of recording)
+        virtual void start( uint64_t startTimeMs = 0 ) = 0;
+    };
+
+    std::shared_ptr<IFileViewer> createFileViewer( std::shared_ptr<net::IAsyncTcpSession> tcpSession,
+                                                   const StreamId& streamId,
+                                                   const DistributorConfig& config,
+                                                   SwitchToLiveHandler switchToLiveHandler = {} );
+
+}} // namespace catapult { namespace streaming
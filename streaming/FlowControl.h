@@ -0,0 +1,112 @@
+#pragma once
+#include <stdint.h>
+
+namespace catapult {
+namespace streaming {
+
+    //
+    // Ingest flow control (negotiated by START_STREAMING)
+    //
+    // START_STREAMING:        { version, START_STREAMING, streamId [, flowControl] }
+    // OK_STREAMING_RESPONSE:  { version, OK_STREAMING_RESPONSE [, flowControl, windowFrames, windowBytes] }
+    // STREAMING_ACK:          { version, STREAMING_ACK, ackedFrames, ackedBytes }
+    //
+    // In CREDIT_WINDOW mode server does not answer each STREAMING_DATA packet;
+    // a streamer could send packets while the number of not acknowledged frames (and bytes)
+    // is less than the granted window. Server periodically sends cumulative STREAMING_ACK.
+    // Counters are uint32 and wrap around, so only their differences are meaningful.
+    //
+    enum FlowControl
+    {
+        ONE_RESPONSE_PER_FRAME  = 0,    // OK_STREAMING_RESPONSE for each STREAMING_DATA (default)
+        CREDIT_WINDOW           = 1,
+    };
+
+    //
+    // IngestCreditWindow - streamer side accounting of credits, granted by server
+    //
+    class IngestCreditWindow
+    {
+        uint32_t m_windowFrames = 0;
+        uint32_t m_windowBytes  = 0;
+
+        uint32_t m_sentFrames   = 0;
+        uint32_t m_sentBytes    = 0;
+        uint32_t m_ackedFrames  = 0;
+        uint32_t m_ackedBytes   = 0;
+
+    public:
+        IngestCreditWindow() {}
+
+        void init( uint32_t windowFrames, uint32_t windowBytes )
+        {
+            m_windowFrames = windowFrames;
+            m_windowBytes  = windowBytes;
+        }
+
+        uint32_t framesInFlight() const { return m_sentFrames - m_ackedFrames; }
+        uint32_t bytesInFlight()  const { return m_sentBytes  - m_ackedBytes; }
+
+        // canSend - a packet bigger than the whole window could be sent only when nothing is in flight
+        bool canSend( uint32_t packetLenght ) const
+        {
+            if ( framesInFlight() >= m_windowFrames )
+                return false;
+
+            return framesInFlight() == 0 || bytesInFlight() + packetLenght <= m_windowBytes;
+        }
+
+        void onSent( uint32_t packetLenght )
+        {
+            m_sentFrames++;
+            m_sentBytes += packetLenght;
+        }
+
+        void onAck( uint32_t ackedFrames, uint32_t ackedBytes )
+        {
+            m_ackedFrames = ackedFrames;
+            m_ackedBytes  = ackedBytes;
+        }
+    };
+
+    //
+    // IngestAckCounter - server side counter of received frames
+    //
+    class IngestAckCounter
+    {
+        uint32_t m_windowFrames;
+        uint32_t m_windowBytes;
+
+        uint32_t m_receivedFrames = 0;
+        uint32_t m_receivedBytes  = 0;
+        uint32_t m_ackedFrames    = 0;
+        uint32_t m_ackedBytes     = 0;
+
+    public:
+        IngestAckCounter( uint32_t windowFrames, uint32_t windowBytes )
+            : m_windowFrames( windowFrames ), m_windowBytes( windowBytes )
+        {}
+
+        uint32_t windowFrames()   const { return m_windowFrames; }
+        uint32_t windowBytes()    const { return m_windowBytes; }
+        uint32_t receivedFrames() const { return m_receivedFrames; }
+        uint32_t receivedBytes()  const { return m_receivedBytes; }
+
+        // onReceived - returns true, when it is time to send STREAMING_ACK
+        // (a quarter of the window is received since the last one)
+        bool onReceived( uint32_t packetLenght )
+        {
+            m_receivedFrames++;
+            m_receivedBytes += packetLenght;
+
+            if ( m_receivedFrames - m_ackedFrames >= (m_windowFrames+3)/4 || m_receivedBytes - m_ackedBytes >= m_windowBytes/4 )
+            {
+                m_ackedFrames = m_receivedFrames;
+                m_ackedBytes  = m_receivedBytes;
+                return true;
+            }
+            return false;
+        }
+    };
+
+}} // namespace catapult { namespace streaming
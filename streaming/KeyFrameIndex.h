@@ -0,0 +1,116 @@
+#pragma once
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+
+#include "Streaming.h"
+
+namespace catapult {
+namespace streaming {
+
+    //
+    // Key frame index of a recording: <recordingDirectory>/keyframes.idx
+    //
+    // It is appended by recorder (when a key frame is written to segment),
+    // so entries are ordered by time and could be searched without reading of segments.
+    //
+    struct KeyFrameIndexEntry
+    {
+        uint64_t    m_timestampMs;      // arrival time (milliseconds since epoch)
+        uint64_t    m_segmentNumber;
+        uint64_t    m_offset;           // offset of packet in segment
+        uint32_t    m_seq;              // sequence number of STREAMING_DATA packet
+        uint32_t    m_entryNumber;      // number of RecordIndexEntry in segment index
+    };
+    static_assert( sizeof(KeyFrameIndexEntry) == 32 );
+
+    inline std::string keyFrameIndexFileName( const std::string& recordingDirectory )
+    {
+        return recordingDirectory + "/keyframes.idx";
+    }
+
+    //
+    // KeyFrameIndex - memory-mapped key frame index (it is remapped when the file grows)
+    //
+    class KeyFrameIndex
+    {
+        int                         m_fd = -1;
+        void*                       m_map = MAP_FAILED;
+        size_t                      m_mapSize = 0;
+
+    public:
+        KeyFrameIndex() {}
+
+        KeyFrameIndex( const KeyFrameIndex& ) = delete;
+        KeyFrameIndex& operator=( const KeyFrameIndex& ) = delete;
+
+        ~KeyFrameIndex()
+        {
+            unmap();
+            if ( m_fd >= 0 )
+                ::close( m_fd );
+        }
+
+        // open - returns false, if there is no index
+        bool open( const std::string& recordingDirectory )
+        {
+            m_fd = ::open( keyFrameIndexFileName( recordingDirectory ).c_str(), O_RDONLY );
+            return m_fd >= 0 && refresh();
+        }
+
+        // refresh - maps entries, that were added since the last call
+        bool refresh()
+        {
+            struct stat st;
+            if ( ::fstat( m_fd, &st ) != 0 )
+                return false;
+
+            size_t size = size_t(st.st_size) - size_t(st.st_size) % sizeof(KeyFrameIndexEntry);
+            if ( size == m_mapSize )
+                return true;
+
+            unmap();
+            if ( size == 0 )
+                return true;
+
+            m_map = ::mmap( nullptr, size, PROT_READ, MAP_SHARED, m_fd, 0 );
+            if ( m_map == MAP_FAILED )
+                return false;
+
+            m_mapSize = size;
+            return true;
+        }
+
+        size_t                      size()  const { return m_mapSize / sizeof(KeyFrameIndexEntry); }
+        const KeyFrameIndexEntry*   begin() const { return (const KeyFrameIndexEntry*) m_map; }
+        const KeyFrameIndexEntry*   end()   const { return begin() + size(); }
+
+        // find - returns the last key frame not later than 'timestampMs'
+        // (or the first key frame, if all key frames are later); returns nullptr if index is empty
+        const KeyFrameIndexEntry* find( uint64_t timestampMs ) const
+        {
+            if ( size() == 0 )
+                return nullptr;
+
+            auto it = std::upper_bound( begin(), end(), timestampMs, []( uint64_t timestampMs, const KeyFrameIndexEntry& entry )
+            {
+                return timestampMs < entry.m_timestampMs;
+            });
+            return it == begin() ? begin() : it-1;
+        }
+
+    private:
+        void unmap()
+        {
+            if ( m_map != MAP_FAILED )
+                ::munmap( m_map, m_mapSize );
+            m_map = MAP_FAILED;
+            m_mapSize = 0;
+        }
+    };
+
+}} // namespace catapult { namespace streaming
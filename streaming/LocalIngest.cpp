@@ -0,0 +1,413 @@
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "LocalIngest.h"
+#include "PacketSchema.h"
+
+namespace catapult {
+namespace streaming {
+
+using namespace catapult::net;
+
+enum
+{
+    MAX_CONTROL_PACKET_LENGHT   = 64*1024,
+    HANDSHAKE_TIMEOUT_SECONDS   = 5,
+};
+
+//
+// LocalIngestSession - serves a local streamer by its own thread (one thread per local streamer)
+//
+// The thread receives START_STREAMING (so a silent streamer does not block other ones)
+// and then reads the ring. It holds the session until it ends, so handlers are called only by the thread
+// (and the session could be released by them). The server joins threads of all sessions, when it is stopped.
+//
+class LocalIngestSession : public ILocalIngestSession, public std::enable_shared_from_this<LocalIngestSession>
+{
+    int                 m_socket;
+    int                 m_dataEventFd  = -1;
+    int                 m_spaceEventFd = -1;
+    LocalIngestRing     m_ring;
+
+    TpktBufferPoolPtr   m_bufferPool;
+
+    // they are set by 'start()' (it is called by NewSessionHandler on the thread of session)
+    FrameHandler        m_frameHandler;
+    EndHandler          m_endHandler;
+
+    std::atomic<bool>   m_isStopped{false};
+    std::thread         m_thread;
+
+public:
+    LocalIngestSession( int socket ) : m_socket( socket ) {}
+
+    ~LocalIngestSession()
+    {
+        // (the last reference could be released by the thread itself)
+        if ( m_thread.joinable() )
+            m_thread.detach();
+
+        ::close( m_socket );
+        if ( m_dataEventFd >= 0 )
+            ::close( m_dataEventFd );
+        if ( m_spaceEventFd >= 0 )
+            ::close( m_spaceEventFd );
+    }
+
+    // accept - starts the thread of session; 'newSessionHandler' is called by it after START_STREAMING
+    void accept( ILocalIngestServer::NewSessionHandler newSessionHandler )
+    {
+        m_thread = std::thread( [self=shared_from_this(), newSessionHandler=std::move(newSessionHandler)]
+        {
+            StreamId streamId;
+            if ( !self->receiveStartStreaming( streamId ) || self->m_isStopped )
+                return;
+
+            newSessionHandler( streamId, self );
+
+            // (the streamer could be rejected by the handler)
+            if ( self->m_frameHandler )
+            {
+                self->run( self->m_frameHandler, self->m_endHandler );
+            }
+        });
+    }
+
+    void setBufferPool( TpktBufferPoolPtr bufferPool ) override
+    {
+        m_bufferPool = bufferPool;
+    }
+
+    void start( FrameHandler frameHandler, EndHandler endHandler ) override
+    {
+        m_frameHandler = std::move(frameHandler);
+        m_endHandler   = std::move(endHandler);
+    }
+
+    bool sendResponse( const Tpkt& response ) override
+    {
+        return sendLocalPacket( m_socket, response.ptr(), response.lenght() );
+    }
+
+    // stop - the thread is woken by shutdown of the socket (it could wait for the handshake or for the ring)
+    void stop() override
+    {
+        m_isStopped = true;
+        shutdown( m_socket, SHUT_RDWR );
+    }
+
+    // join - waits for the end of thread (it must be stopped)
+    void join()
+    {
+        if ( m_thread.joinable() && m_thread.get_id() != std::this_thread::get_id() )
+            m_thread.join();
+    }
+
+private:
+    // receiveStartStreaming - receives START_STREAMING with the ring (an error is sent to the streamer)
+    bool receiveStartStreaming( StreamId& streamId )
+    {
+        // the thread does not wait for a silent streamer
+        timeval timeout{ HANDSHAKE_TIMEOUT_SECONDS, 0 };
+        setsockopt( m_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout) );
+
+        int fds[3];
+        int fdNumber = 0;
+        StreamingTpktRcv request;
+        bool isReceived = receiveLocalPacket( m_socket, request, MAX_CONTROL_PACKET_LENGHT, fds, 3, &fdNumber );
+
+        if ( !isReceived || fdNumber != 3 )
+        {
+            if ( !m_isStopped )
+            {
+                LOG_WARN( "local ingest: invalid handshake: " << ( isReceived ? "file descriptors are not received" : strerror( errno ) ) << std::endl );
+            }
+            for( int i = 0; i < fdNumber; i++ )
+            {
+                ::close( fds[i] );
+            }
+            return false;
+        }
+
+        timeval noTimeout{ 0, 0 };
+        setsockopt( m_socket, SOL_SOCKET, SO_RCVTIMEO, &noTimeout, sizeof(noTimeout) );
+
+        // (eventfds are owned by the session, memfd is owned by the ring)
+        m_dataEventFd  = fds[1];
+        m_spaceEventFd = fds[2];
+
+        try
+        {
+            std::string errorText;
+            if ( !m_ring.attach( fds[0], errorText ) )
+                throw std::runtime_error( errorText );
+
+            uint32_t version, requestId;
+            request.read( version, requestId );
+            if ( version != PROTOCOL_VERSION || requestId != cmd::START_STREAMING )
+                throw std::runtime_error( "START_STREAMING is expected" );
+
+            uint32_t flowControl = 0;
+            StartStreamingRequest::decode( request, streamId, flowControl );
+            return true;
+        }
+        catch ( std::runtime_error& error )
+        {
+            LOG_WARN( "local ingest: " << error.what() << std::endl );
+            sendResponse( ErrorStreamingResponse::encode( error.what() ) );
+            return false;
+        }
+    }
+
+    void run( const FrameHandler& frameHandler, const EndHandler& endHandler )
+    {
+        LocalIngestRingHeader& header = m_ring.header();
+
+        for(;;)
+        {
+            std::string errorText;
+            if ( !readFrames( frameHandler, errorText ) )
+            {
+                endHandler( errorText );
+                return;
+            }
+
+            if ( m_isStopped )
+                return;
+
+            // the streamer writes the doorbell after this flag is set
+            header.m_isConsumerWaiting = 1;
+            if ( header.m_writePosition != header.m_readPosition.load( std::memory_order_relaxed ) )
+                continue;
+
+            pollfd fds[2] = { { m_dataEventFd, POLLIN, 0 }, { m_socket, POLLIN, 0 } };
+            if ( poll( fds, 2, -1 ) < 0 )
+            {
+                if ( errno == EINTR )
+                    continue;
+                endHandler( std::string( "poll: " ) + strerror( errno ) );
+                return;
+            }
+
+            if ( fds[0].revents & POLLIN )
+            {
+                eventfd_t value;
+                eventfd_read( m_dataEventFd, &value );
+            }
+
+            if ( fds[1].revents != 0 )
+            {
+                // frames, that were written before the control packet, are handled before it
+                if ( !readFrames( frameHandler, errorText ) )
+                {
+                    endHandler( errorText );
+                    return;
+                }
+
+                if ( !m_isStopped && !handleControlPacket( endHandler ) )
+                    return;
+            }
+        }
+    }
+
+    // readFrames - handles all published frames; returns false, if the ring is invalid
+    bool readFrames( const FrameHandler& frameHandler, std::string& errorText )
+    {
+        LocalIngestRingHeader& header = m_ring.header();
+
+        uint64_t readPosition  = header.m_readPosition.load( std::memory_order_relaxed );
+        uint64_t writePosition = header.m_writePosition.load( std::memory_order_acquire );
+
+        while( readPosition != writePosition && !m_isStopped )
+        {
+            // { packetLenght, version, STREAMING_DATA, frameFlags, ... }
+            uint8_t packetHeader[16];
+            uint64_t available = writePosition - readPosition;
+            if ( available < sizeof(packetHeader) || available > m_ring.capacity() )
+            {
+                errorText = "invalid ingest ring position";
+                return false;
+            }
+            m_ring.read( readPosition, packetHeader, sizeof(packetHeader) );
+
+            uint32_t packetLenght = loadUint32LE( packetHeader );
+            if ( packetLenght < sizeof(packetHeader) || packetLenght > available
+                    || loadUint32LE( packetHeader+4 ) != PROTOCOL_VERSION || loadUint32LE( packetHeader+8 ) != cmd::STREAMING_DATA )
+            {
+                errorText = "invalid packet in ingest ring";
+                return false;
+            }
+
+            TpktBufferPtr packet = acquireTpktBuffer( m_bufferPool, packetLenght );
+            packet->setLenght( packetLenght );
+            m_ring.read( readPosition, packet->data(), packetLenght );
+
+            readPosition += packetLenght;
+            header.m_readPosition.store( readPosition, std::memory_order_release );
+            ringDoorbell( header.m_isProducerWaiting, m_spaceEventFd );
+
+            // (frame flags are taken from the copy, they could be changed in the ring)
+            frameHandler( packet, loadUint32LE( packet->data()+12 ) );
+
+            if ( readPosition == writePosition )
+            {
+                writePosition = header.m_writePosition.load( std::memory_order_acquire );
+            }
+        }
+        return true;
+    }
+
+    // handleControlPacket - returns false, if the session is ended
+    bool handleControlPacket( const EndHandler& endHandler )
+    {
+        StreamingTpktRcv request;
+        if ( !receiveLocalPacket( m_socket, request, MAX_CONTROL_PACKET_LENGHT ) )
+        {
+            endHandler( errno == 0 ? "local streamer connection is closed" : std::string( "local streamer connection: " ) + strerror( errno ) );
+            return false;
+        }
+
+        uint32_t version = 0, requestId = 0;
+        if ( !request.TpktRcv::read( version, requestId ) || requestId != cmd::END_STREAMING )
+        {
+            LOG_WARN( "local ingest: unexpected request: " << cmd::name( requestId ) << std::endl );
+            return true;
+        }
+
+        endHandler( "" );
+        return false;
+    }
+};
+
+//
+// LocalIngestServer - accepts local streamers by its own thread
+//
+class LocalIngestServer : public ILocalIngestServer
+{
+    NewSessionHandler   m_newSessionHandler;
+
+    int                 m_listenSocket = -1;
+    std::thread         m_thread;
+
+    // (sessions are released by their threads)
+    std::mutex                                      m_sessionsMutex;
+    std::vector<std::weak_ptr<LocalIngestSession>>  m_sessions;
+
+public:
+    LocalIngestServer( NewSessionHandler newSessionHandler ) : m_newSessionHandler( newSessionHandler ) {}
+
+    ~LocalIngestServer()
+    {
+        stop();
+    }
+
+    bool start( uint32_t port, std::string& errorText ) override
+    {
+        sockaddr_un address;
+        socklen_t addressLenght = localIngestAddress( port, address );
+
+        m_listenSocket = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+        if ( m_listenSocket < 0 || bind( m_listenSocket, (sockaddr*) &address, addressLenght ) != 0 || listen( m_listenSocket, 64 ) != 0 )
+        {
+            errorText = std::string( "local ingest socket: " ) + strerror( errno );
+            if ( m_listenSocket >= 0 )
+            {
+                ::close( m_listenSocket );
+                m_listenSocket = -1;
+            }
+            return false;
+        }
+
+        m_thread = std::thread( [this] { acceptLoop(); } );
+        return true;
+    }
+
+    void stop() override
+    {
+        if ( m_listenSocket < 0 )
+            return;
+
+        // accept() is interrupted by shutdown
+        shutdown( m_listenSocket, SHUT_RDWR );
+        if ( m_thread.joinable() )
+            m_thread.join();
+
+        ::close( m_listenSocket );
+        m_listenSocket = -1;
+
+        // handlers are not called after the return
+        std::vector<std::shared_ptr<LocalIngestSession>> sessions;
+        {
+            const std::lock_guard<std::mutex> autolock( m_sessionsMutex );
+            for( auto& weakSession : m_sessions )
+            {
+                if ( auto session = weakSession.lock(); session )
+                    sessions.push_back( session );
+            }
+            m_sessions.clear();
+        }
+
+        for( auto& session : sessions )
+        {
+            session->stop();
+        }
+        for( auto& session : sessions )
+        {
+            session->join();
+        }
+    }
+
+private:
+    void acceptLoop()
+    {
+        for(;;)
+        {
+            int socket = accept4( m_listenSocket, nullptr, nullptr, SOCK_CLOEXEC );
+            if ( socket < 0 )
+            {
+                if ( errno == EINTR || errno == ECONNABORTED )
+                    continue;
+                return;
+            }
+
+            handleConnection( socket );
+        }
+    }
+
+    // handleConnection - the socket is owned by the session or is closed
+    void handleConnection( int socket )
+    {
+        // abstract sockets are not protected by file permissions
+        ucred credentials;
+        socklen_t credentialsLenght = sizeof(credentials);
+        if ( getsockopt( socket, SOL_SOCKET, SO_PEERCRED, &credentials, &credentialsLenght ) != 0 || credentials.uid != getuid() )
+        {
+            LOG_WARN( "local ingest: streamer of another user is rejected" << std::endl );
+            ::close( socket );
+            return;
+        }
+
+        auto session = std::make_shared<LocalIngestSession>( socket );
+        {
+            const std::lock_guard<std::mutex> autolock( m_sessionsMutex );
+            m_sessions.erase( std::remove_if( m_sessions.begin(), m_sessions.end(), []( const auto& weakSession ) { return weakSession.expired(); } ),
+                              m_sessions.end() );
+            m_sessions.push_back( session );
+        }
+        session->accept( m_newSessionHandler );
+    }
+};
+
+std::shared_ptr<ILocalIngestServer> createLocalIngestServer( ILocalIngestServer::NewSessionHandler newSessionHandler )
+{
+    return std::make_shared<LocalIngestServer>( newSessionHandler );
+}
+
+}} // namespace catapult { namespace streaming
@@ -0,0 +1,401 @@
+#pragma once
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "StreamingTpkt.h"
+#include "TpktBuffer.h"
+
+namespace catapult {
+namespace streaming {
+
+    //
+    // Local (shared-memory) ingest of co-located streamers
+    //
+    // The server (if 'DistributorConfig::m_isLocalIngestEnabled' is set) listens on the abstract unix socket
+    // "catapult.streaming.<port>". A streamer (see 'createLocalStreamingClient()') creates a ring in memfd
+    // and two eventfds and sends them with START_STREAMING (as SCM_RIGHTS):
+    //
+    // START_STREAMING:        { version, START_STREAMING, streamId }   + { memfd, dataEventFd, spaceEventFd }
+    // OK_STREAMING_RESPONSE:  { version, OK_STREAMING_RESPONSE }
+    // END_STREAMING:          { version, END_STREAMING, streamId }
+    //
+    // Control packets are sent by the unix socket. STREAMING_DATA packets are written into the ring as they are
+    // and they are not answered: the free space of the ring is the flow control.
+    // An eventfd is written only if its peer waits, so the ring has no syscalls per frame, while it is not empty.
+    // The server copies a frame once (from the ring to a buffer of the stream, see 'LiveStream::startLocalSession()').
+    // The stream is ended by END_STREAMING or by the close of unix socket (it is not restored).
+    //
+
+    // localIngestSocketName - abstract socket name of server, that is listening on 'port'
+    inline std::string localIngestSocketName( uint32_t port )
+    {
+        return "catapult.streaming." + std::to_string( port );
+    }
+
+    // localIngestAddress - returns address lenght
+    inline socklen_t localIngestAddress( uint32_t port, sockaddr_un& address )
+    {
+        std::string name = localIngestSocketName( port );
+
+        memset( &address, 0, sizeof(address) );
+        address.sun_family = AF_UNIX;
+        memcpy( address.sun_path+1, name.c_str(), name.size() );     // (sun_path[0] is 0 for abstract socket)
+
+        return socklen_t( offsetof( sockaddr_un, sun_path ) + 1 + name.size() );
+    }
+
+    //
+    // LocalIngestRingHeader - the beginning of memfd; it is followed by 'm_capacity' bytes of data
+    //
+    // Positions are not wrapped (offset in data is 'position & (capacity-1)').
+    // Each side sets its 'isWaiting' flag and checks the ring again before waiting for its eventfd;
+    // the other side writes the eventfd only if the flag is set.
+    //
+    struct LocalIngestRingHeader
+    {
+        enum : uint32_t { MAGIC = 0x52494e47 };
+
+        uint32_t                            m_magic;
+        uint32_t                            m_capacity;             // (power of 2)
+
+        // (it is changed by streamer)
+        alignas(64) std::atomic<uint64_t>   m_writePosition;
+        std::atomic<uint32_t>               m_isConsumerWaiting;
+
+        // (it is changed by server)
+        alignas(64) std::atomic<uint64_t>   m_readPosition;
+        std::atomic<uint32_t>               m_isProducerWaiting;
+    };
+
+    static_assert( std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+                   "atomics of shared memory must be lock free" );
+
+    // ringDoorbell - wakes the peer, if it waits
+    inline void ringDoorbell( std::atomic<uint32_t>& isWaiting, int eventFd )
+    {
+        if ( isWaiting.exchange( 0 ) )
+        {
+            eventfd_write( eventFd, 1 );
+        }
+    }
+
+    //
+    // LocalIngestRing - single-producer single-consumer ring of STREAMING_DATA packets in shared memory
+    //
+    class LocalIngestRing
+    {
+        int                     m_memFd = -1;
+        void*                   m_memory = MAP_FAILED;
+        size_t                  m_memorySize = 0;
+
+        LocalIngestRingHeader*  m_header = nullptr;
+        uint8_t*                m_data = nullptr;
+        uint64_t                m_mask = 0;
+
+    public:
+        LocalIngestRing() {}
+
+        LocalIngestRing( const LocalIngestRing& ) = delete;
+        LocalIngestRing& operator=( const LocalIngestRing& ) = delete;
+
+        ~LocalIngestRing()
+        {
+            if ( m_memory != MAP_FAILED )
+                munmap( m_memory, m_memorySize );
+            if ( m_memFd >= 0 )
+                ::close( m_memFd );
+        }
+
+        // create - creates ring in memfd (by streamer); 'capacity' is rounded up to power of 2
+        bool create( uint32_t capacity, std::string& errorText )
+        {
+            uint32_t roundedCapacity = 4096;
+            while( roundedCapacity < capacity )
+            {
+                roundedCapacity *= 2;
+            }
+
+            // the size is sealed, so the server could not get SIGBUS
+            m_memFd = memfd_create( "catapult-ingest", MFD_CLOEXEC | MFD_ALLOW_SEALING );
+            if ( m_memFd < 0 || ftruncate( m_memFd, off_t( sizeof(LocalIngestRingHeader) + roundedCapacity ) ) != 0
+                    || fcntl( m_memFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL ) != 0 )
+            {
+                errorText = std::string( "memfd: " ) + strerror( errno );
+                return false;
+            }
+
+            if ( !map( errorText ) )
+                return false;
+
+            // (new memfd is filled by zeros)
+            m_header->m_magic    = LocalIngestRingHeader::MAGIC;
+            m_header->m_capacity = roundedCapacity;
+            m_mask = roundedCapacity-1;
+            return true;
+        }
+
+        // attach - maps ring of streamer (by server); 'memFd' is owned by the ring
+        bool attach( int memFd, std::string& errorText )
+        {
+            m_memFd = memFd;
+            int seals = fcntl( m_memFd, F_GET_SEALS );
+            if ( seals < 0 || ( seals & F_SEAL_SHRINK ) == 0 )
+            {
+                errorText = "ingest ring is not sealed";
+                return false;
+            }
+
+            if ( !map( errorText ) )
+                return false;
+
+            uint64_t capacity = m_header->m_capacity;
+            if ( m_header->m_magic != LocalIngestRingHeader::MAGIC || capacity == 0 || ( capacity & (capacity-1) ) != 0
+                    || sizeof(LocalIngestRingHeader) + capacity > m_memorySize )
+            {
+                errorText = "invalid ingest ring";
+                return false;
+            }
+            m_mask = capacity-1;
+            return true;
+        }
+
+        int                     memFd()     const { return m_memFd; }
+        LocalIngestRingHeader&  header()          { return *m_header; }
+        uint64_t                capacity()  const { return m_mask+1; }
+
+        // write - copies bytes at 'position' (they are published by 'm_writePosition')
+        void write( uint64_t position, const uint8_t* bytes, size_t size )
+        {
+            size_t offset = size_t( position & m_mask );
+            size_t firstPart = std::min( size, size_t( capacity() - offset ) );
+
+            memcpy( m_data + offset, bytes, firstPart );
+            memcpy( m_data, bytes + firstPart, size - firstPart );
+        }
+
+        // read - copies bytes from 'position'
+        void read( uint64_t position, uint8_t* bytes, size_t size ) const
+        {
+            size_t offset = size_t( position & m_mask );
+            size_t firstPart = std::min( size, size_t( capacity() - offset ) );
+
+            memcpy( bytes, m_data + offset, firstPart );
+            memcpy( bytes + firstPart, m_data, size - firstPart );
+        }
+
+    private:
+        bool map( std::string& errorText )
+        {
+            struct stat fileStat;
+            if ( fstat( m_memFd, &fileStat ) != 0 || size_t( fileStat.st_size ) <= sizeof(LocalIngestRingHeader) )
+            {
+                errorText = "invalid ingest ring size";
+                return false;
+            }
+
+            m_memorySize = size_t( fileStat.st_size );
+            m_memory = mmap( nullptr, m_memorySize, PROT_READ | PROT_WRITE, MAP_SHARED, m_memFd, 0 );
+            if ( m_memory == MAP_FAILED )
+            {
+                errorText = std::string( "ingest ring mmap: " ) + strerror( errno );
+                return false;
+            }
+
+            m_header = static_cast<LocalIngestRingHeader*>( m_memory );
+            m_data   = static_cast<uint8_t*>( m_memory ) + sizeof(LocalIngestRingHeader);
+            return true;
+        }
+    };
+
+    //
+    // Control packets of unix socket
+    //
+
+    // sendLocalPacket - sends packet with file descriptors (if 'fdNumber' > 0)
+    inline bool sendLocalPacket( int socket, const uint8_t* data, size_t size, const int* fds = nullptr, int fdNumber = 0 )
+    {
+        union
+        {
+            cmsghdr m_header;
+            char    m_bytes[CMSG_SPACE( 4*sizeof(int) )];
+        } control;
+
+        iovec  iov{ const_cast<uint8_t*>( data ), size };
+        msghdr message{};
+        message.msg_iov    = &iov;
+        message.msg_iovlen = 1;
+
+        if ( fdNumber > 0 )
+        {
+            message.msg_control    = control.m_bytes;
+            message.msg_controllen = CMSG_SPACE( fdNumber*sizeof(int) );
+
+            cmsghdr* header = CMSG_FIRSTHDR( &message );
+            header->cmsg_level = SOL_SOCKET;
+            header->cmsg_type  = SCM_RIGHTS;
+            header->cmsg_len   = CMSG_LEN( fdNumber*sizeof(int) );
+            memcpy( CMSG_DATA( header ), fds, fdNumber*sizeof(int) );
+        }
+
+        while( iov.iov_len > 0 )
+        {
+            ssize_t sent = sendmsg( socket, &message, MSG_NOSIGNAL );
+            if ( sent < 0 )
+            {
+                if ( errno == EINTR )
+                    continue;
+                return false;
+            }
+
+            // file descriptors are sent with the first part
+            message.msg_control    = nullptr;
+            message.msg_controllen = 0;
+            iov.iov_base = static_cast<uint8_t*>( iov.iov_base ) + sent;
+            iov.iov_len -= size_t( sent );
+        }
+        return true;
+    }
+
+    //
+    // receiveLocalPacket - receives packet into 'packet' (see 'TpktRcv::prepareToRead()')
+    // and up to 'maxFdNumber' file descriptors (they are owned by caller);
+    // returns false on error or at the end of stream ('errno' is 0)
+    //
+    inline bool receiveLocalPacket( int socket, net::TpktRcv& packet, uint32_t maxPacketLenght, int* fds = nullptr, int maxFdNumber = 0, int* fdNumber = nullptr )
+    {
+        union
+        {
+            cmsghdr m_header;
+            char    m_bytes[CMSG_SPACE( 4*sizeof(int) )];
+        } control;
+
+        uint8_t lenght[4];
+        iovec   iov{ lenght, sizeof(lenght) };
+        msghdr  message{};
+        message.msg_iov        = &iov;
+        message.msg_iovlen     = 1;
+        message.msg_control    = control.m_bytes;
+        message.msg_controllen = sizeof(control.m_bytes);
+
+        ssize_t received;
+        do received = recvmsg( socket, &message, MSG_WAITALL | MSG_CMSG_CLOEXEC ); while( received < 0 && errno == EINTR );
+
+        if ( fdNumber )
+        {
+            *fdNumber = 0;
+        }
+        for( cmsghdr* header = CMSG_FIRSTHDR( &message ); header; header = CMSG_NXTHDR( &message, header ) )
+        {
+            if ( header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS )
+                continue;
+
+            int number = int( ( header->cmsg_len - CMSG_LEN(0) ) / sizeof(int) );
+            const int* received = reinterpret_cast<const int*>( CMSG_DATA( header ) );
+            for( int i = 0; i < number; i++ )
+            {
+                // (unexpected descriptors are closed)
+                if ( fdNumber && *fdNumber < maxFdNumber )
+                    fds[ (*fdNumber)++ ] = received[i];
+                else
+                    ::close( received[i] );
+            }
+        }
+
+        if ( received != ssize_t( sizeof(lenght) ) )
+        {
+            if ( received >= 0 )
+                errno = 0;
+            return false;
+        }
+
+        uint32_t packetLenght = net::loadUint32LE( lenght );
+        if ( packetLenght < 12 || packetLenght > maxPacketLenght )
+        {
+            errno = EMSGSIZE;
+            return false;
+        }
+
+        packet.prepareToRead( packetLenght );
+
+        uint8_t* ptr = packet.ptr() + 4;
+        size_t   rest = packetLenght - 4;
+        while( rest > 0 )
+        {
+            received = recv( socket, ptr, rest, MSG_WAITALL );
+            if ( received <= 0 )
+            {
+                if ( received < 0 && errno == EINTR )
+                    continue;
+                if ( received == 0 )
+                    errno = 0;
+                return false;
+            }
+            ptr  += received;
+            rest -= size_t( received );
+        }
+        return true;
+    }
+
+    //
+    // ILocalIngestSession - ingest of one stream by local streamer (it is created by ILocalIngestServer)
+    //
+    class ILocalIngestSession
+    {
+    public:
+        // FrameHandler - is called by the thread of session for each STREAMING_DATA packet
+        typedef std::function<void( const net::TpktBufferPtr& packet, uint32_t frameFlags )> FrameHandler;
+
+        // EndHandler - is called by the thread of session after END_STREAMING ('errorText' is empty) or after an error
+        typedef std::function<void( const std::string& errorText )> EndHandler;
+
+        virtual ~ILocalIngestSession() = default;
+
+        // setBufferPool - frames will be copied to buffers of 'bufferPool' (it must be called before 'start()')
+        virtual void setBufferPool( net::TpktBufferPoolPtr bufferPool ) = 0;
+
+        // start - sets handlers; the ring is read after the return of NewSessionHandler, that calls it
+        virtual void start( FrameHandler frameHandler, EndHandler endHandler ) = 0;
+
+        // sendResponse - writes control packet to the streamer (it is blocking, but control packets are small)
+        virtual bool sendResponse( const net::Tpkt& response ) = 0;
+
+        // stop - the thread of session is stopped without calling of handlers
+        virtual void stop() = 0;
+    };
+
+    //
+    // ILocalIngestServer - accepts local streamers (see the protocol above)
+    //
+    class ILocalIngestServer
+    {
+    public:
+        // NewSessionHandler - is called by the thread of session after START_STREAMING
+        // (the streamer is accepted, if the handler calls 'ILocalIngestSession::start()')
+        typedef std::function<void( StreamId& streamId, std::shared_ptr<ILocalIngestSession> session )> NewSessionHandler;
+
+        virtual ~ILocalIngestServer() = default;
+
+        // start - returns false, if the socket could not be listened
+        virtual bool start( uint32_t port, std::string& errorText ) = 0;
+
+        // stop - stops all sessions and waits for their threads (handlers are not called after it)
+        virtual void stop() = 0;
+    };
+
+    std::shared_ptr<ILocalIngestServer> createLocalIngestServer( ILocalIngestServer::NewSessionHandler newSessionHandler );
+
+}} // namespace catapult { namespace streaming
@@ -0,0 +1,69 @@
+#pragma once
+#include "StreamingTpkt.h"
+#include "GatherTpkt.h"
+
+namespace catapult {
+namespace streaming {
+
+    //
+    // Stream multiplexing - several streams over one connection
+    //
+    // START_MULTIPLEXING:         { version, START_MULTIPLEXING }  (the first request of a connection)
+    // OK_STREAMING_RESPONSE:      { version, OK_STREAMING_RESPONSE }
+    //
+    // Then channels are opened by requests of the connection (responses are sent in the order of requests):
+    // START_STREAMING:            { version, START_STREAMING, streamId }
+    // START_LIFE_STREAM_VIEWING:  { version, START_LIFE_STREAM_VIEWING, streamId }
+    // OK_STREAMING_RESPONSE:      { version, OK_STREAMING_RESPONSE, channelId }
+    // IS_NOT_STARTED_RESPONSE:    { version, IS_NOT_STARTED_RESPONSE, channelId }  (viewer channel is open)
+    // ERROR_STREAMING_RESPONSE:   { version, ERROR_STREAMING_RESPONSE, errorText }  (channel is not open)
+    //
+    // MUX_STREAMING_DATA:         { version, MUX_STREAMING_DATA, channelId, frameFlags, data ... }  (in both directions)
+    // END_STREAMING:              { version, END_STREAMING, channelId }  (channel is closed by either side)
+    //
+    // Channel id is the number of the stream on server (it is the same for all connections),
+    // so a frame is converted into MUX_STREAMING_DATA once for all multiplexed viewers
+    // (frame data is not copied by conversions in either direction).
+    // A slow viewer channel is closed by END_STREAMING (if SlowViewerPolicy::DISCONNECT is set),
+    // other channels of the connection are continued.
+    // A multiplexed streamer gets no response per frame (the connection is throttled by TCP);
+    // CREDIT_WINDOW, RESTORE_STREAMING and time-shift are not supported by multiplexed connections.
+    // All channels are closed with the connection.
+    //
+
+    enum { TPKT_HEADER_SIZE = 12 };     // { packetLenght, version, command }
+
+    inline uint32_t readUint32( const uint8_t* bytes )
+    {
+        return net::loadUint32LE( bytes );
+    }
+
+    inline void writeUint32( uint8_t* bytes, uint32_t value )
+    {
+        net::storeUint32LE( bytes, value );
+    }
+
+    // toMuxStreamingData - makes MUX_STREAMING_DATA of channel from STREAMING_DATA packet
+    // (only the header is built; { frameFlags, data ... } are referenced in the packet)
+    inline net::GatherTpktPtr toMuxStreamingData( const net::TpktBufferPtr& packet, uint32_t channelId )
+    {
+        auto muxPacket = std::make_shared<net::GatherTpkt>( PROTOCOL_VERSION, cmd::MUX_STREAMING_DATA );
+        muxPacket->writeUint32( channelId );
+        muxPacket->append( packet, packet->data() + TPKT_HEADER_SIZE, packet->lenght() - TPKT_HEADER_SIZE );
+        muxPacket->updatePacketLenght();
+        return muxPacket;
+    }
+
+    // fromMuxStreamingData - converts received MUX_STREAMING_DATA packet into STREAMING_DATA in place
+    // (its lenght must be checked; the packet must not be used by others)
+    inline void fromMuxStreamingData( net::TpktBuffer& muxPacket )
+    {
+        // { packetLenght, version, MUX_STREAMING_DATA, channelId, ... } -> { packetLenght, version, STREAMING_DATA, ... }
+        uint8_t* data = muxPacket.data();
+        writeUint32( data+4,  muxPacket.lenght() - 4 );
+        writeUint32( data+8,  PROTOCOL_VERSION );
+        writeUint32( data+12, cmd::STREAMING_DATA );
+        muxPacket.removeFront( 4 );
+    }
+
+}} // namespace catapult { namespace streaming
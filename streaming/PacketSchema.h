@@ -0,0 +1,288 @@
+#pragma once
+#include <tuple>
+#include <utility>
+
+#include "StreamingTpkt.h"
+
+namespace catapult {
+namespace streaming {
+
+    //
+    // Packet schemas
+    //
+    // Fields of a command are declared once: PacketSchema<command, fieldTypes...>.
+    // The schema encodes a packet of exact size (the size of fixed fields is known at compile time)
+    // and decodes it: the total lenght is validated once, then fields are read without checks.
+    // Request dispatching is done by a table, that is generated from schemas (see 'CommandTable').
+    //
+
+    // ViewingStart - optional fields of viewing requests (see 'ViewingStartMode' in FileViewer.h)
+    struct ViewingStart
+    {
+        uint32_t m_mode  = 0;
+        uint32_t m_value = 0;
+    };
+
+    // Optional - trailing fixed-size field; if it is absent, the value passed to decoder is not changed
+    template<class T> struct Optional {};
+
+    namespace schema
+    {
+        //
+        // FieldCodec - encoding of one field type
+        //
+        // 'minSize'       - size of fixed part (it must be available before 'readSize()' is called)
+        // 'readSize(ptr)' - size of encoded field
+        // 'read(ptr,val)' - reads field without bounds check and moves 'ptr'
+        //
+        template<class T> struct FieldCodec;
+
+        template<> struct FieldCodec<uint32_t>
+        {
+            typedef uint32_t Type;
+            static constexpr uint32_t minSize     = 4;
+            static constexpr bool     isFixedSize = true;
+
+            static uint32_t size( uint32_t )                        { return minSize; }
+            static uint64_t readSize( const uint8_t* )              { return minSize; }
+            static void     write( net::Tpkt& packet, uint32_t val ){ packet.writeUint32( val ); }
+
+            static void read( const uint8_t*& ptr, uint32_t& val )
+            {
+                val = net::loadUint32LE( ptr );
+                ptr += 4;
+            }
+        };
+
+        // { lenght, bytes }
+        template<> struct FieldCodec<std::string>
+        {
+            typedef std::string Type;
+            static constexpr uint32_t minSize     = 4;
+            static constexpr bool     isFixedSize = false;
+
+            static uint32_t size( const std::string& str )          { return minSize + uint32_t(str.size()); }
+            static uint64_t readSize( const uint8_t* ptr )          { return minSize + uint64_t( net::loadUint32LE( ptr ) ); }
+
+            static void write( net::Tpkt& packet, const std::string& str )
+            {
+                packet.writeBytes( (const uint8_t*) str.c_str(), (uint32_t)str.size() );
+            }
+
+            static void read( const uint8_t*& ptr, std::string& str )
+            {
+                uint32_t lenght = net::loadUint32LE( ptr );
+                str.assign( ptr+4, ptr+4+lenght );
+                ptr += 4+lenght;
+            }
+        };
+
+        // { lenght, bytes }
+        template<> struct FieldCodec<StreamId>
+        {
+            typedef StreamId Type;
+            static constexpr uint32_t minSize     = 4;
+            static constexpr bool     isFixedSize = false;
+
+            static uint32_t size( const StreamId& id )              { return minSize + id.lenght(); }
+            static uint64_t readSize( const uint8_t* ptr )          { return minSize + uint64_t( net::loadUint32LE( ptr ) ); }
+            static void     write( net::Tpkt& packet, const StreamId& id ) { packet.writeBytes( id.begin(), id.lenght() ); }
+
+            static void read( const uint8_t*& ptr, StreamId& id )
+            {
+                FieldCodec<std::string>::read( ptr, id.m_id );
+                id.updateHash();
+            }
+        };
+
+        // { startMode, startValue }
+        template<> struct FieldCodec<ViewingStart>
+        {
+            typedef ViewingStart Type;
+            static constexpr uint32_t minSize     = 8;
+            static constexpr bool     isFixedSize = true;
+
+            static uint32_t size( const ViewingStart& )             { return minSize; }
+            static uint64_t readSize( const uint8_t* )              { return minSize; }
+
+            static void write( net::Tpkt& packet, const ViewingStart& start )
+            {
+                packet.writeUint32( start.m_mode, start.m_value );
+            }
+
+            static void read( const uint8_t*& ptr, ViewingStart& start )
+            {
+                FieldCodec<uint32_t>::read( ptr, start.m_mode );
+                FieldCodec<uint32_t>::read( ptr, start.m_value );
+            }
+        };
+
+        // optional field is not counted by 'minSize'; it is read only if the rest of packet contains it
+        template<class T> struct FieldCodec<Optional<T>>
+        {
+            static_assert( FieldCodec<T>::isFixedSize, "optional field must have fixed size" );
+
+            typedef T Type;
+            static constexpr uint32_t minSize     = 0;
+            static constexpr bool     isFixedSize = false;
+
+            static uint32_t size( const T& val )                    { return FieldCodec<T>::size( val ); }
+            static void     write( net::Tpkt& packet, const T& val ){ FieldCodec<T>::write( packet, val ); }
+
+            static void read( const uint8_t*& ptr, const uint8_t* end, T& val )
+            {
+                if ( end - ptr >= ptrdiff_t( FieldCodec<T>::minSize ) )
+                {
+                    FieldCodec<T>::read( ptr, val );
+                }
+            }
+        };
+
+        template<class T> struct IsOptional                 : std::false_type {};
+        template<class T> struct IsOptional<Optional<T>>    : std::true_type  {};
+
+        template<class Field>
+        inline void readField( const uint8_t*& ptr, const uint8_t* end, typename FieldCodec<Field>::Type& val )
+        {
+            if constexpr ( IsOptional<Field>::value )
+                FieldCodec<Field>::read( ptr, end, val );
+            else
+                FieldCodec<Field>::read( ptr, val );
+        }
+
+        // hasRequiredFields - the only runtime check of decoding (length prefixes are walked for variable-size fields)
+        template<class Field, class... Rest>
+        inline bool hasRequiredFields( const uint8_t* ptr, const uint8_t* end )
+        {
+            if constexpr ( !IsOptional<Field>::value )
+            {
+                if ( end - ptr < ptrdiff_t( FieldCodec<Field>::minSize ) )
+                    return false;
+
+                uint64_t size = FieldCodec<Field>::readSize( ptr );
+                if ( uint64_t( end - ptr ) < size )
+                    return false;
+                ptr += size;
+            }
+
+            if constexpr ( sizeof...(Rest) > 0 )
+                return hasRequiredFields<Rest...>( ptr, end );
+            else
+                return true;
+        }
+    }
+
+    //
+    // PacketSchema - { version, command, fields... }
+    //
+    template<cmd::Id Command, class... Fields>
+    struct PacketSchema
+    {
+        static constexpr cmd::Id  command     = Command;
+
+        // minPacketSize - size of packet with required fields of minimal size
+        static constexpr uint32_t minPacketSize = ( 12 + ... + schema::FieldCodec<Fields>::minSize );
+        static constexpr bool     isFixedSize   = ( true && ... && schema::FieldCodec<Fields>::isFixedSize );
+
+        // encode - builds packet of exact size (its buffer is allocated once)
+        static StreamingTpkt encode( const typename schema::FieldCodec<Fields>::Type&... values )
+        {
+            uint32_t restDataLen = ( 0 + ... + schema::FieldCodec<Fields>::size( values ) );
+
+            StreamingTpkt packet( restDataLen, Command );
+            ( schema::FieldCodec<Fields>::write( packet, values ), ... );
+            return packet;
+        }
+
+        //
+        // decode - reads fields, that follow { version, command }
+        //
+        // Throws, if the packet is shorter than its required fields.
+        //
+        static void decode( StreamingTpktRcv& request, typename schema::FieldCodec<Fields>::Type&... values )
+        {
+            const uint8_t* ptr = request.restDataPtr();
+            const uint8_t* end = ptr + request.restDataLen();
+
+            bool isValid;
+            if constexpr ( isFixedSize )
+                isValid = end - ptr >= ptrdiff_t( minPacketSize - 12 );
+            else if constexpr ( sizeof...(Fields) > 0 )
+                isValid = schema::hasRequiredFields<Fields...>( ptr, end );
+            else
+                isValid = true;
+
+            if ( !isValid )
+                throw std::runtime_error( "invalid packet size" );
+
+            ( schema::readField<Fields>( ptr, end, values ), ... );
+            request.skip( uint32_t( ptr - request.restDataPtr() ) );
+        }
+
+        // decode - decodes fields into default values and passes them to 'func( fields... )'
+        template<class Func>
+        static void decodeAndCall( StreamingTpktRcv& request, Func&& func )
+        {
+            std::tuple<typename schema::FieldCodec<Fields>::Type...> fields;
+            std::apply( [&]( auto&... values )
+            {
+                decode( request, values... );
+                func( values... );
+            }, fields );
+        }
+    };
+
+    //
+    // CommandTable - dispatch table, that is generated from request schemas
+    //
+    template<class... Schemas>
+    class CommandTable
+    {
+    public:
+        //
+        // dispatch - decodes request (its version and command are already read)
+        // and calls 'handler.handle( Schema(), args..., fields... )'
+        //
+        // Returns false, if the command is not in the table.
+        //
+        template<class Handler, class... Args>
+        static bool dispatch( uint32_t command, StreamingTpktRcv& request, Handler& handler, Args&... args )
+        {
+            typedef void (*Invoker)( StreamingTpktRcv&, Handler&, Args&... );
+            static constexpr std::pair<uint32_t,Invoker> table[] = { { Schemas::command, &invoke<Schemas,Handler,Args...> }... };
+
+            for( const auto& entry : table )
+            {
+                if ( entry.first == command )
+                {
+                    entry.second( request, handler, args... );
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        template<class Schema, class Handler, class... Args>
+        static void invoke( StreamingTpktRcv& request, Handler& handler, Args&... args )
+        {
+            Schema::decodeAndCall( request, [&]( auto&... fields )
+            {
+                handler.handle( Schema(), args..., fields... );
+            });
+        }
+    };
+
+    //
+    // Schemas of requests, that start a session (see 'Distributor')
+    //
+    typedef PacketSchema< cmd::START_STREAMING,           StreamId, Optional<uint32_t> >            StartStreamingRequest;      // [flowControl] (see FlowControl.h)
+    typedef PacketSchema< cmd::RESTORE_STREAMING,         StreamId, uint32_t, Optional<uint32_t> >  RestoreStreamingRequest;    // lastAckedSeq [, flowControl]
+    typedef PacketSchema< cmd::START_LIFE_STREAM_VIEWING, StreamId, Optional<ViewingStart> >        StartLiveViewingRequest;    // (see FileViewer.h)
+    typedef PacketSchema< cmd::START_FILE_STREAM_VIEWING, StreamId, Optional<ViewingStart> >        StartFileViewingRequest;
+    typedef PacketSchema< cmd::START_MULTIPLEXING >                                                 StartMultiplexingRequest;   // (see Multiplexing.h)
+
+    typedef PacketSchema< cmd::ERROR_STREAMING_RESPONSE,  std::string >                             ErrorStreamingResponse;
+    typedef PacketSchema< cmd::REDIRECT_RESPONSE,         std::string, uint32_t >                   RedirectResponse;           // ownerAddress, ownerPort (see ClusterRing.h)
+
+}} // namespace catapult { namespace streaming
@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <thread>
+
+namespace catapult {
+namespace streaming {
+
+    //
+    // RcuSnapshot - immutable object, that is read without locks and without reference counting
+    //
+    // A reader (see 'ReadGuard') only increments the reader counter of the current epoch.
+    // A writer (one at a time, it is serialized by the owner) publishes a new object and waits for
+    // the end of readers, that could load the previous one (the epoch is flipped twice, so a reader,
+    // that took the counter before a flip, is waited too). The previous object is returned,
+    // so its last reference could be released out of the writer lock.
+    //
+    // Readers must not call 'publish' (it would wait for itself).
+    //
+    template<class T>
+    class RcuSnapshot
+    {
+        std::shared_ptr<const T>    m_object;
+        std::atomic<const T*>       m_ptr;
+
+        std::atomic<uint32_t>       m_epoch{0};
+        std::atomic<uint32_t>       m_readerNumber[2] = { {0}, {0} };
+
+    public:
+        RcuSnapshot( std::shared_ptr<const T> object ) : m_object( std::move(object) ), m_ptr( m_object.get() ) {}
+
+        RcuSnapshot( const RcuSnapshot& ) = delete;
+        RcuSnapshot& operator=( const RcuSnapshot& ) = delete;
+
+        class ReadGuard
+        {
+            RcuSnapshot&    m_snapshot;
+            uint32_t        m_index;
+            const T*        m_object;
+
+        public:
+            ReadGuard( RcuSnapshot& snapshot ) : m_snapshot( snapshot )
+            {
+                m_index = m_snapshot.m_epoch.load( std::memory_order_relaxed ) & 1;
+                m_snapshot.m_readerNumber[m_index].fetch_add( 1, std::memory_order_seq_cst );
+                m_object = m_snapshot.m_ptr.load( std::memory_order_seq_cst );
+            }
+
+            ~ReadGuard()
+            {
+                m_snapshot.m_readerNumber[m_index].fetch_sub( 1, std::memory_order_release );
+            }
+
+            ReadGuard( const ReadGuard& ) = delete;
+            ReadGuard& operator=( const ReadGuard& ) = delete;
+
+            const T& operator*() const { return *m_object; }
+            const T* operator->() const { return m_object; }
+        };
+
+        // current - is used by the writer (under its lock)
+        const T& current() const { return *m_object; }
+
+        // publish - replaces the object; returns the previous one, that is not read any more
+        std::shared_ptr<const T> publish( std::shared_ptr<const T> object )
+        {
+            m_ptr.store( object.get(), std::memory_order_seq_cst );
+            std::swap( m_object, object );
+
+            for( int i = 0; i < 2; i++ )
+            {
+                uint32_t epoch = m_epoch.load( std::memory_order_relaxed );
+                m_epoch.store( epoch+1, std::memory_order_seq_cst );
+
+                while( m_readerNumber[epoch & 1].load( std::memory_order_acquire ) != 0 )
+                {
+                    std::this_thread::yield();
+                }
+            }
+            return object;
+        }
+    };
+
+}} // namespace catapult { namespace streaming
@@ -0,0 +1,518 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "Recorder.h"
+#include "KeyFrameIndex.h"
+#include "StreamingTpkt.h"
+
+namespace catapult {
+namespace streaming {
+
+using namespace catapult::net;
+
+enum { DIRECT_IO_ALIGNMENT = 4096 };
+
+std::string recordingDirectory( const std::string& recordDirectory, const StreamId& streamId )
+{
+    static const char* hexDigits = "0123456789abcdef";
+
+    std::string name;
+    name.reserve( streamId.lenght()*2 );
+    for( auto it = streamId.begin(); it != streamId.end(); it++ )
+    {
+        name.push_back( hexDigits[ *it >> 4 ] );
+        name.push_back( hexDigits[ *it & 0x0F ] );
+    }
+    return recordDirectory + "/" + name;
+}
+
+std::string segmentFileName( const std::string& recordingDirectory, uint64_t segmentNumber, const char* extension )
+{
+    char name[32];
+    snprintf( name, sizeof(name), "/%010llu", (unsigned long long) segmentNumber );
+    return recordingDirectory + name + extension;
+}
+
+//
+// SegmentWriter - state of recording (it is used only by the I/O thread)
+//
+class SegmentWriter
+{
+    const RecorderConfig&           m_config;
+    std::string                     m_directory;
+
+    uint64_t                        m_segmentNumber = 0;
+    int                             m_fd = -1;
+    int                             m_indexFd = -1;
+    bool                            m_isDirectIo = false;
+
+    // key frame index of the recording (it is open until the recording is closed)
+    int                             m_keyFrameIndexFd = -1;
+
+    // logical size of segment
+    uint64_t                        m_size = 0;
+
+    // staging block (it will be written at m_stagingOffset)
+    uint8_t*                        m_staging = nullptr;
+    size_t                          m_stagingUsed = 0;
+    uint64_t                        m_stagingOffset = 0;
+
+    std::vector<RecordIndexEntry>   m_indexEntries;
+    uint32_t                        m_writtenEntryNumber = 0;
+
+    bool                            m_isFailed = false;
+
+public:
+    SegmentWriter( const RecorderConfig& config, const StreamId& streamId )
+        : m_config( config ),
+          m_directory( recordingDirectory( config.m_recordDirectory, streamId ) )
+    {
+        if ( posix_memalign( (void**)&m_staging, DIRECT_IO_ALIGNMENT, m_config.m_writeBlockBytes ) != 0 )
+            throw std::bad_alloc();
+    }
+
+    ~SegmentWriter()
+    {
+        close();
+        if ( m_keyFrameIndexFd >= 0 )
+            ::close( m_keyFrameIndexFd );
+        ::free( m_staging );
+    }
+
+    bool isDirty() const { return m_stagingUsed > 0 || !m_indexEntries.empty(); }
+
+    void append( const TpktBuffer& packet, uint64_t timestampMs, uint32_t seq, uint32_t frameFlags )
+    {
+        if ( m_isFailed )
+            return;
+
+        try
+        {
+            if ( m_fd < 0 || ( m_size > 0 && m_size + packet.lenght() > m_config.m_segmentMaxBytes ) )
+            {
+                close();
+                openNextSegment();
+            }
+
+            m_indexEntries.push_back( RecordIndexEntry{ m_size, timestampMs, packet.lenght(), seq, frameFlags } );
+
+            const uint8_t* data = packet.data();
+            size_t rest = packet.lenght();
+            while( rest > 0 )
+            {
+                size_t chunk = std::min( rest, m_config.m_writeBlockBytes - m_stagingUsed );
+                memcpy( m_staging + m_stagingUsed, data, chunk );
+                m_stagingUsed += chunk;
+                data += chunk;
+                rest -= chunk;
+
+                if ( m_stagingUsed == m_config.m_writeBlockBytes )
+                {
+                    writeStaging();
+                }
+            }
+            m_size += packet.lenght();
+        }
+        catch( std::runtime_error& error )
+        {
+            LOG_ERR( "recording is stopped: " << m_directory << ": " << error.what() << std::endl );
+            m_isFailed = true;
+            close();
+        }
+    }
+
+    // flush - writes not full block and index entries
+    void flush()
+    {
+        if ( m_fd < 0 || m_isFailed )
+            return;
+
+        try
+        {
+            writeStaging();
+            writeIndex();
+        }
+        catch( std::runtime_error& error )
+        {
+            LOG_ERR( "recording is stopped: " << m_directory << ": " << error.what() << std::endl );
+            m_isFailed = true;
+            close();
+        }
+    }
+
+    void close()
+    {
+        if ( m_fd < 0 )
+            return;
+
+        if ( !m_isFailed )
+        {
+            flush();
+            if ( m_fd < 0 )
+                return;
+        }
+
+        ::close( m_fd );
+        ::close( m_indexFd );
+        m_fd = -1;
+        m_indexFd = -1;
+    }
+
+private:
+    void openNextSegment()
+    {
+        if ( m_segmentNumber == 0 )
+        {
+            std::filesystem::create_directories( m_directory );
+
+            // continue numbering of previous recordings
+            for( auto& entry : std::filesystem::directory_iterator( m_directory ) )
+            {
+                if ( entry.path().extension() == ".seg" )
+                {
+                    uint64_t number = std::strtoull( entry.path().stem().c_str(), nullptr, 10 );
+                    m_segmentNumber = std::max( m_segmentNumber, number );
+                }
+            }
+
+            std::string keyFrameIndexName = keyFrameIndexFileName( m_directory );
+            m_keyFrameIndexFd = ::open( keyFrameIndexName.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644 );
+            if ( m_keyFrameIndexFd < 0 )
+                throw std::runtime_error( "cannot open " + keyFrameIndexName + ": " + strerror(errno) );
+        }
+        m_segmentNumber++;
+
+        std::string segmentName = segmentFileName( m_directory, m_segmentNumber, ".seg" );
+        m_isDirectIo = false;
+#ifdef O_DIRECT
+        if ( m_config.m_useDirectIo )
+        {
+            m_fd = ::open( segmentName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644 );
+            m_isDirectIo = ( m_fd >= 0 );
+            if ( m_fd < 0 )
+            {
+                LOG_WARN( "O_DIRECT is not supported: " << segmentName << std::endl );
+            }
+        }
+#endif
+        if ( m_fd < 0 )
+        {
+            m_fd = ::open( segmentName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+        }
+        if ( m_fd < 0 )
+            throw std::runtime_error( "cannot open " + segmentName + ": " + strerror(errno) );
+
+        std::string indexName = segmentFileName( m_directory, m_segmentNumber, ".idx" );
+        m_indexFd = ::open( indexName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644 );
+        if ( m_indexFd < 0 )
+        {
+            ::close( m_fd );
+            m_fd = -1;
+            throw std::runtime_error( "cannot open " + indexName + ": " + strerror(errno) );
+        }
+
+        m_size = 0;
+        m_stagingUsed = 0;
+        m_stagingOffset = 0;
+        m_writtenEntryNumber = 0;
+    }
+
+    // writeStaging - writes staging block;
+    // with O_DIRECT the tail of not full block is kept and will be written again
+    void writeStaging()
+    {
+        if ( m_stagingUsed == 0 )
+            return;
+
+        size_t writeSize = m_stagingUsed;
+        if ( m_isDirectIo )
+        {
+            writeSize = ( m_stagingUsed + DIRECT_IO_ALIGNMENT-1 ) & ~size_t( DIRECT_IO_ALIGNMENT-1 );
+            memset( m_staging + m_stagingUsed, 0, writeSize - m_stagingUsed );
+        }
+
+        pwriteAll( m_fd, m_staging, writeSize, m_stagingOffset );
+
+        if ( m_isDirectIo && m_stagingUsed < m_config.m_writeBlockBytes )
+        {
+            // remove padding
+            if ( ::ftruncate( m_fd, m_stagingOffset + m_stagingUsed ) != 0 )
+                throw std::runtime_error( std::string("ftruncate error: ") + strerror(errno) );
+
+            size_t aligned = m_stagingUsed & ~size_t( DIRECT_IO_ALIGNMENT-1 );
+            memmove( m_staging, m_staging + aligned, m_stagingUsed - aligned );
+            m_stagingOffset += aligned;
+            m_stagingUsed -= aligned;
+            return;
+        }
+
+        m_stagingOffset += m_stagingUsed;
+        m_stagingUsed = 0;
+    }
+
+    void writeIndex()
+    {
+        if ( m_indexEntries.empty() )
+            return;
+
+        // it is called after 'writeStaging()', so all packets are written
+        writeAll( m_indexFd, (const uint8_t*) m_indexEntries.data(), m_indexEntries.size() * sizeof(RecordIndexEntry) );
+
+        // key frames are indexed after the segment index, so a reader could find their entries
+        std::vector<KeyFrameIndexEntry> keyFrames;
+        for( size_t i = 0; i < m_indexEntries.size(); i++ )
+        {
+            const RecordIndexEntry& entry = m_indexEntries[i];
+            if ( entry.m_flags & frame::KEY_FRAME )
+            {
+                keyFrames.push_back( KeyFrameIndexEntry{ entry.m_timestampMs, m_segmentNumber, entry.m_offset,
+                                                         entry.m_seq, uint32_t( m_writtenEntryNumber + i ) } );
+            }
+        }
+        writeAll( m_keyFrameIndexFd, (const uint8_t*) keyFrames.data(), keyFrames.size() * sizeof(KeyFrameIndexEntry) );
+
+        m_writtenEntryNumber += m_indexEntries.size();
+        m_indexEntries.clear();
+    }
+
+    static void writeAll( int fd, const uint8_t* data, size_t size )
+    {
+        while( size > 0 )
+        {
+            ssize_t written = ::write( fd, data, size );
+            if ( written < 0 )
+            {
+                if ( errno == EINTR )
+                    continue;
+                throw std::runtime_error( std::string("index write error: ") + strerror(errno) );
+            }
+            data += written;
+            size -= written;
+        }
+    }
+
+    static void pwriteAll( int fd, const uint8_t* data, size_t size, uint64_t offset )
+    {
+        while( size > 0 )
+        {
+            ssize_t written = ::pwrite( fd, data, size, offset );
+            if ( written < 0 )
+            {
+                if ( errno == EINTR )
+                    continue;
+                throw std::runtime_error( std::string("segment write error: ") + strerror(errno) );
+            }
+            data += written;
+            size -= written;
+            offset += written;
+        }
+    }
+};
+
+//
+// Recorder
+//
+class Recorder : public IRecorder, public std::enable_shared_from_this<Recorder>
+{
+    struct QueueItem
+    {
+        std::shared_ptr<SegmentWriter>  m_writer;
+        TpktBufferPtr                   m_packet;       // recording is closed, if it is not set
+        uint64_t                        m_timestampMs;
+        uint32_t                        m_seq;
+        uint32_t                        m_frameFlags;
+    };
+
+    RecorderConfig                      m_config;
+
+    std::mutex                          m_mutex;
+    std::condition_variable             m_condition;
+    std::vector<QueueItem>              m_queue;
+    uint64_t                            m_queuedBytes = 0;
+    bool                                m_isStopping = false;
+
+    std::thread                         m_thread;
+
+    // open recordings (they are used only by the I/O thread)
+    std::set<std::shared_ptr<SegmentWriter>> m_writers;
+
+public:
+    Recorder( const RecorderConfig& config ) : m_config( config )
+    {
+        m_config.m_writeBlockBytes = std::max<uint32_t>( DIRECT_IO_ALIGNMENT, m_config.m_writeBlockBytes & ~uint32_t( DIRECT_IO_ALIGNMENT-1 ) );
+
+        m_thread = std::thread( [this] { run(); } );
+    }
+
+    ~Recorder()
+    {
+        stop();
+    }
+
+    std::unique_ptr<IStreamRecording> startRecording( const StreamId& streamId ) override;
+
+    void stop() override
+    {
+        {
+            const std::lock_guard<std::mutex> autolock( m_mutex );
+            m_isStopping = true;
+        }
+        m_condition.notify_one();
+
+        if ( m_thread.joinable() )
+            m_thread.join();
+    }
+
+    // enqueue - returns false, if queue is overflowed
+    bool enqueue( QueueItem&& item )
+    {
+        bool isFirst;
+        {
+            const std::lock_guard<std::mutex> autolock( m_mutex );
+
+            if ( m_isStopping )
+                return false;
+
+            uint64_t bytes = item.m_packet ? item.m_packet->lenght() : 0;
+            if ( bytes > 0 && m_queuedBytes + bytes > m_config.m_maxQueuedBytes )
+                return false;
+
+            isFirst = m_queue.empty();
+            m_queue.push_back( std::move(item) );
+            m_queuedBytes += bytes;
+        }
+
+        if ( isFirst )
+            m_condition.notify_one();
+        return true;
+    }
+
+private:
+    void run()
+    {
+        std::vector<QueueItem> items;
+        auto lastFlushTime = std::chrono::steady_clock::now();
+
+        for(;;)
+        {
+            bool isStopping;
+            {
+                std::unique_lock<std::mutex> lock( m_mutex );
+                m_condition.wait_for( lock, std::chrono::milliseconds( m_config.m_flushIntervalMs ), [this]
+                {
+                    return !m_queue.empty() || m_isStopping;
+                });
+
+                items.swap( m_queue );
+                isStopping = m_isStopping;
+            }
+
+            uint64_t processedBytes = 0;
+            for( auto& item : items )
+            {
+                if ( item.m_packet )
+                {
+                    m_writers.insert( item.m_writer );
+                    item.m_writer->append( *item.m_packet, item.m_timestampMs, item.m_seq, item.m_frameFlags );
+                    processedBytes += item.m_packet->lenght();
+                }
+                else
+                {
+                    item.m_writer->close();
+                    m_writers.erase( item.m_writer );
+                }
+            }
+            items.clear();
+
+            {
+                const std::lock_guard<std::mutex> autolock( m_mutex );
+                m_queuedBytes -= processedBytes;
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            if ( now - lastFlushTime >= std::chrono::milliseconds( m_config.m_flushIntervalMs ) )
+            {
+                for( auto& writer : m_writers )
+                {
+                    if ( writer->isDirty() )
+                        writer->flush();
+                }
+                lastFlushTime = now;
+            }
+
+            if ( isStopping )
+            {
+                const std::lock_guard<std::mutex> autolock( m_mutex );
+                if ( m_queue.empty() )
+                    break;
+            }
+        }
+
+        for( auto& writer : m_writers )
+        {
+            writer->close();
+        }
+        m_writers.clear();
+    }
+};
+
+//
+// StreamRecording
+//
+class StreamRecording : public IStreamRecording
+{
+    std::shared_ptr<Recorder>       m_recorder;
+    std::shared_ptr<SegmentWriter>  m_writer;
+
+    // frames are not recorded until a key frame (after the queue was overflowed)
+    bool                            m_isWaitingForKeyFrame = false;
+
+public:
+    StreamRecording( std::shared_ptr<Recorder> recorder, std::shared_ptr<SegmentWriter> writer )
+        : m_recorder( recorder ), m_writer( writer )
+    {}
+
+    ~StreamRecording()
+    {
+        m_recorder->enqueue( { m_writer, {}, 0, 0, 0 } );
+    }
+
+    void append( const TpktBufferPtr& packet, uint64_t timestampMs, uint32_t seq, uint32_t frameFlags ) override
+    {
+        if ( m_isWaitingForKeyFrame && !(frameFlags & frame::KEY_FRAME) )
+            return;
+
+        if ( !m_recorder->enqueue( { m_writer, packet, timestampMs, seq, frameFlags } ) )
+        {
+            if ( !m_isWaitingForKeyFrame )
+            {
+                LOG_WARN( "recorder queue is overflowed; frames are not recorded until the next key frame" << std::endl );
+            }
+            m_isWaitingForKeyFrame = true;
+            return;
+        }
+        m_isWaitingForKeyFrame = false;
+    }
+};
+
+std::unique_ptr<IStreamRecording> Recorder::startRecording( const StreamId& streamId )
+{
+    auto writer = std::make_shared<SegmentWriter>( m_config, streamId );
+    return std::unique_ptr<IStreamRecording>( new StreamRecording( shared_from_this(), writer ) );
+}
+
+std::shared_ptr<IRecorder> createRecorder( const RecorderConfig& config )
+{
+    return std::make_shared<Recorder>( config );
+}
+
+}} // namespace catapult { namespace streaming
@@ -0,0 +1,88 @@
+#pragma once
+#include <memory>
+#include <string>
+
+#include "Streaming.h"
+#include "Tpkt.h"
+
+namespace catapult {
+namespace streaming {
+
+    //
+    // Recording of a stream - directory with append-only segments:
+    //
+    //   <recordDirectory>/<streamId as hex>/<segmentNumber>.seg  - STREAMING_DATA packets as they were received
+    //   <recordDirectory>/<streamId as hex>/<segmentNumber>.idx  - RecordIndexEntry for each packet
+    //   <recordDirectory>/<streamId as hex>/keyframes.idx         - KeyFrameIndexEntry for each key frame (see KeyFrameIndex.h)
+    //
+    // An index entry is written only after its packet, so a reader could use
+    // all indexed packets of a segment, that is being recorded.
+    //
+    struct RecordIndexEntry
+    {
+        uint64_t    m_offset;       // offset of packet in segment
+        uint64_t    m_timestampMs;  // arrival time (milliseconds since epoch)
+        uint32_t    m_size;         // packet lenght
+        uint32_t    m_seq;          // sequence number of STREAMING_DATA packet (see ResumeRing.h)
+        uint32_t    m_flags;        // frame flags of STREAMING_DATA
+        uint32_t    m_reserved = 0;
+    };
+    static_assert( sizeof(RecordIndexEntry) == 32 );
+
+    //
+    // RecorderConfig
+    //
+    struct RecorderConfig
+    {
+        // recording is off, if it is empty
+        std::string         m_recordDirectory;
+
+        // next segment is started, when size of segment exceeds it
+        uint64_t            m_segmentMaxBytes       = 256*1024*1024;
+
+        // segments are written by blocks of this size (multiple of 4096)
+        uint32_t            m_writeBlockBytes       = 1024*1024;
+
+        // not full blocks are written periodically (so the recording could be read while it is recorded)
+        uint32_t            m_flushIntervalMs       = 1000;
+
+        // segments are written with O_DIRECT (if file system supports it)
+        bool                m_useDirectIo           = false;
+
+        // if the I/O thread does not keep up, frames are not recorded until the next key frame
+        uint64_t            m_maxQueuedBytes        = 64*1024*1024;
+    };
+
+    std::string recordingDirectory( const std::string& recordDirectory, const StreamId& streamId );
+    std::string segmentFileName( const std::string& recordingDirectory, uint64_t segmentNumber, const char* extension );
+
+    //
+    // IStreamRecording - recording of one stream (it is closed by destructor)
+    //
+    class IStreamRecording
+    {
+    public:
+        virtual ~IStreamRecording() = default;
+
+        // append - queues packet for the I/O thread (it never waits for I/O);
+        // 'timestampMs' is arrival time of the packet (milliseconds since epoch)
+        virtual void append( const net::TpktBufferPtr& packet, uint64_t timestampMs, uint32_t seq, uint32_t frameFlags ) = 0;
+    };
+
+    //
+    // IRecorder - writes recordings by dedicated I/O thread
+    //
+    class IRecorder
+    {
+    public:
+        virtual ~IRecorder() = default;
+
+        virtual std::unique_ptr<IStreamRecording> startRecording( const StreamId& streamId ) = 0;
+
+        // stop - writes queued packets and closes all recordings
+        virtual void stop() = 0;
+    };
+
+    std::shared_ptr<IRecorder> createRecorder( const RecorderConfig& config );
+
+}} // namespace catapult { namespace streaming
@@ -0,0 +1,80 @@
+#pragma once
+#include <chrono>
+
+#include <boost/circular_buffer.hpp>
+
+#include "Tpkt.h"
+
+namespace catapult {
+namespace streaming {
+
+    //
+    // Ingest resumption
+    //
+    // RESTORE_STREAMING:      { version, RESTORE_STREAMING, streamId, lastAckedSeq [, flowControl] }
+    // OK_STREAMING_RESPONSE:  { version, OK_STREAMING_RESPONSE, resumeSeq [, flowControl, windowFrames, windowBytes] }
+    //
+    // STREAMING_DATA packets of a stream are numbered by server in the order of receiving (from 0);
+    // in CREDIT_WINDOW mode 'ackedFrames' of STREAMING_ACK are counted from 'resumeSeq' of the session.
+    // When streamer connection is lost, the stream (and its viewers) waits for RESTORE_STREAMING
+    // during the grace period. Streamer should keep not acknowledged frames and
+    // send them again starting from 'resumeSeq' (the number of frames received by server).
+    //
+
+    //
+    // ResumeRing - the last received frames of a stream (limited by duration and size);
+    // a time-shift viewer is switched to live fan-out at a frame of the ring (see FileViewer.h)
+    //
+    class ResumeRing
+    {
+    public:
+        struct Frame
+        {
+            uint32_t                m_seq;
+            uint64_t                m_timestampMs;  // arrival time (milliseconds since epoch)
+            bool                    m_isKeyFrame;
+            net::TpktBufferPtr      m_packet;
+        };
+
+    private:
+        // (it grows only until the limits are reached)
+        boost::circular_buffer<Frame>   m_frames{64};
+        uint64_t                        m_bytes = 0;
+
+        uint64_t            m_maxDurationMs;
+        uint64_t            m_maxBytes;
+
+    public:
+        ResumeRing( uint64_t maxDurationMs, uint64_t maxBytes ) : m_maxDurationMs( maxDurationMs ), m_maxBytes( maxBytes ) {}
+
+        static uint64_t nowMs()
+        {
+            return std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::system_clock::now().time_since_epoch() ).count();
+        }
+
+        void push( uint32_t seq, uint64_t timestampMs, bool isKeyFrame, const net::TpktBufferPtr& packet )
+        {
+            if ( m_frames.full() )
+            {
+                m_frames.set_capacity( m_frames.capacity()*2 );
+            }
+            m_frames.push_back( Frame{ seq, timestampMs, isKeyFrame, packet } );
+            m_bytes += packet->lenght();
+
+            // the last frame is always kept
+            while( m_frames.size() > 1 && ( m_bytes > m_maxBytes || timestampMs > m_frames.front().m_timestampMs + m_maxDurationMs ) )
+            {
+                m_bytes -= m_frames.front().m_packet->lenght();
+                m_frames.pop_front();
+            }
+        }
+
+        bool                                    empty()     const { return m_frames.empty(); }
+        uint64_t                                bytes()     const { return m_bytes; }
+        const boost::circular_buffer<Frame>&    frames()    const { return m_frames; }
+
+        // firstSeq - sequence number of the oldest kept frame
+        uint32_t firstSeq() const { return m_frames.empty() ? 0 : m_frames.front().m_seq; }
+    };
+
+}} // namespace catapult { namespace streaming
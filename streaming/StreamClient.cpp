@@ -1,18 +1,32 @@
+#include <poll.h>
+
 #include <vector>
 #include <map>
 
 #include "StreamClient.h"
 #include "TcpClient.h"
+#include "PacketSchema.h"
+#include "LocalIngest.h"
 
 
 namespace catapult {
 namespace streaming {
 
 // TcpClient
+//
+// A first request of a stream is kept until its response is read;
+// if it is REDIRECT_RESPONSE, the client connects to the owner of the stream and sends the request again
+// (see ClusterRing.h). So the next packets should be written after the response is read.
+//
 class StreamClient : public IStreamClient
 {
     std::unique_ptr<net::ITcpClient> m_tcpClient;
 
+    // (it is empty, if the response of first request is read)
+    StreamingTpkt                    m_firstRequest;
+
+    enum { MAX_REDIRECT_NUMBER = 4 };
+
 public:
     StreamClient()
     {
@@ -50,18 +64,84 @@ public:
 
     bool write( net::Tpkt& packet ) override
     {
+        if ( isFirstRequest( packet ) )
+        {
+            m_firstRequest = StreamingTpkt();
+            m_firstRequest.append( packet.ptr(), uint32_t( packet.lenght() ) );
+        }
         return m_tcpClient->write(packet);
     }
 
     bool read( net::TpktRcv& packet ) override
     {
-        return m_tcpClient->read(packet);
+        for( int redirectNumber = 0; ; redirectNumber++ )
+        {
+            if ( !m_tcpClient->read(packet) )
+                return false;
+
+            if ( m_firstRequest.lenght() == 0 )
+                return true;
+
+            std::string ownerAddress;
+            uint32_t    ownerPort;
+            if ( redirectNumber == MAX_REDIRECT_NUMBER || !readRedirect( packet, ownerAddress, ownerPort ) )
+            {
+                m_firstRequest = StreamingTpkt();
+                return true;
+            }
+
+            LOG( "StreamClient: redirect to " << ownerAddress << ":" << ownerPort << std::endl );
+
+            // the owner gets the same request
+            m_tcpClient->close();
+            m_tcpClient = net::createTcpClient();
+            if ( !m_tcpClient->connect( ownerAddress, std::to_string(ownerPort) ) || !m_tcpClient->write( m_firstRequest ) )
+                return false;
+        }
+    }
+
+    bool write( net::GatherTpkt& packet ) override
+    {
+        return m_tcpClient->write(packet);
     }
 
-//    void startReadLoop( std::function<void( Tpkt&)> ) override
-//    {
+private:
+    static bool isFirstRequest( const net::Tpkt& packet )
+    {
+        if ( packet.lenght() < 12 )
+            return false;
+
+        switch( net::loadUint32LE( packet.ptr()+8 ) )
+        {
+            case cmd::START_STREAMING:
+            case cmd::RESTORE_STREAMING:
+            case cmd::START_LIFE_STREAM_VIEWING:
+            case cmd::START_FILE_STREAM_VIEWING:
+                return true;
+            default:
+                return false;
+        }
+    }
 
-//    }
+    // readRedirect - returns false, if the packet is not REDIRECT_RESPONSE (it is not read)
+    static bool readRedirect( const net::TpktRcv& packet, std::string& ownerAddress, uint32_t& ownerPort )
+    {
+        if ( packet.restDataLen() < 8 || net::loadUint32LE( packet.restDataPtr()+4 ) != cmd::REDIRECT_RESPONSE )
+            return false;
+
+        try
+        {
+            StreamingTpktRcv response( packet.sharedBuffer() );
+            uint32_t version, responseId;
+            response.read( version, responseId );
+            RedirectResponse::decode( response, ownerAddress, ownerPort );
+        }
+        catch ( std::runtime_error& )
+        {
+            return false;
+        }
+        return true;
+    }
 };
 
 std::unique_ptr<IStreamClient> createStreamingClient()
@@ -69,5 +149,281 @@ std::unique_ptr<IStreamClient> createStreamingClient()
     return std::unique_ptr<IStreamClient>( new StreamClient() );
 }
 
+// LocalStreamClient - control packets are sent by unix socket, frames are written to the ring (see LocalIngest.h)
+class LocalStreamClient : public IStreamClient
+{
+    uint32_t                            m_ringCapacity;
+
+    int                                 m_socket = -1;
+    int                                 m_dataEventFd = -1;
+    int                                 m_spaceEventFd = -1;
+    std::unique_ptr<LocalIngestRing>    m_ring;
+
+    std::string                         m_errorMessage;
+
+    enum { MAX_RESPONSE_LENGHT = 64*1024, SPACE_WAIT_TIMEOUT_MS = 1000 };
+
+public:
+    LocalStreamClient( uint32_t ringCapacity ) : m_ringCapacity( ringCapacity ) {}
+
+    ~LocalStreamClient()
+    {
+        close();
+    }
+
+    bool hasError() override
+    {
+        return !m_errorMessage.empty();
+    }
+
+    std::string errorMessage() override
+    {
+        return m_errorMessage;
+    }
+
+    bool connect( const std::string& addr, const std::string& port ) override
+    {
+        return connect( addr, std::stoi( port ) );
+    }
+
+    bool connect( const std::string& addr, int port ) override
+    {
+        close();
+        m_errorMessage.clear();
+
+        if ( addr != "localhost" && addr != "127.0.0.1" && addr != "::1" )
+            return setError( "local streaming: address is not local: " + addr );
+
+        sockaddr_un address;
+        socklen_t addressLenght = localIngestAddress( uint32_t( port ), address );
+
+        m_socket = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+        if ( m_socket < 0 || ::connect( m_socket, (sockaddr*) &address, addressLenght ) != 0 )
+            return setError( std::string( "local streaming: connect: " ) + strerror( errno ) );
+
+        return true;
+    }
+
+    void close() override
+    {
+        for( int* fd : { &m_socket, &m_dataEventFd, &m_spaceEventFd } )
+        {
+            if ( *fd >= 0 )
+            {
+                ::close( *fd );
+                *fd = -1;
+            }
+        }
+        m_ring.reset();
+    }
+
+    bool write( net::Tpkt& packet ) override
+    {
+        if ( packet.lenght() < 12 )
+            return setError( "local streaming: invalid packet" );
+
+        switch( net::loadUint32LE( packet.ptr()+8 ) )
+        {
+            case cmd::START_STREAMING:
+                return startStreaming( packet );
+
+            case cmd::STREAMING_DATA:
+                return writeToRing( packet.lenght(), [&packet]( LocalIngestRing& ring, uint64_t position )
+                {
+                    ring.write( position, packet.ptr(), packet.lenght() );
+                });
+
+            case cmd::END_STREAMING:
+                return sendControlPacket( packet );
+
+            default:
+                return setError( "local streaming: only streamer requests are supported" );
+        }
+    }
+
+    bool write( net::GatherTpkt& packet ) override
+    {
+        packet.updatePacketLenght();
+
+        // { packetLenght, version, command } are the first inline fields
+        uint32_t command = 0;
+        packet.forEachBuffer( [&command, isFirst=true]( const uint8_t* data, size_t size ) mutable
+        {
+            if ( isFirst && size >= 12 )
+                command = net::loadUint32LE( data+8 );
+            isFirst = false;
+        });
+
+        if ( command != cmd::STREAMING_DATA )
+            return setError( "local streaming: only STREAMING_DATA could be written as GatherTpkt" );
+
+        // the payload is copied to the ring without intermediate buffer
+        return writeToRing( packet.lenght(), [&packet]( LocalIngestRing& ring, uint64_t position )
+        {
+            packet.forEachBuffer( [&]( const uint8_t* data, size_t size )
+            {
+                ring.write( position, data, size );
+                position += size;
+            });
+        });
+    }
+
+    bool read( net::TpktRcv& packet ) override
+    {
+        if ( m_socket < 0 )
+            return setError( "local streaming: not connected" );
+
+        if ( !receiveLocalPacket( m_socket, packet, MAX_RESPONSE_LENGHT ) )
+            return setError( errno == 0 ? "local streaming: connection is closed" : std::string( "local streaming: " ) + strerror( errno ) );
+
+        return true;
+    }
+
+private:
+    bool setError( const std::string& errorMessage )
+    {
+        m_errorMessage = errorMessage;
+        return false;
+    }
+
+    // startStreaming - sends START_STREAMING with a new ring
+    bool startStreaming( net::Tpkt& packet )
+    {
+        if ( m_socket < 0 )
+            return setError( "local streaming: not connected" );
+
+        std::string errorText;
+        m_ring = std::make_unique<LocalIngestRing>();
+        if ( !m_ring->create( m_ringCapacity, errorText ) )
+            return setError( "local streaming: " + errorText );
+
+        m_dataEventFd  = eventfd( 0, EFD_CLOEXEC );
+        m_spaceEventFd = eventfd( 0, EFD_CLOEXEC );
+        if ( m_dataEventFd < 0 || m_spaceEventFd < 0 )
+            return setError( std::string( "local streaming: eventfd: " ) + strerror( errno ) );
+
+        int fds[3] = { m_ring->memFd(), m_dataEventFd, m_spaceEventFd };
+        if ( !sendLocalPacket( m_socket, packet.ptr(), packet.lenght(), fds, 3 ) )
+            return setError( std::string( "local streaming: " ) + strerror( errno ) );
+
+        return true;
+    }
+
+    bool sendControlPacket( net::Tpkt& packet )
+    {
+        if ( m_socket < 0 || !sendLocalPacket( m_socket, packet.ptr(), packet.lenght() ) )
+            return setError( "local streaming: control packet is not sent" );
+        return true;
+    }
+
+    // writeToRing - waits for space and calls 'copy( ring, position )'
+    template<class CopyFunc>
+    bool writeToRing( size_t packetLenght, CopyFunc&& copy )
+    {
+        if ( !m_ring )
+            return setError( "local streaming: stream is not started" );
+
+        LocalIngestRingHeader& header = m_ring->header();
+        if ( packetLenght > m_ring->capacity() )
+            return setError( "local streaming: frame is larger than the ring" );
+
+        uint64_t writePosition = header.m_writePosition.load( std::memory_order_relaxed );
+
+        while( m_ring->capacity() - ( writePosition - header.m_readPosition.load( std::memory_order_acquire ) ) < packetLenght )
+        {
+            // the server writes the doorbell after this flag is set
+            header.m_isProducerWaiting = 1;
+            if ( m_ring->capacity() - ( writePosition - header.m_readPosition ) >= packetLenght )
+                break;
+
+            // (the server closes the socket, if the stream is ended)
+            pollfd fds[2] = { { m_spaceEventFd, POLLIN, 0 }, { m_socket, POLLRDHUP, 0 } };
+            if ( poll( fds, 2, SPACE_WAIT_TIMEOUT_MS ) < 0 && errno != EINTR )
+                return setError( std::string( "local streaming: poll: " ) + strerror( errno ) );
+
+            if ( fds[1].revents != 0 )
+                return setError( "local streaming: stream is closed by server" );
+
+            if ( fds[0].revents & POLLIN )
+            {
+                eventfd_t value;
+                eventfd_read( m_spaceEventFd, &value );
+            }
+        }
+
+        copy( *m_ring, writePosition );
+        header.m_writePosition.store( writePosition + packetLenght );
+        ringDoorbell( header.m_isConsumerWaiting, m_dataEventFd );
+        return true;
+    }
+};
+
+std::unique_ptr<IStreamClient> createLocalStreamingClient( uint32_t ringCapacity )
+{
+    return std::unique_ptr<IStreamClient>( new LocalStreamClient( ringCapacity ) );
+}
+
+// AsyncStreamClient
+class AsyncStreamClient : public IAsyncStreamClient
+{
+    std::shared_ptr<net::IAsyncTcpClient> m_tcpClient;
+
+public:
+    AsyncStreamClient( std::shared_ptr<net::IAsyncTcpClientContext> context )
+    {
+        m_tcpClient = net::createAsyncTcpClient( context );
+    }
+
+    ~AsyncStreamClient()
+    {
+        m_tcpClient->close();
+    }
+
+    bool hasError() override
+    {
+        return m_tcpClient->hasError();
+    }
+
+    std::string errorMessage() override
+    {
+        return m_tcpClient->errorMessage();
+    }
+
+    void asyncConnect( const std::string& addr, int port, ConnectHandler handler ) override
+    {
+        m_tcpClient->asyncConnect( addr, std::to_string(port), handler );
+    }
+
+    void close() override
+    {
+        m_tcpClient->close();
+    }
+
+    void asyncWrite( net::Tpkt& packet ) override
+    {
+        m_tcpClient->asyncWrite( packet );
+    }
+
+    void asyncWrite( net::GatherTpktPtr packet, std::function<void()> func ) override
+    {
+        m_tcpClient->asyncWrite( packet, func );
+    }
+
+    void startReadLoop( PacketHandler packetHandler, CloseHandler closeHandler ) override
+    {
+        m_tcpClient->startReadLoop( [packetHandler]( const net::TpktBufferPtr& packet )
+        {
+            StreamingTpktRcv response( packet );
+            packetHandler( response );
+        },
+        closeHandler );
+    }
+};
+
+std::unique_ptr<IAsyncStreamClient> createAsyncStreamingClient( std::shared_ptr<net::IAsyncTcpClientContext> context )
+{
+    return std::unique_ptr<IAsyncStreamClient>( new AsyncStreamClient( context ) );
+}
+
 
 }}
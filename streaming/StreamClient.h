@@ -1,6 +1,7 @@
 #pragma once
 #include "Streaming.h"
 #include "StreamingTpkt.h"
+#include "AsyncTcpClient.h"
 
 namespace catapult {
 namespace streaming {
@@ -24,9 +25,50 @@ namespace streaming {
         virtual bool write( net::Tpkt& ) = 0;
         virtual bool read( net::TpktRcv& ) = 0;
 
-    //        virtual void startReadLoop( std::function<void(Tpkt&)> ) = 0;
+        // write - writes packet without copying of its payload (see GatherTpkt.h)
+        virtual bool write( net::GatherTpkt& ) = 0;
     };
 
     std::unique_ptr<IStreamClient> createStreamingClient();
 
+    //
+    // createLocalStreamingClient - streamer, that writes frames to shared memory of server on the same host (see LocalIngest.h)
+    //
+    // 'connect( "localhost", port )' connects to the server, that is listening on 'port' with local ingest enabled;
+    // the ring of 'ringCapacity' bytes is created by START_STREAMING. STREAMING_DATA is not answered:
+    // 'write()' waits, while the ring has no space for the frame.
+    //
+    std::unique_ptr<IStreamClient> createLocalStreamingClient( uint32_t ringCapacity = 8*1024*1024 );
+
+    //
+    // IAsyncStreamClient - callback driven client (see AsyncTcpClient.h);
+    // many clients could share one IAsyncTcpClientContext
+    //
+    class IAsyncStreamClient
+    {
+    public:
+        typedef std::function<void( bool isConnected )>         ConnectHandler;
+        typedef std::function<void( StreamingTpktRcv& )>        PacketHandler;
+        typedef std::function<void()>                           CloseHandler;
+
+        virtual ~IAsyncStreamClient() = default;
+
+        virtual bool        hasError() = 0;
+        virtual std::string errorMessage() = 0;
+
+        virtual void asyncConnect( const std::string& addr, int port, ConnectHandler handler ) = 0;
+        virtual void close() = 0;
+
+        // asyncWrite - queues a copy of packet (it does not wait for the write)
+        virtual void asyncWrite( net::Tpkt& ) = 0;
+
+        // asyncWrite - queues packet without copying of its payload; 'func' is called after the write
+        virtual void asyncWrite( net::GatherTpktPtr packet, std::function<void()> func ) = 0;
+
+        // startReadLoop - 'packetHandler' is called for each received packet, 'closeHandler' - after disconnection
+        virtual void startReadLoop( PacketHandler packetHandler, CloseHandler closeHandler ) = 0;
+    };
+
+    std::unique_ptr<IAsyncStreamClient> createAsyncStreamingClient( std::shared_ptr<net::IAsyncTcpClientContext> context );
+
 }} // namespace catapult { namespace streaming
@@ -1,14 +1,31 @@
 #include <memory>
 #include <thread>
-#include <set>
-#include <map>
+#include <vector>
+#include <algorithm>
 #include <unordered_set>
+#include <unordered_map>
 #include <queue>
+#include <optional>
 #include <strstream>
 
+#include <boost/circular_buffer.hpp>
+
 #include "StreamManager.h"
 #include "AsyncTcpServer.h"
+#include "AsyncTcpClient.h"
 #include "StreamingTpkt.h"
+#include "FlowControl.h"
+#include "StreamRegistry.h"
+#include "ResumeRing.h"
+#include "RcuSnapshot.h"
+#include "FileViewer.h"
+#include "Multiplexing.h"
+#include "PacketSchema.h"
+#include "LocalIngest.h"
+
+#if CATAPULT_COROUTINES
+#include "SessionCoroutine.h"
+#endif
 
 namespace catapult {
 namespace streaming {
@@ -30,11 +47,28 @@ class ILiveStream: public std::enable_shared_from_this<ILiveStream>
 public:
     virtual ~ILiveStream() = default;
 
-    virtual void startSession( std::shared_ptr<IAsyncTcpSession> session ) = 0;
+    virtual void startSession( std::shared_ptr<IAsyncTcpSession> session, FlowControl flowControl ) = 0;
+    virtual void restoreSession( std::shared_ptr<IAsyncTcpSession> session, uint32_t lastAckedSeq, FlowControl flowControl ) = 0;
     virtual bool isLiveStreamRunning() = 0;
     virtual void addViewer( std::shared_ptr<IAsyncTcpSession> viewerTcpSession ) = 0;
+    virtual bool addTimeShiftViewer( std::shared_ptr<IAsyncTcpSession> viewerTcpSession, uint32_t lastSeq, uint64_t lastTimestampMs ) = 0;
     virtual void removeViewer( std::shared_ptr<Viewer> ) = 0;
 
+    // multiplexed channels (see Multiplexing.h)
+    virtual uint32_t channelId() const = 0;
+    virtual bool startMuxSession( std::shared_ptr<IAsyncTcpSession> session ) = 0;
+    virtual void handleMuxStreamingData( const TpktBufferPtr& muxPacket ) = 0;
+    virtual void endMuxSession() = 0;
+    virtual std::shared_ptr<Viewer> addMuxViewer( std::shared_ptr<IAsyncTcpSession> viewerTcpSession ) = 0;
+
+    // startRelay - the stream is received from the origin server (edge mode, see 'DistributorConfig::m_originAddress');
+    // 'endRelayHandler' is called once, when the upstream connection is closed
+    virtual void startRelay( std::shared_ptr<IAsyncTcpClientContext> context, const std::string& originAddress, uint32_t originPort,
+                             std::function<void()> endRelayHandler ) = 0;
+
+    // startLocalSession - the stream is received from shared memory of a local streamer (see LocalIngest.h)
+    virtual void startLocalSession( std::shared_ptr<ILocalIngestSession> localSession ) = 0;
+
     virtual void sendErrorResponse( std::string errorText) = 0;
     
     virtual void prepareToStop() = 0;
@@ -56,46 +90,117 @@ class Viewer: public std::enable_shared_from_this<Viewer>
     std::weak_ptr<ILiveStream>     m_streamerSession;
 
     StreamingTpkt                       m_response; //?
+
+    const DistributorConfig&            m_config;
+
+    // frames are skipped until a key frame (after the backlog was dropped)
+    bool                                m_isWaitingForKeyFrame = false;
     
     bool                                m_isStopping = false;
 
+    // is set for a channel of multiplexed connection (the connection is read by MuxSession)
+    uint32_t                            m_muxChannelId = 0;
+
+    // a viewer is published to fan-out before its GOP cache is queued (out of stream locks),
+    // so live frames are held by the viewer until 'join' is called
+    std::atomic<bool>                   m_isJoining{true};
+    std::mutex                          m_joinMutex;
+    struct JoinFrame
+    {
+        TpktBufferPtr   m_packet;
+        GatherTpktPtr   m_muxPacket;
+        uint32_t        m_seq;
+        bool            m_isKeyFrame;
+    };
+    std::vector<JoinFrame>              m_joinFrames;
+
 public:
 
-    Viewer( std::shared_ptr<IAsyncTcpSession> tcpSession, std::weak_ptr<ILiveStream> streamerSession )
+    Viewer( std::shared_ptr<IAsyncTcpSession> tcpSession, std::weak_ptr<ILiveStream> streamerSession, const DistributorConfig& config,
+            uint32_t muxChannelId = 0 )
         : m_tcpSession(tcpSession),
-          m_streamerSession( streamerSession )
+          m_streamerSession( streamerSession ),
+          m_config( config ),
+          m_muxChannelId( muxChannelId )
     {
+        if ( !isMuxChannel() )
+        {
+            m_tcpSession->setSendQueueLimits( m_config.m_viewerBacklogFrames, m_config.m_viewerBacklogBytes );
+        }
     }
 
     ~Viewer()
     {
+        if ( isMuxChannel() )
+        {
+            // the stream is ended; other channels of the connection are continued
+            if ( !m_isStopping )
+            {
+                StreamingTpkt endStreaming( 4, cmd::END_STREAMING );
+                endStreaming.writeUint32( m_muxChannelId );
+                m_tcpSession->asyncWrite( endStreaming, [] {} );
+            }
+            return;
+        }
+
         m_isStopping = true;
         if ( m_tcpSession )
             m_tcpSession->closeSession();
     }
 
+    bool isMuxChannel() const { return m_muxChannelId != 0; }
+
+#if CATAPULT_COROUTINES
     void readNextClientRequest()
     {
-        m_tcpSession->asyncRead( [this, weak=weak_from_this()]
+        serveViewer( m_tcpSession, weak_from_this(), false );
+    }
+
+    // serveViewer - writes m_response (if 'sendResponse' is set) and reads the viewer connection until it is closed
+    SessionCoroutine serveViewer( std::shared_ptr<IAsyncTcpSession> tcpSession, std::weak_ptr<Viewer> weak, bool sendResponse )
+    {
+        AwaitableSession session( tcpSession );
+
+        if ( sendResponse )
         {
+            bool isWritten = co_await session.write( m_response );
+
+            // the viewer is not held while the connection is read (it is deleted by its stream)
             auto shared = weak.lock();
             if ( !shared )
-                return;
+                co_return;
 
-            if ( m_tcpSession->hasReadError() && !m_isStopping )
+            if ( !isWritten && !m_isStopping )
             {
-                if ( !m_tcpSession->isEof() )
-                {
-                    LOG_WARN( "ViewerSession asyncRead error: " << m_tcpSession->readErrorMessage() << std::endl );
+                LOG_WARN( "ViewerSession asyncWrite error: " << m_tcpSession->writeErrorMessage() << std::endl );
+                m_tcpSession->closeSession();
+                co_return;
+            }
+            shared.reset();
+        }
 
-                    StreamingTpkt response( 0, cmd::ERROR_STREAMING_RESPONSE, m_tcpSession->readErrorMessage() );
-                    m_tcpSession->asyncWrite( response, [] {} );
-                }
+        //TODO handle viewer requests
+        while( co_await session.read() )
+        {
+        }
 
-                if ( auto shared = m_streamerSession.lock(); shared )
-                {
-                    shared->removeViewer( shared_from_this() );
-                }
+        if ( auto shared = weak.lock(); shared )
+        {
+            onReadError();
+        }
+    }
+#else
+    void readNextClientRequest()
+    {
+        m_tcpSession->asyncRead( [this, weak=weak_from_this()]
+        {
+            auto shared = weak.lock();
+            if ( !shared )
+                return;
+
+            if ( m_tcpSession->hasReadError() )
+            {
+                onReadError();
                 return;
             }
 
@@ -115,19 +220,50 @@ public:
 //            }
         });
     }
+#endif
+
+    // onReadError - the viewer is removed from its stream
+    void onReadError()
+    {
+        if ( m_isStopping )
+            return;
+
+        if ( !m_tcpSession->isEof() )
+        {
+            LOG_WARN( "ViewerSession asyncRead error: " << m_tcpSession->readErrorMessage() << std::endl );
+
+            StreamingTpkt response( 0, cmd::ERROR_STREAMING_RESPONSE, m_tcpSession->readErrorMessage() );
+            m_tcpSession->asyncWrite( response, [] {} );
+        }
+
+        if ( auto shared = m_streamerSession.lock(); shared )
+        {
+            shared->removeViewer( shared_from_this() );
+        }
+    }
 
     // ViewerSession::sendResponse
     void sendResponse()
     {
+        cmd::Id responseId = cmd::IS_NOT_STARTED_RESPONSE;
         if ( auto shared = m_streamerSession.lock(); shared->isLiveStreamRunning() )
         {
-            m_response.init( 0, cmd::OK_STREAMING_RESPONSE );
+            responseId = cmd::OK_STREAMING_RESPONSE;
         }
-        else
+
+        if ( isMuxChannel() )
         {
-            m_response.init( 0, cmd::IS_NOT_STARTED_RESPONSE );
+            m_response.init( 4, responseId );
+            m_response.writeUint32( m_muxChannelId );
+            m_tcpSession->asyncWrite( m_response, [] {} );
+            return;
         }
 
+        m_response.init( 0, responseId );
+
+#if CATAPULT_COROUTINES
+        serveViewer( m_tcpSession, weak_from_this(), true );
+#else
         m_tcpSession->asyncWrite( m_response, [this, weak=weak_from_this()]
         {
             if ( auto shared = weak.lock(); shared )
@@ -141,33 +277,150 @@ public:
                 readNextClientRequest();
             }
         });
+#endif
     }
 
-    void sendStreamingData( StreamingTpkt& packet )
+    // sendGopCache - sends frames since the last key frame (before live frames)
+    void sendGopCache( const std::vector<TpktBufferPtr>& gopCache )
     {
-        if ( m_tcpSession.get() )
+        if ( gopCache.empty() || !m_tcpSession.get() || m_isStopping )
+            return;
+
+        if ( isMuxChannel() )
         {
-            m_tcpSession->asyncWrite( packet, [this, weak=weak_from_this()]
+            for( const auto& packet : gopCache )
             {
-                if ( auto shared = weak.lock(); shared )
+                // the rest of GOP is skipped
+                if ( !m_tcpSession->asyncWrite( toMuxStreamingData( packet, m_muxChannelId ) ) )
                 {
-                    if ( m_tcpSession->hasWriteError() && !m_isStopping )
-                    {
-                        LOG_WARN( "sendStreamingData:asyncWrite error: " << m_tcpSession->writeErrorMessage() << std::endl );
-                        if ( auto shared = m_streamerSession.lock(); shared )
-                        {
-                            shared->removeViewer( shared_from_this() );
-                        }
-                    }
+                    m_isWaitingForKeyFrame = true;
+                    return;
                 }
-            });
+            }
+            return;
+        }
+
+        if ( !m_tcpSession->asyncWrite( gopCache ) )
+        {
+            LOG( "sendGopCache: GOP cache exceeds viewer backlog" << std::endl );
+            m_isWaitingForKeyFrame = true;
         }
     }
-    
+
+    // join - queues the response (if 'sendResponse' is set), GOP cache (the frames up to 'lastSeq')
+    // and live frames, that were held (except the frames of GOP cache)
+    void join( bool sendResponse, const std::vector<TpktBufferPtr>& gopCache, uint32_t lastSeq )
+    {
+        if ( sendResponse )
+        {
+            this->sendResponse();
+        }
+        sendGopCache( gopCache );
+
+        const std::lock_guard<std::mutex> autolock( m_joinMutex );
+        for( const auto& frame : m_joinFrames )
+        {
+            // (sequence numbers could wrap around)
+            if ( int32_t( frame.m_seq - lastSeq ) > 0 )
+            {
+                writeStreamingData( frame.m_packet, frame.m_muxPacket, frame.m_isKeyFrame );
+            }
+        }
+        m_joinFrames.clear();
+        m_isJoining = false;
+    }
+
+    // sendStreamingData - 'muxPacket' is the same frame as MUX_STREAMING_DATA (it is set for a channel of multiplexed connection)
+    void sendStreamingData( const TpktBufferPtr& packet, const GatherTpktPtr& muxPacket, uint32_t seq, bool isKeyFrame )
+    {
+        if ( m_isJoining.load( std::memory_order_acquire ) )
+        {
+            const std::lock_guard<std::mutex> autolock( m_joinMutex );
+            if ( m_isJoining.load( std::memory_order_relaxed ) )
+            {
+                m_joinFrames.push_back( JoinFrame{ packet, muxPacket, seq, isKeyFrame } );
+                return;
+            }
+        }
+
+        writeStreamingData( packet, muxPacket, isKeyFrame );
+    }
+
     void prepareToStop()
     {
         m_isStopping = true;
     }
+
+private:
+    void writeStreamingData( const TpktBufferPtr& packet, const GatherTpktPtr& muxPacket, bool isKeyFrame )
+    {
+        if ( !m_tcpSession.get() || m_isStopping )
+            return;
+
+        if ( m_isWaitingForKeyFrame )
+        {
+            if ( !isKeyFrame )
+                return;
+            m_isWaitingForKeyFrame = false;
+        }
+
+        // write errors are not handled here: after a write error the session is closed,
+        // so 'readNextClientRequest()' will remove this viewer
+        if ( isMuxChannel() ? m_tcpSession->asyncWrite( muxPacket ) : m_tcpSession->asyncWrite( packet, {} ) )
+            return;
+
+        // the viewer does not keep up with the stream
+        if ( m_config.m_slowViewerPolicy == SlowViewerPolicy::DISCONNECT )
+        {
+            if ( isMuxChannel() )
+            {
+                LOG_WARN( "sendStreamingData: connection backlog is overflowed; channel is closed" << std::endl );
+                closeMuxChannel();
+                return;
+            }
+
+            LOG_WARN( "sendStreamingData: viewer backlog is overflowed; viewer is disconnected" << std::endl );
+            m_tcpSession->closeSession();
+            return;
+        }
+
+        // the queue is shared by other channels, so only frames of this channel are skipped
+        if ( isMuxChannel() )
+        {
+            LOG( "sendStreamingData: connection backlog is overflowed; channel frames are dropped" << std::endl );
+            m_isWaitingForKeyFrame = true;
+            return;
+        }
+
+        LOG( "sendStreamingData: viewer backlog is overflowed; frames are dropped" << std::endl );
+        m_tcpSession->dropQueuedPackets();
+
+        if ( !isKeyFrame || !m_tcpSession->asyncWrite( packet, {} ) )
+        {
+            m_isWaitingForKeyFrame = true;
+        }
+    }
+
+    // closeMuxChannel - sends END_STREAMING of the channel and removes the viewer from its stream;
+    // the removal is posted, because it waits for the end of fan-out, that calls it
+    void closeMuxChannel()
+    {
+        m_isStopping = true;
+
+        StreamingTpkt endStreaming( 4, cmd::END_STREAMING );
+        endStreaming.writeUint32( m_muxChannelId );
+        m_tcpSession->asyncWrite( endStreaming, [] {} );
+
+        m_tcpSession->postOnStrand( [weak=weak_from_this(), streamerSession=m_streamerSession]
+        {
+            auto viewer = weak.lock();
+            auto liveStream = streamerSession.lock();
+            if ( viewer && liveStream )
+            {
+                liveStream->removeViewer( viewer );
+            }
+        });
+    }
 };
 
 //-------------------------------------------------------------------------------------------------------------------------------
@@ -178,7 +431,6 @@ public:
 class LiveStream : public ILiveStream
 {
     typedef std::shared_ptr<Viewer>  ViewerSessionPtr;
-    typedef std::shared_ptr<StreamingTpkt>  StreamingTpktPtr;
 
     friend class Distributor;
     friend class Viewer;
@@ -186,40 +438,166 @@ class LiveStream : public ILiveStream
     StreamId                            m_streamId;
     std::shared_ptr<IAsyncTcpSession>   m_tcpSession;
     StreamingTpkt                       m_response;
-    
-    std::queue<StreamingTpktPtr>        m_streamData;
-    std::vector<StreamingTpktPtr>       m_streamDataPool;
-    std::mutex                          m_streamDataMutex;
 
-    std::set<ViewerSessionPtr>          m_viewers;
+    const DistributorConfig&            m_config;
+
+    // is set in CREDIT_WINDOW mode
+    std::optional<IngestAckCounter>     m_ackCounter;
+    StreamingTpkt                       m_ackPacket;    // (its buffer is reused by the read loop)
+
+    // buffers for received STREAMING_DATA packets (they return to it after fan-out)
+    TpktBufferPoolPtr                   m_bufferPool;
+
+    // m_viewers - immutable snapshot; join/leave replace it by a modified copy (under m_viewersMutex),
+    // so fan-out reads it without locks and reference counting (see RcuSnapshot.h)
+    typedef std::vector<ViewerSessionPtr> ViewerList;
+    RcuSnapshot<ViewerList>             m_viewers{ std::make_shared<const ViewerList>() };
     std::mutex                          m_viewersMutex;
 
+    // m_gopCache - frames since the last key frame (up to m_lastFanOutSeq);
+    // fan-out holds m_gopCacheMutex only to update it (viewers are served out of the lock),
+    // so the mutex is contended only by joining viewers.
+    // A joining viewer is published with the copy of the cache (a frame could be sent to it by fan-out and be in the copy);
+    // it holds live frames until the copy is queued and skips the held frames of the copy (see 'Viewer::join'),
+    // so it gets each frame exactly once
+    std::vector<TpktBufferPtr>          m_gopCache;
+    size_t                              m_gopCacheBytes = 0;
+    bool                                m_isGopCacheValid = false;
+    uint32_t                            m_lastFanOutSeq = uint32_t(-1);
+    std::mutex                          m_gopCacheMutex;
+
+    // is set, if recording is on
+    std::unique_ptr<IStreamRecording>   m_recording;
+
+    // sequence number of the next STREAMING_DATA packet (see ResumeRing.h)
+    uint32_t                            m_nextSeq = 0;
+
+    // m_resumeRing is updated with m_gopCache (under m_gopCacheMutex)
+    ResumeRing                          m_resumeRing;
+
+    struct FanOutFrame
+    {
+        TpktBufferPtr   m_packet;
+        GatherTpktPtr   m_muxPacket;    // (it is made by fan-out for multiplexed viewers)
+        uint32_t        m_seq;
+        uint64_t        m_timestampMs;
+        bool            m_isKeyFrame;
+    };
+
+    //
+    // FanOutTask - sends received frames to viewers (on the strand of streamer session)
+    //
+    // Frames are queued by the read loop; the task is posted only if it is not posted yet,
+    // so the fan-out does not allocate a handler for each frame (see 'StrandTask').
+    //
+    class FanOutTask : public StrandTask
+    {
+        LiveStream& m_liveStream;
+
+    public:
+        std::mutex                              m_mutex;
+        boost::circular_buffer<FanOutFrame>     m_queued{16};
+        bool                                    m_isPosted = false;
+
+        // frames, that are being sent (they are swapped with m_queued)
+        boost::circular_buffer<FanOutFrame>     m_frames{16};
+
+        FanOutTask( LiveStream& liveStream ) : m_liveStream( liveStream ) {}
+
+        void run() override
+        {
+            {
+                const std::lock_guard<std::mutex> autolock( m_mutex );
+                std::swap( m_queued, m_frames );
+                m_isPosted = false;
+            }
+
+            // the next task is run on the same strand after this one
+            for( auto& frame : m_frames )
+            {
+                m_liveStream.sendFrameToViewers( frame );
+            }
+            m_frames.clear();
+        }
+    };
+    FanOutTask                          m_fanOutTask{ *this };
+
+    // streamer connection is lost; the stream waits for RESTORE_STREAMING (during the grace period)
+    bool                                m_isWaitingForRestore = false;
+    std::shared_ptr<IAsyncTcpSession>   m_droppedSession;
+
+    // RESTORE_STREAMING, that was received before the loss of the current connection was detected
+    struct PendingRestore
+    {
+        std::shared_ptr<IAsyncTcpSession>   m_tcpSession;
+        uint32_t                            m_lastAckedSeq;
+        FlowControl                         m_flowControl;
+    };
+    std::optional<PendingRestore>       m_pendingRestore;
+
+    // grace timers of previous connections are ignored
+    uint32_t                            m_sessionGeneration = 0;
+
+    // guards m_tcpSession replacement and the restore state
+    std::mutex                          m_sessionMutex;
+
     EndSessionHandler                   m_endSessionHandler;
     
     bool                                m_isStopping = false;
 
+    // the number of stream on server (it is channel id of multiplexed connections)
+    uint32_t                            m_channelId;
+
+    // m_tcpSession is a multiplexed connection (it is read and closed by MuxSession)
+    bool                                m_isMuxSession = false;
+
+    // upstream viewer connection of relayed stream (it is the ingest of the stream instead of m_tcpSession)
+    std::shared_ptr<IAsyncTcpClient>    m_upstream;
+    std::function<void()>               m_endRelayHandler;
+    std::atomic<bool>                   m_isRelayEnded{false};
+
+    // shared-memory ingest of local streamer (it is the ingest of the stream instead of m_tcpSession)
+    std::shared_ptr<ILocalIngestSession> m_localSession;
+
 public:
 
-    LiveStream( StreamId& streamId, EndSessionHandler endSessionHandler )
+    LiveStream( StreamId& streamId, EndSessionHandler endSessionHandler, const DistributorConfig& config, IRecorder* recorder, uint32_t channelId )
         : m_streamId(streamId),
-          m_endSessionHandler(endSessionHandler)
+          m_config(config),
+          m_bufferPool( TpktBufferPool::create( config.m_streamBufferPoolMaxBytes ) ),
+          m_recording( recorder ? recorder->startRecording( streamId ) : nullptr ),
+          m_resumeRing( config.m_resumeRingMilliseconds, config.m_resumeRingMaxBytes ),
+          m_endSessionHandler(endSessionHandler),
+          m_channelId(channelId)
     {
         LOG( "StreamerSession: " << m_streamId.m_id << std::endl );
     }
 
     ~LiveStream()
     {
-        LOG( "~StreamerSession: " << m_streamId.m_id << std::endl );
-        if ( m_tcpSession )
+        [[maybe_unused]] auto stats = m_bufferPool->stats();
+        LOG( "~StreamerSession: " << m_streamId.m_id << "; buffers allocated: " << stats.m_allocatedNumber
+                << " reused: " << stats.m_reusedNumber << " freed: " << stats.m_freedNumber << std::endl );
+        if ( m_tcpSession && !m_isMuxSession )
             m_tcpSession->closeSession();
+        if ( m_upstream )
+            m_upstream->close();
+        if ( m_localSession )
+            m_localSession->stop();
     }
     
-    void startSession( std::shared_ptr<IAsyncTcpSession> tcpSession ) override
+    void startSession( std::shared_ptr<IAsyncTcpSession> tcpSession, FlowControl flowControl ) override
     {
-        m_tcpSession = tcpSession;
+        {
+            const std::lock_guard<std::mutex> autolock( m_sessionMutex );
+            m_tcpSession = tcpSession;
+        }
+
         if ( m_tcpSession )
         {
-            sendOkStreamingResponse();
+            initSession( flowControl );
+            sendStartStreamingResponse();
+            readNextClientRequest();
         }
         else
         {
@@ -228,208 +606,969 @@ public:
         }
     }
 
-    bool isLiveStreamRunning() override { return m_tcpSession ? true : false; }
-
-    void addViewer( std::shared_ptr<IAsyncTcpSession> viewerTcpSession ) override
+    // restoreSession - continues the stream by a new streamer connection
+    void restoreSession( std::shared_ptr<IAsyncTcpSession> tcpSession, uint32_t lastAckedSeq, FlowControl flowControl ) override
     {
-        std::shared_ptr<Viewer> viewerSession = std::make_shared<Viewer>( viewerTcpSession, std::weak_ptr<ILiveStream>( shared_from_this() ) );
+        std::shared_ptr<IAsyncTcpSession> currentSession;
+        std::shared_ptr<IAsyncTcpSession> replacedSession;
+        bool isMuxSession;
         {
-            const std::lock_guard<std::mutex> autolock( m_viewersMutex );
-            m_viewers.insert( viewerSession );
+            const std::lock_guard<std::mutex> autolock( m_sessionMutex );
+
+            isMuxSession = m_isMuxSession;
+            if ( m_tcpSession && !isMuxSession )
+            {
+                // loss of the current connection is not detected yet;
+                // the restore will be done, when the connection will be closed
+                if ( m_pendingRestore )
+                {
+                    replacedSession = m_pendingRestore->m_tcpSession;
+                }
+                m_pendingRestore = PendingRestore{ tcpSession, lastAckedSeq, flowControl };
+                currentSession = m_tcpSession;
+            }
         }
-        viewerSession->sendResponse();
-    }
 
-    void removeViewer( std::shared_ptr<Viewer> viewerSession ) override
-    {
-        auto it = m_viewers.find( viewerSession );
-        if ( it == m_viewers.end() )
+        // a multiplexed stream is ended with its connection
+        if ( isMuxSession )
         {
-            LOG_ERR( "removeViewer: internal error")
+            replacedSession = tcpSession;
         }
-        else
+
+        if ( replacedSession )
         {
-            std::shared_ptr<Viewer> shared = *it;
-            {
-                const std::lock_guard<std::mutex> autolock( m_viewersMutex );
-                m_viewers.erase( it );
-            }
-            // when shared will be deleted it will call closeSession,
-            // so it shoul de out of lock
+            StreamingTpkt response( 0, cmd::ERROR_STREAMING_RESPONSE, "stream could not be restored" );
+            replacedSession->asyncWrite( response, [replacedSession] { replacedSession->closeSession(); } );
         }
-    }
 
-    void sendOkStreamingResponse()
-    {
-        m_response.init( 0, cmd::OK_STREAMING_RESPONSE );
+        if ( isMuxSession )
+        {
+            return;
+        }
 
-        m_tcpSession->asyncWrite( m_response, [this, weak=weak_from_this()]
+        if ( currentSession )
         {
-            if ( auto shared = weak.lock(); shared )
-            {
-                if ( m_tcpSession && m_tcpSession->hasWriteError() )
-                {
-                    LOG_WARN( "asyncWrite error: " << m_tcpSession->writeErrorMessage() << std::endl );
-                    m_tcpSession->closeSession();
-                    m_tcpSession = nullptr;
-                    return;
-                }
-                readNextClientRequest();
-            }
-        });
+            currentSession->closeSession();
+        }
+        else
+        {
+            resumeSession( PendingRestore{ tcpSession, lastAckedSeq, flowControl } );
+        }
     }
 
-    void sendErrorResponse( std::string errorText) override
+    uint32_t channelId() const override { return m_channelId; }
+
+    // startMuxSession - starts stream by a channel of multiplexed connection; returns false, if the stream is running
+    bool startMuxSession( std::shared_ptr<IAsyncTcpSession> tcpSession ) override
     {
-        m_response.init( 0, cmd::ERROR_STREAMING_RESPONSE, errorText );
+        const std::lock_guard<std::mutex> autolock( m_sessionMutex );
 
-        m_tcpSession->asyncWrite( m_response, [this, weak=weak_from_this()]
-        {
-            if ( auto shared = weak.lock(); shared )
-            {
-                if ( m_tcpSession && m_tcpSession->hasWriteError() )
-                {
-                    LOG_WARN( "asyncWrite error: " << m_tcpSession->writeErrorMessage() << std::endl );
-                    m_tcpSession->closeSession();
-                    m_tcpSession = nullptr;
-                    return;
-                }
-                readNextClientRequest();
-            }
-        });
+        if ( m_tcpSession || m_isWaitingForRestore )
+            return false;
+
+        m_tcpSession = tcpSession;
+        m_isMuxSession = true;
+        m_ackCounter.reset();
+        return true;
     }
 
-    void readNextClientRequest()
+    // handleMuxStreamingData - is called by MuxSession (by the read loop of the connection);
+    // the packet is converted into STREAMING_DATA in place
+    void handleMuxStreamingData( const TpktBufferPtr& muxPacket ) override
     {
-        m_tcpSession->asyncRead( [this, weak=weak_from_this()]
+        // { packetLenght, version, MUX_STREAMING_DATA, channelId, frameFlags, ... }
+        if ( muxPacket->lenght() < TPKT_HEADER_SIZE + 8 )
         {
-            auto shared = weak.lock();
-            if ( !shared )
-                return;
+            StreamingTpkt response( 0, cmd::ERROR_STREAMING_RESPONSE, "invalid streaming data lenngth" );
+            m_tcpSession->asyncWrite( response, [] {} );
+            return;
+        }
 
-            if ( m_tcpSession->hasReadError() )
-            {
-                if ( !m_tcpSession->isEof() && !m_isStopping )
-                {
-                    LOG_WARN( "StreamerSession asyncRead error: " << m_tcpSession->readErrorMessage() << std::endl );
+        uint32_t frameFlags = readUint32( muxPacket->data() + TPKT_HEADER_SIZE + 4 );
 
-                    StreamingTpkt response( 0, cmd::ERROR_STREAMING_RESPONSE, m_tcpSession->readErrorMessage() );
-                    m_tcpSession->asyncWrite( response, [] {} );
-                }
+        // frames are stored and sent to not multiplexed viewers as STREAMING_DATA
+        // (the packet of the read batch is not used after it by MuxSession)
+        fromMuxStreamingData( *muxPacket );
+        handleStreamingData( muxPacket, frameFlags );
+    }
 
-                m_tcpSession->closeSession();
-                return;
-            }
+    void endMuxSession() override
+    {
+        m_endSessionHandler( m_streamId );
+    }
 
-            try
-            {
-                StreamingTpktRcv& request = static_cast<StreamingTpktRcv&>( m_tcpSession->request() );
+    std::shared_ptr<Viewer> addMuxViewer( std::shared_ptr<IAsyncTcpSession> viewerTcpSession ) override
+    {
+        std::shared_ptr<Viewer> viewerSession = std::make_shared<Viewer>( viewerTcpSession, std::weak_ptr<ILiveStream>( shared_from_this() ),
+                                                                          m_config, m_channelId );
+        auto [gopCache, lastSeq] = publishViewer( viewerSession );
+        viewerSession->join( true, gopCache, lastSeq );
+        return viewerSession;
+    }
 
-                // version
-                uint32_t version;
-                request.read( version );
-                if ( version != PROTOCOL_VERSION )
-                    throw std::runtime_error("invalid protocol version");
+    bool isLiveStreamRunning() override
+    {
+        const std::lock_guard<std::mutex> autolock( m_sessionMutex );
+        return m_tcpSession || m_isWaitingForRestore || m_upstream || m_localSession;
+    }
 
-                // requestId
-                uint32_t requestId;
-                request.read( requestId );
+    void addViewer( std::shared_ptr<IAsyncTcpSession> viewerTcpSession ) override
+    {
+        std::shared_ptr<Viewer> viewerSession = std::make_shared<Viewer>( viewerTcpSession, std::weak_ptr<ILiveStream>( shared_from_this() ), m_config );
 
-                LOG( "StreamerSession: clientRequest:" << cmd::name(requestId) << std::endl );
+        // response and GOP cache are queued before live frames
+        auto [gopCache, lastSeq] = publishViewer( viewerSession );
+        viewerSession->join( true, gopCache, lastSeq );
+    }
 
-                switch( requestId )
-                {
-                    case cmd::END_STREAMING:
-                        m_endSessionHandler( m_streamId );
-                        break;
+    // addTimeShiftViewer - adds a viewer, that has received frames up to (lastSeq, lastTimestampMs) from recording;
+    // the following frames are taken from ResumeRing; returns false, if the ring has no such frame
+    bool addTimeShiftViewer( std::shared_ptr<IAsyncTcpSession> viewerTcpSession, uint32_t lastSeq, uint64_t lastTimestampMs ) override
+    {
+        std::shared_ptr<Viewer> viewerSession = std::make_shared<Viewer>( viewerTcpSession, std::weak_ptr<ILiveStream>( shared_from_this() ), m_config );
 
-                    case cmd::RESTORE_STREAMING:
-                        sendErrorResponse( "command RESTORE_STREAMING is not ready" );
-                        readNextClientRequest();
-                        break;
+        std::vector<TpktBufferPtr> missedFrames;
+        uint32_t ringLastSeq;
+        {
+            const std::lock_guard<std::mutex> autolock( m_viewersMutex );
+            const std::lock_guard<std::mutex> gopCacheLock( m_gopCacheMutex );
+
+            // the viewer is usually near the end of the ring
+            const auto& frames = m_resumeRing.frames();
+            auto it = frames.rbegin();
+            while( it != frames.rend() && !( it->m_seq == lastSeq && it->m_timestampMs == lastTimestampMs ) )
+                it++;
+
+            if ( it == frames.rend() )
+                return false;
+
+            missedFrames.reserve( it - frames.rbegin() );
+            for( auto frameIt = it.base(); frameIt != frames.end(); frameIt++ )
+                missedFrames.push_back( frameIt->m_packet );
+            ringLastSeq = m_lastFanOutSeq;
+
+            insertViewer( viewerSession );
+        }
+
+        // response was sent by FileViewer; missed frames are queued before live frames
+        viewerSession->join( false, missedFrames, ringLastSeq );
+        viewerSession->readNextClientRequest();
+        return true;
+    }
+
+    void removeViewer( std::shared_ptr<Viewer> viewerSession ) override
+    {
+        // the old snapshot could hold the last reference to viewer;
+        // when it will be deleted it will call closeSession, so it should be out of lock
+        std::shared_ptr<const ViewerList> oldViewers;
+        bool isLastViewer;
+        {
+            const std::lock_guard<std::mutex> autolock( m_viewersMutex );
+
+            const ViewerList& current = m_viewers.current();
+            auto it = std::find( current.begin(), current.end(), viewerSession );
+            if ( it == current.end() )
+            {
+                LOG_ERR( "removeViewer: internal error")
+                return;
+            }
+
+            auto viewers = std::make_shared<ViewerList>();
+            viewers->reserve( current.size()-1 );
+            viewers->insert( viewers->end(), current.begin(), it );
+            viewers->insert( viewers->end(), it+1, current.end() );
+
+            isLastViewer = viewers->empty();
+            oldViewers = m_viewers.publish( std::move(viewers) );
+        }
+
+        // a relayed stream is not pulled from the origin without local viewers
+        if ( isLastViewer && m_upstream )
+        {
+            LOG( "relay: the last viewer left: " << m_streamId.m_id << std::endl );
+            endRelay();
+        }
+    }
+
+    void startRelay( std::shared_ptr<IAsyncTcpClientContext> context, const std::string& originAddress, uint32_t originPort,
+                     std::function<void()> endRelayHandler ) override
+    {
+        m_endRelayHandler = std::move( endRelayHandler );
+        {
+            const std::lock_guard<std::mutex> autolock( m_sessionMutex );
+            m_upstream = createAsyncTcpClient( context );
+        }
+
+        // received frames are placed in buffers of this stream (as frames of a streamer)
+        m_upstream->setBufferPool( m_bufferPool );
+
+        m_upstream->asyncConnect( originAddress, std::to_string( originPort ), [this, weak=weak_from_this()]( bool isConnected )
+        {
+            auto shared = weak.lock();
+            if ( !shared )
+                return;
+
+            if ( !isConnected )
+            {
+                LOG_WARN( "relay: cannot connect to origin: " << m_upstream->errorMessage() << std::endl );
+                endRelay();
+                return;
+            }
+
+            // the edge is an ordinary viewer of the origin
+            StreamingTpkt request = StartLiveViewingRequest::encode( m_streamId, ViewingStart{} );
+            m_upstream->asyncWrite( request );
+
+            m_upstream->startReadLoop( [this, weak]( const TpktBufferPtr& packet )
+            {
+                if ( auto shared = weak.lock(); shared )
+                {
+                    handleUpstreamPacket( packet );
+                }
+            },
+            [this, weak]
+            {
+                if ( auto shared = weak.lock(); shared )
+                {
+                    if ( m_upstream->hasError() && !m_isRelayEnded )
+                    {
+                        LOG_WARN( "relay: upstream connection error: " << m_upstream->errorMessage() << std::endl );
+                    }
+                    endRelay();
+                }
+            });
+        });
+    }
+
+    // handleUpstreamPacket - is called by the read loop of the upstream connection
+    void handleUpstreamPacket( const TpktBufferPtr& packet )
+    {
+        try
+        {
+            StreamingTpktRcv response( packet );
+
+            uint32_t version, responseId;
+            response.read( version, responseId );
+
+            switch( responseId )
+            {
+                case cmd::STREAMING_DATA:
+                {
+                    // the frame is fanned out as it was received from the origin
+                    uint32_t frameFlags;
+                    response.read( frameFlags );
+
+                    handleStreamingData( packet, frameFlags );
+                    break;
+                }
+
+                case cmd::ERROR_STREAMING_RESPONSE:
+                {
+                    std::string errorText;
+                    response.read( errorText );
+
+                    LOG_WARN( "relay: origin error: " << m_streamId.m_id << ": " << errorText << std::endl );
+                    endRelay();
+                    break;
+                }
+
+                // (the origin must be the owner of the stream, if it is a node of cluster)
+                case cmd::REDIRECT_RESPONSE:
+                {
+                    std::string ownerAddress;
+                    uint32_t    ownerPort;
+                    RedirectResponse::decode( response, ownerAddress, ownerPort );
+
+                    LOG_WARN( "relay: origin redirects " << m_streamId.m_id << " to " << ownerAddress << ":" << ownerPort << std::endl );
+                    endRelay();
+                    break;
+                }
+
+                // (the stream could be started by its streamer later)
+                case cmd::OK_STREAMING_RESPONSE:
+                case cmd::IS_NOT_STARTED_RESPONSE:
+                default:
+                    break;
+            }
+        }
+        catch ( std::runtime_error& error )
+        {
+            LOG_WARN( "relay: invalid packet from origin: " << m_streamId.m_id << ": " << error.what() << std::endl );
+            endRelay();
+        }
+    }
+
+    void startLocalSession( std::shared_ptr<ILocalIngestSession> localSession ) override
+    {
+        {
+            const std::lock_guard<std::mutex> autolock( m_sessionMutex );
+            m_localSession = localSession;
+        }
+
+        // frames are copied from the ring to buffers of this stream
+        localSession->setBufferPool( m_bufferPool );
+
+        localSession->start( [this, weak=weak_from_this()]( const TpktBufferPtr& packet, uint32_t frameFlags )
+        {
+            if ( auto shared = weak.lock(); shared )
+            {
+                handleStreamingData( packet, frameFlags );
+            }
+        },
+        [this, weak=weak_from_this()]( const std::string& errorText )
+        {
+            if ( auto shared = weak.lock(); shared )
+            {
+                if ( !errorText.empty() )
+                {
+                    LOG_WARN( "local streamer error: " << m_streamId.m_id << ": " << errorText << std::endl );
+                }
+                m_endSessionHandler( m_streamId );
+            }
+        });
+
+        localSession->sendResponse( StreamingTpkt( 0, cmd::OK_STREAMING_RESPONSE ) );
+    }
+
+    // endRelay - closes the upstream connection and ends the stream (only once)
+    void endRelay()
+    {
+        if ( m_isRelayEnded.exchange( true ) )
+            return;
+
+        m_upstream->close();
+        m_endRelayHandler();
+    }
+
+    // initSession - must be called before reading of requests
+    void initSession( FlowControl flowControl )
+    {
+        if ( flowControl == CREDIT_WINDOW )
+        {
+            m_ackCounter.emplace( m_config.m_ingestWindowFrames, m_config.m_ingestWindowBytes );
+        }
+        else
+        {
+            m_ackCounter.reset();
+        }
+
+        // received STREAMING_DATA packets will be placed in buffers of this stream
+        m_tcpSession->request().setBufferPool( m_bufferPool );
+    }
+
+    // onSessionDropped - is called, when streamer connection is lost (without END_STREAMING)
+    void onSessionDropped( std::shared_ptr<IAsyncTcpSession> tcpSession )
+    {
+        std::optional<PendingRestore> pendingRestore;
+        uint32_t generation;
+        {
+            const std::lock_guard<std::mutex> autolock( m_sessionMutex );
+            if ( m_tcpSession != tcpSession )
+                return;
+
+            m_tcpSession = nullptr;
+            m_droppedSession = tcpSession;
+            m_isWaitingForRestore = !m_isStopping;
+            generation = ++m_sessionGeneration;
+            std::swap( pendingRestore, m_pendingRestore );
+        }
+
+        if ( m_isStopping )
+            return;
+
+        if ( pendingRestore )
+        {
+            resumeSession( std::move( *pendingRestore ) );
+            return;
+        }
+
+        LOG( "streamer connection is lost: " << m_streamId.m_id << std::endl );
+        tcpSession->asyncWait( m_config.m_restoreGracePeriodMs, [this, weak=weak_from_this(), generation]
+        {
+            auto shared = weak.lock();
+            if ( !shared )
+                return;
+
+            {
+                const std::lock_guard<std::mutex> autolock( m_sessionMutex );
+                if ( generation != m_sessionGeneration || !m_isWaitingForRestore )
+                    return;
+                m_isWaitingForRestore = false;
+                m_droppedSession.reset();
+            }
+
+            LOG( "stream is not restored: " << m_streamId.m_id << std::endl );
+            m_endSessionHandler( m_streamId );
+        });
+    }
+
+    // resumeSession - replaces the dropped streamer connection (if the stream is still waiting for restore)
+    void resumeSession( PendingRestore restore )
+    {
+        std::shared_ptr<IAsyncTcpSession> droppedSession;
+        {
+            const std::lock_guard<std::mutex> autolock( m_sessionMutex );
+
+            // the streamer could not acknowledge frames, that were not received (sequence numbers wrap around)
+            bool isValidSeq = int32_t( restore.m_lastAckedSeq - m_nextSeq ) <= 0;
+
+            if ( m_isWaitingForRestore && isValidSeq )
+            {
+                m_tcpSession = restore.m_tcpSession;
+                m_isWaitingForRestore = false;
+                m_sessionGeneration++;
+                std::swap( droppedSession, m_droppedSession );
+            }
+        }
+
+        if ( !droppedSession )
+        {
+            StreamingTpkt response( 0, cmd::ERROR_STREAMING_RESPONSE, "stream could not be restored" );
+            restore.m_tcpSession->asyncWrite( response, [tcpSession=restore.m_tcpSession] { tcpSession->closeSession(); } );
+            return;
+        }
+
+        // fan-out of frames of the dropped connection is finished on its strand before the new ones
+        droppedSession->postOnStrand( [this, shared=shared_from_this(), flowControl=restore.m_flowControl]
+        {
+            initSession( flowControl );
+            sendRestoreStreamingResponse();
+            readNextClientRequest();
+        });
+    }
+
+    void sendRestoreStreamingResponse()
+    {
+        m_response.init( m_ackCounter ? 16 : 4, cmd::OK_STREAMING_RESPONSE );
+        m_response.writeUint32( m_nextSeq );
+        if ( m_ackCounter )
+        {
+            m_response.writeUint32( CREDIT_WINDOW );
+            m_response.writeUint32( m_ackCounter->windowFrames() );
+            m_response.writeUint32( m_ackCounter->windowBytes() );
+        }
+        sendResponse();
+    }
+
+    void sendStartStreamingResponse()
+    {
+        if ( !m_ackCounter )
+        {
+            sendOkStreamingResponse();
+            return;
+        }
+
+        m_response.init( 12, cmd::OK_STREAMING_RESPONSE );
+        m_response.writeUint32( CREDIT_WINDOW );
+        m_response.writeUint32( m_ackCounter->windowFrames() );
+        m_response.writeUint32( m_ackCounter->windowBytes() );
+        sendResponse();
+    }
+
+    void sendOkStreamingResponse()
+    {
+        m_response.init( 0, cmd::OK_STREAMING_RESPONSE );
+        sendResponse();
+    }
+
+    void sendErrorResponse( std::string errorText) override
+    {
+        m_response.init( 0, cmd::ERROR_STREAMING_RESPONSE, errorText );
+        sendResponse();
+    }
+
+    // sendAck - sends cumulative STREAMING_ACK (CREDIT_WINDOW mode)
+    void sendAck()
+    {
+        m_ackPacket.init( 8, cmd::STREAMING_ACK );
+        m_ackPacket.writeUint32( m_ackCounter->receivedFrames(), m_ackCounter->receivedBytes() );
+        m_tcpSession->asyncWrite( m_ackPacket, []{} );
+    }
+
+    // sendResponse - queues m_response (reading of requests is not blocked by the write)
+    // (after a write error the session is closed, so its reading will fail)
+    void sendResponse()
+    {
+        // the handler is called by the session itself, so it does not hold the session
+        // (and it is small enough to be stored in std::function without allocation)
+        m_tcpSession->asyncWrite( m_response, [tcpSession=m_tcpSession.get()]
+        {
+            if ( tcpSession->hasWriteError() )
+            {
+                LOG_WARN( "asyncWrite error: " << tcpSession->writeErrorMessage() << std::endl );
+                tcpSession->closeSession();
+            }
+        });
+    }
+
+#if CATAPULT_COROUTINES
+    void readNextClientRequest()
+    {
+        ingestLoop( m_tcpSession, weak_from_this() );
+    }
+
+    // ingestLoop - reads requests of streamer until END_STREAMING or loss of the connection
+    SessionCoroutine ingestLoop( std::shared_ptr<IAsyncTcpSession> tcpSession, std::weak_ptr<ILiveStream> weak )
+    {
+        AwaitableSession session( tcpSession );
+
+        while( co_await session.read() )
+        {
+            auto shared = weak.lock();
+            if ( !shared || !handleReceivedPackets() )
+                co_return;
+        }
+
+        if ( auto shared = weak.lock(); shared )
+        {
+            onReadError();
+        }
+    }
+#else
+    void readNextClientRequest()
+    {
+        m_tcpSession->asyncReadBatch( [this, weak=weak_from_this()]
+        {
+            auto shared = weak.lock();
+            if ( !shared )
+                return;
+
+            if ( m_tcpSession->hasReadError() )
+            {
+                onReadError();
+                return;
+            }
+
+            if ( !handleReceivedPackets() )
+                return;
+
+            // the next read is done with this handler
+            m_tcpSession->asyncReadBatch();
+        });
+    }
+#endif
+
+    // handleReceivedPackets - returns false, if requests should not be read anymore
+    bool handleReceivedPackets()
+    {
+        // in CREDIT_WINDOW mode one read could bring several packets
+        for( auto& packet : m_tcpSession->receivedPackets() )
+        {
+            if ( !handleClientRequest( packet ) )
+                return false;
+        }
+        return true;
+    }
+
+    // onReadError - the stream is kept for RESTORE_STREAMING
+    void onReadError()
+    {
+        if ( !m_tcpSession->isEof() && !m_isStopping )
+        {
+            LOG_WARN( "StreamerSession asyncRead error: " << m_tcpSession->readErrorMessage() << std::endl );
+
+            StreamingTpkt response( 0, cmd::ERROR_STREAMING_RESPONSE, m_tcpSession->readErrorMessage() );
+            m_tcpSession->asyncWrite( response, [] {} );
+        }
+
+        m_tcpSession->closeSession();
+        onSessionDropped( m_tcpSession );
+    }
+
+    // handleClientRequest - returns false, if requests should not be read anymore
+    bool handleClientRequest( const TpktBufferPtr& packet )
+    {
+        try
+        {
+            StreamingTpktRcv request( packet );
+
+            // version and requestId
+            uint32_t version, requestId;
+            request.read( version, requestId );
+            if ( version != PROTOCOL_VERSION )
+                throw std::runtime_error("invalid protocol version");
+
+            LOG( "StreamerSession: clientRequest:" << cmd::name(requestId) << std::endl );
+
+            switch( requestId )
+            {
+                case cmd::END_STREAMING:
+                    m_endSessionHandler( m_streamId );
+                    return false;
+
+                case cmd::RESTORE_STREAMING:
+                    sendErrorResponse( "RESTORE_STREAMING should be sent by a new connection" );
+                    return true;
+
+                case cmd::STREAMING_DATA:
+                {
+                    uint32_t dataLen = request.restDataLen();
+                    if ( dataLen<4 )
+                    {
+                        LOG_WARN( "StreamerSession asyncRead error: dataLen=" << dataLen << std::endl );
+
+                        StreamingTpkt response( 0, cmd::ERROR_STREAMING_RESPONSE, "invalid streaming data lenngth" );
+                        m_tcpSession->asyncWrite( response, [] {} );
+                    }
+                    else
+                    {
+                        uint32_t frameFlags;
+                        request.read( frameFlags );
+
+                        handleStreamingData( packet, frameFlags );
+                    }
+
+                    if ( m_ackCounter )
+                    {
+                        if ( m_ackCounter->onReceived( packet->lenght() ) )
+                        {
+                            sendAck();
+                        }
+                    }
+                    else
+                    {
+                        sendOkStreamingResponse();
+                    }
+                    return true;
+                }
+
+                default:
+                    auto errText = (std::strstream() << "unsupported command: " << cmd::name(requestId)).str();
+                    LOG_ERR( errText << std::endl );
+                    throw std::runtime_error( errText );
+            }
+        }
+        catch ( std::runtime_error error )
+        {
+            LOG_ERR( ": error:" << error.what() << std::endl );
+            StreamingTpkt response( 0, cmd::ERROR_STREAMING_RESPONSE, error.what() );
+            m_tcpSession->asyncWrite( response, []{} );
+            return false;
+        }
+    }
+
+    void handleStreamingData( const TpktBufferPtr& packet, uint32_t frameFlags )
+    {
+        bool isKeyFrame = (frameFlags & frame::KEY_FRAME) != 0;
+
+        uint32_t seq = m_nextSeq++;
+        uint64_t timestampMs = ResumeRing::nowMs();
+
+        if ( m_recording )
+        {
+            m_recording->append( packet, timestampMs, seq, frameFlags );
+        }
+
+        // STREAMING_DATA packet is sent to viewers as it was received
+        // (and is cached for new viewers even if there are no viewers now)
+        sendStreamingDataToViewers( packet, seq, timestampMs, isKeyFrame );
+    }
+
+    void sendStreamingDataToViewers( TpktBufferPtr packet, uint32_t seq, uint64_t timestampMs, bool isKeyFrame )
+    {
+        // relayed and local frames are received by one thread (the upstream read loop or the thread of local session),
+        // so they are sent at once
+        if ( m_upstream || m_localSession )
+        {
+            FanOutFrame frame{ std::move(packet), {}, seq, timestampMs, isKeyFrame };
+            sendFrameToViewers( frame );
+            return;
+        }
+
+        {
+            const std::lock_guard<std::mutex> autolock( m_fanOutTask.m_mutex );
+
+            auto& queued = m_fanOutTask.m_queued;
+            if ( queued.full() )
+            {
+                queued.set_capacity( queued.capacity()*2 );
+            }
+            queued.push_back( FanOutFrame{ std::move(packet), {}, seq, timestampMs, isKeyFrame } );
+
+            if ( m_fanOutTask.m_isPosted )
+                return;
+            m_fanOutTask.m_isPosted = true;
+        }
 
-                    case cmd::STREAMING_DATA:
-                    {
-                        if ( m_viewers.size() > 0 )
-                        {
-                            uint32_t dataLen = request.restDataLen();
-                            if ( dataLen<4 )
-                            {
-                                LOG_WARN( "StreamerSession asyncRead error: dataLen=" << dataLen << std::endl );
-
-                                StreamingTpkt response( 0, cmd::ERROR_STREAMING_RESPONSE, "invalid streaming data lenngth" );
-                                m_tcpSession->asyncWrite( response, [] {} );
-                            }
-                            else
-                            {
-                                {
-                                    const std::lock_guard<std::mutex> autolock( m_streamDataMutex );
-
-//                                    if ( m_streamDataPool.empty() )
-//                                    {
-                                        m_streamData.push( std::make_shared<StreamingTpkt>() );
-                                        //_LOG( "m_streamData.size=" << m_streamData.size() );
-//                                    }
-//                                    else
-//                                    {
-//                                        //_LOG( "m_streamDataPool.size=" << m_streamDataPool.size() );
-//                                        m_streamData.push( m_streamDataPool.front() );
-//                                        m_streamDataPool.pop();
-//                                    }
-
-                                    m_streamData.back().get()->initWithStreamingData( 0, cmd::STREAMING_DATA, request.restDataPtr(), dataLen );
-                                }
-
-                                sendStreamingDataToViewers();
-                            }
-                        }
-                        sendOkStreamingResponse();
-                        break;
-                    }
+        // the task holds the stream (by aliasing shared pointer)
+        m_tcpSession->postOnStrand( StrandTaskPtr( shared_from_this(), &m_fanOutTask ) );
+    }
+
+    // sendFrameToViewers - is called on the strand of streamer session (by m_fanOutTask)
+    void sendFrameToViewers( FanOutFrame& frame )
+    {
+        {
+            const std::lock_guard<std::mutex> autolock( m_gopCacheMutex );
+            updateGopCache( frame.m_packet, frame.m_isKeyFrame );
+            m_resumeRing.push( frame.m_seq, frame.m_timestampMs, frame.m_isKeyFrame, frame.m_packet );
+            m_lastFanOutSeq = frame.m_seq;
+        }
+
+        // (the snapshot is loaded after the cache update, so a viewer, that is published later, has the frame in its copy)
+        RcuSnapshot<ViewerList>::ReadGuard viewers( m_viewers );
+        for( const auto& viewer : *viewers )
+        {
+            if ( !viewer->isMuxChannel() )
+            {
+                viewer->sendStreamingData( frame.m_packet, {}, frame.m_seq, frame.m_isKeyFrame );
+                continue;
+            }
+
+            // the frame is converted once for all multiplexed viewers
+            if ( !frame.m_muxPacket )
+            {
+                frame.m_muxPacket = toMuxStreamingData( frame.m_packet, m_channelId );
+            }
+            viewer->sendStreamingData( frame.m_packet, frame.m_muxPacket, frame.m_seq, frame.m_isKeyFrame );
+        }
+    }
+
+    // must be called under m_gopCacheMutex
+    void updateGopCache( const TpktBufferPtr& packet, bool isKeyFrame )
+    {
+        if ( isKeyFrame )
+        {
+            m_gopCache.clear();
+            m_gopCacheBytes = 0;
+            m_isGopCacheValid = true;
+        }
+        else if ( !m_isGopCacheValid )
+        {
+            return;
+        }
+
+        // a part of GOP is useless for a viewer
+        if ( m_gopCache.size() >= m_config.m_gopCacheMaxFrames || m_gopCacheBytes + packet->lenght() > m_config.m_gopCacheMaxBytes )
+        {
+            LOG( "GOP cache is overflowed: " << m_streamId.m_id << std::endl );
+            m_gopCache.clear();
+            m_gopCacheBytes = 0;
+            m_isGopCacheValid = false;
+            return;
+        }
+
+        m_gopCache.push_back( packet );
+        m_gopCacheBytes += packet->lenght();
+    }
+    
+    void prepareToStop() override
+    {
+        RcuSnapshot<ViewerList>::ReadGuard viewers( m_viewers );
+        for( const auto& viewer : *viewers )
+            viewer->prepareToStop();
+        m_isStopping = true;
+    }
+
+private:
+    // publishViewer - adds the viewer to fan-out; returns the GOP cache, that the viewer should get before live frames,
+    // and the sequence number of its last frame
+    std::pair<std::vector<TpktBufferPtr>,uint32_t> publishViewer( const ViewerSessionPtr& viewerSession )
+    {
+        const std::lock_guard<std::mutex> autolock( m_viewersMutex );
+        const std::lock_guard<std::mutex> gopCacheLock( m_gopCacheMutex );
+
+        insertViewer( viewerSession );
+        return { m_gopCache, m_lastFanOutSeq };
+    }
+
+    // insertViewer - replaces m_viewers by a copy with the viewer; must be called under m_viewersMutex
+    // (the previous snapshot does not hold the last reference of any viewer)
+    void insertViewer( const ViewerSessionPtr& viewerSession )
+    {
+        const ViewerList& current = m_viewers.current();
+
+        auto viewers = std::make_shared<ViewerList>();
+        viewers->reserve( current.size()+1 );
+        viewers->insert( viewers->end(), current.begin(), current.end() );
+        viewers->push_back( viewerSession );
+
+        m_viewers.publish( std::move(viewers) );
+    }
+};
+
+//-------------------------------------------------------------------------------------------------------------------------------
+
+// LiveStreamProvider - returns stream (it is created, if it does not exist)
+typedef std::function<std::shared_ptr<ILiveStream>( StreamId& )>  LiveStreamProvider;
+
+//
+// MuxSession - multiplexed connection (see Multiplexing.h)
+//
+// All channels share the read loop and the write queue of the connection.
+//
+class MuxSession : public std::enable_shared_from_this<MuxSession>
+{
+    std::shared_ptr<IAsyncTcpSession>   m_tcpSession;
+    LiveStreamProvider                  m_liveStreamProvider;
+    LiveStreamProvider                  m_viewedStreamProvider;     // (it could relay the stream, see 'ILiveStream::startRelay()')
+    const DistributorConfig&            m_config;
+
+    // channels are used only by the read loop
+    std::unordered_map<uint32_t, std::shared_ptr<ILiveStream>>  m_streamerChannels;
+
+    // a viewer channel is ended with its stream (then the stream and viewer are deleted)
+    struct ViewerChannel
+    {
+        std::weak_ptr<ILiveStream>      m_liveStream;
+        std::weak_ptr<Viewer>           m_viewer;
+    };
+    std::unordered_map<uint32_t, ViewerChannel>                 m_viewerChannels;
+
+public:
+    MuxSession( std::shared_ptr<IAsyncTcpSession> tcpSession, LiveStreamProvider liveStreamProvider, LiveStreamProvider viewedStreamProvider,
+                const DistributorConfig& config )
+        : m_tcpSession( tcpSession ),
+          m_liveStreamProvider( liveStreamProvider ),
+          m_viewedStreamProvider( viewedStreamProvider ),
+          m_config( config )
+    {
+        // the backlog is shared by viewer channels
+        m_tcpSession->setSendQueueLimits( m_config.m_viewerBacklogFrames, m_config.m_viewerBacklogBytes );
+    }
+
+    void start()
+    {
+        StreamingTpkt response( 0, cmd::OK_STREAMING_RESPONSE );
+        m_tcpSession->asyncWrite( response, [] {} );
+
+        readNextRequests();
+    }
 
-                    default:
-                        auto errText = (std::strstream() << "unsupported command: " << cmd::name(requestId)).str();
-                        LOG_ERR( errText << std::endl );
-                        throw std::runtime_error( errText );
+private:
+    void readNextRequests()
+    {
+        m_tcpSession->asyncReadBatch( [this, shared=shared_from_this()]
+        {
+            if ( m_tcpSession->hasReadError() )
+            {
+                if ( !m_tcpSession->isEof() )
+                {
+                    LOG_WARN( "MuxSession asyncRead error: " << m_tcpSession->readErrorMessage() << std::endl );
                 }
+                closeChannels();
+                m_tcpSession->closeSession();
+                return;
             }
-            catch ( std::runtime_error error )
+
+            for( auto& packet : m_tcpSession->receivedPackets() )
             {
-                LOG_ERR( ": error:" << error.what() << std::endl );
-                StreamingTpkt response( 0, cmd::ERROR_STREAMING_RESPONSE, error.what() );
-                m_tcpSession->asyncWrite( response, []{} );
+                handleRequest( packet );
             }
+
+            // the next read is done with this handler
+            m_tcpSession->asyncReadBatch();
         });
     }
 
-    void sendStreamingDataToViewers()
+    void handleRequest( const TpktBufferPtr& packet )
     {
-        if ( !m_streamData.empty() )
+        try
         {
-            m_streamDataMutex.lock();
-            auto packet = m_streamData.front();
-            m_streamData.pop();
-            m_streamDataMutex.unlock();
+            StreamingTpktRcv request( packet );
 
-            
-            m_tcpSession->postOnStrand( [ this, shared=shared_from_this(), packet ]
+            uint32_t version, requestId;
+            request.read( version, requestId );
+            if ( version != PROTOCOL_VERSION )
+                throw std::runtime_error("invalid protocol version");
+
+            switch( requestId )
             {
-                for( auto it = m_viewers.begin(); it != m_viewers.end(); it++ )
+                case cmd::MUX_STREAMING_DATA:
                 {
-                    (*it)->sendStreamingData( *packet.get() );
+                    uint32_t channelId;
+                    request.read( channelId );
+
+                    auto it = m_streamerChannels.find( channelId );
+                    if ( it == m_streamerChannels.end() )
+                        throw std::runtime_error( "unknown channel" );
+
+                    it->second->handleMuxStreamingData( packet );
+                    break;
                 }
+                case cmd::START_STREAMING:
+                {
+                    StreamId streamId;
+                    request.read( streamId );
 
-                const std::lock_guard<std::mutex> autolock( m_streamDataMutex );
-                m_streamDataPool.push_back( packet );
-            });
+                    std::shared_ptr<ILiveStream> liveStream = m_liveStreamProvider( streamId );
+                    if ( !liveStream->startMuxSession( m_tcpSession ) )
+                        throw std::runtime_error( "stream is already running" );
+
+                    m_streamerChannels[ liveStream->channelId() ] = liveStream;
+
+                    StreamingTpkt response( 4, cmd::OK_STREAMING_RESPONSE );
+                    response.writeUint32( liveStream->channelId() );
+                    m_tcpSession->asyncWrite( response, [] {} );
+                    break;
+                }
+                case cmd::START_LIFE_STREAM_VIEWING:
+                {
+                    StreamId streamId;
+                    request.read( streamId );
+
+                    std::shared_ptr<ILiveStream> liveStream = m_viewedStreamProvider( streamId );
+                    // (a channel of slow viewer could be closed by the stream, see 'Viewer::closeMuxChannel()')
+                    if ( auto it = m_viewerChannels.find( liveStream->channelId() ); it != m_viewerChannels.end() && !it->second.m_viewer.expired() )
+                        throw std::runtime_error( "stream is already viewed by this connection" );
+
+                    // the response is sent by 'addMuxViewer()' (before the GOP cache)
+                    auto viewer = liveStream->addMuxViewer( m_tcpSession );
+                    m_viewerChannels[ liveStream->channelId() ] = ViewerChannel{ liveStream, viewer };
+                    break;
+                }
+                case cmd::END_STREAMING:
+                {
+                    uint32_t channelId;
+                    request.read( channelId );
+                    closeChannel( channelId );
+                    break;
+                }
+                default:
+                    auto errText = (std::strstream() << "unsupported command: " << cmd::name(requestId)).str();
+                    LOG_ERR( errText << std::endl );
+                    throw std::runtime_error( errText );
+            }
+        }
+        catch ( std::runtime_error& error )
+        {
+            // other channels are continued
+            LOG_ERR( "MuxSession: error:" << error.what() << std::endl );
+            StreamingTpkt response( 0, cmd::ERROR_STREAMING_RESPONSE, error.what() );
+            m_tcpSession->asyncWrite( response, []{} );
         }
     }
-    
-    void prepareToStop() override
+
+    void closeChannel( uint32_t channelId )
     {
-        for( auto& it : m_viewers )
-            it->prepareToStop();
-        m_isStopping = true;
+        if ( auto it = m_streamerChannels.find( channelId ); it != m_streamerChannels.end() )
+        {
+            it->second->endMuxSession();
+            m_streamerChannels.erase( it );
+            return;
+        }
+
+        if ( auto it = m_viewerChannels.find( channelId ); it != m_viewerChannels.end() )
+        {
+            auto liveStream = it->second.m_liveStream.lock();
+            auto viewer = it->second.m_viewer.lock();
+            m_viewerChannels.erase( it );
+
+            if ( liveStream && viewer )
+            {
+                // the viewer will not send END_STREAMING
+                viewer->prepareToStop();
+                liveStream->removeViewer( viewer );
+            }
+        }
+    }
+
+    void closeChannels()
+    {
+        while( !m_streamerChannels.empty() )
+            closeChannel( m_streamerChannels.begin()->first );
+
+        while( !m_viewerChannels.empty() )
+            closeChannel( m_viewerChannels.begin()->first );
     }
 };
 
@@ -442,13 +1581,28 @@ class Distributor : protected IDistributor
 {
     std::shared_ptr<IAsyncTcpServer>                     m_tcpServer;
 
-    std::map<StreamId,std::shared_ptr<ILiveStream>>      m_liveStreamMap;
-    std::mutex                                           m_liveStreamMutex;
+    StreamRegistry<std::shared_ptr<ILiveStream>>         m_liveStreams;
 
     using SessionWPtr = std::weak_ptr<IAsyncTcpSession>;
     std::queue<std::pair<std::time_t,SessionWPtr>>       m_newSessionQueue;
     std::mutex                                           m_newSessionMutex;
 
+    DistributorConfig                                    m_config;
+
+    std::shared_ptr<IRecorder>                           m_recorder;
+
+    // channel ids of multiplexed connections (see Multiplexing.h)
+    std::atomic<uint32_t>                                m_nextChannelId{1};
+
+    // upstream connections of relayed streams (edge mode)
+    std::shared_ptr<IAsyncTcpClientContext>              m_upstreamContext;
+
+    // owners of streams (if this server is a node of cluster)
+    std::unique_ptr<ClusterRing>                         m_clusterRing;
+
+    // streamers on this host (see LocalIngest.h)
+    std::shared_ptr<ILocalIngestServer>                  m_localIngestServer;
+
     bool                                                 m_isStopping = false;
 
 public:
@@ -459,24 +1613,92 @@ public:
 
     virtual ~Distributor() {};
 
-    void startStreamManager( uint32_t port, uint threadNumber, std::string& errorText ) override
+    void startStreamManager( uint32_t port, uint threadNumber, std::string& errorText, const DistributorConfig& config ) override
     {
-        m_tcpServer = createAsyncTcpServer(
-            std::bind( &Distributor::handleNewStreamSession, this, std::placeholders::_1 )
-        );
+        m_config = config;
+
+        if ( !m_config.m_recorderConfig.m_recordDirectory.empty() )
+        {
+            m_recorder = createRecorder( m_config.m_recorderConfig );
+        }
+
+        if ( !m_config.m_originAddress.empty() )
+        {
+            m_upstreamContext = createAsyncTcpClientContext( 1 );
+        }
+
+        if ( !m_config.m_clusterNodes.empty() )
+        {
+            const auto& nodes = m_config.m_clusterNodes;
+            if ( std::find( nodes.begin(), nodes.end(), m_config.m_selfNode ) == nodes.end() )
+            {
+                errorText = "self node is not in cluster: " + m_config.m_selfNode.name();
+                return;
+            }
+            m_clusterRing = std::make_unique<ClusterRing>( nodes );
+        }
+
+        auto newSessionHandler = std::bind( &Distributor::handleNewStreamSession, this, std::placeholders::_1 );
+
+        if ( m_config.m_tcpServerMode == TcpServerMode::IO_URING )
+        {
+            std::string uringErrorText;
+            m_tcpServer = createUringTcpServer( newSessionHandler, uringErrorText );
+            if ( !m_tcpServer )
+            {
+                LOG_WARN( "io_uring is not available (" << uringErrorText << "); sharded server is used" << std::endl );
+                m_tcpServer = createShardedAsyncTcpServer( newSessionHandler, true );
+            }
+        }
+        else if ( m_config.m_tcpServerMode == TcpServerMode::SHARED_IO_CONTEXT )
+        {
+            m_tcpServer = createAsyncTcpServer( newSessionHandler );
+        }
+        else
+        {
+            bool useReusePort = m_config.m_tcpServerMode == TcpServerMode::SHARDED;
+            m_tcpServer = createShardedAsyncTcpServer( newSessionHandler, useReusePort );
+        }
         m_tcpServer->start( port, threadNumber );
         errorText = "";
+
+        if ( m_config.m_isLocalIngestEnabled )
+        {
+            m_localIngestServer = createLocalIngestServer( std::bind( &Distributor::handleLocalStreaming, this, std::placeholders::_1, std::placeholders::_2 ) );
+
+            std::string localErrorText;
+            if ( !m_localIngestServer->start( port, localErrorText ) )
+            {
+                LOG_WARN( "local ingest is not available: " << localErrorText << std::endl );
+                m_localIngestServer.reset();
+            }
+        }
     }
 
     void stopStreamManager() override
     {
-        for( auto& it : m_liveStreamMap )
+        m_liveStreams.forEach( [] ( const std::shared_ptr<ILiveStream>& stream )
         {
-            it.second->prepareToStop();
-        }
-        LOG( "m_liveStreamMap.size()=" << m_liveStreamMap.size() << std::endl );
+            stream->prepareToStop();
+        });
+        LOG( "m_liveStreams.size()=" << m_liveStreams.size() << std::endl );
         m_isStopping = true;
         m_tcpServer->stop();
+
+        if ( m_localIngestServer )
+        {
+            m_localIngestServer->stop();
+        }
+
+        if ( m_upstreamContext )
+        {
+            m_upstreamContext->stop();
+        }
+
+        if ( m_recorder )
+        {
+            m_recorder->stop();
+        }
         LOG( "stopStreamManager ended" << std::endl );
     }
 
@@ -529,50 +1751,19 @@ public:
             {
                 StreamingTpktRcv& request = static_cast<StreamingTpktRcv&>( newSession->request() );
 
-                // version
-                uint32_t version;
-                request.read( version );
+                // version and requestId
+                uint32_t version, requestId;
+                request.read( version, requestId );
                 if ( version != PROTOCOL_VERSION )
                     throw std::runtime_error("invalid protocol version");
-
-                // requestId
-                uint32_t requestId;
-                request.read( requestId );
                 
                 LOG( "StreamManager: clientRequest:" << cmd::name(requestId) << std::endl );
 
-                switch( requestId )
+                if ( !FirstRequests::dispatch( requestId, request, *this, newSession ) )
                 {
-                    case cmd::START_STREAMING:
-                    {
-                        StreamId streamId;
-                        request.read( streamId );
-                        handleStartStreaming( streamId, newSession );
-                        break;
-                    }
-                    case cmd::START_LIFE_STREAM_VIEWING:
-                    {
-                        StreamId streamId;
-                        request.read( streamId );
-                        handleViewerConnection( streamId, newSession );
-                        break;
-                    }
-                    case cmd::START_FILE_STREAM_VIEWING:
-                    {
-                        // IS NOT READY
-                        std::string errorText("START_FILE_STREAM_VIEWING is not ready");
-                        StreamingTpkt response( 0, cmd::ERROR_STREAMING_RESPONSE, errorText );
-                        newSession->asyncWrite( response, [newSession]
-                        {
-                            newSession->closeSession();
-                            return;
-                        });
-                        break;
-                    }
-                    default:
-                        auto errText = (std::strstream() << "unsupported command: " << cmd::name(requestId)).str();
-                        LOG_ERR( errText << std::endl );
-                        throw std::runtime_error( errText );
+                    auto errText = (std::strstream() << "unsupported command: " << cmd::name(requestId)).str();
+                    LOG_ERR( errText << std::endl );
+                    throw std::runtime_error( errText );
                 }
 
                 LOG( "clientRequest:" << std::endl );
@@ -590,65 +1781,198 @@ public:
         });
     }
 
-    void handleStartStreaming( StreamId& streamId, std::shared_ptr<IAsyncTcpSession> tcpSession )
+    //
+    // First requests of a session; they are dispatched by 'FirstRequests' table
+    //
+    typedef CommandTable< StartStreamingRequest,
+                          RestoreStreamingRequest,
+                          StartLiveViewingRequest,
+                          StartFileViewingRequest,
+                          StartMultiplexingRequest > FirstRequests;
+
+    friend FirstRequests;
+
+    void handle( StartStreamingRequest, const std::shared_ptr<IAsyncTcpSession>& tcpSession, StreamId& streamId, uint32_t flowControl )
+    {
+        if ( redirectToOwner( streamId, tcpSession ) )
+            return;
+
+        handleStartStreaming( streamId, FlowControl(flowControl), tcpSession );
+    }
+
+    void handle( RestoreStreamingRequest, const std::shared_ptr<IAsyncTcpSession>& tcpSession, StreamId& streamId, uint32_t lastAckedSeq, uint32_t flowControl )
+    {
+        if ( redirectToOwner( streamId, tcpSession ) )
+            return;
+
+        handleRestoreStreaming( streamId, lastAckedSeq, FlowControl(flowControl), tcpSession );
+    }
+
+    void handle( StartLiveViewingRequest, const std::shared_ptr<IAsyncTcpSession>& tcpSession, StreamId& streamId, const ViewingStart& start )
+    {
+        if ( redirectToOwner( streamId, tcpSession ) )
+            return;
+
+        uint64_t startTimeMs = viewingStartTimeMs( start.m_mode, start.m_value );
+
+        if ( startTimeMs == 0 )
+        {
+            handleViewerConnection( streamId, tcpSession );
+        }
+        else
+        {
+            handleTimeShiftViewerConnection( streamId, startTimeMs, tcpSession );
+        }
+    }
+
+    void handle( StartFileViewingRequest, const std::shared_ptr<IAsyncTcpSession>& tcpSession, StreamId& streamId, const ViewingStart& start )
     {
-        m_liveStreamMutex.lock();
+        if ( redirectToOwner( streamId, tcpSession ) )
+            return;
+
+        uint64_t startTimeMs = viewingStartTimeMs( start.m_mode, start.m_value );
+
+        if ( !m_recorder )
+            throw std::runtime_error( "streams are not recorded" );
+
+        createFileViewer( tcpSession, streamId, m_config )->start( startTimeMs );
+    }
 
-        auto stream = m_liveStreamMap.find( streamId );
-        if ( stream != m_liveStreamMap.end() )
+    void handle( StartMultiplexingRequest, const std::shared_ptr<IAsyncTcpSession>& tcpSession )
+    {
+        auto liveStreamProvider = [this]( StreamId& streamId )
         {
-            m_liveStreamMutex.unlock();
+            bool isInserted;
+            return m_liveStreams.insertIfAbsent( streamId, [&] { return createLiveStream( streamId ); }, isInserted );
+        };
+        auto viewedStreamProvider = [this]( StreamId& streamId )
+        {
+            return viewedLiveStream( streamId );
+        };
+        std::make_shared<MuxSession>( tcpSession, liveStreamProvider, viewedStreamProvider, m_config )->start();
+    }
 
-            // Have some viewers connected before?
-            if ( !stream->second->isLiveStreamRunning() )
-            {
-                stream->second->startSession( tcpSession );
-                return;
-            }
+    // redirectToOwner - returns true, if the stream is owned by another node of cluster (REDIRECT_RESPONSE is sent)
+    bool redirectToOwner( const StreamId& streamId, const std::shared_ptr<IAsyncTcpSession>& tcpSession )
+    {
+        if ( !m_clusterRing )
+            return false;
 
+        const ClusterNode& owner = m_clusterRing->owner( streamId );
+        if ( owner == m_config.m_selfNode )
+            return false;
+
+        LOG( "redirect: " << streamId.m_id << " -> " << owner.name() << std::endl );
+
+        StreamingTpkt response = RedirectResponse::encode( owner.m_address, owner.m_port );
+        tcpSession->asyncWrite( response, [tcpSession] { tcpSession->closeSession(); } );
+        return true;
+    }
+
+    void handleStartStreaming( StreamId& streamId, FlowControl flowControl, std::shared_ptr<IAsyncTcpSession> tcpSession )
+    {
+        bool isInserted;
+        std::shared_ptr<ILiveStream> session = m_liveStreams.insertIfAbsent( streamId, [&] { return createLiveStream( streamId ); }, isInserted );
+
+        // Have some viewers connected before?
+        if ( !isInserted && session->isLiveStreamRunning() )
+        {
             //TODO  ? for demo: reconnect or send error message "session already running"
             //tcpSession->asyncWrite(...)
 
             return;
         }
 
-        // Add session
-        EndSessionHandler handler = std::bind( &Distributor::handleEndStreamingSession, this, std::placeholders::_1);
-        std::shared_ptr<ILiveStream> session = std::make_shared<LiveStream>( streamId, handler );
-        m_liveStreamMap[ streamId ] = session;
-        m_liveStreamMutex.unlock();
-
         // Start session
-        session->startSession( tcpSession );
+        session->startSession( tcpSession, flowControl );
+    }
+
+    // handleLocalStreaming - START_STREAMING of local streamer (it could not be redirected)
+    void handleLocalStreaming( StreamId& streamId, std::shared_ptr<ILocalIngestSession> localSession )
+    {
+        if ( m_clusterRing && !( m_clusterRing->owner( streamId ) == m_config.m_selfNode ) )
+        {
+            localSession->sendResponse( ErrorStreamingResponse::encode( "stream is owned by " + m_clusterRing->owner( streamId ).name() ) );
+            return;
+        }
+
+        bool isInserted;
+        std::shared_ptr<ILiveStream> session = m_liveStreams.insertIfAbsent( streamId, [&] { return createLiveStream( streamId ); }, isInserted );
+
+        if ( !isInserted && session->isLiveStreamRunning() )
+        {
+            localSession->sendResponse( ErrorStreamingResponse::encode( "stream is running" ) );
+            return;
+        }
+
+        session->startLocalSession( localSession );
+    }
+
+    void handleRestoreStreaming( StreamId& streamId, uint32_t lastAckedSeq, FlowControl flowControl, std::shared_ptr<IAsyncTcpSession> tcpSession )
+    {
+        std::shared_ptr<ILiveStream> session = m_liveStreams.find( streamId );
+        if ( !session )
+        {
+            StreamingTpkt response( 0, cmd::ERROR_STREAMING_RESPONSE, "stream is not found" );
+            tcpSession->asyncWrite( response, [tcpSession] { tcpSession->closeSession(); } );
+            return;
+        }
+
+        session->restoreSession( tcpSession, lastAckedSeq, flowControl );
+    }
+
+    std::shared_ptr<ILiveStream> createLiveStream( StreamId& streamId )
+    {
+        EndSessionHandler handler = std::bind( &Distributor::handleEndStreamingSession, this, std::placeholders::_1);
+        return std::make_shared<LiveStream>( streamId, handler, m_config, m_recorder.get(), m_nextChannelId++ );
     }
 
     void handleEndStreamingSession( StreamId& streamId )
     {
-        std::thread( [=] { m_liveStreamMap.erase( streamId ); } ).detach();
+        std::thread( [this, streamId] { m_liveStreams.erase( streamId ); } ).detach();
     }
 
-    void handleViewerConnection( StreamId& streamId, std::shared_ptr<IAsyncTcpSession> tcpSession )
+    // handleTimeShiftViewerConnection - the viewer gets recording of the stream, until it catches up with live fan-out
+    void handleTimeShiftViewerConnection( StreamId& streamId, uint64_t startTimeMs, std::shared_ptr<IAsyncTcpSession> tcpSession )
     {
-        std::shared_ptr<ILiveStream> session;
+        if ( !m_recorder )
+            throw std::runtime_error( "streams are not recorded" );
 
-        // get streaming session
+        auto switchToLiveHandler = [this, streamId, weakSession=tcpSession->weak_from_this()]( uint32_t lastSeq, uint64_t lastTimestampMs )
         {
-            const std::lock_guard<std::mutex> autolock( m_liveStreamMutex );
+            auto session = m_liveStreams.find( streamId );
+            auto tcpSession = weakSession.lock();
+            return session && tcpSession && session->addTimeShiftViewer( tcpSession, lastSeq, lastTimestampMs );
+        };
 
-            auto it = m_liveStreamMap.find( streamId );
-            if ( it != m_liveStreamMap.end() )
-            {
-                session = it->second;
-            }
-            else
+        createFileViewer( tcpSession, streamId, m_config, switchToLiveHandler )->start( startTimeMs );
+    }
+
+    void handleViewerConnection( StreamId& streamId, std::shared_ptr<IAsyncTcpSession> tcpSession )
+    {
+        viewedLiveStream( streamId )->addViewer( tcpSession );
+    }
+
+    // viewedLiveStream - returns stream for a new viewer
+    // (viewers could be connected before the streamer; in edge mode a new stream is relayed from the origin)
+    std::shared_ptr<ILiveStream> viewedLiveStream( StreamId& streamId )
+    {
+        bool isInserted;
+        std::shared_ptr<ILiveStream> session = m_liveStreams.insertIfAbsent( streamId, [&] { return createLiveStream( streamId ); }, isInserted );
+
+        if ( isInserted && m_upstreamContext )
+        {
+            // only this stream is unregistered (a new stream with the same id could be registered after it)
+            auto endRelayHandler = [this, streamId, weak=std::weak_ptr<ILiveStream>( session )]
             {
-                EndSessionHandler handler = std::bind( &Distributor::handleEndStreamingSession, this, std::placeholders::_1);
-                session = std::make_shared<LiveStream>( streamId, handler );
-                m_liveStreamMap[ streamId ] = session;
-            }
+                if ( auto session = weak.lock(); session )
+                {
+                    m_liveStreams.erase( streamId, session );
+                }
+            };
+            session->startRelay( m_upstreamContext, m_config.m_originAddress, m_config.m_originPort, endRelayHandler );
         }
-
-        session->addViewer( tcpSession );
+        return session;
     }
 };
 
@@ -1,6 +1,8 @@
 #pragma once
 #include "Streaming.h"
 #include "Tpkt.h"
+#include "Recorder.h"
+#include "ClusterRing.h"
 
 namespace catapult {
 
@@ -9,6 +11,81 @@ namespace net { class IAsyncTcpSession; }
 namespace streaming {
 
 
+    // SlowViewerPolicy - what to do with a viewer, which backlog exceeds the limits
+    enum class SlowViewerPolicy
+    {
+        DROP_TO_NEXT_KEY_FRAME,     // drop queued frames and continue from the next key frame
+        DISCONNECT,                 // close the viewer connection (a channel of multiplexed connection is closed by END_STREAMING)
+    };
+
+    // TcpServerMode - how threads of Distributor share connections
+    enum class TcpServerMode
+    {
+        SHARED_IO_CONTEXT,          // all threads run one io_context
+        SHARDED,                    // io_context per thread with SO_REUSEPORT acceptors
+        SHARDED_ROUND_ROBIN,        // io_context per thread, sessions are handed over by one acceptor
+        IO_URING,                   // io_uring per thread with SO_REUSEPORT listeners (falls back to SHARDED)
+    };
+
+    //
+    // DistributorConfig - settings of Distributor
+    //
+    struct DistributorConfig
+    {
+        // limits of frames, that are queued for a viewer but not written yet
+        uint32_t            m_viewerBacklogFrames   = 256;
+        uint32_t            m_viewerBacklogBytes    = 16*1024*1024;
+        SlowViewerPolicy    m_slowViewerPolicy      = SlowViewerPolicy::DROP_TO_NEXT_KEY_FRAME;
+
+        // credits granted to a streamer in CREDIT_WINDOW mode (see FlowControl.h)
+        uint32_t            m_ingestWindowFrames    = 64;
+        uint32_t            m_ingestWindowBytes     = 8*1024*1024;
+
+        // limits of GOP cache (frames since the last key frame, that are sent to a new viewer);
+        // if a GOP exceeds them, it is not cached
+        uint32_t            m_gopCacheMaxFrames     = 256;
+        uint32_t            m_gopCacheMaxBytes      = 16*1024*1024;
+
+        // a stream waits for RESTORE_STREAMING after the loss of streamer connection (see ResumeRing.h)
+        uint32_t            m_restoreGracePeriodMs  = 10*1000;
+        uint64_t            m_resumeRingMilliseconds = 10*1000;
+        uint64_t            m_resumeRingMaxBytes    = 64*1024*1024;
+
+        // max size of free buffers, that are kept by a stream for received frames
+        uint64_t            m_streamBufferPoolMaxBytes = 32*1024*1024;
+
+        TcpServerMode       m_tcpServerMode         = TcpServerMode::SHARED_IO_CONTEXT;
+
+        // recording of streams (it is off, if 'm_recorderConfig.m_recordDirectory' is empty)
+        RecorderConfig      m_recorderConfig;
+
+        // file viewing (START_FILE_STREAM_VIEWING) of recordings:
+        // frames are sent ahead of their timestamps not more than 'm_fileViewingLeadMs';
+        // a recording, that is not changed during 'm_fileViewingIdleTimeoutMs', is finished
+        uint32_t            m_fileViewingLeadMs         = 500;
+        uint32_t            m_fileViewingReadaheadBytes = 4*1024*1024;
+        uint32_t            m_fileViewingIdleTimeoutMs  = 10*1000;
+
+        // time-shift viewers (see FileViewer.h) are paced at this speed (percent of real time);
+        // if it is more than 100, they catch up with the stream and are switched to live fan-out
+        uint32_t            m_timeShiftPlaybackPercent  = 100;
+
+        // edge mode: a live stream, that is not on this server, is pulled from the origin server
+        // by one upstream viewer connection and is fanned out to local viewers;
+        // the upstream connection is closed after the last local viewer (it is off, if 'm_originAddress' is empty)
+        std::string         m_originAddress;
+        uint32_t            m_originPort                = 0;
+
+        // cluster: streams are placed on 'm_clusterNodes' by consistent hashing (see ClusterRing.h);
+        // first requests of streams, that are owned by other nodes, are redirected to them
+        // (it is off, if 'm_clusterNodes' is empty; 'm_selfNode' is this server and it must be in the list)
+        std::vector<ClusterNode>    m_clusterNodes;
+        ClusterNode                 m_selfNode;
+
+        // co-located streamers could write frames to shared memory (see LocalIngest.h)
+        bool                m_isLocalIngestEnabled      = false;
+    };
+
     //
     // IDistributor - interface for Distributor
     //
@@ -17,7 +94,8 @@ namespace streaming {
     public:
         virtual ~IDistributor() = default;
 
-        virtual void startStreamManager( uint32_t port, uint threadNumber, std::string& errorText ) = 0;
+        virtual void startStreamManager( uint32_t port, uint threadNumber, std::string& errorText,
+                                         const DistributorConfig& config = DistributorConfig() ) = 0;
         virtual void stopStreamManager() = 0;
     };
 
@@ -0,0 +1,130 @@
+#pragma once
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Streaming.h"
+
+namespace catapult {
+namespace streaming {
+
+    //
+    // StreamRegistry - concurrent map StreamId -> Value (Value is a shared_ptr)
+    //
+    // Streams are spread over shards by the precomputed StreamId hash;
+    // each shard has its own lock, so requests for unrelated streams do not wait for each other.
+    // Values are released out of shard locks.
+    //
+    template<class Value, size_t SHARD_NUMBER = 64>
+    class StreamRegistry
+    {
+        struct alignas(64) Shard
+        {
+            std::mutex                                      m_mutex;
+            std::unordered_map<StreamId,Value,StreamIdHash> m_map;
+        };
+
+        Shard m_shards[SHARD_NUMBER];
+
+        Shard& shard( const StreamId& streamId ) { return m_shards[ streamId.m_hash % SHARD_NUMBER ]; }
+
+    public:
+        StreamRegistry() {}
+
+        StreamRegistry( const StreamRegistry& ) = delete;
+        StreamRegistry& operator=( const StreamRegistry& ) = delete;
+
+        // find - returns empty Value, if stream is not registered
+        Value find( const StreamId& streamId )
+        {
+            Shard& shard = this->shard( streamId );
+            const std::lock_guard<std::mutex> autolock( shard.m_mutex );
+
+            auto it = shard.m_map.find( streamId );
+            return it != shard.m_map.end() ? it->second : Value();
+        }
+
+        // insertIfAbsent - returns registered value or registers value created by 'createFunc'
+        // ('createFunc' is called under the shard lock, so it should be cheap)
+        template<class CreateFunc>
+        Value insertIfAbsent( const StreamId& streamId, CreateFunc&& createFunc, bool& isInserted )
+        {
+            Shard& shard = this->shard( streamId );
+            const std::lock_guard<std::mutex> autolock( shard.m_mutex );
+
+            auto it = shard.m_map.find( streamId );
+            if ( it != shard.m_map.end() )
+            {
+                isInserted = false;
+                return it->second;
+            }
+
+            isInserted = true;
+            return shard.m_map.emplace( streamId, createFunc() ).first->second;
+        }
+
+        // erase - returns false, if stream is not registered
+        bool erase( const StreamId& streamId )
+        {
+            Value erased;
+            {
+                Shard& shard = this->shard( streamId );
+                const std::lock_guard<std::mutex> autolock( shard.m_mutex );
+
+                auto it = shard.m_map.find( streamId );
+                if ( it == shard.m_map.end() )
+                    return false;
+
+                erased = std::move( it->second );
+                shard.m_map.erase( it );
+            }
+            return true;
+        }
+
+        // erase - erases stream only if 'value' is registered for it
+        bool erase( const StreamId& streamId, const Value& value )
+        {
+            Value erased;
+            {
+                Shard& shard = this->shard( streamId );
+                const std::lock_guard<std::mutex> autolock( shard.m_mutex );
+
+                auto it = shard.m_map.find( streamId );
+                if ( it == shard.m_map.end() || !( it->second == value ) )
+                    return false;
+
+                erased = std::move( it->second );
+                shard.m_map.erase( it );
+            }
+            return true;
+        }
+
+        // forEach - calls 'func' for snapshot of registered values
+        template<class Func>
+        void forEach( Func&& func )
+        {
+            std::vector<Value> values;
+            for( auto& shard : m_shards )
+            {
+                const std::lock_guard<std::mutex> autolock( shard.m_mutex );
+                for( auto& it : shard.m_map )
+                    values.push_back( it.second );
+            }
+
+            for( auto& value : values )
+                func( value );
+        }
+
+        size_t size()
+        {
+            size_t size = 0;
+            for( auto& shard : m_shards )
+            {
+                const std::lock_guard<std::mutex> autolock( shard.m_mutex );
+                size += shard.m_map.size();
+            }
+            return size;
+        }
+    };
+
+}} // namespace catapult { namespace streaming
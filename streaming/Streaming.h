@@ -1,5 +1,8 @@
 #pragma once
 #include <stdlib.h>
+#include <string>
+#include <functional>
+#include <mutex>
 
 //
 // For standalone debugging
@@ -59,14 +62,26 @@ namespace streaming {
     {
         std::string m_id;
 
+        // hash of m_id (it should be updated after m_id is changed)
+        size_t      m_hash = std::hash<std::string>()( std::string() );
+
         StreamId() {}
-        StreamId( const std::string& id ) : m_id(id) {}
+        StreamId( const std::string& id ) : m_id(id) { updateHash(); }
+
+        void updateHash() { m_hash = std::hash<std::string>()( m_id ); }
 
         uint32_t lenght()       const { return (uint32_t) m_id.size(); }
         const uint8_t* begin()  const { return (uint8_t*) m_id.c_str(); }
         const uint8_t* end()    const { return (uint8_t*) m_id.c_str()+m_id.size(); }
 
         bool operator<( const StreamId& id ) const { return m_id < id.m_id; }
+        bool operator==( const StreamId& id ) const { return m_hash == id.m_hash && m_id == id.m_id; }
 //        bool operator<( const StreamId& other ) const { return memcmp( id, other.id, sizeof(id) ) < 0; }
     };
+
+    // StreamIdHash - returns precomputed hash
+    struct StreamIdHash
+    {
+        size_t operator()( const StreamId& id ) const { return id.m_hash; }
+    };
 }} // namespace catapult { namespace streaming
@@ -1,14 +1,15 @@
 #pragma once
 #include <vector>
-#include <map>
+#include <utility>
 
 #include "Streaming.h"
 #include "Tpkt.h"
+#include "GatherTpkt.h"
 
 namespace catapult {
 namespace streaming {
 
-    enum { CURRENT_PROTOCOL_VERSION = 1 , PROTOCOL_VERSION = CURRENT_PROTOCOL_VERSION };
+    enum { CURRENT_PROTOCOL_VERSION = 2 , PROTOCOL_VERSION = CURRENT_PROTOCOL_VERSION };
 
     namespace cmd
     {
@@ -17,42 +18,65 @@ namespace streaming {
             OK_STREAMING_RESPONSE       = 100,
             ERROR_STREAMING_RESPONSE    = 101,
             IS_NOT_STARTED_RESPONSE     = 102,
+            STREAMING_ACK               = 103,
+            REDIRECT_RESPONSE           = 104,
 
             START_STREAMING             = 200,
             END_STREAMING               = 201,
             RESTORE_STREAMING           = 202,
             STREAMING_DATA              = 203,
+            MUX_STREAMING_DATA          = 204,
             
             START_LIFE_STREAM_VIEWING   = 300,
 
             START_FILE_STREAM_VIEWING   = 400,
+
+            START_MULTIPLEXING          = 500,
         };
 
-        inline std::map<int,std::string> cmdMap =
+        inline constexpr std::pair<Id,const char*> cmdNames[] =
         {
             { OK_STREAMING_RESPONSE,        "OK_STREAMING_RESPONSE" },
             { ERROR_STREAMING_RESPONSE,     "ERROR_STREAMING_RESPONSE" },
             { IS_NOT_STARTED_RESPONSE,      "IS_NOT_STARTED_RESPONSE" },
+            { STREAMING_ACK,                "STREAMING_ACK" },
+            { REDIRECT_RESPONSE,            "REDIRECT_RESPONSE" },
 
             { START_STREAMING,              "START_STREAMING" },
             { END_STREAMING,                "END_STREAMING" },
             { RESTORE_STREAMING,            "RESTORE_STREAMING" },
             { STREAMING_DATA,                "STREAMING_DATA" },
+            { MUX_STREAMING_DATA,           "MUX_STREAMING_DATA" },
 
             { START_LIFE_STREAM_VIEWING,    "START_LIFE_STREAM_VIEWING" },
 
             { START_FILE_STREAM_VIEWING,    "START_FILE_STREAM_VIEWING" },
+
+            { START_MULTIPLEXING,           "START_MULTIPLEXING" },
         };
 
         inline std::string name( int id )
         {
-            auto it = cmdMap.find( id );
-            if ( it != cmdMap.end() )
-                return it->second;
+            for( const auto& entry : cmdNames )
+            {
+                if ( entry.first == id )
+                    return entry.second;
+            }
             return std::string("unknown id");
         }
     }
 
+    //
+    // STREAMING_DATA packet: { version, STREAMING_DATA, frameFlags, data ... }
+    //
+    namespace frame
+    {
+        enum Flags
+        {
+            KEY_FRAME   = 0x01,     // a viewer could start decoding from this frame
+        };
+    }
+
 
 
     //
@@ -85,33 +109,17 @@ namespace streaming {
         {
             m_buffer.erase( m_buffer.begin(), m_buffer.end() );
             m_buffer.reserve( restDataLen+12 );
-            writeUint32( restDataLen+12 );
-            writeUint32( PROTOCOL_VERSION );
-            writeUint32( command );
+            writeUint32( restDataLen+12, PROTOCOL_VERSION, command );
         }
 
         void init( uint32_t restDataLen, cmd::Id command, const std::string& text )
         {
             m_buffer.erase( m_buffer.begin(), m_buffer.end() );
             m_buffer.reserve( uint32_t(text.size()+4+restDataLen+12) );
-            writeUint32( uint32_t(text.size()+4+restDataLen+12) );
-            writeUint32( PROTOCOL_VERSION );
-            writeUint32( command );
-            writeUint32( (uint32_t)text.size() );
+            writeUint32( uint32_t(text.size()+4+restDataLen+12), PROTOCOL_VERSION, command );
             writeBytes( (uint8_t*)text.c_str(), (uint32_t)text.size() );
         }
         
-        // !!! binData MUST HAVE length field at the beginning of data
-        void initWithStreamingData( uint32_t restDataLen, cmd::Id command, const uint8_t* binData, uint32_t binDataLen )
-        {
-            m_buffer.erase( m_buffer.begin(), m_buffer.end() );
-            m_buffer.reserve( restDataLen+binDataLen+12 );
-            writeUint32( restDataLen+binDataLen+12 );
-            writeUint32( PROTOCOL_VERSION );
-            writeUint32( command );
-            append( binData, binDataLen );
-        }
-
         void write( const PublicKey& key )
         {
             m_buffer.insert( m_buffer.end(), key.begin(), key.end() );
@@ -125,6 +133,15 @@ namespace streaming {
         const std::vector<uint8_t>& constBuffer() const { return m_buffer; }
     };
 
+    //
+    // StreamingGatherTpkt - StreamingTpkt, which payload is not copied (see GatherTpkt.h)
+    //
+    class StreamingGatherTpkt: public catapult::net::GatherTpkt
+    {
+    public:
+        StreamingGatherTpkt( cmd::Id command ) : GatherTpkt( PROTOCOL_VERSION, command ) {}
+    };
+
     //
     // StreamingTpktRcv - for receiving data
     //
@@ -133,6 +150,8 @@ namespace streaming {
     public:
         StreamingTpktRcv() {}
 
+        StreamingTpktRcv( net::TpktBufferPtr packet ) : TpktRcv( packet ) {}
+
 //        voiprepareToReadte( uint32_t packetLenght )
 //        {
 //            m_buffer.reserve( packetLenght );
@@ -140,9 +159,11 @@ namespace streaming {
 //            m_endPosition  = &m_buffer[packetLenght];
 //        }
 
-        void read( uint32_t& num )
+        // read - reads one or several fields (see 'TpktRcv::read()')
+        template<class... Rest>
+        void read( uint32_t& num, Rest&... rest )
         {
-            if ( !TpktRcv::read(num) )
+            if ( !TpktRcv::read( num, rest... ) )
                 throw std::runtime_error("invalid packet size");
         }
 
@@ -162,6 +183,7 @@ namespace streaming {
         void read( StreamId& id )
         {
             read( id.m_id );
+            id.updateHash();
         }
 
         void readBytes( uint8_t* ptr, uint32_t lenght )
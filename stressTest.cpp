@@ -3,9 +3,12 @@
 #include <iostream>
 #include <thread>
 #include <chrono>
+#include <atomic>
 #include "AsyncTcpServer.h"
 #include "StreamClient.h"
 #include "StreamManager.h"
+#include "FlowControl.h"
+#include "PacketSchema.h"
 
 inline std::mutex sLogMutex;
 #define _LOG(expr) { \
@@ -21,6 +24,40 @@ using namespace catapult::streaming;
 
 #define STREAM_ID    "STREAM_ID_1"
 
+#define KEY_FRAME_INTERVAL  25
+
+#define VIEWER_NUMBER       1000
+#define FRAME_NUMBER        100
+
+// the streamer starts, when all viewers are connected (or after the timeout)
+#define VIEWER_START_TIMEOUT_SECONDS 60
+
+std::atomic<int> gStartedViewerNumber{0};
+std::atomic<int> gViewerWithFramesNumber{0};
+std::atomic<int> gLostFrameNumber{0};
+std::atomic<bool> gIsStreamerCompleted{false};
+
+// readStreamingAck - reads STREAMING_ACK (CREDIT_WINDOW mode)
+void readStreamingAck( IStreamClient& tcpClient, StreamingTpktRcv& response, IngestCreditWindow& creditWindow )
+{
+    if ( !tcpClient.read( (TpktRcv&)response ) )
+        throw std::runtime_error( tcpClient.errorMessage() );
+
+    uint32_t version;
+    response.read( version );
+    uint32_t responseId;
+    response.read( responseId );
+
+    if ( responseId != cmd::STREAMING_ACK )
+        throw std::runtime_error( "responseId != cmd::STREAMING_ACK - " + cmd::name(responseId) );
+
+    uint32_t ackedFrames;
+    response.read( ackedFrames );
+    uint32_t ackedBytes;
+    response.read( ackedBytes );
+    creditWindow.onAck( ackedFrames, ackedBytes );
+}
+
 void runStreamer( std::string streamerId )
 {
     try
@@ -30,9 +67,17 @@ void runStreamer( std::string streamerId )
         if ( !tcpClient->connect( "localhost", PORT ) )
             throw std::runtime_error( tcpClient->errorMessage() );
 
-        // 2) send START_STREAMING
+        // wait for viewers, so each of them should receive all frames
+        auto startDeadline = std::chrono::steady_clock::now() + std::chrono::seconds( VIEWER_START_TIMEOUT_SECONDS );
+        while( gStartedViewerNumber < VIEWER_NUMBER && std::chrono::steady_clock::now() < startDeadline )
+        {
+            usleep(10000);
+        }
+        _LOG( "# " << streamerId << ": started viewers: " << gStartedViewerNumber << std::endl );
+
+        // 2) send START_STREAMING (and request CREDIT_WINDOW mode)
         std::string streamId( STREAM_ID );
-        StreamingTpkt pkt( 0, cmd::START_STREAMING, streamId );
+        StreamingTpkt pkt = StartStreamingRequest::encode( StreamId( streamId ), CREDIT_WINDOW );
         if ( !tcpClient->write(pkt) )
             throw std::runtime_error( tcpClient->errorMessage() );
 
@@ -42,10 +87,8 @@ void runStreamer( std::string streamerId )
             throw std::runtime_error( tcpClient->errorMessage() );
 
         // parse response
-        uint32_t version;
-        response.read( version );
-        uint32_t responseId;
-        response.read( responseId );
+        uint32_t version, responseId;
+        response.read( version, responseId );
 
         // 4) check response
         if ( responseId != cmd::OK_STREAMING_RESPONSE )
@@ -53,7 +96,7 @@ void runStreamer( std::string streamerId )
             if ( responseId == cmd::ERROR_STREAMING_RESPONSE )
             {
                 std::string errorText;
-                response.read( errorText );
+                ErrorStreamingResponse::decode( response, errorText );
                 LOG( "# " << streamerId << ": ERROR_STREAMING_RESPONSE - " << errorText << std::endl );
             }
             else
@@ -63,10 +106,21 @@ void runStreamer( std::string streamerId )
             return;
         }
 
+        // credits are granted only if server supports CREDIT_WINDOW mode
+        IngestCreditWindow creditWindow;
+        bool useCredits = false;
+        if ( response.restDataLen() >= 12 )
+        {
+            uint32_t flowControl, windowFrames, windowBytes;
+            response.read( flowControl, windowFrames, windowBytes );
+            useCredits = ( flowControl == CREDIT_WINDOW );
+            creditWindow.init( windowFrames, windowBytes );
+        }
+
         LOG( "# " << streamerId << " streaming started" << std::endl );
         auto t0 = std::chrono::high_resolution_clock::now();
 
-        for( int i=0; i<100; i++ )
+        for( int i=0; i<FRAME_NUMBER; i++ )
         {
             usleep(10);
 
@@ -77,11 +131,19 @@ void runStreamer( std::string streamerId )
             buffer[0] = 0xaa;
             buffer[dataLen-1] = 0xaa;
 
-            StreamingTpkt pkt( dataLen+4, cmd::STREAMING_DATA );
+            // (payload is not copied into the packet; 'buffer' is valid until the write is completed)
+            StreamingGatherTpkt pkt( cmd::STREAMING_DATA );
+            pkt.writeUint32( (i%KEY_FRAME_INTERVAL == 0) ? frame::KEY_FRAME : 0 );
             pkt.writeUint32( i );
             pkt.writeBytes( buffer.get(), dataLen );
 
-            // 6) send adio/video data
+            // 6) wait for credits
+            while ( useCredits && !creditWindow.canSend( (uint32_t)pkt.lenght() ) )
+            {
+                readStreamingAck( *tcpClient, response, creditWindow );
+            }
+
+            // 7) send adio/video data
             if ( !tcpClient->write(pkt) )
                 throw std::runtime_error( tcpClient->errorMessage() );
             LOG( "# " << streamerId << ": data sent; len=" << dataLen << std::endl );
@@ -90,7 +152,13 @@ void runStreamer( std::string streamerId )
             _LOG( std::chrono::duration_cast<std::chrono::microseconds>( t - t0 ).count()/1000000.0 );
             t0 = t;
 
-            // 7) get response
+            if ( useCredits )
+            {
+                creditWindow.onSent( (uint32_t)pkt.lenght() );
+                continue;
+            }
+
+            // 8) get response
             if ( !tcpClient->read( (TpktRcv&)response ) )
                 throw std::runtime_error( tcpClient->errorMessage() );
 
@@ -100,7 +168,7 @@ void runStreamer( std::string streamerId )
             uint32_t responseId;
             response.read( responseId );
 
-            // 8) check response
+            // 9) check response
             if ( responseId != cmd::OK_STREAMING_RESPONSE )
             {
                 LOG( "# " << streamerId << ": streaming error; responseId != cmd::OK_STREAMING_RESPONSE - " << cmd::name(responseId) << std::endl );
@@ -108,11 +176,13 @@ void runStreamer( std::string streamerId )
             }
         }
 
-        // 9) send END_STREAMING command
+        // 10) send END_STREAMING command
         //std::string streamId( STREAM_ID );
         StreamingTpkt pkt2( 0, cmd::END_STREAMING, streamId );
         if ( !tcpClient->write(pkt2) )
             throw std::runtime_error( tcpClient->errorMessage() );
+
+        gIsStreamerCompleted = true;
     }
     catch ( std::runtime_error error )
     {
@@ -150,6 +220,8 @@ void runViewer( std::string viewerId, int viewerIndex )
         uint32_t responseId;
         response.read( responseId );
 
+        gStartedViewerNumber++;
+
         // 4) check response
         if ( responseId == cmd::OK_STREAMING_RESPONSE )
         {
@@ -188,16 +260,25 @@ void runViewer( std::string viewerId, int viewerIndex )
                 return;
             }
 
+            uint32_t frameFlags;
+            response.read(frameFlags);
+
             // check gaps
             uint32_t i;
             response.read(i);
             if ( prevI == uint32_t(-1) )
             {
                 _LOG( viewerId << " first i="<< i << std::endl );
+                gViewerWithFramesNumber++;
+            }
+            else if ( i != prevI+1 && (frameFlags & frame::KEY_FRAME) )
+            {
+                _LOG( "### " << viewerId << " skipped to key frame; lost "<< i-prevI-1 << std::endl );
             }
             else if ( i != prevI+1 )
             {
                 _LOG( "### " << viewerId << " lost "<< i-prevI-1 << std::endl );
+                gLostFrameNumber++;
             }
             prevI = i;
 
@@ -234,7 +315,7 @@ int main(int, const char * [])
     std::thread streamerThread( [] { runStreamer("Streamer1"); } );
 
     std::vector<std::thread> viewers;
-    for( int i=0; i<1000; i++ )
+    for( int i=0; i<VIEWER_NUMBER; i++ )
     {
         viewers.emplace_back( [i] {
             std::string name = std::string("Viewer_") + std::to_string(i);
@@ -255,6 +336,13 @@ int main(int, const char * [])
     gStreamManager().stopStreamManager();
     serverThread.join();
 
+    // (a slow viewer could skip frames to a key frame, but it must not lose other frames)
+    _LOG( "viewers with frames: " << gViewerWithFramesNumber << " of " << VIEWER_NUMBER << "; lost frames: " << gLostFrameNumber << std::endl );
+    if ( !gIsStreamerCompleted || gViewerWithFramesNumber != VIEWER_NUMBER || gLostFrameNumber != 0 )
+    {
+        _LOG( "stress test FAILED" << std::endl );
+        return 1;
+    }
     return 0;
 }
 
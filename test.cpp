@@ -75,7 +75,8 @@ void runStreamer( std::string streamerId )
             memset(buffer+1, 0xee, dataLen-2 );
             buffer[0] = 0xaa;
             buffer[dataLen-1] = 0xaa;
-            StreamingTpkt pkt( dataLen, cmd::STREAMING_DATA );
+            StreamingTpkt pkt( dataLen+8, cmd::STREAMING_DATA );
+            pkt.writeUint32( frame::KEY_FRAME );
             pkt.writeBytes( buffer, dataLen );
 
             // 5) send adio/video data
@@ -173,6 +174,9 @@ void runViewer( std::string viewerId )
                 return;
             }
 
+            uint32_t frameFlags;
+            response.read(frameFlags);
+
             // get data len
             uint32_t dataLen;
             response.read(dataLen);
@@ -0,0 +1,137 @@
+//
+//  tpktBench.cpp
+//  Streaming
+//
+//  Microbenchmark of Tpkt encoding/decoding:
+//  byte-by-byte codec (as it was) vs. one store/load per field (see ByteOrder.h)
+//
+
+#include <iostream>
+#include <chrono>
+#include "StreamingTpkt.h"
+
+using namespace catapult::net;
+using namespace catapult::streaming;
+
+#define ITERATIONS  10*1000*1000
+
+// ByteTpkt - previous encoder: 4 'push_back' per field
+class ByteTpkt : public StreamingTpkt
+{
+public:
+    void init( cmd::Id command )
+    {
+        m_buffer.clear();
+        m_buffer.reserve( 20 );
+        writeByteUint32( 20 );
+        writeByteUint32( PROTOCOL_VERSION );
+        writeByteUint32( command );
+    }
+
+    void writeByteUint32( uint32_t val )
+    {
+        m_buffer.push_back( (val      ) & 0xFF );
+        m_buffer.push_back( (val >>  8) & 0xFF );
+        m_buffer.push_back( (val >> 16) & 0xFF );
+        m_buffer.push_back( (val >> 24) & 0xFF );
+    }
+};
+
+// readByteUint32 - previous decoder: bounds check and 4 loads per field
+inline bool readByteUint32( const uint8_t*& readPosition, const uint8_t* endPosition, uint32_t& val )
+{
+    if ( endPosition - readPosition < 4 )
+        return false;
+
+    val = *readPosition++;
+    val |= *readPosition++ << 8;
+    val |= *readPosition++ << 16;
+    val |= uint32_t(*readPosition++) << 24;
+
+    return true;
+}
+
+template<class Func>
+void measure( const char* title, Func&& func )
+{
+    auto t0 = std::chrono::steady_clock::now();
+    uint32_t checksum = func();
+    auto t = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration_cast<std::chrono::nanoseconds>( t - t0 ).count() / double(ITERATIONS);
+    std::cout << title << ": " << ns << " ns/packet (checksum " << checksum << ")" << std::endl;
+}
+
+int main()
+{
+    // encode header and 2 fields of STREAMING_DATA
+    measure( "encode byte-by-byte", []
+    {
+        ByteTpkt pkt;
+        uint32_t checksum = 0;
+        for( uint32_t i=0; i<ITERATIONS; i++ )
+        {
+            pkt.init( cmd::STREAMING_DATA );
+            pkt.writeByteUint32( i&1 );
+            pkt.writeByteUint32( i );
+            checksum += pkt.ptr()[16];
+        }
+        return checksum;
+    });
+
+    measure( "encode by fields   ", []
+    {
+        StreamingTpkt pkt;
+        uint32_t checksum = 0;
+        for( uint32_t i=0; i<ITERATIONS; i++ )
+        {
+            pkt.init( 8, cmd::STREAMING_DATA );
+            pkt.writeUint32( i&1, i );
+            checksum += pkt.ptr()[16];
+        }
+        return checksum;
+    });
+
+    // decode the same fields
+    StreamingTpkt pkt( 8, cmd::STREAMING_DATA );
+    pkt.writeUint32( 1, 2 );
+    StreamingTpktRcv rcv;
+    rcv.prepareToRead( uint32_t(pkt.lenght()) );
+    std::memcpy( rcv.ptr(), pkt.ptr(), pkt.lenght() );
+    TpktBufferPtr packet = rcv.sharedBuffer();
+
+    measure( "decode byte-by-byte", [&]
+    {
+        uint32_t checksum = 0;
+        for( uint32_t i=0; i<ITERATIONS; i++ )
+        {
+            StreamingTpktRcv request( packet );
+            const uint8_t* readPosition = request.restDataPtr();
+            const uint8_t* endPosition  = readPosition + request.restDataLen();
+            uint32_t version, command, frameFlags, seq;
+            readByteUint32( readPosition, endPosition, version );
+            readByteUint32( readPosition, endPosition, command );
+            readByteUint32( readPosition, endPosition, frameFlags );
+            readByteUint32( readPosition, endPosition, seq );
+            checksum += version + command + frameFlags + seq;
+            asm volatile( "" : : "r"(readPosition) : "memory" );
+        }
+        return checksum;
+    });
+
+    measure( "decode by fields   ", [&]
+    {
+        uint32_t checksum = 0;
+        for( uint32_t i=0; i<ITERATIONS; i++ )
+        {
+            StreamingTpktRcv request( packet );
+            uint32_t version, command, frameFlags, seq;
+            request.read( version, command, frameFlags, seq );
+            checksum += version + command + frameFlags + seq;
+            asm volatile( "" : : "r"(&request) : "memory" );
+        }
+        return checksum;
+    });
+
+    return 0;
+}
@@ -0,0 +1,249 @@
+#include <unistd.h>
+
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include "StreamClient.h"
+#include "StreamManager.h"
+#include "PacketSchema.h"
+#include "TestUtil.h"
+
+//
+// tpktTest - encoding of transport packets (see ByteOrder.h, Tpkt.h and GatherTpkt.h)
+//
+
+using namespace catapult::net;
+using namespace catapult::streaming;
+
+#define PORT                    7660
+#define STREAM_ID               "GATHER_TPKT"
+#define FRAME_NUMBER            20
+
+// gatherBytes - bytes, that are written for the packet
+std::vector<uint8_t> gatherBytes( const GatherTpkt& packet )
+{
+    std::vector<uint8_t> bytes;
+    packet.forEachBuffer( [&bytes]( const uint8_t* data, size_t size )
+    {
+        bytes.insert( bytes.end(), data, data+size );
+    });
+    return bytes;
+}
+
+// testGatherTpkt - the packet is written as the same bytes as StreamingTpkt, but its payload is not copied
+void testGatherTpkt()
+{
+    std::vector<uint8_t> payload  = makePayload( 1, 1000 );
+    std::vector<uint8_t> trailer  = makePayload( 2, 100 );
+
+    StreamingGatherTpkt gatherPkt( cmd::STREAMING_DATA );
+    gatherPkt.writeUint32( frame::KEY_FRAME );
+    gatherPkt.writeUint32( 1 );
+    gatherPkt.writeBytes( payload.data(), uint32_t(payload.size()) );
+    gatherPkt.append( trailer.data(), uint32_t(trailer.size()) );
+    gatherPkt.updatePacketLenght();
+
+    StreamingTpkt pkt( 12+payload.size()+trailer.size(), cmd::STREAMING_DATA );
+    pkt.writeUint32( frame::KEY_FRAME );
+    pkt.writeUint32( 1 );
+    pkt.writeBytes( payload.data(), uint32_t(payload.size()) );
+    pkt.append( trailer.data(), uint32_t(trailer.size()) );
+    pkt.updatePacketLenght();
+
+    CHECK( gatherPkt.lenght() == pkt.lenght() );
+    CHECK( gatherBytes( gatherPkt ) == pkt.constBuffer() );
+
+    // { inline fields }, payload, trailer: consecutive fields are one buffer; payloads are referenced
+    std::vector<std::pair<const uint8_t*,size_t>> buffers;
+    gatherPkt.forEachBuffer( [&buffers]( const uint8_t* data, size_t size ) { buffers.emplace_back( data, size ); } );
+    CHECK( buffers.size() == 3 );
+    if ( buffers.size() == 3 )
+    {
+        CHECK( buffers[0].second == 24 );
+        CHECK( buffers[1].first == payload.data() && buffers[1].second == payload.size() );
+        CHECK( buffers[2].first == trailer.data() && buffers[2].second == trailer.size() );
+    }
+
+    // a shared span holds its owner until the packet is released
+    auto owner = std::make_shared<std::vector<uint8_t>>( makePayload( 3, 500 ) );
+    std::weak_ptr<std::vector<uint8_t>> weakOwner = owner;
+    auto sharedPkt = std::make_shared<StreamingGatherTpkt>( cmd::STREAMING_DATA );
+    sharedPkt->writeUint32( 0 );
+    sharedPkt->writeBytes( owner, owner->data(), uint32_t(owner->size()) );
+    owner.reset();
+    CHECK( !weakOwner.expired() );
+    sharedPkt.reset();
+    CHECK( weakOwner.expired() );
+
+    // inline fields are limited
+    StreamingGatherTpkt longPkt( cmd::STREAMING_DATA );
+    bool isThrown = false;
+    try
+    {
+        for( int i = 0; i < 64; i++ )
+            longPkt.writeUint32( i );
+    }
+    catch( std::runtime_error& )
+    {
+        isThrown = true;
+    }
+    CHECK( isThrown );
+}
+
+// toReceived - packet, as it is received (see 'TpktRcv::prepareToRead()')
+StreamingTpktRcv toReceived( const StreamingTpkt& pkt )
+{
+    TpktBufferPtr buffer = acquireTpktBuffer( nullptr, uint32_t(pkt.lenght()) );
+    buffer->setLenght( uint32_t(pkt.lenght()) );
+    memcpy( buffer->data(), pkt.ptr(), pkt.lenght() );
+    return StreamingTpktRcv( buffer );
+}
+
+// testByteOrder - fields are little-endian at any (unaligned) offset
+void testByteOrder()
+{
+    uint8_t bytes[12] = {};
+    for( size_t offset = 0; offset < 8; offset++ )
+    {
+        memset( bytes, 0, sizeof(bytes) );
+        storeUint32LE( bytes+offset, 0x04030201 );
+        CHECK( bytes[offset] == 1 && bytes[offset+1] == 2 && bytes[offset+2] == 3 && bytes[offset+3] == 4 );
+        CHECK( loadUint32LE( bytes+offset ) == 0x04030201 );
+    }
+
+    TpktLen len( 0xA1B2C3D4 );
+    CHECK( len.bytes[0] == 0xD4 && len.bytes[3] == 0xA1 );
+    CHECK( len.uint32() == 0xA1B2C3D4 );
+}
+
+// testTpktCodec - fields, that are written by one call, are read back by one call with one bounds check
+void testTpktCodec()
+{
+    std::string text( "text" );
+
+    StreamingTpkt pkt( 12+4+uint32_t(text.size()), cmd::STREAMING_DATA );
+    pkt.writeUint32( 1, 0xFFFFFFFF, 0x80000000 );
+    pkt.writeBytes( (const uint8_t*) text.c_str(), uint32_t(text.size()) );
+
+    // (the exact size is reserved, so the packet lenght is already valid)
+    CHECK( pkt.lenght() == 12+12+4+text.size() );
+    CHECK( loadUint32LE( pkt.ptr() ) == pkt.lenght() );
+    CHECK( loadUint32LE( pkt.ptr()+4 ) == PROTOCOL_VERSION );
+    CHECK( loadUint32LE( pkt.ptr()+8 ) == cmd::STREAMING_DATA );
+    CHECK( loadUint32LE( pkt.ptr()+12 ) == 1 );
+
+    StreamingTpktRcv received = toReceived( pkt );
+    uint32_t version, command, a, b, c;
+    received.read( version, command, a, b, c );
+    CHECK( version == PROTOCOL_VERSION && command == cmd::STREAMING_DATA );
+    CHECK( a == 1 && b == 0xFFFFFFFF && c == 0x80000000 );
+
+    std::string str;
+    received.read( str );
+    CHECK( str == text );
+    CHECK( received.restDataLen() == 0 );
+
+    // a short packet: nothing is read
+    StreamingTpktRcv shortPacket = toReceived( pkt );
+    uint32_t fields[8] = {};
+    CHECK( !shortPacket.TpktRcv::read( fields[0], fields[1], fields[2], fields[3], fields[4], fields[5], fields[6], fields[7] ) );
+    CHECK( fields[0] == 0 );
+    CHECK( shortPacket.restDataLen() == pkt.lenght()-4 );
+
+    bool isThrown = false;
+    try
+    {
+        shortPacket.read( fields[0], fields[1], fields[2], fields[3], fields[4], fields[5], fields[6], fields[7] );
+    }
+    catch( std::runtime_error& )
+    {
+        isThrown = true;
+    }
+    CHECK( isThrown );
+
+    // the lenght of string is greater than the rest of packet
+    StreamingTpkt badString( 4, cmd::STREAMING_DATA );
+    badString.writeUint32( 100 );
+    StreamingTpktRcv badReceived = toReceived( badString );
+    badReceived.read( version, command );
+    isThrown = false;
+    try
+    {
+        badReceived.read( str );
+    }
+    catch( std::runtime_error& )
+    {
+        isThrown = true;
+    }
+    CHECK( isThrown );
+}
+
+// testGatherWrite - frames, that are written as buffer sequences, are received by a viewer as they were encoded
+void testGatherWrite()
+{
+    std::string streamId( STREAM_ID );
+
+    auto streamer = connect( PORT, StartStreamingRequest::encode( StreamId( streamId ), 0 ) );
+    auto viewer   = connect( PORT, StreamingTpkt( 0, cmd::START_LIFE_STREAM_VIEWING, streamId ) );
+
+    StreamingTpktRcv response;
+    StreamingTpktRcv viewerResponse;
+
+    for( uint32_t i = 0; i < FRAME_NUMBER; i++ )
+    {
+        std::vector<uint8_t> payload = makePayload( i, 10*1000+i );
+        std::vector<uint8_t> trailer = makePayload( i+1, 100 );
+
+        StreamingGatherTpkt pkt( cmd::STREAMING_DATA );
+        pkt.writeUint32( (i%10 == 0) ? frame::KEY_FRAME : 0 );
+        pkt.writeUint32( i );
+        pkt.writeBytes( payload.data(), uint32_t(payload.size()) );
+        pkt.append( trailer.data(), uint32_t(trailer.size()) );
+        CHECK( streamer->write( pkt ) );
+        CHECK( readResponse( *streamer, response ) == cmd::OK_STREAMING_RESPONSE );
+
+        CHECK( readResponse( *viewer, viewerResponse ) == cmd::STREAMING_DATA );
+        TpktBufferPtr received = viewerResponse.sharedBuffer();
+        std::vector<uint8_t> expected = gatherBytes( pkt );
+        CHECK( received->lenght() == expected.size() );
+        CHECK( received->lenght() == expected.size() && memcmp( received->data(), expected.data(), expected.size() ) == 0 );
+    }
+
+    StreamingTpkt endStreaming( 0, cmd::END_STREAMING, streamId );
+    CHECK( streamer->write( endStreaming ) );
+}
+
+int main( int, const char* [] )
+{
+    std::string errorText;
+    gStreamManager().startStreamManager( PORT, 2, errorText );
+    if ( !errorText.empty() )
+    {
+        _LOG( "cannot start server: " << errorText );
+        return 1;
+    }
+
+    try
+    {
+        testByteOrder();
+        testTpktCodec();
+        testGatherTpkt();
+        testGatherWrite();
+    }
+    catch( std::runtime_error& error )
+    {
+        _LOG( "tpktTest: " << error.what() );
+        gErrorNumber++;
+    }
+
+    gStreamManager().stopStreamManager();
+
+    if ( gErrorNumber != 0 )
+    {
+        _LOG( "tpktTest FAILED: " << gErrorNumber << " errors" );
+        return 1;
+    }
+    _LOG( "tpktTest passed" );
+    return 0;
+}
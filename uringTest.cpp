@@ -0,0 +1,140 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include "AsyncTcpServer.h"
+#include "StreamClient.h"
+#include "StreamManager.h"
+#include "PacketSchema.h"
+#include "TestUtil.h"
+
+//
+// uringTest - streaming over io_uring backend (see UringTcpServer.cpp);
+// it is skipped (SKIP_RETURN_CODE), if io_uring is not supported by the kernel
+//
+
+using namespace catapult::net;
+using namespace catapult::streaming;
+
+#define PORT                    7662
+#define SKIP_RETURN_CODE        77
+#define VIEWER_NUMBER           20
+#define FRAME_NUMBER            100
+
+// makeUringFrame - every 3rd frame is bigger than ZERO_COPY_MIN_BYTES of UringTcpSession (it is sent by IORING_OP_SEND_ZC)
+StreamingTpkt makeUringFrame( uint32_t i )
+{
+    return makeFrame( i, (i%3 == 0) ? 200*1000+i : 1000+i );
+}
+
+// testFanOut - small and zero-copy frames are fanned out to all viewers;
+// a viewer, that closes its connection, does not stop the stream
+void testFanOut()
+{
+    std::string streamId( "URING_FAN_OUT" );
+    auto streamer = connect( PORT, StartStreamingRequest::encode( StreamId( streamId ), 0 ) );
+
+    std::vector<std::unique_ptr<Viewer>> viewers;
+    for( int i = 0; i < VIEWER_NUMBER; i++ )
+    {
+        viewers.push_back( std::make_unique<Viewer>( PORT, streamId ) );
+    }
+    Viewer leavingViewer( PORT, streamId, FRAME_NUMBER/2 );
+
+    StreamingTpktRcv response;
+    for( uint32_t i = 0; i < FRAME_NUMBER; i++ )
+    {
+        StreamingTpkt pkt = makeUringFrame( i );
+        CHECK( streamer->write( pkt ) );
+        CHECK( readResponse( *streamer, response ) == cmd::OK_STREAMING_RESPONSE );
+    }
+
+    // (frames, that are queued to viewers, are not sent after the end of stream)
+    CHECK( waitFor( [&] { return std::all_of( viewers.begin(), viewers.end(), []( auto& viewer ) { return viewer->m_frameNumber == FRAME_NUMBER; } ); } ) );
+
+    StreamingTpkt endStreaming( 0, cmd::END_STREAMING, streamId );
+    CHECK( streamer->write( endStreaming ) );
+
+    for( auto& viewer : viewers )
+    {
+        viewer->join();
+        CHECK( viewer->m_frameNumber == FRAME_NUMBER );
+        CHECK( viewer->m_lastFrame == FRAME_NUMBER-1 );
+        CHECK( !viewer->m_hasGap );
+        CHECK( !viewer->m_hasBadData );
+    }
+
+    leavingViewer.join();
+    CHECK( leavingViewer.m_frameNumber == FRAME_NUMBER/2 );
+    CHECK( !leavingViewer.m_hasBadData );
+}
+
+// testLateViewer - a new viewer starts from the last key frame (GOP cache is written as a batch)
+void testLateViewer()
+{
+    std::string streamId( "URING_LATE_VIEWER" );
+    auto streamer = connect( PORT, StartStreamingRequest::encode( StreamId( streamId ), 0 ) );
+
+    StreamingTpktRcv response;
+    for( uint32_t i = 0; i < 25; i++ )
+    {
+        StreamingTpkt pkt = makeUringFrame( i );
+        CHECK( streamer->write( pkt ) );
+        CHECK( readResponse( *streamer, response ) == cmd::OK_STREAMING_RESPONSE );
+    }
+
+    Viewer viewer( PORT, streamId );
+    CHECK( waitFor( [&] { return viewer.m_frameNumber == 5; } ) );
+
+    StreamingTpkt endStreaming( 0, cmd::END_STREAMING, streamId );
+    CHECK( streamer->write( endStreaming ) );
+
+    viewer.join();
+    CHECK( viewer.m_frameNumber == 5 );
+    CHECK( viewer.m_lastFrame == 24 );
+    CHECK( !viewer.m_hasGap );
+    CHECK( !viewer.m_hasBadData );
+}
+
+int main( int, const char* [] )
+{
+    std::string errorText;
+    if ( !createUringTcpServer( []( std::shared_ptr<IAsyncTcpSession> ) {}, errorText ) )
+    {
+        _LOG( "io_uring is not available (" << errorText << "); uringTest is skipped" );
+        return SKIP_RETURN_CODE;
+    }
+
+    DistributorConfig config;
+    config.m_tcpServerMode = TcpServerMode::IO_URING;
+
+    gStreamManager().startStreamManager( PORT, 2, errorText, config );
+    if ( !errorText.empty() )
+    {
+        _LOG( "cannot start server: " << errorText );
+        return 1;
+    }
+
+    try
+    {
+        testFanOut();
+        testLateViewer();
+    }
+    catch( std::runtime_error& error )
+    {
+        _LOG( "uringTest: " << error.what() );
+        gErrorNumber++;
+    }
+
+    gStreamManager().stopStreamManager();
+
+    if ( gErrorNumber != 0 )
+    {
+        _LOG( "uringTest FAILED: " << gErrorNumber << " errors" );
+        return 1;
+    }
+    _LOG( "uringTest passed" );
+    return 0;
+}